@@ -291,8 +291,13 @@ end
 --------------------------------------------------------------------------------
 -- [ PROJECT CONFIG ]
 --------------------------------------------------------------------------------
-local function setup_project()
-    project "sketchpad"
+-- the same sources are built into two executables: "sketchpad" is the regular
+-- interactive application, "sketchpad_bench" is a headless benchmark runner
+-- that renders every scene offscreen for a fixed number of frames and writes
+-- a JSON report of the frame timings (see `src/core/bench.h`).
+--------------------------------------------------------------------------------
+local function setup_project(name)
+    project(name)
         kind "ConsoleApp"
         language "C++"
         cppdialect "C++17"
@@ -303,7 +308,7 @@ local function setup_project()
         -- build all binaries into the build folder
         objdir(OBJECT_DIR .. "%{prj.name}/" .. OUTPUT_DIR)
         targetdir(TARGET_DIR .. "%{prj.name}/" .. OUTPUT_DIR)
-        targetname "sketchpad"  -- sketchpad.exe
+        targetname(name)  -- sketchpad.exe or sketchpad_bench.exe
 
         -- use main() instead of WinMain() as the application entry point
         entrypoint "mainCRTStartup"
@@ -334,6 +339,12 @@ local function setup_project()
             defines "__FREEGLUT__"
         end
 
+        -- the benchmark runner replaces the main event loop with a fixed number of frames,
+        -- trace and debug logs are compiled out so that they don't skew the measurements
+        if name == "sketchpad_bench" then
+            defines { "__BENCHMARK__", "SP_LOG_LEVEL=2" }
+        end
+
         -- precompiled headers
         pchheader "pch.h"
         pchsource "src/pch.cpp"
@@ -506,7 +517,8 @@ local function main()
     ----------------------------------------------------------------------------
     setup_solution()
     setup_vendor_library()
-    setup_project()
+    setup_project("sketchpad")
+    setup_project("sketchpad_bench")
 end
 
 --------------------------------------------------------------------------------
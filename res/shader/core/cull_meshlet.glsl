@@ -0,0 +1,131 @@
+#version 460 core
+
+// GPU culling of the meshlets of a mesh (see "utils/meshopt.h"), each invocation tests one
+// meshlet against the view frustum, its normal cone and optionally the depth pyramid built
+// by "depth_pyramid.glsl", and appends a draw command for the meshlet if it may be visible.
+// the commands are then consumed by `glMultiDrawElementsIndirectCount`, see `Mesh::DrawClusters()`
+// reference:
+// https://advances.realtimerendering.com/s2015/aaltonenhaar_siggraph2015_combined_final_footer_220dpi.pdf
+// https://zeux.io/2023/04/28/triangle-backface-culling/
+
+#ifdef compute_shader
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+struct Meshlet {
+    vec4 sphere;  // xyz = center, w = radius, in local space
+    vec4 cone;    // xyz = axis, w = cutoff
+    uint first_index;
+    uint n_indices;
+    uint n_verts;
+    uint padding;
+};
+
+struct DrawCommand {
+    uint count;
+    uint n_instances;
+    uint first_index;
+    int  base_vertex;
+    uint base_instance;
+};
+
+layout(std430, binding = 8) restrict readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+layout(std430, binding = 9) restrict buffer Clusters {
+    uint n_draws;
+    DrawCommand commands[];
+};
+
+layout(location = 0) uniform uint n_meshlets;
+layout(location = 1) uniform mat4 model;
+layout(location = 2) uniform mat4 view_projection;
+layout(location = 3) uniform vec3 camera_position;  // in local space
+layout(location = 4) uniform float scale;           // largest scale of the model matrix
+layout(location = 5) uniform bool cone_culling;     // only valid when back faces are culled
+layout(location = 6) uniform bool occlusion_culling;
+layout(location = 7) uniform vec4 frustum[6];       // world space planes, normals point inward
+layout(location = 13) uniform uint first_index;     // offsets of the mesh in the geometry arena
+layout(location = 14) uniform int base_vertex;
+layout(binding = 0) uniform sampler2D depth_pyramid;
+
+// test the screen-space bounding rectangle of a sphere against the depth pyramid, the level is
+// chosen so that the rectangle covers at most 2 x 2 texels, so 4 fetches are always enough
+bool Occluded(vec3 center, float radius) {
+    vec2 min_uv = vec2(1.0);
+    vec2 max_uv = vec2(0.0);
+    float min_depth = 1.0;
+
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = center + radius * vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * 2.0 - radius;
+        vec4 clip = view_projection * vec4(corner, 1.0);
+
+        if (clip.w <= 0.0) {
+            return false;  // the box crosses the near plane, don't bother
+        }
+
+        vec3 ndc = clip.xyz / clip.w;
+        min_uv = min(min_uv, ndc.xy * 0.5 + 0.5);
+        max_uv = max(max_uv, ndc.xy * 0.5 + 0.5);
+        min_depth = min(min_depth, ndc.z * 0.5 + 0.5);
+    }
+
+    ivec2 size = textureSize(depth_pyramid, 0);
+    ivec2 lower = ivec2(clamp(min_uv, 0.0, 1.0) * vec2(size));
+    ivec2 upper = min(ivec2(clamp(max_uv, 0.0, 1.0) * vec2(size)), size - 1);
+    lower = min(lower, upper);
+
+    int extent = max(upper.x - lower.x, upper.y - lower.y) + 1;
+    int level = min(findMSB(extent - 1) + 1, textureQueryLevels(depth_pyramid) - 1);
+
+    // texel `x` of a level covers texels `x << level` to `(x + 1) << level` of level 0, the last
+    // one also covers the remainder of an odd size, so we shift and clamp rather than scale uvs
+    ivec2 level_size = textureSize(depth_pyramid, level);
+    ivec2 a = min(lower >> level, level_size - 1);
+    ivec2 b = min(upper >> level, level_size - 1);
+
+    float max_depth = max(
+        max(texelFetch(depth_pyramid, ivec2(a.x, a.y), level).r, texelFetch(depth_pyramid, ivec2(b.x, a.y), level).r),
+        max(texelFetch(depth_pyramid, ivec2(a.x, b.y), level).r, texelFetch(depth_pyramid, ivec2(b.x, b.y), level).r)
+    );
+
+    return min_depth > max_depth;
+}
+
+void main() {
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= n_meshlets) {
+        return;
+    }
+
+    Meshlet meshlet = meshlets[id];
+    vec3 center = vec3(model * vec4(meshlet.sphere.xyz, 1.0));
+    float radius = meshlet.sphere.w * scale;
+
+    // step 1: the bounding sphere must not lie entirely outside any of the 6 frustum planes
+    for (int i = 0; i < 6; i++) {
+        if (dot(frustum[i].xyz, center) + frustum[i].w < -radius) {
+            return;
+        }
+    }
+
+    // step 2: if the camera is within the normal cone, extended by the sphere, every triangle of
+    // the meshlet is back-facing, plane sides are preserved by affine maps so local space is fine
+    if (cone_culling) {
+        vec3 v = meshlet.sphere.xyz - camera_position;
+        if (dot(v, meshlet.cone.xyz) >= meshlet.cone.w * length(v) + meshlet.sphere.w) {
+            return;
+        }
+    }
+
+    // step 3: the nearest point of the bounding box must not be behind the depth pyramid
+    if (occlusion_culling && Occluded(center, radius)) {
+        return;
+    }
+
+    uint slot = atomicAdd(n_draws, 1);
+    commands[slot] = DrawCommand(meshlet.n_indices, 1, first_index + meshlet.first_index, base_vertex, 0);
+}
+
+#endif
@@ -0,0 +1,47 @@
+#version 460 core
+
+// build a hierarchical depth buffer (Hi-Z) for occlusion culling, each texel of a level holds
+// the farthest depth of the texels it covers in the level below, so a bounding box is hidden
+// if its nearest depth is farther than a few texels of the level that matches its screen size
+
+#ifdef compute_shader
+
+layout(local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+layout(location = 0) uniform int level;  // the level to write, level 0 is copied from the depth buffer
+layout(binding = 0) uniform sampler2D depth_texture;
+layout(binding = 0, r32f) restrict readonly uniform image2D src_level;
+layout(binding = 1, r32f) restrict writeonly uniform image2D dst_level;
+
+void main() {
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(dst_level);
+
+    if (coord.x >= size.x || coord.y >= size.y) {
+        return;
+    }
+
+    if (level == 0) {
+        imageStore(dst_level, coord, vec4(texelFetch(depth_texture, coord, 0).r));
+        return;
+    }
+
+    // when the level below has an odd size, the last texel of a row or column also covers the
+    // extra texel, o/w its depth would be dropped and the pyramid would no longer be conservative
+    ivec2 src_size = imageSize(src_level);
+    ivec2 first = coord * 2;
+    ivec2 last = first + 1 + ivec2(equal(coord, size - 1)) * (src_size & 1);
+    last = min(last, src_size - 1);
+
+    float depth = 0.0;
+
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++) {
+            depth = max(depth, imageLoad(src_level, ivec2(x, y)).r);
+        }
+    }
+
+    imageStore(dst_level, coord, vec4(depth));
+}
+
+#endif
@@ -276,6 +276,14 @@ vec3 EvaluateAL(const Pixel px, const vec3 L) {
     return Lo;
 }
 
+// samples the tangent-space normal map, z is reconstructed from xy so that two-channel BC5
+// normal maps work as well, for uncompressed RGB maps the blue channel is simply ignored
+vec3 SampleNormal(const vec2 uv) {
+    vec2 xy = texture(normal_map, uv).rg * 2.0 - 1.0;
+    float z = sqrt(max(1.0 - dot(xy, xy), 0.0));
+    return vec3(xy, z);
+}
+
 /*********************************** MAIN API ***********************************/
 
 // initializes the current pixel (fragment), values are computed from the material inputs
@@ -286,7 +294,7 @@ void InitPixel(inout Pixel px, const vec3 camera_pos) {
         ComputeTBN(px._position, px._normal, px.uv);  // approximate using partial derivatives
 
     px.V = normalize(camera_pos - px.position);
-    px.N = sample_normal ? normalize(px.TBN * (texture(normal_map, px.uv).rgb * 2.0 - 1.0)) : px._normal;
+    px.N = sample_normal ? normalize(px.TBN * SampleNormal(px.uv)) : px._normal;
     px.R = reflect(-px.V, px.N);
     px.NoV = max(dot(px.N, px.V), 1e-4);
 
@@ -400,7 +408,8 @@ vec3 EvaluateIBL(const Pixel px) {
     // diffuse color directly. Do not divide by PI here cause that will be double-counting
     // for spherical harmonics, INV_PI should be rolled into SH9 during C++ precomputation
 
-    Fd = texture(irradiance_map, px.N).rgb * px.diffuse_color * (1.0 - E);
+    vec3 irradiance = irradiance_sh ? EvaluateSH3(px.N) : texture(irradiance_map, px.N).rgb;
+    Fd = max(irradiance, 0.0) * px.diffuse_color * (1.0 - E);
     Fd *= AO;  // apply ambient occlussion and multi-scattering colored GTAO
 
     if (model.x == 2) {  // refraction model
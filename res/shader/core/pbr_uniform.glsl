@@ -66,6 +66,13 @@ layout(location = 927) uniform vec3  subsurface_color;
 layout(location = 929) uniform float clearcoat;
 layout(location = 930) uniform float clearcoat_roughness;
 
+// diffuse IBL can be evaluated from 9 SH coefficients projected on the CPU (locations 940-948),
+// which replaces the irradiance map fetch, see `IBLBaker` and `imgproc::ProjectSH()`
+layout(location = 932) uniform bool  irradiance_sh;
+
+#define SH_UNIFORM_LOCATION 940
+#include "../utils/sh9.glsl"
+
 // the subsurface scattering model is very different and hard so we'll skip it for now, the way
 // that Disney BSDF (2015) and Filament handles real-time SSS is very hacky, which is not worth
 // learning at the moment. A decent SSS model usually involves an approximation of path tracing
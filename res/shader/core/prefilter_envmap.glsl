@@ -5,14 +5,19 @@
 #ifdef compute_shader
 
 #include "../utils/projection.glsl"
-#include "../utils/material.glsl"
-#include "../utils/sampling.glsl"
 
 layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
 layout(binding = 0) uniform samplerCube environment_map;
 layout(binding = 1, rgba16f) restrict writeonly uniform imageCube prefilter_map;
 
-layout(location = 0) uniform float roughness;
+// GGX samples of the current roughness level, drawn on the CPU by `IBLBaker` since they are the
+// same for every texel under the `N = V = R` assumption: xyz = tangent space light direction
+// (so that NoL = z, samples with NoL <= 0 have been dropped already), w = source mipmap level
+layout(std430, binding = 7) readonly buffer GGXSamples {
+    vec4 samples[];
+};
+
+layout(location = 0) uniform uint n_samples;
 
 /* this part of the integral does not have the cosine term, we simply average all the
    incoming radiance Li over the hemisphere. Using GGX importance sampling, we narrow
@@ -49,36 +54,28 @@ layout(location = 0) uniform float roughness;
    they can help average out the error in the integral estimation from this region. In
    this case, the sample should only average a small area of the environment map, so a
    higher mipmap level should be used.
-*/
-vec3 PrefilterEnvironmentMap(vec3 R, uint n_samples) {
-    vec3 N = R;
-    vec3 V = R;
 
-    vec2 env_size = vec2(textureSize(environment_map, 0));
-    float w = 4.0 * PI / (6 * env_size.x * env_size.y);  // solid angle per texel (Equation 12)
-
-    // roughness is guaranteed to be > 0 as the base level is copied directly
-    float alpha = roughness * roughness;
+   since every sample already averages the right footprint of the environment, a few
+   dozen samples are enough for the narrow lobes of the low roughness levels, only the
+   wide lobes near roughness 1 need a few hundred. The sample set, the PDF and the mip
+   level of each sample only depend on the roughness, so they are computed once per
+   level on the CPU (see "asset/ibl.cpp"), what's left here is a change of frame and a
+   filtered texture fetch per sample.
+*/
+vec3 PrefilterEnvironmentMap(vec3 R) {
+    // tangent frame around N = R, same as `Tangent2World()` but built once for all samples
+    vec3 U = mix(vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), step(abs(R.y), 0.999));
+    vec3 T = normalize(cross(U, R));
+    vec3 B = cross(R, T);
 
     float weight = 0.0;
     vec3 color = vec3(0.0);
 
     for (uint i = 0; i < n_samples; i++) {
-        vec2 u = Hammersley2D(i, n_samples);
-        vec3 H = Tangent2World(N, ImportanceSampleGGX(u.x, u.y, alpha));
-        vec3 L = 2 * dot(H, V) * H - V;
-
-        float NoH = max(dot(N, H), 0.0);
-        float NoL = max(dot(N, L), 0.0);
-        float HoV = max(dot(H, V), 0.0);
-
-        if (NoL > 0.0) {
-            float pdf = D_TRGGX(NoH, alpha) * NoH / (4.0 * HoV);
-            float ws = 1.0 / (n_samples * pdf + 0.0001);  // solid angle associated with this sample (Equation 11)
-            float mip_level = max(0.5 * log2(ws / w) + 1.0, 0.0);  // mipmap level (Equation 13 biased by +1)
-            color += textureLod(environment_map, L, mip_level).rgb * NoL;
-            weight += NoL;
-        }
+        vec4 s = samples[i];
+        vec3 L = T * s.x + B * s.y + R * s.z;
+        color += textureLod(environment_map, L, s.w).rgb * s.z;
+        weight += s.z;
     }
 
     return color / weight;
@@ -94,7 +91,7 @@ void main() {
     }
 
     vec3 R = ILS2Cartesian(ils_coordinate, resolution);
-    vec3 color = PrefilterEnvironmentMap(R, 2048);  // ~ 1024 samples for 2K resolution
+    vec3 color = PrefilterEnvironmentMap(R);
 
     imageStore(prefilter_map, ils_coordinate, vec4(color, 1.0));
 }
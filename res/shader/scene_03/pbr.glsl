@@ -18,8 +18,7 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 uv;
 layout(location = 3) in vec2 uv2;
-layout(location = 4) in vec3 tangent;
-layout(location = 5) in vec3 binormal;
+layout(location = 4) in vec4 tangent;  // w = handedness, binormal = cross(normal, tangent) * w
 
 layout(location = 0) out _vtx {
     out vec3 _position;
@@ -35,8 +34,8 @@ void main() {
     _normal = normalize(vec3(self.transform * vec4(normal, 0.0)));
     _uv = uv;
     _uv2 = uv;
-    _tangent = normalize(vec3(self.transform * vec4(tangent, 0.0)));
-    _binormal = normalize(vec3(self.transform * vec4(binormal, 0.0)));
+    _tangent = normalize(vec3(self.transform * vec4(tangent.xyz, 0.0)));
+    _binormal = normalize(vec3(self.transform * vec4(cross(normal, tangent.xyz) * tangent.w, 0.0)));
 
     gl_Position = camera.projection * camera.view * self.transform * vec4(position, 1.0);
 }
@@ -18,9 +18,8 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 uv;
 layout(location = 3) in vec2 uv2;
-layout(location = 4) in vec3 tangent;
-layout(location = 5) in vec3 binormal;
-layout(location = 6) in ivec4 bone_id;
+layout(location = 4) in vec4 tangent;  // w = handedness, binormal = cross(normal, tangent) * w
+layout(location = 6) in uvec4 bone_id;  // unsigned to match the packed integer format
 layout(location = 7) in vec4 bone_wt;
 
 layout(location = 0) out _vtx {
@@ -37,7 +36,7 @@ layout(location = 100) uniform mat4 bone_transform[150];  // up to 150 bones
 mat4 CalcBoneTransform() {
     mat4 T = mat4(0.0);
     for (uint i = 0; i < 4; ++i) {
-        if (bone_id[i] >= 0) {
+        if (bone_wt[i] > 0.0) {  // an empty slot is bone 0 with a weight of 0
             T += (bone_transform[bone_id[i]] * bone_wt[i]);
         }
     }
@@ -54,8 +53,8 @@ void main() {
 
     _position = vec3(self.transform * BT * vec4(position, 1.0));
     _normal   = normalize(vec3(self.transform * BT * vec4(normal, 0.0)));
-    _tangent  = normalize(vec3(self.transform * BT * vec4(tangent, 0.0)));
-    _binormal = normalize(vec3(self.transform * BT * vec4(binormal, 0.0)));
+    _tangent  = normalize(vec3(self.transform * BT * vec4(tangent.xyz, 0.0)));
+    _binormal = normalize(vec3(self.transform * BT * vec4(cross(normal, tangent.xyz) * tangent.w, 0.0)));
     _uv = uv;
 }
 
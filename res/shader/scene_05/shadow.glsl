@@ -13,9 +13,8 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 uv;
 layout(location = 3) in vec2 uv2;
-layout(location = 4) in vec3 tangent;
-layout(location = 5) in vec3 binormal;
-layout(location = 6) in ivec4 bone_id;
+layout(location = 4) in vec4 tangent;  // w = handedness, binormal = cross(normal, tangent) * w
+layout(location = 6) in uvec4 bone_id;  // unsigned to match the packed integer format
 layout(location = 7) in vec4 bone_wt;
 
 layout(location = 100) uniform mat4 bone_transform[150];  // up to 150 bones
@@ -23,7 +22,7 @@ layout(location = 100) uniform mat4 bone_transform[150];  // up to 150 bones
 mat4 CalcBoneTransform() {
     mat4 T = mat4(0.0);
     for (uint i = 0; i < 4; ++i) {
-        if (bone_id[i] >= 0) {
+        if (bone_wt[i] > 0.0) {  // an empty slot is bone 0 with a weight of 0
             T += (bone_transform[bone_id[i]] * bone_wt[i]);
         }
     }
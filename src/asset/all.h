@@ -6,4 +6,6 @@
 #include "asset/fbo.h"
 #include "asset/shader.h"
 #include "asset/sampler.h"
-#include "asset/texture.h"
\ No newline at end of file
+#include "asset/texture.h"
+#include "asset/stream.h"
+#include "asset/ibl.h"
\ No newline at end of file
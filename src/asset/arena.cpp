@@ -0,0 +1,156 @@
+#include "pch.h"
+
+#include "core/log.h"
+#include "asset/arena.h"
+#include "utils/profile.h"
+
+namespace asset {
+
+    static GLsizeiptr IndexSize(GLenum index_type) {
+        return index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    }
+
+    GeometryArena::FreeList::FreeList(GLuint capacity) {
+        ranges[0] = capacity;
+    }
+
+    GLuint GeometryArena::FreeList::Allocate(GLuint size) {
+        for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+            if (auto [offset, free] = *it; free >= size) {
+                ranges.erase(it);
+                if (free > size) {
+                    ranges[offset + size] = free - size;
+                }
+                return offset;
+            }
+        }
+
+        return npos;
+    }
+
+    void GeometryArena::FreeList::Free(GLuint offset, GLuint size) {
+        if (size == 0) {
+            return;
+        }
+
+        auto next = ranges.lower_bound(offset);
+
+        // merge with the following range
+        if (next != ranges.end() && offset + size == next->first) {
+            size += next->second;
+            next = ranges.erase(next);
+        }
+
+        // merge with the preceding range
+        if (next != ranges.begin()) {
+            if (auto prev = std::prev(next); prev->first + prev->second == offset) {
+                prev->second += size;
+                return;
+            }
+        }
+
+        ranges.emplace_hint(next, offset, size);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    GeometryArena::Page::Page(uint64_t format, GLint stride, GLenum index_type, GLuint max_verts, GLuint max_indices, Setup setup)
+        : format(format), stride(stride), index_type(index_type), setup(std::move(setup)), vertices(max_verts), indices(max_indices)
+    {
+        // immutable storage, but the data is written block by block, as meshes are created
+        vbo = WrapAsset<VBO>(static_cast<GLsizeiptr>(max_verts) * stride, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        ibo = WrapAsset<IBO>(static_cast<GLsizeiptr>(max_indices) * IndexSize(index_type), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    GeometryArena::Block::~Block() {
+        GeometryArena::Free(*this);
+    }
+
+    void GeometryArena::Block::SetData(const void* vertices, const GLuint* indices) const {
+        page->vbo->SetData(static_cast<GLintptr>(base_vertex) * page->stride, n_verts * page->stride, vertices);
+        GLintptr offset = static_cast<GLintptr>(first_index) * IndexSize(page->index_type);
+
+        if (page->index_type == GL_UNSIGNED_SHORT) {
+            std::vector<GLushort> narrow(indices, indices + n_indices);  // relative to the block, so they fit
+            page->ibo->SetData(offset, n_indices * sizeof(GLushort), narrow.data());
+        }
+        else {
+            page->ibo->SetData(offset, n_indices * sizeof(GLuint), indices);
+        }
+    }
+
+    VAO& GeometryArena::Block::GetVAO() const {
+        if (page->vao == nullptr) {
+            page->vao = WrapAsset<VAO>();
+            page->setup(*page->vao, page->vbo->ID());
+            page->vao->SetIBO(page->ibo->ID(), page->index_type);
+        }
+
+        return *page->vao;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    asset_ref<GeometryArena::Block> GeometryArena::Allocate(uint64_t format, GLint stride, size_t n_verts, size_t n_indices, GLenum index_type, const Setup& setup) {
+        PROFILE_FUNCTION();
+        auto block = MakeAsset<Block>();
+        block->n_verts = static_cast<GLuint>(n_verts);
+        block->n_indices = static_cast<GLuint>(n_indices);
+        glGenVertexArrays(1, &block->name);  // only the name, no object is created
+
+        auto place = [&](Page& page) {
+            GLuint base_vertex = page.vertices.Allocate(block->n_verts);
+            if (base_vertex == FreeList::npos) {
+                return false;
+            }
+
+            GLuint first_index = page.indices.Allocate(block->n_indices);
+            if (first_index == FreeList::npos) {
+                page.vertices.Free(base_vertex, block->n_verts);
+                return false;
+            }
+
+            block->page = &page;
+            block->base_vertex = static_cast<GLint>(base_vertex);
+            block->first_index = first_index;
+            page.n_blocks++;
+            return true;
+        };
+
+        for (auto& page : pages) {
+            if (page->format == format && page->index_type == index_type && place(*page)) {
+                return block;
+            }
+        }
+
+        // a mesh larger than the default page size gets a page of its own size
+        GLuint max_verts = std::max(static_cast<GLuint>(vertex_page_size / stride), block->n_verts);
+        GLsizeiptr index_size = IndexSize(index_type);
+        GLuint max_indices = std::max(static_cast<GLuint>(index_page_size / index_size), block->n_indices);
+
+        auto& page = pages.emplace_back(std::make_unique<Page>(format, stride, index_type, max_verts, max_indices, setup));
+        CORE_TRACE("Created geometry page: {0} vertices of {1} bytes, {2} indices of {3} bytes", max_verts, stride, max_indices, index_size);
+
+        bool placed = place(*page);
+        CORE_ASERT(placed, "Cannot allocate a mesh in a new geometry page...");
+        return block;
+    }
+
+    void GeometryArena::Free(Block& block) {
+        glDeleteVertexArrays(1, &block.name);
+
+        if (Page* page = block.page; page != nullptr) {
+            page->vertices.Free(block.base_vertex, block.n_verts);
+            page->indices.Free(block.first_index, block.n_indices);
+
+            if (--page->n_blocks == 0) {
+                pages.erase(std::find_if(pages.begin(), pages.end(), [page](const auto& p) { return p.get() == page; }));
+            }
+        }
+    }
+
+    size_t GeometryArena::PageCount() {
+        return pages.size();
+    }
+
+}
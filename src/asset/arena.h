@@ -0,0 +1,118 @@
+/*
+   the geometry arena lets meshes share a few large vertex and index buffers instead of owning
+   a VAO, a VBO and an IBO each. The buffers are grouped into pages, a page holds one vertex
+   format (the `format` key and `stride` given by the caller, see `Mesh::Layout`) and one index
+   type, a VBO with room for `vertex_page_size` bytes, an IBO with room for `index_page_size`
+   bytes of indices, and a single VAO over both. Pages are immutable storage, a mesh that doesn't
+   fit in any page of its format and index type gets a new page, at least as large as the mesh.
+
+   # sub-allocation
+
+   `Allocate()` reserves a `Block` of vertices and indices in a page with a first-fit free
+   list, a free range adjacent to other free ranges is merged with them, so the space of the
+   meshes of an unloaded scene can be reused by the next one. The block remembers its offsets,
+   indices are stored relative to the first vertex of the block and drawn with a base vertex,
+   so the mesh data is uploaded as is, and a mesh with up to 65536 vertices can go in a page of
+   16-bit indices, they are narrowed on upload. Blocks are shared by the copies of a mesh component,
+   the space is released when the last copy is gone, and a page is deleted once empty.
+
+   # batching
+
+   since all meshes in a page share one VAO and one index type, drawing them one after another costs
+   no VAO switch, and several of them can be drawn with the same state by a single call to
+   `glMultiDrawElementsIndirect`, see `VAO::MultiDraw()` and `Mesh::DrawBatch()`.
+
+   # VAO names
+
+   shaders may compare `self.material_id` against constants, and the material id of a mesh is
+   the name of its VAO (see "model.h"), so a block still reserves a VAO name for the mesh, in
+   the same order as before, and the VAO of a page is only created when it's first drawn, so
+   that creating pages doesn't shift the names of the meshes loaded after them.
+
+   > auto block = GeometryArena::Allocate(key, stride, n_verts, n_indices, GL_UNSIGNED_SHORT, [](const VAO& vao, GLuint vbo) { ... });
+   > block->SetData(packed_vertices, indices);
+   > block->GetVAO().Draw(GL_TRIANGLES, n_indices, block->first_index, block->base_vertex);
+*/
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include "core/base.h"
+#include "asset/buffer.h"
+#include "asset/vao.h"
+
+namespace asset {
+
+    class GeometryArena {
+      private:
+        struct Page;  // forward declaration
+
+      public:
+        using Setup = std::function<void(const VAO& vao, GLuint vbo)>;  // sets the attributes of a page's VAO
+
+        class Block {
+          private:
+            friend class GeometryArena;
+            Page* page = nullptr;
+            GLuint name = 0;  // reserved VAO name
+
+          public:
+            GLint base_vertex = 0;
+            GLuint first_index = 0;
+            GLuint n_verts = 0, n_indices = 0;
+
+            Block() = default;
+            ~Block();
+
+            Block(const Block&) = delete;
+            Block& operator=(const Block&) = delete;
+
+            GLuint Name() const { return name; }
+            bool SharesPage(const Block& other) const { return page == other.page; }
+            void SetData(const void* vertices, const GLuint* indices) const;
+            VAO& GetVAO() const;
+        };
+
+      private:
+        class FreeList {
+          private:
+            std::map<GLuint, GLuint> ranges;  // offset : size of each free range
+
+          public:
+            static constexpr GLuint npos = 0xFFFFFFFF;
+            FreeList(GLuint capacity);
+            GLuint Allocate(GLuint size);  // returns `npos` if no free range is large enough
+            void Free(GLuint offset, GLuint size);
+        };
+
+        struct Page {
+            uint64_t format;
+            GLint stride;
+            GLenum index_type;  // `GL_UNSIGNED_SHORT` or `GL_UNSIGNED_INT`
+            Setup setup;
+            asset_tmp<VBO> vbo;
+            asset_tmp<IBO> ibo;
+            asset_tmp<VAO> vao;  // created on the first draw
+            FreeList vertices;   // in vertices
+            FreeList indices;    // in indices
+            size_t n_blocks = 0;
+
+            Page(uint64_t format, GLint stride, GLenum index_type, GLuint max_verts, GLuint max_indices, Setup setup);
+        };
+
+        static inline std::vector<std::unique_ptr<Page>> pages;
+        static void Free(Block& block);
+
+      public:
+        static inline bool enabled = true;  // meshes created while disabled own their buffers
+        static inline GLsizeiptr vertex_page_size = 32 << 20;  // bytes
+        static inline GLsizeiptr index_page_size = 16 << 20;   // bytes
+
+        static asset_ref<Block> Allocate(uint64_t format, GLint stride, size_t n_verts, size_t n_indices, GLenum index_type, const Setup& setup);
+        static size_t PageCount();
+    };
+
+}
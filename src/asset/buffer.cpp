@@ -2,11 +2,15 @@
 
 #include "core/app.h"
 #include "core/log.h"
+#include "core/sync.h"
 #include "asset/buffer.h"
 #include "utils/ext.h"
 
 namespace asset {
 
+    // marks a block of a multi-buffered UBO that has never been bound
+    constexpr uint64_t never_bound = std::numeric_limits<uint64_t>::max();
+
     IBuffer::IBuffer() : id(0), size(0), data_ptr(nullptr) {
         CORE_ASERT(core::Application::GLContextActive(), "OpenGL context not found: {0}", utils::func_sig());
     }
@@ -235,13 +239,87 @@ namespace asset {
     }
 
     void UBO::SetUniform(GLuint uid, const void* data) const {
-        glNamedBufferSubData(id, offset_vec[uid], length_vec[uid], data);  // update a single uniform
+        Write(offset_vec[uid], length_vec[uid], data);  // update a single uniform
     }
 
     void UBO::SetUniform(GLuint fr, GLuint to, const void* data) const {
         auto it = stride_vec.begin();
         auto n_bytes = std::accumulate(it + fr, it + to + 1, decltype(stride_vec)::value_type(0));
-        glNamedBufferSubData(id, offset_vec[fr], n_bytes, data);  // update a range of uniforms
+        Write(offset_vec[fr], n_bytes, data);  // update a range of uniforms
+    }
+
+    void UBO::MultiBuffer(GLuint versions) {
+        CORE_ASERT(n_blocks == 0, "The uniform buffer is already multi-buffered...");
+        CORE_ASERT(versions > 0, "Number of versions per frame must be at least 1...");
+
+        static GLint alignment = -1;
+        if (alignment < 0) {
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);  // typically 256 bytes
+        }
+
+        // keep the current contents, they are carried over to the first block
+        shadow.resize(this->size);
+        glGetNamedBufferSubData(id, 0, this->size, shadow.data());
+        glDeleteBuffers(1, &id);
+
+        // every frame in flight needs its own copies, `versions` of them if updated more than once
+        n_blocks = core::FrameSync::n_frames * versions;
+        block_stride = (this->size + alignment - 1) / alignment * alignment;
+        retired.assign(n_blocks, never_bound);
+
+        const GLbitfield access = GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT | GL_MAP_WRITE_BIT;
+        glCreateBuffers(1, &id);
+        glNamedBufferStorage(id, n_blocks * block_stride, NULL, access);
+        data_ptr = glMapNamedBufferRange(id, 0, n_blocks * block_stride, access);
+
+        block = 0;
+        frame = core::FrameSync::FrameCount();
+        committed = false;
+
+        memcpy(data_ptr, shadow.data(), this->size);
+        glBindBufferRange(this->target, this->index, id, 0, this->size);
+    }
+
+    void UBO::Commit() const {
+        // the current block is going to be read by the draw calls issued next, so the next update
+        // must go to a new block (no-op if single buffered, the driver takes care of the copies)
+        committed = n_blocks > 0;
+    }
+
+    void UBO::Write(GLintptr offset, GLsizeiptr size, const void* data) const {
+        if (n_blocks == 0) {
+            glNamedBufferSubData(id, offset, size, data);
+            return;
+        }
+
+        if (committed || frame != core::FrameSync::FrameCount()) {
+            Rotate();
+        }
+
+        memcpy(shadow.data() + offset, data, size);
+        memcpy(static_cast<uint8_t*>(data_ptr) + block * block_stride + offset, data, size);
+    }
+
+    void UBO::Rotate() const {
+        uint64_t curr_frame = core::FrameSync::FrameCount();
+        GLuint next = (block + 1) % n_blocks;
+        retired[block] = curr_frame;  // the current block may be read by commands up to this frame
+
+        // the next block is free once its last frame has completed on the GPU, which is always the
+        // case unless the UBO has been updated more than `versions` times within `n_frames` frames
+        if (uint64_t last = retired[next]; last != never_bound && last + core::FrameSync::n_frames > curr_frame) {
+            CORE_WARN_ONCE("Uniform buffer {0} ran out of blocks, consider more versions per frame", id);
+            core::FrameSync::WaitFrame(last);
+        }
+
+        block = next;
+        frame = curr_frame;
+        committed = false;
+
+        // the mapped memory is write-combined, never read from it, copy from the shadow instead
+        auto block_ptr = static_cast<uint8_t*>(data_ptr) + block * block_stride;
+        memcpy(block_ptr, shadow.data(), this->size);
+        glBindBufferRange(this->target, this->index, id, block * block_stride, this->size);
     }
 
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
    - ATC  (Atomic Counters)
    - UBO  (Uniform Buffer Object)
    - SSBO (Shader Storage Buffer Object)
+   - DIB  (Draw Indirect Buffer)
 
    note that those below are not buffer objects so do not fall into this category:
 
@@ -67,6 +68,20 @@
    that SSBO will be in a lock state while the data store is mapped to C++, it can't be used
    by OpenGL until the pointer is released (except persistent mapping).
 
+   # multi-buffering
+
+   a UBO that is updated every frame is a hazard, the GPU could still be reading the values
+   of the last frame when we overwrite them, in which case the driver either has to stall or
+   make a hidden copy of the buffer. `MultiBuffer()` turns the UBO into a persistently mapped
+   ring of blocks against the `FrameSync` fences: the first update in a new frame moves on to
+   the next block, carrying over the values of the previous block, and rebinds the binding
+   point to that range, so writes never touch a block that may still be in flight.
+
+   a UBO that is updated more than once per frame, e.g. between two render passes, must call
+   `Commit()` after each group of updates (before the draw calls that consume them), so that
+   the next update starts a new block, `versions` is the number of such groups per frame. If
+   the ring is exhausted, we must wait on the oldest block's frame, it's slow but correct.
+
    # padding issues
 
    when using UBO and SSBO, we need to follow some rules so that they can work properly. The
@@ -176,6 +191,11 @@ namespace asset {
         PBO(GLsizeiptr size, const void* data, GLbitfield access = 0) : IBuffer(size, data, access) {}
     };
 
+    class DIB : public IBuffer {
+      public:
+        DIB(GLsizeiptr size, const void* data, GLbitfield access = GL_DYNAMIC_STORAGE_BIT) : IBuffer(size, data, access) {}
+    };
+
     ///////////////////////////////////////////////////////////////////////////////////////////////
 
     class IIndexedBuffer : public IBuffer {
@@ -210,12 +230,26 @@ namespace asset {
         u_vec stride_vec;  // each uniform's byte stride (with padding)
         u_vec length_vec;  // each uniform's byte length (w/o. padding)
 
+        // multi-buffered data store, see `MultiBuffer()`, a block is a copy of the uniform block
+        GLuint n_blocks = 0;             // 0 if single buffered
+        GLsizeiptr block_stride = 0;     // block size rounded up to the offset alignment
+        mutable GLuint block = 0;        // index of the block currently bound to the binding point
+        mutable uint64_t frame = 0;      // frame in which the current block was bound
+        mutable bool committed = false;  // whether the current block has been consumed by the GPU
+        mutable std::vector<uint64_t> retired;  // last frame in which each block was bound
+        mutable std::vector<uint8_t> shadow;    // CPU copy of the latest block contents
+        void Write(GLintptr offset, GLsizeiptr size, const void* data) const;
+        void Rotate() const;
+
       public:
         UBO() = default;
         UBO(GLuint index, const u_vec& offset, const u_vec& length, const u_vec& stride);
         UBO(GLuint shader, GLuint block_id, GLbitfield access = GL_DYNAMIC_STORAGE_BIT);
         void SetUniform(GLuint uid, const void* data) const;
         void SetUniform(GLuint fr, GLuint to, const void* data) const;
+
+        void MultiBuffer(GLuint versions = 1);
+        void Commit() const;
     };
 
 }
\ No newline at end of file
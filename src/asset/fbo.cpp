@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "core/app.h"
+#include "core/bench.h"
 #include "core/log.h"
 #include "core/window.h"
 #include "asset/vao.h"
@@ -8,6 +9,7 @@
 #include "asset/shader.h"
 #include "asset/texture.h"
 #include "utils/path.h"
+#include "utils/profile.h"
 
 namespace asset {
 
@@ -327,6 +329,7 @@ namespace asset {
         glUniformSubroutinesuiv(GL_FRAGMENT_SHADER, 1, &subroutine_index);
 
         glDrawArrays(GL_TRIANGLES, 0, 3);  // bufferless quad rendering
+        core::Benchmark::draw_calls++;
     }
 
     void FBO::Clear(GLint index) const {
@@ -375,6 +378,7 @@ namespace asset {
         GLuint fw = fr.width, fh = fr.height;
         GLuint tw = to.width, th = to.height;
 
+        GPU_SCOPE("Blit Color");
         glNamedFramebufferReadBuffer(fr.id, GL_COLOR_ATTACHMENT0 + fr_idx);
         glNamedFramebufferDrawBuffer(to.id, GL_COLOR_ATTACHMENT0 + to_idx);
         glBlitNamedFramebuffer(fr.id, to.id, 0, 0, fw, fh, 0, 0, tw, th, GL_COLOR_BUFFER_BIT, GL_NEAREST);
@@ -385,6 +389,7 @@ namespace asset {
         // if colorspace correction is enabled, depth values will be gamma encoded during blits...
         GLuint fw = fr.width, fh = fr.height;
         GLuint tw = to.width, th = to.height;
+        GPU_SCOPE("Blit Depth");
         glBlitNamedFramebuffer(fr.id, to.id, 0, 0, fw, fh, 0, 0, tw, th, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
     }
 
@@ -393,6 +398,7 @@ namespace asset {
         // if colorspace correction is enabled, stencil values will be gamma encoded during blits...
         GLuint fw = fr.width, fh = fr.height;
         GLuint tw = to.width, th = to.height;
+        GPU_SCOPE("Blit Stencil");
         glBlitNamedFramebuffer(fr.id, to.id, 0, 0, fw, fh, 0, 0, tw, th, GL_STENCIL_BUFFER_BIT, GL_NEAREST);
     }
 
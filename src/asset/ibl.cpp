@@ -0,0 +1,524 @@
+#include "pch.h"
+
+#include <cstring>
+#include "core/job.h"
+#include "core/log.h"
+#include "core/sync.h"
+#include "asset/buffer.h"
+#include "asset/ibl.h"
+#include "asset/shader.h"
+#include "asset/texture.h"
+#include "utils/file.h"
+#include "utils/glsl.h"
+#include "utils/image.h"
+#include "utils/imgproc.h"
+#include "utils/ktx.h"
+#include "utils/path.h"
+#include "utils/profile.h"
+
+namespace fs = std::filesystem;
+using namespace core;
+
+namespace asset {
+
+    struct CachedTexture {
+        asset_ref<Texture> texture;
+        uint64_t last_used = 0;
+    };
+
+    struct SourceHash {
+        fs::file_time_type mtime;
+        uintmax_t size = 0;
+        uint64_t hash = 0;
+    };
+
+    static std::unordered_map<uint64_t, CachedTexture> cache;  // indexed by the bake key
+    static std::unordered_map<uint64_t, std::vector<glm::vec3>> sh_cache;  // 27 floats each, never evicted
+    static std::unordered_map<std::string, SourceHash> source_hashes;  // so that large HDRIs are hashed only once
+    static uint64_t tick = 0;
+
+    static constexpr uint64_t sh_version = 1;  // bump whenever `imgproc::ProjectSH()` changes its output
+    static constexpr uint64_t ggx_version = 1;  // bump whenever `GGXSamples()` changes its output
+    static constexpr float pi = 3.14159265358979f;
+
+    static const std::vector<std::string> faces { "px", "nx", "py", "ny", "pz", "nz" };
+
+    static bool IsDirectory(const std::string& hdri) {
+        return !hdri.empty() && (hdri.back() == '\\' || hdri.back() == '/');
+    }
+
+    static uint64_t HashSource(const std::string& filepath) {
+        std::error_code error;
+        auto mtime = fs::last_write_time(filepath, error);
+        auto size = fs::file_size(filepath, error);
+
+        if (error) {
+            return 0;
+        }
+
+        if (auto it = source_hashes.find(filepath); it != source_hashes.end()) {
+            if (it->second.mtime == mtime && it->second.size == size) {
+                return it->second.hash;
+            }
+        }
+
+        uint64_t hash = utils::HashFile(filepath);
+        source_hashes.insert_or_assign(filepath, SourceHash { mtime, size, hash });
+        return hash;
+    }
+
+    static uint64_t HashHDRI(const std::string& hdri) {
+        if (!IsDirectory(hdri)) {
+            return HashSource(hdri);
+        }
+
+        uint64_t hash = utils::Hash64(nullptr, 0);
+        for (const auto& face : faces) {
+            uint64_t face_hash = HashSource(hdri + face + ".hdr");
+            if (face_hash == 0) {
+                return 0;
+            }
+            hash = utils::Hash64(&face_hash, sizeof(face_hash), hash);
+        }
+
+        return hash;
+    }
+
+    static uint64_t HashShader(const std::string& filename) {
+        // preprocessing is cheap and the files are cached, unlike compiling the shader
+        auto program = utils::glsl::Preprocess(utils::paths::shader + "core\\" + filename);
+        uint64_t hash = utils::Hash64(program.prefix.data(), program.prefix.size());
+        return utils::Hash64(program.suffix.data(), program.suffix.size(), hash);
+    }
+
+    static uint64_t Combine(uint64_t seed, std::initializer_list<uint64_t> values) {
+        for (uint64_t value : values) {
+            seed = utils::Hash64(&value, sizeof(value), seed);
+        }
+        return seed;
+    }
+
+    static std::string CachePath(const std::string& name, uint64_t key, const std::string& extension = ".ktx2") {
+        std::ostringstream path;
+        path << utils::paths::cache << name << "." << std::hex << std::setw(16) << std::setfill('0') << key << extension;
+        return path.str();
+    }
+
+    static void Store(uint64_t key, const asset_ref<Texture>& texture) {
+        cache.insert_or_assign(key, CachedTexture { texture, ++tick });
+
+        // evict the least recently used textures, those still used by a scene stay alive anyway
+        while (cache.size() > IBLBaker::capacity) {
+            auto lru = std::min_element(cache.begin(), cache.end(),
+                [](const auto& a, const auto& b) { return a.second.last_used < b.second.last_used; });
+            cache.erase(lru);
+        }
+    }
+
+    static asset_ref<Texture> Find(uint64_t key, const std::string& filepath) {
+        if (auto it = cache.find(key); it != cache.end()) {
+            it->second.last_used = ++tick;
+            return it->second.texture;
+        }
+
+        if (!IBLBaker::use_cache) {
+            return nullptr;
+        }
+
+        auto file = utils::KTXFile(filepath);
+        if (!file.Valid()) {
+            return nullptr;
+        }
+
+        PROFILE_FUNCTION();
+        CORE_INFO("Loading baked IBL texture from {0}", filepath);
+
+        GLenum target = file.Faces() == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+        auto texture = MakeAsset<Texture>(target, file.Width(), file.Height(), file.Faces(), GL_RGBA16F, file.Levels());
+
+        for (GLuint level = 0; level < file.Levels(); level++) {
+            GLuint w = std::max(file.Width() >> level, 1U);
+            GLuint h = std::max(file.Height() >> level, 1U);
+
+            // the faces of a cubemap are layers of a 3D upload, a 2D texture (the BRDF LUT) has none
+            if (file.Faces() == 1) {
+                glTextureSubImage2D(texture->ID(), level, 0, 0, w, h, GL_RGBA, GL_HALF_FLOAT, file.LevelData(level));
+            }
+            else {
+                glTextureSubImage3D(texture->ID(), level, 0, 0, 0, w, h, file.Faces(), GL_RGBA, GL_HALF_FLOAT, file.LevelData(level));
+            }
+        }
+
+        Store(key, texture);
+        return texture;
+    }
+
+    static void Save(const Texture& texture, const std::string& filepath) {
+        if (!IBLBaker::use_cache) {
+            return;
+        }
+
+        // read back on the main thread, the file is assembled and written by a worker
+        auto levels = std::make_shared<std::vector<std::vector<uint8_t>>>(texture.n_levels);
+
+        for (GLuint level = 0; level < texture.n_levels; level++) {
+            size_t w = std::max(texture.width >> level, 1U);
+            size_t h = std::max(texture.height >> level, 1U);
+            auto& pixels = levels->at(level);
+            pixels.resize(w * h * texture.depth * 8);  // RGBA16F
+            glGetTextureImage(texture.ID(), level, GL_RGBA, GL_HALF_FLOAT, static_cast<GLsizei>(pixels.size()), pixels.data());
+        }
+
+        JobSystem::Submit([filepath, levels, w = texture.width, h = texture.height, faces = texture.depth] {
+            if (!utils::KTXFile::Write(filepath, w, h, faces, *levels)) {
+                CORE_WARN("Unable to write baked IBL texture: {0}", filepath);
+            }
+        });
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    static asset_ref<Texture> BakeIrradiance(const Texture& env_map) {
+        PROFILE_FUNCTION();
+        auto irradiance_shader = CShader(utils::paths::shader + "core\\irradiance_map.glsl");
+
+        GLuint resolution = IBLBaker::irradiance_resolution;
+        auto irradiance_map = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, resolution, resolution, 6, GL_RGBA16F, 1);
+
+        env_map.Bind(0);
+        irradiance_map->BindILS(0, 0, GL_WRITE_ONLY);
+
+        if (irradiance_shader.Bind(); true) {
+            irradiance_shader.Dispatch(resolution / 32, resolution / 32, 6);
+            irradiance_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+
+            auto irradiance_fence = Sync(0);
+            irradiance_fence.ClientWaitSync();
+            irradiance_map->UnbindILS(0);
+        }
+
+        return irradiance_map;
+    }
+
+    static float RadicalInverse(uint32_t bits) {
+        bits = (bits << 16U) | (bits >> 16U);
+        bits = ((bits & 0x55555555U) << 1U) | ((bits & 0xAAAAAAAAU) >> 1U);
+        bits = ((bits & 0x33333333U) << 2U) | ((bits & 0xCCCCCCCCU) >> 2U);
+        bits = ((bits & 0x0F0F0F0FU) << 4U) | ((bits & 0xF0F0F0F0U) >> 4U);
+        bits = ((bits & 0x00FF00FFU) << 8U) | ((bits & 0xFF00FF00U) >> 8U);
+        return bits * 2.3283064365386963e-10f;  // 1 / 0x100000000
+    }
+
+    // GGX importance samples around N = V = +z, the same for every texel of a roughness level, the
+    // samples below the horizon are dropped, xyz = light direction, w = the mip level to sample
+    // from the environment, so that each sample averages the solid angle it stands for (GPU Gems
+    // 3, chapter 20.4), `env_resolution` is the size of the base level of the environment map
+    static std::vector<glm::vec4> GGXSamples(float roughness, GLuint n_samples, GLuint env_resolution) {
+        float alpha = roughness * roughness;
+        float a2 = alpha * alpha;
+        float max_lod = std::log2(static_cast<float>(env_resolution));
+        float texel = 4.0f * pi / (6.0f * env_resolution * env_resolution);  // solid angle per texel
+
+        std::vector<glm::vec4> samples;
+        samples.reserve(n_samples);
+
+        for (GLuint i = 0; i < n_samples; i++) {
+            float u = i / static_cast<float>(n_samples);
+            float v = RadicalInverse(i);
+
+            float phi = u * 2.0f * pi;
+            float cos_theta = std::sqrt((1.0f - v) / (1.0f + (a2 - 1.0f) * v));
+            float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+            auto H = glm::vec3(std::cos(phi) * sin_theta, std::sin(phi) * sin_theta, cos_theta);
+
+            float NoH = H.z;
+            auto L = glm::vec3(2.0f * NoH * H.x, 2.0f * NoH * H.y, 2.0f * NoH * NoH - 1.0f);  // reflect V = +z
+
+            if (L.z <= 0.0f) {
+                continue;
+            }
+
+            // pdf of L = D(h) * NoH / (4 * HoV), where HoV = NoH since V = N
+            float d = NoH * NoH * (a2 - 1.0f) + 1.0f;
+            float D = a2 / (pi * d * d);
+            float pdf = D * 0.25f;
+
+            float solid_angle = 1.0f / (n_samples * pdf + 0.0001f);
+            float lod = glm::clamp(0.5f * std::log2(solid_angle / texel) + 1.0f, 0.0f, max_lod);  // biased by +1
+            samples.emplace_back(L, lod);
+        }
+
+        return samples;
+    }
+
+    // the number of samples grows geometrically with roughness, since filtering with mipmaps
+    // already takes care of the noise, the narrow lobes need much fewer samples than wide ones
+    static GLuint SampleCount(float roughness) {
+        float lo = std::log2(static_cast<float>(std::max(IBLBaker::prefilter_min_samples, 1U)));
+        float hi = std::log2(static_cast<float>(std::max(IBLBaker::prefilter_max_samples, 1U)));
+        return static_cast<GLuint>(std::round(std::exp2(glm::mix(lo, hi, roughness))));
+    }
+
+    static asset_ref<Texture> BakePrefiltered(const Texture& env_map) {
+        PROFILE_FUNCTION();
+        auto prefilter_shader = CShader(utils::paths::shader + "core\\prefilter_envmap.glsl");
+
+        GLuint resolution = IBLBaker::env_resolution;
+        auto prefiltered_map = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, resolution, resolution, 6, GL_RGBA16F, IBLBaker::prefilter_levels);
+
+        env_map.Bind(0);
+        Texture::Copy(env_map, 0, *prefiltered_map, 0);  // copy the base level
+
+        const GLuint max_level = prefiltered_map->n_levels - 1;
+        resolution /= 2;
+        prefilter_shader.Bind();
+
+        for (unsigned int level = 1; level <= max_level; level++, resolution /= 2) {
+            float roughness = level / static_cast<float>(max_level);
+            GLuint n_groups = glm::max<GLuint>(resolution / 32, 1);
+
+            auto samples = GGXSamples(roughness, SampleCount(roughness), env_map.width);
+            auto sample_buffer = SSBO(7, samples.size() * sizeof(glm::vec4), GL_DYNAMIC_STORAGE_BIT);
+            sample_buffer.SetData(samples.data());
+
+            prefiltered_map->BindILS(level, 1, GL_WRITE_ONLY);
+            prefilter_shader.SetUniform(0, static_cast<GLuint>(samples.size()));
+            prefilter_shader.Dispatch(n_groups, n_groups, 6);
+            prefilter_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+
+            auto prefilter_fence = Sync(level);
+            prefilter_fence.ClientWaitSync();
+            prefiltered_map->UnbindILS(1);
+        }
+
+        return prefiltered_map;
+    }
+
+    static void Validate(const std::string& hdri, const Texture& prefiltered_map) {
+        PROFILE_FUNCTION();
+        auto image = utils::Image(hdri);
+
+        if (!image.IsHDR()) {
+            return;
+        }
+
+        // the centers of the 6 faces, texel (res / 2, res / 2) maps to the face axis exactly
+        const glm::vec3 axes[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+        const GLuint max_level = prefiltered_map.n_levels - 1;
+
+        for (GLuint level = 1; level <= max_level; level++) {
+            float roughness = level / static_cast<float>(max_level);
+            GLint center = std::max(prefiltered_map.width >> level, 1U) / 2;
+            float max_error = 0.0f;
+
+            for (GLint face = 0; face < 6; face++) {
+                auto gpu = glm::vec4(0.0f);
+                glGetTextureSubImage(prefiltered_map.ID(), level, center, center, face, 1, 1, 1, GL_RGBA, GL_FLOAT, sizeof(gpu), &gpu);
+
+                glm::vec3 cpu = IBLBaker::PrefilterReference(image, axes[face], roughness);
+                float error = glm::length(glm::vec3(gpu) - cpu) / std::max(glm::length(cpu), 1e-4f);
+                max_error = std::max(max_error, error);
+            }
+
+            CORE_TRACE("Prefiltered level {0} (roughness = {1:.3f}, {2} samples): {3:.2f}% max error against the CPU reference",
+                level, roughness, SampleCount(roughness), max_error * 100.0f);
+        }
+    }
+
+    static asset_ref<Texture> BakeBRDF() {
+        PROFILE_FUNCTION();
+        auto envBRDF_shader = CShader(utils::paths::shader + "core\\environment_BRDF.glsl");
+
+        GLuint resolution = IBLBaker::BRDF_resolution;
+        auto BRDF_LUT = MakeAsset<Texture>(GL_TEXTURE_2D, resolution, resolution, 1, GL_RGBA16F, 1);
+        BRDF_LUT->BindILS(0, 2, GL_WRITE_ONLY);
+
+        if (envBRDF_shader.Bind(); true) {
+            envBRDF_shader.Dispatch(resolution / 32, resolution / 32, 1);
+            envBRDF_shader.SyncWait(GL_ALL_BARRIER_BITS);
+            Sync::WaitFinish();
+            BRDF_LUT->UnbindILS(2);
+        }
+
+        return BRDF_LUT;
+    }
+
+    static std::vector<glm::vec3> ProjectIrradiance(const std::string& hdri, uint64_t key, const std::string& filepath, bool cacheable) {
+        static_assert(sizeof(glm::vec3) == 3 * sizeof(float));
+        constexpr size_t n_bytes = 9 * sizeof(glm::vec3);
+
+        if (auto it = sh_cache.find(key); it != sh_cache.end()) {
+            return it->second;
+        }
+
+        auto sh = std::vector<glm::vec3>(9);
+
+        if (cacheable && IBLBaker::use_cache) {
+            if (auto file = utils::MappedFile(filepath); file.Valid() && file.Size() == n_bytes) {
+                CORE_INFO("Loading irradiance SH from {0}", filepath);
+                std::memcpy(sh.data(), file.Data(), n_bytes);
+                sh_cache.insert_or_assign(key, sh);
+                return sh;
+            }
+        }
+
+        PROFILE_FUNCTION();
+        CORE_INFO("Projecting diffuse irradiance onto SH9 from {0}", hdri);
+        auto image = utils::Image(hdri);
+
+        if (!image.IsHDR()) {
+            CORE_WARN("{0} is not an HDR image, baking the irradiance map instead", hdri);
+            return {};
+        }
+
+        auto coefficients = utils::imgproc::ProjectSH(image.GetPixels<uint16_t>(), image.Width(), image.Height(), IBLBaker::sh_window);
+        std::memcpy(sh.data(), coefficients.data(), n_bytes);
+
+        if (cacheable) {
+            sh_cache.insert_or_assign(key, sh);
+
+            if (IBLBaker::use_cache) {
+                JobSystem::Submit([filepath, coefficients] {
+                    if (!utils::WriteFileAtomic(filepath, coefficients.data(), sizeof(coefficients))) {
+                        CORE_WARN("Unable to write irradiance SH: {0}", filepath);
+                    }
+                });
+            }
+        }
+
+        return sh;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    IBLMaps IBLBaker::Bake(const std::string& hdri, bool irradiance_sh) {
+        PROFILE_FUNCTION();
+        uint64_t source = HashHDRI(hdri);
+
+        if (source == 0) {
+            CORE_ERROR("Unable to read HDRI {0}, the IBL maps won't be cached", hdri);
+        }
+
+        // each key covers the HDRI content, the bake settings and the shaders that produce the texture
+        uint64_t env_key = Combine(source, { env_resolution, HashShader("equirect2cube.glsl") });
+        uint64_t irr_key = Combine(env_key, { 1, irradiance_resolution, HashShader("irradiance_map.glsl") });
+        uint64_t pre_key = Combine(env_key, { 2, prefilter_levels, HashShader("prefilter_envmap.glsl"),
+            prefilter_min_samples, prefilter_max_samples, ggx_version });
+        uint64_t LUT_key = Combine(utils::Hash64(nullptr, 0), { 3, BRDF_resolution, HashShader("environment_BRDF.glsl") });
+
+        uint64_t window = 0;  // the SH are computed on the CPU, so a version number stands for the shader
+        std::memcpy(&window, &sh_window, sizeof(sh_window));
+        uint64_t sh9_key = Combine(source, { 4, sh_version, window });
+
+        auto path = fs::path(hdri);
+        std::string name = IsDirectory(hdri) ? path.parent_path().filename().string() : path.stem().string();
+
+        std::string irr_path = CachePath(name + ".irradiance", irr_key);
+        std::string pre_path = CachePath(name + ".prefiltered", pre_key);
+        std::string LUT_path = CachePath("environment_BRDF", LUT_key);
+        std::string sh9_path = CachePath(name + ".sh9", sh9_key, ".bin");
+
+        IBLMaps maps;
+
+        if (irradiance_sh && IsDirectory(hdri)) {
+            CORE_WARN("SH projection needs an equirectangular HDRI, baking the irradiance map of {0}", hdri);
+        }
+        else if (irradiance_sh) {
+            maps.irradiance_sh = ProjectIrradiance(hdri, sh9_key, sh9_path, source != 0);
+        }
+
+        bool bake_irradiance = maps.irradiance_sh.empty();
+
+        maps.irradiance_map  = source != 0 && bake_irradiance ? Find(irr_key, irr_path) : nullptr;
+        maps.prefiltered_map = source != 0 ? Find(pre_key, pre_path) : nullptr;
+        maps.BRDF_LUT        = Find(LUT_key, LUT_path);
+
+        if ((bake_irradiance && maps.irradiance_map == nullptr) || maps.prefiltered_map == nullptr) {
+            CORE_INFO("Precomputing IBL maps from {0}", hdri);
+
+            // the environment cubemap is only an intermediate, which is no longer needed once baked
+            auto env_map = IsDirectory(hdri)
+                ? MakeAsset<Texture>(hdri, ".hdr", env_resolution, 0)
+                : MakeAsset<Texture>(hdri, env_resolution, 0);
+
+            if (bake_irradiance && maps.irradiance_map == nullptr) {
+                CORE_INFO("Precomputing diffuse irradiance map from {0}", hdri);
+                maps.irradiance_map = BakeIrradiance(*env_map);
+
+                if (source != 0) {
+                    Save(*maps.irradiance_map, irr_path);
+                    Store(irr_key, maps.irradiance_map);
+                }
+            }
+
+            if (maps.prefiltered_map == nullptr) {
+                CORE_INFO("Precomputing specular prefiltered envmap from {0}", hdri);
+                maps.prefiltered_map = BakePrefiltered(*env_map);
+
+                if (validate && !IsDirectory(hdri)) {
+                    Validate(hdri, *maps.prefiltered_map);
+                }
+
+                if (source != 0) {
+                    Save(*maps.prefiltered_map, pre_path);
+                    Store(pre_key, maps.prefiltered_map);
+                }
+            }
+
+            env_map->Unbind(0);
+        }
+
+        if (maps.BRDF_LUT == nullptr) {
+            CORE_INFO("Precomputing specular environment BRDF ...");
+            maps.BRDF_LUT = BakeBRDF();
+            Save(*maps.BRDF_LUT, LUT_path);
+            Store(LUT_key, maps.BRDF_LUT);
+        }
+
+        return maps;
+    }
+
+    glm::vec3 IBLBaker::PrefilterReference(const utils::Image& equirect, const glm::vec3& R, float roughness, unsigned int n_samples) {
+        // the same estimator as "core/prefilter_envmap.glsl", but with plain point lookups into the
+        // equirectangle instead of filtered ones, which converges to the exact convolution given
+        // enough samples, it's slow, but it needs neither a GPU nor mipmaps to compare against
+        auto samples = GGXSamples(roughness, n_samples, 1);
+
+        glm::vec3 N = glm::normalize(R);
+        glm::vec3 U = std::abs(N.y) <= 0.999f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 T = glm::normalize(glm::cross(U, N));
+        glm::vec3 B = glm::cross(N, T);
+
+        const uint16_t* pixels = equirect.GetPixels<uint16_t>();
+        const GLuint w = equirect.Width();
+        const GLuint h = equirect.Height();
+
+        auto color = glm::dvec3(0.0);
+        double weight = 0.0;
+
+        for (const auto& s : samples) {
+            glm::vec3 L = T * s.x + B * s.y + N * s.z;
+
+            // same mapping as `Cartesian2Spherical()` and `Spherical2Equirect()` in GLSL
+            float u = std::atan2(L.z, L.x) / (2.0f * pi) + 0.5f;
+            float v = std::acos(glm::clamp(L.y, -1.0f, 1.0f)) / pi;
+            GLuint x = std::min(static_cast<GLuint>(u * w), w - 1);
+            GLuint y = std::min(static_cast<GLuint>(v * h), h - 1);
+
+            const uint16_t* texel = pixels + (static_cast<size_t>(y) * w + x) * 4;
+            auto Li = glm::dvec3(glm::unpackHalf1x16(texel[0]), glm::unpackHalf1x16(texel[1]), glm::unpackHalf1x16(texel[2]));
+
+            color += Li * static_cast<double>(s.z);
+            weight += s.z;
+        }
+
+        return glm::vec3(color / weight);
+    }
+
+    void IBLBaker::Clear() {
+        cache.clear();
+        sh_cache.clear();
+        source_hashes.clear();
+    }
+
+}
@@ -0,0 +1,101 @@
+/*
+   the IBL baker precomputes the maps needed by image-based lighting from an HDRI: the diffuse
+   irradiance map, the specular prefiltered environment map, and the environment BRDF lookup
+   table (split-sum approximation). Baking them takes several compute passes over a 2K cubemap,
+   and used to be repeated on every scene attach, even when the same HDRI and the same LUT were
+   used before, so the results are now cached at two levels.
+
+   # memory cache
+
+   each baked texture is keyed by a hash of everything it depends on: the content of the HDRI
+   file(s), the resolutions and number of levels, and the preprocessed source of the compute
+   shaders involved, so editing a bake shader automatically invalidates the maps it produced.
+   The BRDF LUT doesn't depend on the HDRI at all, so it's baked once and shared by all scenes.
+   Baked textures stay alive in a cross-scene cache after the scene that asked for them has
+   been unloaded, so switching back and forth between scenes costs nothing, the cache keeps the
+   `capacity` most recently used textures, `Clear()` releases all of them.
+
+   # disk cache
+
+   every texture that is baked is also written to `paths::cache` as a KTX2 file (RGBA16F, all
+   faces and levels, see "utils/ktx.h"), the key is part of the file name so a stale file is
+   simply never looked up again. On the next launch, the maps are uploaded straight from the
+   files, the HDRI is not even decoded. Reading back the texture from the GPU happens on the
+   main thread, but encoding and writing the file is done by a worker. Set `use_cache` to false
+   to always bake from scratch and skip writing the files.
+
+   > Renderer::SeamlessCubemap(true);  // the bake samples across cubemap faces
+   > auto ibl = IBLBaker::Bake(paths::texture + "HDRI\\moonlit_sky2.hdr");
+   > material.SetTexture(pbr_t::irradiance_map, ibl.irradiance_map);
+
+   # prefiltering
+
+   the prefiltered map uses filtered importance sampling: each GGX sample reads the mip level
+   of the environment whose texels cover the solid angle the sample stands for (derived from
+   its PDF), so a few dozen samples are enough at low roughness, and the count only grows to
+   `prefilter_max_samples` at roughness 1. Under the split-sum `N = V = R` assumption, the
+   sample directions, weights and mip levels are the same for every texel, they are computed
+   once per level on the CPU and passed to the shader in an SSBO. `PrefilterReference()` is a
+   brute-force CPU version of the same integral on the equirectangle (no mipmaps, no GPU),
+   with `validate` set, every fresh bake is compared against it at the face centers.
+
+   # spherical harmonics
+
+   with `irradiance_sh` set, the diffuse irradiance of an equirectangular HDRI is projected on
+   the CPU onto 9 SH coefficients (see `imgproc::ProjectSH()`) instead of being baked into a
+   cubemap, `irradiance_map` is then left empty. That saves a cubemap and a texture fetch per
+   pixel, PBR materials evaluate the coefficients directly (see "core/pbr_uniform.glsl"). The
+   27 floats are cached like the textures, in memory and as a small binary file on disk. For
+   a directory of faces, there's no equirectangle to project, so the cubemap is baked anyway.
+
+   > auto ibl = IBLBaker::Bake(paths::texture + "HDRI\\moonlit_sky2.hdr", true);
+   > material.SetUniform(pbr_u::irradiance_sh, true);
+   > material.SetUniformArray(pbr_u::sh9, 9, &ibl.irradiance_sh);  // the vector must outlive the material
+
+   `hdri` is either an equirectangular ".hdr" file, or a directory that contains the 6 faces
+   "px.hdr", "nx.hdr", "py.hdr", "ny.hdr", "pz.hdr" and "nz.hdr" (the path ends with a slash).
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "core/base.h"
+
+namespace utils {
+    class Image;  // forward declaration
+}
+
+namespace asset {
+
+    class Texture;  // forward declaration
+
+    struct IBLMaps {
+        asset_ref<Texture> irradiance_map;
+        asset_ref<Texture> prefiltered_map;
+        asset_ref<Texture> BRDF_LUT;
+        std::vector<glm::vec3> irradiance_sh;  // 9 coefficients, empty if the irradiance map was baked
+    };
+
+    class IBLBaker {
+      public:
+        static inline unsigned int env_resolution = 2048;        // base level of the prefiltered map
+        static inline unsigned int prefilter_levels = 8;         // one roughness value per level
+        static inline unsigned int prefilter_min_samples = 32;   // GGX samples per texel at roughness 0
+        static inline unsigned int prefilter_max_samples = 512;  // GGX samples per texel at roughness 1
+        static inline unsigned int irradiance_resolution = 128;
+        static inline unsigned int BRDF_resolution = 1024;
+        static inline float sh_window = 0.0f;  // Hanning window width in bands, 0 = no windowing
+        static inline size_t capacity = 8;  // baked textures kept alive across scenes
+        static inline bool use_cache = true;  // read and write the KTX2 files in `paths::cache`
+        static inline bool validate = false;  // check freshly baked prefiltered maps against the CPU reference
+
+        static IBLMaps Bake(const std::string& hdri, bool irradiance_sh = false);
+        static void Clear();
+
+        static glm::vec3 PrefilterReference(const utils::Image& equirect, const glm::vec3& R, float roughness,
+            unsigned int n_samples = 16384);
+    };
+
+}
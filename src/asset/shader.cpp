@@ -3,29 +3,123 @@
 #include <fstream>
 #include <sstream>
 #include <type_traits>
+#include <GL/freeglut.h>
+#include <GLFW/glfw3.h>
+
 #include "core/app.h"
+#include "core/base.h"
+#include "core/bench.h"
 #include "core/log.h"
 #include "asset/shader.h"
 #include "utils/ext.h"
+#include "utils/file.h"
+#include "utils/glsl.h"
+#include "utils/path.h"
+#include "utils/profile.h"
+#include "utils/watch.h"
+
+// GL_KHR_parallel_shader_compile is not in our GLAD build, the token is shared with the ARB version
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (KHRONOS_APIENTRY* PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
 
 namespace asset {
 
     static GLuint curr_bound_shader = 0;  // keep track of the current rendering state
+    static std::vector<Shader*> pending_shaders;  // submitted to the driver, but not finished yet
+    static std::vector<Shader*> live_shaders;     // built from source, can be hot-reloaded
+    static std::unique_ptr<utils::DirectoryWatcher> watcher;  // watches `paths::shader` for hot-reload
+
+    // program binary cache file layout: header followed by the binary blob
+    struct ProgramCacheHeader {
+        uint32_t tag;
+        uint32_t version;
+        uint64_t hash;     // preprocessed sources + driver strings
+        uint32_t format;   // binary format returned by `glGetProgramBinary()`
+        uint32_t length;   // length of the binary in bytes
+    };
+
+    static_assert(sizeof(ProgramCacheHeader) == 24);
+
+    static constexpr uint32_t cache_tag = 0x47505053;  // "SPPG"
+    static constexpr uint32_t cache_version = 1;
+
+    static const char* StageMacro(GLenum type) {
+        switch (type) {
+            case GL_COMPUTE_SHADER:          return "compute_shader";
+            case GL_VERTEX_SHADER:           return "vertex_shader";
+            case GL_TESS_CONTROL_SHADER:     return "tess_ctrl_shader";
+            case GL_TESS_EVALUATION_SHADER:  return "tess_eval_shader";
+            case GL_GEOMETRY_SHADER:         return "geometry_shader";
+            case GL_FRAGMENT_SHADER:         return "fragment_shader";
+            default:                         return "";
+        }
+    }
+
+    static std::string ShaderLog(GLuint shader) {
+        GLint info_log_length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
+
+        std::string info_log(std::max(info_log_length, 1), '\0');
+        glGetShaderInfoLog(shader, info_log_length, NULL, info_log.data());
+        return info_log.c_str();
+    }
+
+    static std::string ProgramLog(GLuint program) {
+        GLint info_log_length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
+
+        std::string info_log(std::max(info_log_length, 1), '\0');
+        glGetProgramInfoLog(program, info_log_length, NULL, info_log.data());
+        return info_log.c_str();
+    }
+
+    static uint64_t DriverHash() {
+        // a binary can only be loaded by the same card and driver that produced it
+        static const uint64_t hash = [] {
+            uint64_t h = utils::Hash64(nullptr, 0);
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+                auto str = reinterpret_cast<const char*>(glGetString(name));
+                h = str ? utils::Hash64(str, std::strlen(str), h) : h;
+            }
+            return h;
+        }();
+        return hash;
+    }
+
+    static uint64_t ReadStages(const std::string& source_path, const std::vector<GLenum>& types,
+        std::vector<std::pair<GLenum, std::string>>& stages) {
+        // preprocessing is cheap compared to compiling, the hash must cover every included file,
+        // the source is expanded only once, each stage differs only in the macro that's defined
+        auto program = utils::glsl::Preprocess(source_path);
+        uint64_t hash = DriverHash();
+
+        for (GLenum type : types) {
+            if (std::string macro = StageMacro(type); program.HasStage(macro)) {
+                std::string code = program.Stage(macro);
+                hash = utils::Hash64(&type, sizeof(type), hash);
+                hash = utils::Hash64(code.data(), code.size(), hash);
+                stages.emplace_back(type, std::move(code));
+            }
+        }
+
+        return hash;
+    }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////
 
     Shader::Shader(const std::string& source_path) : IAsset(), source_path(source_path) {
-        CORE_INFO("Compiling and linking shader source: {0}", source_path);
-        LoadShader(GL_VERTEX_SHADER);
-        LoadShader(GL_TESS_CONTROL_SHADER);
-        LoadShader(GL_TESS_EVALUATION_SHADER);
-        LoadShader(GL_GEOMETRY_SHADER);
-        LoadShader(GL_FRAGMENT_SHADER);
-
-        LinkShaders();
+        PROFILE_FUNCTION();
+        Build({
+            GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER,
+            GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER
+        });
     }
 
     Shader::Shader(const std::string& binary_path, GLenum format) : IAsset(), source_path() {
+        PROFILE_FUNCTION();
         CORE_INFO("Loading pre-compiled shader program from {0} ...", binary_path);
 
         // construct the shader program by loading from a pre-compiled shader binary
@@ -60,11 +154,24 @@ namespace asset {
     }
 
     Shader::~Shader() {
+        if (!source_path.empty()) {
+            live_shaders.erase(std::remove(live_shaders.begin(), live_shaders.end(), this), live_shaders.end());
+        }
+
+        if (pending) {
+            pending_shaders.erase(std::remove(pending_shaders.begin(), pending_shaders.end(), this), pending_shaders.end());
+            utils::ranges::for_each(shaders, [](GLuint shader) { glDeleteShader(shader); });
+        }
+
         Unbind();
         glDeleteProgram(id);
     }
 
     void Shader::Bind() const {
+        if (pending) {
+            const_cast<Shader*>(this)->Finish();  // shaders are never created const, this is safe
+        }
+
         if (id != curr_bound_shader) {
             glUseProgram(id);
             curr_bound_shader = id;
@@ -78,36 +185,108 @@ namespace asset {
         }
     }
 
-    void Shader::Save() const {
-        // save the compiled shader binary to the source folder on disk
+    bool Shader::Ready() const {
+        if (!pending) {
+            return true;
+        }
+
+        // doesn't block, unlike `GL_LINK_STATUS` which waits for the driver to finish the program
+        GLint status = GL_FALSE;
+        glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &status);
+        return status == GL_TRUE;
+    }
+
+    void Shader::Wait() {
+        if (pending) {
+            Finish();
+        }
+    }
+
+    bool Shader::Reload() {
+        PROFILE_FUNCTION();
         if (source_path.empty()) {
-            CORE_ERROR("Shader binary already exists, please delete it before saving ...");
-            return;
+            return false;  // loaded from a binary, there's no source to rebuild from
         }
 
-        GLint formats;
-        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
-        CORE_TRACE("Number of shader binary formats supported: {0}", formats);
+        Wait();
 
-        if (formats <= 0) {
-            CORE_WARN("No binary formats supported, failed to save shader binary.");
-            return;
+        // build a new program next to the old one, which is only replaced if everything succeeds,
+        // unlike the first build, errors are not fatal, we keep running with the last good version
+        std::vector<std::pair<GLenum, std::string>> stages;
+        uint64_t hash = ReadStages(source_path, stage_types, stages);
+
+        std::vector<GLuint> new_shaders;
+        GLint status = GL_TRUE;
+
+        for (const auto& [type, code] : stages) {
+            const char* c_source_code = code.c_str();
+            GLuint shader_id = glCreateShader(type);
+            glShaderSource(shader_id, 1, &c_source_code, nullptr);
+            glCompileShader(shader_id);
+            new_shaders.push_back(shader_id);
         }
 
-        GLint binary_length;
-        glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &binary_length);
-        CORE_TRACE("Retrieving shader binary length ... : {0}", binary_length);
+        for (GLuint shader : new_shaders) {
+            if (glGetShaderiv(shader, GL_COMPILE_STATUS, &status); status == GL_FALSE) {
+                CORE_ERROR("Failed to compile shader {0}: {1}", source_path, ShaderLog(shader));
+                break;
+            }
+        }
 
-        GLenum binary_format;
-        std::vector<GLubyte> buffer(binary_length);
-        glGetProgramBinary(id, binary_length, NULL, &binary_format, buffer.data());
+        GLuint pid = 0;
+
+        if (status == GL_TRUE) {
+            pid = glCreateProgram();
+            utils::ranges::for_each(new_shaders, [pid](GLuint shader) { glAttachShader(pid, shader); });
+            glProgramParameteri(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            glLinkProgram(pid);
+
+            if (glGetProgramiv(pid, GL_LINK_STATUS, &status); status == GL_FALSE) {
+                CORE_ERROR("Failed to link shaders {0}: {1}", source_path, ProgramLog(pid));
+            }
+        }
+
+        for (GLuint shader : new_shaders) {
+            if (pid > 0) {
+                glDetachShader(pid, shader);
+            }
+            glDeleteShader(shader);
+        }
+
+        if (status == GL_FALSE) {
+            glDeleteProgram(pid);  // silently ignored if 0
+            CORE_WARN("Shader reload failed, keeping the previous version: {0}", source_path);
+            return false;
+        }
+
+        // swap in the new program under the same object, materials pick up the new id on bind
+        if (curr_bound_shader == id) {
+            glUseProgram(pid);
+            curr_bound_shader = pid;
+        }
 
-        std::string filepath = source_path + "\\" + std::to_string(binary_format) + ".bin";
-        CORE_TRACE("Saving compiled shader program to {0} ...", filepath);
+        glDeleteProgram(id);
+        this->id = pid;
+        this->source_hash = hash;
+        this->source_code = stages.empty() ? "" : stages.front().second;
+
+        if (use_cache) {
+            SaveCache(CachePath(source_path), hash);
+        }
 
-        std::ofstream out_stream(filepath.c_str(), std::ios::binary);
-        out_stream.write(reinterpret_cast<char*>(buffer.data()), binary_length);
-        out_stream.close();
+        Reflect();
+        CORE_INFO("Reloaded shader program (id = {0}): {1}", id, source_path);
+        return true;
+    }
+
+    void Shader::Save() const {
+        // save the compiled shader binary to the cache, this is done automatically after compiling
+        if (source_path.empty()) {
+            CORE_ERROR("Shader binary already exists, please delete it before saving ...");
+            return;
+        }
+
+        SaveCache(CachePath(source_path), source_hash);
     }
 
     void Shader::Inspect() const {
@@ -122,18 +301,20 @@ namespace asset {
         }
 
         CORE_TRACE("Inspecting source code for shader {0}: (example shader stage)", id);
-        core::Log::GetLogger()->set_pattern("         > %^%v%$");
 
+        // the listing is sent as a single message, in async mode the pattern can't be switched
+        // on the fly because messages still in the queue would be formatted with the new one
         std::istringstream isstream(source_code);
+        std::ostringstream listing;
         std::string line;
         int line_number = 1;
 
         while (std::getline(isstream, line)) {
-            CORE_DEBUG("{0:03d} | {1}", line_number, line);
+            listing << fmt::format("\n         > {0:03d} | {1}", line_number, line);
             line_number++;
         }
 
-        core::Log::GetLogger()->set_pattern("%^%T > [%L] %v%$");
+        CORE_DEBUG("{0}", listing.str());
     }
 
     template<typename T>
@@ -163,169 +344,319 @@ namespace asset {
         }
     }
 
-    void Shader::ReadShader(const std::string& path, const std::string& macro, std::string& output) {
-        std::ifstream file_stream = std::ifstream(path, std::ios::in);
-        if (!file_stream.is_open()) {
-            CORE_ERROR("Unable to read shader file {0} ... ", path);
-            return;
+    void Shader::LoadShader(GLenum type, const std::string& code) {
+        if (this->source_code.empty()) {
+            this->source_code = code;
         }
 
-        bool defined = false;
-        std::string line;
+        const char* c_source_code = code.c_str();
+        GLuint shader_id = glCreateShader(type);
+        glShaderSource(shader_id, 1, &c_source_code, nullptr);
+        glCompileShader(shader_id);  // the status is checked in `Finish()`, so that we don't block here
 
-        while (std::getline(file_stream, line)) {
-            // lines w/o "#ifdef" and "#include", just append to the string buffer and continue
-            if (line.find("#include") == std::string::npos && line.find("#ifdef") == std::string::npos) {
-                output.append(line + '\n');
-                continue;
-            }
+        shaders.push_back(shader_id);
+    }
 
-            // "#define" the macro only once before the first occurrence of "#ifdef" or "#include"
-            if (!defined && !macro.empty()) {
-                output += ("#ifndef " + macro + '\n');
-                output += ("#define " + macro + '\n');
-                output += ("#endif\n\n");
-                defined = true;
+    void Shader::LinkShaders() {
+        GLuint pid = glCreateProgram();
+        CORE_ASERT(pid > 0, "Cannot create the program object...");
+
+        for (auto&& shader : shaders) {
+            if (shader > 0) {  // invalid shader ids are discarded
+                glAttachShader(pid, shader);
             }
+        }
 
-            if (line.find("#include") != std::string::npos) {
-                // recursively resolve "#include", replace the line with the contents of the header file
-                auto directory = std::filesystem::path(path).parent_path();
-                std::string relative_path = line.substr(10);
-                relative_path.pop_back();  // remove the last double quote
-                std::string full_include_path = (directory / relative_path).string();
+        glProgramParameteri(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);  // so that it can be cached
+        glLinkProgram(pid);
 
-                ReadShader(full_include_path, "", output);  // recursive call doesn't define the macro
+        this->id = pid;
+        this->pending = true;
+    }
+
+    void Shader::Finish() {
+        PROFILE_FUNCTION();
+        GLint status;
+
+        // a shader that failed to compile also fails the link, but its own log is more helpful
+        for (GLuint shader : shaders) {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+            if (status == GL_FALSE) {
+                CORE_ERROR("Failed to compile shader {0}: {1}", source_path, ShaderLog(shader));
+                std::cin.get();  // pause the console before exiting so that we can read error messages
+                exit(EXIT_FAILURE);
             }
-            else {
-                output.append(line + '\n');  // macro is already defined, "#ifdef" proceeds as normal
+        }
+
+        GLuint pid = id;
+        glGetProgramiv(pid, GL_LINK_STATUS, &status);
+
+        if (status == GL_FALSE) {
+            CORE_ERROR("Failed to link shaders: {0}", ProgramLog(pid));
+            std::cin.get();  // pause the console before exiting so that we can read error messages
+            exit(EXIT_FAILURE);
+        }
+
+        auto clear_cache = [&pid](GLuint& shader) {
+            if (shader > 0) {
+                glDetachShader(pid, shader);
+                glDeleteShader(shader);
             }
+        };
+        
+        utils::ranges::for_each(shaders, clear_cache);
+        this->shaders.clear();
+        this->pending = false;
+
+        pending_shaders.erase(std::remove(pending_shaders.begin(), pending_shaders.end(), this), pending_shaders.end());
+
+        if (use_cache) {
+            SaveCache(CachePath(source_path), source_hash);
         }
 
-        output.append("\n");
-        file_stream.close();
+        Reflect();
     }
 
-    void Shader::LoadShader(GLenum type) {
-        std::string macro;
-        std::string outbuff;
-        outbuff.reserve(8192);
+    void Shader::Build(const std::vector<GLenum>& types) {
+        this->stage_types = types;
+        live_shaders.push_back(this);
 
-        switch (type) {
-            case GL_COMPUTE_SHADER:          macro = "compute_shader";    break;
-            case GL_VERTEX_SHADER:           macro = "vertex_shader";     break;
-            case GL_TESS_CONTROL_SHADER:     macro = "tess_ctrl_shader";  break;
-            case GL_TESS_EVALUATION_SHADER:  macro = "tess_eval_shader";  break;
-            case GL_GEOMETRY_SHADER:         macro = "geometry_shader";   break;
-            case GL_FRAGMENT_SHADER:         macro = "fragment_shader";   break;
-            default: {
-                CORE_ERROR("Invalid shader type: {0}", type);
-                return;
-            }
+        std::vector<std::pair<GLenum, std::string>> stages;
+        uint64_t hash = ReadStages(source_path, types, stages);
+
+        this->source_hash = hash;
+        std::string cache_path = CachePath(source_path);
+
+        if (use_cache && LoadCache(cache_path, hash)) {
+            CORE_INFO("Loading cached shader program: {0}", source_path);
+            this->source_code = stages.empty() ? "" : stages.front().second;
+            Reflect();
+            return;
         }
 
-        ReadShader(source_path, macro, outbuff);
+        CORE_INFO("Compiling and linking shader source: {0}", source_path);
 
-        if (outbuff.find("#ifdef " + macro) == std::string::npos) {
-            return;  // this shader type is not defined in the GLSL file, skip
+        for (const auto& [type, code] : stages) {
+            LoadShader(type, code);
         }
 
-        if (this->source_code.empty()) {
-            this->source_code = outbuff;
+        LinkShaders();
+
+        // with parallel compile, the driver keeps working in the background until we ask for the result
+        if (ParallelCompile()) {
+            pending_shaders.push_back(this);
         }
+        else {
+            Finish();
+        }
+    }
 
-        const char* c_source_code = outbuff.c_str();
-        GLuint shader_id = glCreateShader(type);
-        glShaderSource(shader_id, 1, &c_source_code, nullptr);
-        glCompileShader(shader_id);
+    bool Shader::LoadCache(const std::string& filepath, uint64_t hash) {
+        auto file = utils::MappedFile(filepath);
+        if (!file.Valid() || file.Size() < sizeof(ProgramCacheHeader)) {
+            return false;
+        }
+
+        ProgramCacheHeader header;
+        std::memcpy(&header, file.Data(), sizeof(ProgramCacheHeader));
+
+        bool valid = header.tag == cache_tag
+            && header.version == cache_version
+            && header.hash == hash
+            && header.length > 0
+            && sizeof(ProgramCacheHeader) + header.length == file.Size();
+
+        if (!valid) {
+            CORE_TRACE("Cache file is outdated, will be rebuilt: {0}", filepath);
+            return false;
+        }
+
+        GLuint pid = glCreateProgram();
+        glProgramBinary(pid, header.format, file.Data() + sizeof(ProgramCacheHeader), header.length);
 
         GLint status;
-        glGetShaderiv(shader_id, GL_COMPILE_STATUS, &status);
+        glGetProgramiv(pid, GL_LINK_STATUS, &status);
 
+        // the driver is free to reject any binary, in which case we simply compile from source
         if (status == GL_FALSE) {
-            GLint info_log_length;
-            glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &info_log_length);
+            CORE_WARN("Cached shader binary rejected by the driver, will be rebuilt: {0}", filepath);
+            glDeleteProgram(pid);
+            return false;
+        }
 
-            GLchar* info_log = new GLchar[info_log_length + 1];
-            glGetShaderInfoLog(shader_id, info_log_length, NULL, info_log);
+        this->id = pid;
+        return true;
+    }
 
-            CORE_ERROR("Failed to compile shader: {0}", info_log);
-            delete[] info_log;
-            glDeleteShader(shader_id);  // prevent shader leak
+    void Shader::SaveCache(const std::string& filepath, uint64_t hash) const {
+        GLint formats;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
 
-            std::cin.get();  // pause the console before exiting so that we can read error messages
-            exit(EXIT_FAILURE);
+        if (formats <= 0) {
+            CORE_WARN("No binary formats supported, failed to save shader binary.");
+            return;
         }
 
-        shaders.push_back(shader_id);
+        GLint binary_length;
+        glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+
+        if (binary_length <= 0) {
+            return;
+        }
+
+        std::vector<uint8_t> buffer(sizeof(ProgramCacheHeader) + binary_length);
+        GLenum binary_format;
+        glGetProgramBinary(id, binary_length, NULL, &binary_format, buffer.data() + sizeof(ProgramCacheHeader));
+
+        ProgramCacheHeader header { cache_tag, cache_version, hash, binary_format, static_cast<uint32_t>(binary_length) };
+        std::memcpy(buffer.data(), &header, sizeof(ProgramCacheHeader));
+
+        if (!utils::WriteFileAtomic(filepath, buffer.data(), buffer.size())) {
+            CORE_WARN("Unable to write shader binary cache: {0}", filepath);
+        }
     }
 
-    void Shader::LinkShaders() {
-        GLuint pid = glCreateProgram();
-        CORE_ASERT(pid > 0, "Cannot create the program object...");
+    bool Shader::ParallelCompile() {
+        static const bool supported = [] {
+            GLint n_extensions = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &n_extensions);
+            std::string suffix;
+
+            for (GLint i = 0; i < n_extensions && suffix != "KHR"; i++) {
+                auto name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+                if (name == nullptr) {
+                    continue;
+                }
+                else if (std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0) {
+                    suffix = "KHR";
+                }
+                else if (std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0) {
+                    suffix = "ARB";
+                }
+            }
 
-        for (auto&& shader : shaders) {
-            if (shader > 0) {  // invalid shader ids are discarded
-                glAttachShader(pid, shader);
+            if (suffix.empty()) {
+                CORE_WARN("Parallel shader compilation is not supported, programs will be compiled in turn");
+                return false;
+            }
+
+            // the extension is not loaded by GLAD, so we have to fetch the entry point ourselves
+            std::string proc_name = "glMaxShaderCompilerThreads" + suffix;
+            PFNGLMAXSHADERCOMPILERTHREADSKHRPROC max_threads = nullptr;
+
+            if constexpr (_freeglut) {
+                max_threads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(glutGetProcAddress(proc_name.c_str()));
+            }
+            else {
+                max_threads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(glfwGetProcAddress(proc_name.c_str()));
+            }
+
+            if (max_threads != nullptr) {
+                max_threads(0xFFFFFFFF);  // let the driver use as many threads as it sees fit
             }
+
+            CORE_INFO("Enabled parallel shader compilation (GL_{0}_parallel_shader_compile)", suffix);
+            return true;
+        }();
+
+        return supported;
+    }
+
+    bool Shader::Poll() {
+        PROFILE_FUNCTION();
+
+        // finishing a program removes it from the list, so collect the ready ones first
+        std::vector<Shader*> ready;
+        std::copy_if(pending_shaders.begin(), pending_shaders.end(), std::back_inserter(ready),
+            [](const Shader* shader) { return shader->Ready(); });
+
+        for (Shader* shader : ready) {
+            shader->Finish();
         }
 
-        glLinkProgram(pid);
+        PROFILE_COUNTER("Pending Shaders", pending_shaders.size());
+        return pending_shaders.empty();
+    }
 
-        GLint status;
-        glGetProgramiv(pid, GL_LINK_STATUS, &status);
+    void Shader::WaitAll() {
+        PROFILE_FUNCTION();
+        while (!pending_shaders.empty()) {
+            pending_shaders.front()->Finish();
+        }
+    }
 
-        if (status == GL_FALSE) {
-            GLint info_log_length;
-            glGetProgramiv(pid, GL_INFO_LOG_LENGTH, &info_log_length);
+    void Shader::HotReload() {
+        if (!hot_reload) {
+            watcher.reset();
+            return;
+        }
 
-            GLchar* info_log = new GLchar[info_log_length + 1];
-            glGetProgramInfoLog(pid, info_log_length, NULL, info_log);
+        if (watcher == nullptr) {
+            CORE_INFO("Watching shader sources for changes: {0}", utils::paths::shader);
+            watcher = std::make_unique<utils::DirectoryWatcher>(utils::paths::shader);
+        }
 
-            CORE_ERROR("Failed to link shaders: {0}", info_log);
-            delete[] info_log;
+        auto changes = watcher->Poll();
+        if (changes.empty()) {
+            return;
+        }
 
-            std::cin.get();  // pause the console before exiting so that we can read error messages
-            exit(EXIT_FAILURE);
+        PROFILE_FUNCTION();
+        std::set<std::string> affected;
+
+        // a changed header affects every program that includes it, directly or indirectly
+        for (const auto& file : changes) {
+            if (std::filesystem::path(file).extension() != ".glsl") {
+                continue;
+            }
+
+            std::string path = utils::glsl::Normalize(file);
+            utils::glsl::Invalidate(path);
+            affected.insert(path);
+
+            for (auto& dependent : utils::glsl::Dependents(path)) {
+                affected.insert(std::move(dependent));
+            }
         }
 
-        auto clear_cache = [&pid](GLuint& shader) {
-            if (shader > 0) {
-                glDetachShader(pid, shader);
-                glDeleteShader(shader);
+        // reloading doesn't add or remove shaders, but iterate over a copy to be safe
+        auto shaders = live_shaders;
+
+        for (Shader* shader : shaders) {
+            if (affected.count(utils::glsl::Normalize(shader->source_path)) > 0) {
+                shader->Reload();
             }
-        };
-        
-        utils::ranges::for_each(shaders, clear_cache);
-        this->shaders.clear();
-        this->id = pid;
+        }
+    }
+
+    std::string Shader::CachePath(const std::string& source_path) {
+        // keyed by the source path, the content hash is stored inside the file
+        uint64_t key = utils::Hash64(source_path.data(), source_path.size());
+
+        std::ostringstream name;
+        name << std::filesystem::path(source_path).stem().string() << "."
+             << std::hex << std::setw(16) << std::setfill('0') << key << ".glbin";
+
+        return utils::paths::cache + name.str();
     }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////
 
     CShader::CShader(const std::string& source_path) : Shader() {
+        PROFILE_FUNCTION();
         this->source_path = source_path;
         this->source_code = "";
+        this->label = std::filesystem::path(source_path).stem().string();
 
-        CORE_INFO("Compiling and linking compute shader: {0}", source_path);
-        LoadShader(GL_COMPUTE_SHADER);
-        LinkShaders();
-
-        GLint local_size[3];
-        glGetProgramiv(id, GL_COMPUTE_WORK_GROUP_SIZE, local_size);
-        this->local_size_x = local_size[0];
-        this->local_size_y = local_size[1];
-        this->local_size_z = local_size[2];
+        Build({ GL_COMPUTE_SHADER });
     }
 
     CShader::CShader(const std::string& binary_path, GLenum format)
     try : Shader(binary_path, format) {
         // this is the ctor body, we won't reach here if `try` failed in the initializer list
-        GLint local_size[3];
-        glGetProgramiv(id, GL_COMPUTE_WORK_GROUP_SIZE, local_size);
-        this->local_size_x = local_size[0];
-        this->local_size_y = local_size[1];
-        this->local_size_z = local_size[2];
+        this->label = std::filesystem::path(binary_path).parent_path().stem().string();  // "<source>\\<format>.bin"
+        Reflect();
     }
     // this is the `catch` block in the initializer list, not the ctor body
     catch (const std::runtime_error& e) {
@@ -333,6 +664,14 @@ namespace asset {
         throw std::runtime_error("Compute shader compilation failed...");
     }
 
+    void CShader::Reflect() {
+        GLint local_size[3];
+        glGetProgramiv(id, GL_COMPUTE_WORK_GROUP_SIZE, local_size);
+        this->local_size_x = local_size[0];
+        this->local_size_y = local_size[1];
+        this->local_size_z = local_size[2];
+    }
+
     void CShader::Dispatch(GLuint nx, GLuint ny, GLuint nz) const {
         static GLuint max_invocations = core::Application::GetInstance().cs_max_invocations;
         CORE_ASERT(local_size_x * local_size_y * local_size_z <= max_invocations, "Compute size overflow!");
@@ -353,7 +692,9 @@ namespace asset {
         CORE_ASERT(ny >= 1 && ny <= cs_ny, "Invalid number of work groups y: {0}", ny);
         CORE_ASERT(nz >= 1 && nz <= cs_nz, "Invalid number of work groups z: {0}", nz);
 
+        GPU_SCOPE(label);  // named after the shader file, e.g. "cull", "bloom", "cloth"
         glDispatchCompute(nx, ny, nz);
+        core::Benchmark::dispatches++;
     }
 
     void CShader::SyncWait(GLbitfield barriers) const {
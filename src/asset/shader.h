@@ -44,21 +44,67 @@
 
    nested "#include" is also supported by recursion so you can include file "A" that includes
    another file "B", but make sure to protect headers by "#ifdef/endif" guards if you want to
-   include them multiple times ("#pragma once" is implementation-dependent in GLSL). Also, we
-   cannot use "#include" or "ifdef" in any line comment and block comment as they are treated
-   as special statements when being parsed, even in the comments!
-
-   # save/load shader binaries
-
-   to build a shader by loading a precompiled binary, that file needs to be already `Save()`
-   on local disk. On save, the current shader program will be saved to the source directory
-   as a ".bin" file, whose filename is an integer format number that depends on the hardware
-   such as 3274 or 1. If the GPU does not support any format number, meaning that we cannot
-   `Save()`, the user will be notified by a warning message in the console.
-
-   it should be noted that the format number support differs across hardware and drivers, you
-   can only load a binary that's saved by yourself, on the same platform, same card, AND with
-   the same driver version, o/w loading could fail. SPIR-V binary is currently not supported.
+   include them multiple times, or put "#pragma once" in the header, which our preprocessor
+   resolves by itself (see "utils/glsl.h"). Also, we cannot use "#include" or "ifdef" in any
+   line comment and block comment as they are treated as special statements when being parsed,
+   even in the comments! Files are read and parsed only once and cached across programs, the
+   source is expanded once per program, and each stage is cut from the same flattened text.
+
+   # program binary cache
+
+   compiling and linking is by far the slowest part of creating a shader, the PBR uber-shader
+   alone takes a good fraction of a second, and every scene switch compiles a dozen programs.
+   so when a shader is built from source, the source of every stage is first preprocessed,
+   then hashed along with `GL_VENDOR`, `GL_RENDERER` and `GL_VERSION`, and the linked program
+   binary is looked up under `paths::cache` (one file per source file). On a hit, the program
+   is created with `glProgramBinary()` and no GLSL is compiled at all. On a miss, or if the
+   driver rejects the binary (e.g. after a driver update it didn't tell us about), we fall
+   back to compiling, then `glGetProgramBinary()` writes the new binary back to the cache.
+
+   the hash covers the fully preprocessed code, so editing an included header invalidates all
+   the programs that include it, and the driver strings make sure that we never load a binary
+   built for another card or driver. Set `Shader::use_cache` to false to always compile.
+
+   it's still possible to load a binary from an explicit path and format number, which then
+   must have been saved by the same platform, same card, AND same driver version. `Save()`
+   forces the current program to be written to the cache, if the driver supports at least one
+   binary format. SPIR-V binary is currently not supported.
+
+   # parallel compilation
+
+   compiling is CPU work done by the driver, and most drivers can spread it over many threads,
+   but only if we don't ask for the result right away. Querying the compile or link status
+   forces the driver to finish that one program before returning, so a scene that compiles
+   a dozen programs in a row ends up compiling them one by one. With the extension
+   `GL_KHR_parallel_shader_compile` (or the ARB one), the constructor only submits the work
+   and returns: the stages are compiled and the program is linked in the background, nothing
+   is checked until the program is actually needed. The driver is allowed to use as many
+   threads as it likes, `Ready()` polls `GL_COMPLETION_STATUS_KHR` without blocking.
+
+   so the way to load a scene's shaders is to create all of them first, then use them. A
+   pending program is finished automatically the first time it's bound (or when a material
+   reads its uniforms), `Poll()` finishes the programs that are ready and tells whether some
+   are still pending, it's called by the loading screen and once per frame by the renderer.
+   `WaitAll()` blocks until every program is done. Finishing a program is where errors are
+   reported, the binary is saved to the cache, and compute shaders query their local size.
+
+   > auto a = MakeAsset<Shader>(path_a);  // returns immediately
+   > auto b = MakeAsset<Shader>(path_b);  // compiled in parallel with `a`
+   > while (!Shader::Poll()) { ... }      // or simply bind them, which waits if needed
+
+   without the extension, we fall back to the old behavior, each program is compiled, linked
+   and checked in the constructor. Programs loaded from a binary are never pending.
+
+   # hot reload
+
+   restarting the app to see a shader tweak means loading the whole scene again, IBL, models
+   and all, so in debug builds the renderer calls `HotReload()` once per frame, which watches
+   `paths::shader` for changes (see "utils/watch.h"). When a file is saved, every program built
+   from that file, or from a file that includes it (see "utils/glsl.h"), is rebuilt in place by
+   `Reload()`: the object and everything that refers to it stay valid, only its program id
+   changes, materials notice it on the next bind and parse the uniforms again, keeping the
+   values that have been set. If the new code fails to compile or link, the error is logged
+   and we keep running with the previous program. Set `Shader::hot_reload` to toggle it.
 
    # smart bindings
 
@@ -93,9 +139,11 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <glad/glad.h>
+#include "core/base.h"
 #include "asset/asset.h"
 
 namespace asset {
@@ -105,10 +153,29 @@ namespace asset {
         std::string source_path;
         std::string source_code;
         std::vector<GLuint> shaders;
+        uint64_t source_hash = 0;  // preprocessed sources + driver strings, 0 if loaded from a binary
+        bool pending = false;      // compiled and linked in the background, not checked yet
+        std::vector<GLenum> stage_types;  // stages to look for in the source, kept for reloading
 
-        void ReadShader(const std::string& path, const std::string& macro, std::string& output);
-        void LoadShader(GLenum type);
+        void LoadShader(GLenum type, const std::string& code);
         void LinkShaders();
+        void Build(const std::vector<GLenum>& types);
+        void Finish();
+        virtual void Reflect() {}
+
+        bool LoadCache(const std::string& filepath, uint64_t hash);
+        void SaveCache(const std::string& filepath, uint64_t hash) const;
+
+      public:
+        static inline bool use_cache = true;  // look up program binaries in `paths::cache` before compiling
+        static std::string CachePath(const std::string& source_path);
+
+        static bool ParallelCompile();  // true if the driver compiles programs in the background
+        static bool Poll();
+        static void WaitAll();
+
+        static inline bool hot_reload = debug_mode;  // rebuild programs when their sources are edited
+        static void HotReload();
 
       public:  // rule of five
         Shader() : IAsset() {}
@@ -118,13 +185,17 @@ namespace asset {
 
         Shader(const Shader&) = delete;
         Shader& operator=(const Shader&) = delete;
-        Shader(Shader&& other) = default;
-        Shader& operator=(Shader&& other) = default;
+        Shader(Shader&& other) = delete;  // `this` is registered for polling and hot reloading
+        Shader& operator=(Shader&& other) = delete;
 
       public:
         void Bind() const override;
         void Unbind() const override;
 
+        bool Ready() const;
+        void Wait();
+        bool Reload();
+
         void Save() const;
         void Inspect() const;
 
@@ -138,6 +209,9 @@ namespace asset {
     class CShader : public Shader {
       private:
         GLint local_size_x, local_size_y, local_size_z;
+        std::string label;  // shader filename, used to name sections in the GPU profiler
+
+        void Reflect() override;
 
       public:  // rule of zero
         CShader(const std::string& source_path);
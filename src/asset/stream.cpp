@@ -0,0 +1,249 @@
+#include "pch.h"
+
+#include "core/clock.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "asset/stream.h"
+#include "asset/texture.h"
+#include "utils/image.h"
+#include "utils/profile.h"
+
+using namespace core;
+
+namespace asset {
+
+    struct Streamed {
+        std::weak_ptr<Texture> texture;  // the texture is owned by the materials, not by us
+        std::shared_ptr<const utils::BlockImage> image;
+
+        GLuint tail = 0;      // the finest of the tail levels, which are always resident
+        GLuint resident = 0;  // the finest level in VRAM, i.e. the texture's base level
+        GLuint target = 0;    // the level we want to have, after the budget is applied
+
+        float pixels = 0.0f;  // the largest on-screen size reported within the hold time
+        float seen = 0.0f;    // when `pixels` was last reported
+        float fade = 0.0f;    // current min LOD clamp, fades from 1 to 0 after a new level arrives
+
+        JobHandle job;   // reads the next level from disk on a worker
+        GLuint loading = 0;
+        std::shared_ptr<std::vector<uint8_t>> bytes;
+    };
+
+    static std::unordered_map<GLuint, Streamed> registry;  // indexed by texture name
+    static size_t resident_bytes = 0;
+
+    static GLuint Resolution(const utils::BlockImage& image, GLuint level) {
+        return std::max(std::max(image.Width() >> level, image.Height() >> level), 1U);
+    }
+
+    static size_t LevelBytes(const utils::BlockImage& image, GLuint fr_level, GLuint to_level) {
+        size_t bytes = 0;
+        for (GLuint level = fr_level; level < to_level; level++) {
+            bytes += image.LevelSize(level);
+        }
+        return bytes;
+    }
+
+    static GLuint WantedLevel(const Streamed& entry) {
+        if (entry.pixels <= 0.0f) {
+            return entry.tail;  // not visible, only the tail is needed
+        }
+
+        // pick the level whose resolution is closest to the number of texels we aim for
+        float texels = entry.pixels * TextureStreamer::texel_ratio;
+        float level = std::round(std::log2(Resolution(*entry.image, 0) / texels));
+        return static_cast<GLuint>(std::clamp(level, 0.0f, static_cast<float>(entry.tail)));
+    }
+
+    static void Forget(std::unordered_map<GLuint, Streamed>::iterator it) {
+        const Streamed& entry = it->second;
+        resident_bytes -= LevelBytes(*entry.image, entry.resident, entry.image->Levels());
+        registry.erase(it);  // a pending read keeps its own refs to the image and buffer
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    asset_ref<Texture> TextureStreamer::Create(std::shared_ptr<const utils::BlockImage> image) {
+        PROFILE_FUNCTION();
+        CORE_ASERT(JobSystem::IsMainThread(), "Streamed textures must be created on the main thread...");
+
+        // the tail starts at the first level that is no larger than the minimum resolution
+        GLuint n_levels = image->Levels();
+        GLuint tail = 0;
+        while (tail + 1 < n_levels && Resolution(*image, tail) > min_resolution) {
+            tail++;
+        }
+
+        auto texture = MakeAsset<Texture>(*image, tail);
+
+        if (auto it = registry.find(texture->ID()); it != registry.end()) {
+            Forget(it);  // the name of a destroyed texture has been recycled
+        }
+
+        Streamed entry;
+        entry.texture = texture;
+        entry.image = std::move(image);
+        entry.tail = entry.resident = entry.target = tail;
+        entry.seen = Clock::time;
+
+        resident_bytes += LevelBytes(*entry.image, tail, n_levels);
+        registry.emplace(texture->ID(), std::move(entry));
+        return texture;
+    }
+
+    void TextureStreamer::Request(const Texture& texture, float pixels) {
+        auto it = registry.find(texture.ID());
+        if (it == registry.end() || it->second.texture.expired()) {
+            return;  // not a streamed texture, silently ignored
+        }
+
+        // hold on to the largest request until it expires, then take whatever comes next
+        auto& entry = it->second;
+        if (pixels >= entry.pixels || Clock::time - entry.seen > hold_time) {
+            entry.pixels = pixels;
+            entry.seen = Clock::time;
+        }
+    }
+
+    void TextureStreamer::Release(const Texture& texture) {
+        if (auto it = registry.find(texture.ID()); it != registry.end()) {
+            Forget(it);
+        }
+    }
+
+    void TextureStreamer::Update() {
+        PROFILE_FUNCTION();
+
+        // forget the textures that have been destroyed since the last frame
+        for (auto it = registry.begin(); it != registry.end();) {
+            if (it->second.texture.expired()) {
+                auto expired = it++;
+                Forget(expired);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        size_t wanted_bytes = 0;
+
+        for (auto& [id, entry] : registry) {
+            if (Clock::time - entry.seen > hold_time) {
+                entry.pixels = 0.0f;  // hasn't been seen for a while
+            }
+
+            entry.target = WantedLevel(entry);
+            wanted_bytes += LevelBytes(*entry.image, entry.target, entry.image->Levels());
+        }
+
+        // over budget, the most oversampled texture drops a level, repeat until everything fits
+        while (wanted_bytes > budget) {
+            Streamed* victim = nullptr;
+            float max_ratio = 0.0f;
+
+            for (auto& [id, entry] : registry) {
+                if (entry.target >= entry.tail) {
+                    continue;  // tail mips are never dropped
+                }
+
+                float texels = entry.pixels * texel_ratio;
+                float ratio = texels > 0.0f ? Resolution(*entry.image, entry.target) / texels : std::numeric_limits<float>::max();
+
+                if (victim == nullptr || ratio > max_ratio) {
+                    victim = &entry;
+                    max_ratio = ratio;
+                }
+            }
+
+            if (victim == nullptr) {
+                break;  // only the tails are left, the budget is too small for this scene
+            }
+
+            wanted_bytes -= victim->image->LevelSize(victim->target);
+            victim->target++;
+        }
+
+        size_t uploaded = 0;
+
+        for (auto& [id, entry] : registry) {
+            const auto& image = *entry.image;
+
+            // evict the levels that are finer than the target, their content is discarded right away
+            if (entry.resident < entry.target) {
+                for (GLuint level = entry.resident; level < entry.target; level++) {
+                    glInvalidateTexImage(id, level);
+                }
+
+                resident_bytes -= LevelBytes(image, entry.resident, entry.target);
+                entry.resident = entry.target;
+                entry.fade = 0.0f;
+
+                glTextureParameteri(id, GL_TEXTURE_BASE_LEVEL, entry.resident);
+                glTextureParameterf(id, GL_TEXTURE_MIN_LOD, 0.0f);
+            }
+
+            // a level has been read from disk, upload it if it's still wanted and within bandwidth
+            if (entry.job.Valid() && entry.job.Done()) {
+                bool wanted = entry.loading + 1 == entry.resident && entry.loading >= entry.target;
+                size_t size = entry.bytes->size();
+
+                try {
+                    entry.job.Wait();  // rethrows the exception if the read has failed
+                }
+                catch (const std::exception& e) {
+                    CORE_ERROR("Failed to stream texture level {0}: {1}", entry.loading, e.what());
+                    wanted = false;
+                }
+
+                // at least one level is uploaded per frame, even if it exceeds the bandwidth alone,
+                // a level that doesn't fit in this frame's bandwidth is kept until the next frame
+                if (bool deferred = wanted && uploaded > 0 && uploaded + size > bandwidth; !deferred) {
+                    if (wanted) {
+                        GLuint w = std::max(image.Width() >> entry.loading, 1U);
+                        GLuint h = std::max(image.Height() >> entry.loading, 1U);
+                        GLsizei n_bytes = static_cast<GLsizei>(size);
+                        glCompressedTextureSubImage2D(id, entry.loading, 0, 0, w, h, image.IFormat(), n_bytes, entry.bytes->data());
+
+                        uploaded += size;
+                        resident_bytes += size;
+                        entry.resident = entry.loading;
+                        entry.fade = 1.0f;  // looks exactly like the previous base level
+                        glTextureParameteri(id, GL_TEXTURE_BASE_LEVEL, entry.resident);
+                    }
+
+                    entry.job = JobHandle();
+                    entry.bytes.reset();
+                }
+            }
+
+            // request the next finer level, the pages of the mapped file are faulted in on the worker
+            if (!entry.job.Valid() && entry.target < entry.resident) {
+                GLuint level = entry.resident - 1;
+                entry.loading = level;
+                entry.bytes = std::make_shared<std::vector<uint8_t>>();
+
+                entry.job = JobSystem::Submit([image = entry.image, bytes = entry.bytes, level] {
+                    const uint8_t* data = image->LevelData(level);
+                    bytes->assign(data, data + image->LevelSize(level));
+                });
+            }
+
+            // blend in the detail of the newly arrived level
+            if (entry.fade > 0.0f) {
+                entry.fade = fade_time > 0.0f ? std::max(entry.fade - Clock::delta_time / fade_time, 0.0f) : 0.0f;
+                glTextureParameterf(id, GL_TEXTURE_MIN_LOD, entry.fade);
+            }
+        }
+
+        PROFILE_COUNTER("Streamed Texture MB", resident_bytes / 1048576.0);
+    }
+
+    size_t TextureStreamer::Count() {
+        return registry.size();
+    }
+
+    size_t TextureStreamer::ResidentBytes() {
+        return resident_bytes;
+    }
+
+}
@@ -0,0 +1,76 @@
+/*
+   the texture streamer keeps only the mip levels that are actually visible resident, so that
+   scenes with many high-resolution materials start rendering right away and the amount of
+   texture data we upload and keep valid stays under a fixed budget, no matter how many
+   assets are loaded.
+
+   a streamed texture is created from a `BlockImage`, whose mip chain is read in place from
+   the memory-mapped cache file. On creation, the full immutable storage is allocated but only
+   the tail of the chain (the levels no larger than `min_resolution`) is uploaded, which takes
+   a few KB and makes the material usable in the same frame. The finer levels are then streamed
+   in one at a time over later frames: the bytes are read from disk on a worker thread, and the
+   upload happens in `Update()`, which is called by the renderer once per frame, limited by the
+   upload `bandwidth`.
+
+   # residency
+
+   the texture's `GL_TEXTURE_BASE_LEVEL` always points at the finest level that is resident,
+   so the sampler never reads a level that hasn't been uploaded yet. When a new level arrives,
+   the base level moves down by one and `GL_TEXTURE_MIN_LOD` (relative to the base level) is
+   faded from 1 to 0 over `fade_time`, so the extra detail blends in instead of popping. The
+   texture keeps the same name throughout, materials don't need to know that it's streamed.
+
+   # feedback
+
+   each frame, the renderer estimates the on-screen size (in pixels) of every mesh it draws
+   from its bounding sphere and the main camera, and reports it for all the textures of the
+   material with `Request()`. A texture wants the level whose resolution is closest to the
+   number of pixels it covers, times `texel_ratio`, tiled materials may need a higher ratio
+   since the uv scale is not taken into account. The largest request is held for `hold_time`
+   seconds, so that turning the camera around doesn't evict and reload textures all the time.
+
+   # budget
+
+   if the levels wanted by all the streamed textures don't fit in `budget` bytes, the textures
+   that are the most oversampled (most texels per pixel, or not visible at all) drop a level
+   first, until everything fits. Dropping a level raises the base level and invalidates the
+   level's content right away, the tail mips are never dropped. Note that immutable storage
+   is allocated once and for all, so the driver may still keep the memory reserved, but it's
+   free to discard invalidated levels, and we never spend upload bandwidth on them.
+
+   > auto image = std::make_shared<utils::BlockImage>(path, bcn::Format::BC7);  // on a worker
+   > auto texture = TextureStreamer::Create(image);  // on the main thread, returns immediately
+*/
+
+#pragma once
+
+#include <memory>
+#include "core/base.h"
+
+namespace utils {
+    class BlockImage;
+}
+
+namespace asset {
+
+    class Texture;  // forward declaration
+
+    class TextureStreamer {
+      public:
+        static inline size_t budget    = 256ULL << 20;  // bytes of resident levels for all streamed textures
+        static inline size_t bandwidth = 16ULL << 20;   // bytes uploaded per frame at most
+        static inline unsigned int min_resolution = 128;  // the tail mips are always resident
+        static inline float texel_ratio = 1.0f;  // texels per screen pixel to aim for
+        static inline float fade_time = 0.25f;   // seconds to blend in a new level
+        static inline float hold_time = 2.0f;    // seconds a texture keeps its detail after it's last seen
+
+        static asset_ref<Texture> Create(std::shared_ptr<const utils::BlockImage> image);
+        static void Request(const Texture& texture, float pixels);
+        static void Release(const Texture& texture);
+        static void Update();
+
+        static size_t Count();
+        static size_t ResidentBytes();
+    };
+
+}
@@ -8,6 +8,7 @@
 #include "utils/path.h"
 #include "utils/math.h"
 #include "utils/image.h"
+#include "utils/profile.h"
 
 namespace asset {
 
@@ -45,10 +46,13 @@ namespace asset {
 
     ///////////////////////////////////////////////////////////////////////////////////////////////
 
-    Texture::Texture(const std::string& img_path, GLuint levels)
+    Texture::Texture(const std::string& img_path, GLuint levels) : Texture(utils::Image(img_path), levels) {}
+
+    Texture::Texture(const utils::Image& image, GLuint levels)
         : IAsset(), target(GL_TEXTURE_2D), depth(1), n_levels(levels)
     {
-        auto image = utils::Image(img_path);
+        // the image may have been decoded on a worker thread, but the upload must happen here
+        PROFILE_FUNCTION();
 
         this->width    = image.Width();
         this->height   = image.Height();
@@ -64,7 +68,7 @@ namespace asset {
         glTextureStorage2D(id, n_levels, i_format, width, height);
 
         if (image.IsHDR()) {
-            glTextureSubImage2D(id, 0, 0, 0, width, height, format, GL_FLOAT, image.GetPixels<float>());
+            glTextureSubImage2D(id, 0, 0, 0, width, height, format, GL_HALF_FLOAT, image.GetPixels<uint16_t>());
         }
         else {
             glTextureSubImage2D(id, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, image.GetPixels<uint8_t>());
@@ -77,9 +81,42 @@ namespace asset {
         SetSampleState();
     }
 
+    Texture::Texture(const std::string& img_path, utils::bcn::Format format)
+        : Texture(utils::BlockImage(img_path, format)) {}
+
+    Texture::Texture(const utils::BlockImage& image, GLuint base_level)
+        : IAsset(), target(GL_TEXTURE_2D), format(GL_RGBA), depth(1)
+    {
+        // the whole mip chain is precompressed, so there's nothing left for the driver to generate,
+        // the storage is always allocated in full, but the levels finer than `base_level` are left
+        // empty for the texture streamer to fill in later, until then the sampler won't touch them
+        PROFILE_FUNCTION();
+
+        this->width    = image.Width();
+        this->height   = image.Height();
+        this->i_format = image.IFormat();
+        this->n_levels = image.Levels();
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &id);
+        glTextureStorage2D(id, n_levels, i_format, width, height);
+
+        for (GLuint level = base_level; level < n_levels; level++) {
+            GLuint w = std::max(width >> level, 1U);
+            GLuint h = std::max(height >> level, 1U);
+            glCompressedTextureSubImage2D(id, level, 0, 0, w, h, i_format, image.LevelSize(level), image.LevelData(level));
+        }
+
+        if (base_level > 0) {
+            glTextureParameteri(id, GL_TEXTURE_BASE_LEVEL, base_level);
+        }
+
+        SetSampleState();
+    }
+
     Texture::Texture(const std::string& img_path, GLuint resolution, GLuint levels)
         : IAsset(), target(GL_TEXTURE_CUBE_MAP), width(resolution), height(resolution), depth(6), n_levels(levels)
     {
+        PROFILE_FUNCTION();
         // resolution must be a power of 2 in order to achieve high-fidelity visual effects
         if (!utils::math::IsPowerOfTwo(resolution)) {
             CORE_ERROR("Attempting to build a cubemap whose resolution is not a power of 2...");
@@ -119,7 +156,7 @@ namespace asset {
 
             if (image.IsHDR()) {
                 glTextureStorage2D(equirectangle, 1, im_ifmt, im_w, im_h);
-                glTextureSubImage2D(equirectangle, 0, 0, 0, im_w, im_h, im_fmt, GL_FLOAT, image.GetPixels<float>());
+                glTextureSubImage2D(equirectangle, 0, 0, 0, im_w, im_h, im_fmt, GL_HALF_FLOAT, image.GetPixels<uint16_t>());
             }
             else {
                 glTextureStorage2D(equirectangle, 1, im_ifmt, im_w, im_h);
@@ -158,6 +195,7 @@ namespace asset {
         : IAsset(), target(GL_TEXTURE_CUBE_MAP), width(resolution), height(resolution),
           depth(6), format(GL_RGBA), i_format(GL_RGBA16F), n_levels(levels)
     {
+        PROFILE_FUNCTION();
         // resolution must be a power of 2 in order to achieve high-fidelity visual effects
         if (!utils::math::IsPowerOfTwo(resolution)) {
             CORE_ERROR("Attempting to build a cubemap whose resolution is not a power of 2...");
@@ -185,7 +223,7 @@ namespace asset {
 
         for (GLuint face = 0; face < 6; face++) {
             auto image = utils::Image(directory + faces[face] + extension, 3, true);
-            glTextureSubImage3D(id, 0, 0, 0, face, width, height, 1, format, GL_FLOAT, image.GetPixels<float>());
+            glTextureSubImage3D(id, 0, 0, 0, face, width, height, 1, format, GL_HALF_FLOAT, image.GetPixels<uint16_t>());
         }
 
         if (n_levels > 1) {
@@ -199,6 +237,7 @@ namespace asset {
         : IAsset(), target(target), width(width), height(height), depth(depth),
           n_levels(levels), format(0), i_format(i_format)
     {
+        PROFILE_FUNCTION();
         if (levels == 0) {
             n_levels = 1 + static_cast<GLuint>(floor(std::log2(std::max(width, height))));
         }
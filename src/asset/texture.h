@@ -19,6 +19,8 @@
 
    - Texture("../albedo.png", 0);                // load a regular image into a 2D texture, with mipmaps
    - Texture("../screen.png", 1);                // load a regular image into a 2D texture, base layer only
+   - Texture("../normal.png", bcn::Format::BC5); // load a block-compressed 2D texture, cached mipmaps
+   - Texture(block_image, 4);                    // allocate all levels, upload levels 4+ only (streaming)
    - Texture("../equirectangular.hdr", 1);       // load a panorama HDRI into a 2D texture, no mipmaps
    - Texture("../equirectangular.hdr", 512, 1);  // load a panorama HDRI into a cubemap texture, no mipmaps
    - Texture("../equirectangular.jpg", 512, 1);  // load a regular image into a cubemap texture, low quality
@@ -106,6 +108,12 @@
 #include <glad/glad.h>
 #include "asset/asset.h"
 
+namespace utils {
+    class Image;
+    class BlockImage;
+    namespace bcn { enum class Format : uint8_t; }
+}
+
 namespace asset {
 
     class Texture;  // forward declaration
@@ -139,6 +147,9 @@ namespace asset {
         GLuint n_levels;
 
         Texture(const std::string& img_path, GLuint levels = 0);
+        Texture(const utils::Image& image, GLuint levels = 0);
+        Texture(const std::string& img_path, utils::bcn::Format format);
+        Texture(const utils::BlockImage& image, GLuint base_level = 0);
         Texture(const std::string& img_path, GLuint resolution, GLuint levels);
         Texture(const std::string& directory, const std::string& extension, GLuint resolution, GLuint levels);
         Texture(GLenum target, GLuint width, GLuint height, GLuint depth, GLenum i_format, GLuint levels);
@@ -1,10 +1,15 @@
 #include "pch.h"
 #include "asset/vao.h"
+#include "asset/buffer.h"
+#include "core/base.h"
+#include "core/bench.h"
 #include "core/debug.h"
 
 namespace asset {
 
     static GLuint curr_bound_vertex_array = 0;  // smart binding
+    static asset_tmp<DIB> draw_commands = nullptr;  // ring buffer of `MultiDraw()` commands
+    static GLintptr draw_commands_offset = 0;
 
     VAO::VAO() : IAsset() {
         glCreateVertexArrays(1, &id);
@@ -29,18 +34,24 @@ namespace asset {
         }
     }
 
-    void VAO::SetVBO(GLuint vbo, GLuint attr_id, GLint offset, GLint size, GLint stride, GLenum type) const {
+    void VAO::SetVBO(GLuint vbo, GLuint attr_id, GLint offset, GLint size, GLint stride, GLenum type, bool normalized) const {
         glVertexArrayVertexBuffer(id, attr_id, vbo, offset, stride);
         glEnableVertexArrayAttrib(id, attr_id);
         glVertexArrayAttribBinding(id, attr_id, attr_id);
 
         switch (type) {
+            case GL_INT_2_10_10_10_REV:
             case GL_HALF_FLOAT:
             case GL_FLOAT: {
-                glVertexArrayAttribFormat(id, attr_id, size, type, GL_FALSE, 0); break;
+                glVertexArrayAttribFormat(id, attr_id, size, type, normalized ? GL_TRUE : GL_FALSE, 0); break;
             }
+            case GL_UNSIGNED_BYTE:
+            case GL_UNSIGNED_SHORT:
             case GL_UNSIGNED_INT:
             case GL_INT: {
+                if (normalized) {
+                    glVertexArrayAttribFormat(id, attr_id, size, type, GL_TRUE, 0); break;  // read as float in [0, 1]
+                }
                 glVertexArrayAttribIFormat(id, attr_id, size, type, 0); break;  // notice the "I" here
             }
             case GL_DOUBLE: {
@@ -52,17 +63,52 @@ namespace asset {
         }
     }
 
-    void VAO::SetIBO(GLuint ibo) const {
+    void VAO::SetIBO(GLuint ibo, GLenum type) {
         glVertexArrayElementBuffer(id, ibo);
+        index_type = type;
     }
 
-    void VAO::Draw(GLenum mode, GLsizei count) {
+    void VAO::Draw(GLenum mode, GLsizei count, GLuint first, GLint base_vertex) {
         Bind();
-        glDrawElements(mode, count, GL_UNSIGNED_INT, 0);
+        size_t offset = first * (index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+        glDrawElementsBaseVertex(mode, count, index_type, reinterpret_cast<const void*>(offset), base_vertex);
+        core::Benchmark::draw_calls++;
 
         if constexpr (false) {
            Unbind();  // with smart bindings, we never need to unbind after the draw call
         }
     }
 
+    void VAO::DrawIndirect(GLenum mode, GLintptr offset, GLintptr count_offset, GLsizei max_count) {
+        Bind();
+        const void* indirect = reinterpret_cast<const void*>(offset);
+        glMultiDrawElementsIndirectCount(mode, index_type, indirect, count_offset, max_count, 5 * sizeof(GLuint));
+        core::Benchmark::draw_calls++;
+    }
+
+    void VAO::MultiDraw(GLenum mode, const std::vector<DrawCommand>& commands) {
+        GLsizeiptr size = commands.size() * sizeof(DrawCommand);
+
+        if (draw_commands == nullptr || draw_commands->Size() < size) {
+            draw_commands = WrapAsset<DIB>(std::max<GLsizeiptr>(size * 2, 64 * 1024), nullptr);
+            draw_commands_offset = 0;
+        }
+
+        // wrapping around overwrites commands that may still be in flight, the driver takes care
+        // of it, but the buffer is large enough that it happens at most once every few frames
+        if (draw_commands_offset + size > draw_commands->Size()) {
+            draw_commands_offset = 0;
+        }
+
+        draw_commands->SetData(draw_commands_offset, size, commands.data());
+
+        Bind();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw_commands->ID());
+        const void* indirect = reinterpret_cast<const void*>(draw_commands_offset);
+        glMultiDrawElementsIndirect(mode, index_type, indirect, static_cast<GLsizei>(commands.size()), 0);
+        core::Benchmark::draw_calls++;
+
+        draw_commands_offset += size;
+    }
+
 }
\ No newline at end of file
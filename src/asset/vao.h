@@ -6,15 +6,39 @@
    this case, there's no need to make a redundant GPU -> CPU -> GPU round trip, instead we
    can directly pass the SSBO's id to `SetVBO()`, which will be treated as if it was a VBO
    bound to the `GL_ARRAY_BUFFER` target. Buffer objects are essentially just data store.
+
+   `SetIBO()` also records the type of the indices, so that `Draw()` can read 16-bit indices
+   from meshes small enough for them, which halves the size of their index buffers.
+
+   `DrawIndirect()` draws a list of `DrawElementsIndirectCommand` written by a compute shader
+   to the buffer bound to `GL_DRAW_INDIRECT_BUFFER`, the number of commands is read from the
+   buffer bound to `GL_PARAMETER_BUFFER` at `count_offset`, up to `max_count`. `MultiDraw()`
+   draws a list of commands built on the CPU with a single `glMultiDrawElementsIndirect`, the
+   commands are written to a small ring buffer shared by all VAOs, so it's meant for ranges of
+   the same index buffer that are drawn with the same state (see "arena.h").
 */
 
 #pragma once
 
+#include <vector>
 #include "asset/asset.h"
 
 namespace asset {
 
+    struct DrawCommand {  // layout of `DrawElementsIndirectCommand`
+        GLuint count;
+        GLuint n_instances;
+        GLuint first_index;
+        GLint  base_vertex;
+        GLuint base_instance;
+    };
+
+    static_assert(sizeof(DrawCommand) == 5 * sizeof(GLuint));
+
     class VAO : public IAsset {
+      private:
+        GLenum index_type = GL_UNSIGNED_INT;  // GL_UNSIGNED_SHORT for meshes with 16-bit indices
+
       public:
         VAO();
         ~VAO();
@@ -27,9 +51,11 @@ namespace asset {
         void Bind() const override;
         void Unbind() const override;
 
-        void SetVBO(GLuint vbo, GLuint attr_id, GLint offset, GLint size, GLint stride, GLenum type) const;
-        void SetIBO(GLuint ibo) const;
-        void Draw(GLenum mode, GLsizei count);
+        void SetVBO(GLuint vbo, GLuint attr_id, GLint offset, GLint size, GLint stride, GLenum type, bool normalized = false) const;
+        void SetIBO(GLuint ibo, GLenum type = GL_UNSIGNED_INT);
+        void Draw(GLenum mode, GLsizei count, GLuint first = 0, GLint base_vertex = 0);  // `first` index, not in bytes
+        void DrawIndirect(GLenum mode, GLintptr offset, GLintptr count_offset, GLsizei max_count);
+        void MultiDraw(GLenum mode, const std::vector<DrawCommand>& commands);
     };
 
 }
@@ -4,6 +4,7 @@
 #include "core/log.h"
 #include "component/animator.h"
 #include "utils/ext.h"
+#include "utils/profile.h"
 
 using namespace utils;
 
@@ -27,67 +28,72 @@ namespace component {
             throw core::ConditionError("Invalid animation channel, require at least one frame per key...");
         }
 
-        // in order for interpolation to work, at least 2 frames per key are needed, if a
-        // key only has one frame at timestamp 0, we shall duplicate it to make an ending
-        // frame at timestamp duration, so that there's always a well-defined transition
-
-        positions.resize(n_positions + 1, FT(glm::vec3(0.0f), -1.0f));
-        rotations.resize(n_rotations + 1, FR(identity_q, -1.0f));
-        scales.resize(n_scales + 1, FS(glm::vec3(1.0f), -1.0f));
-
-        // Assimp guarantees that keyframes will be returned in chronological order and there
-        // will be no duplicates, so we don't need to manually sort in the order of timestamp
-
-        for (auto [i, prev_time] = std::tuple(0U, 0.0f); i < n_positions; ++i) {
+        Sample(positions, n_positions, duration, [ai_channel](unsigned int i) {
             auto& frame = ai_channel->mPositionKeys[i];
             auto& value = frame.mValue;
-            auto timestamp = static_cast<float>(frame.mTime);
-
-            CORE_ASERT(timestamp >= prev_time, "Assimp failed to return frames in chronological order!");
-            positions[i].value = glm::vec3(value.x, value.y, value.z);
-            positions[i].timestamp = timestamp;
-            prev_time = timestamp;
-
-            if (i == 0) {  // mirror the first frame into the last frame so it loops
-                auto& last_frame = positions.back();
-                last_frame.value = glm::vec3(value.x, value.y, value.z);
-                last_frame.timestamp = duration;
-            }
-        }
+            return FT(glm::vec3(value.x, value.y, value.z), static_cast<float>(frame.mTime));
+        });
 
-        for (auto [i, prev_time] = std::tuple(0U, 0.0f); i < n_rotations; ++i) {
+        Sample(rotations, n_rotations, duration, [ai_channel](unsigned int i) {
             auto& frame = ai_channel->mRotationKeys[i];
             auto& value = frame.mValue;
-            auto timestamp = static_cast<float>(frame.mTime);
+            return FR(glm::quat(value.w, value.x, value.y, value.z), static_cast<float>(frame.mTime));
+        });
 
-            CORE_ASERT(timestamp >= prev_time, "Assimp failed to return frames in chronological order!");
-            rotations[i].value = glm::quat(value.w, value.x, value.y, value.z);
-            rotations[i].timestamp = timestamp;
-            prev_time = timestamp;
+        Sample(scales, n_scales, duration, [ai_channel](unsigned int i) {
+            auto& frame = ai_channel->mScalingKeys[i];
+            auto& value = frame.mValue;
+            return FS(glm::vec3(value.x, value.y, value.z), static_cast<float>(frame.mTime));
+        });
+    }
 
-            if (i == 0) {  // mirror the first frame into the last frame so it loops
-                auto& last_frame = rotations.back();
-                last_frame.value = glm::quat(value.w, value.x, value.y, value.z);
-                last_frame.timestamp = duration;
-            }
+    Channel::Channel(const spmesh::Channel& record, const spmesh::Key* keys, const std::string& name, int id, float duration)
+        : name(name), bone_id(id)
+    {
+        if (record.n_positions < 1 || record.n_rotations < 1 || record.n_scales < 1) {
+            throw core::ConditionError("Invalid animation channel, require at least one frame per key...");
         }
 
-        for (auto [i, prev_time] = std::tuple(0U, 0.0f); i < n_scales; ++i) {
-            auto& frame = ai_channel->mScalingKeys[i];
-            auto& value = frame.mValue;
-            auto timestamp = static_cast<float>(frame.mTime);
+        // keys are stored in the same order as in Assimp, positions first, then rotations and scales
+        const spmesh::Key* position_keys = keys + record.first_key;
+        const spmesh::Key* rotation_keys = position_keys + record.n_positions;
+        const spmesh::Key* scale_keys = rotation_keys + record.n_rotations;
+
+        Sample(positions, record.n_positions, duration, [position_keys](unsigned int i) {
+            auto& [time, value] = position_keys[i];
+            return FT(glm::vec3(value[0], value[1], value[2]), time);
+        });
+
+        Sample(rotations, record.n_rotations, duration, [rotation_keys](unsigned int i) {
+            auto& [time, value] = rotation_keys[i];
+            return FR(glm::quat(value[0], value[1], value[2], value[3]), time);
+        });
+
+        Sample(scales, record.n_scales, duration, [scale_keys](unsigned int i) {
+            auto& [time, value] = scale_keys[i];
+            return FS(glm::vec3(value[0], value[1], value[2]), time);
+        });
+    }
+
+    template<typename TFrame, typename Func>
+    void Channel::Sample(std::vector<TFrame>& frames, unsigned int n_frames, float duration, Func&& frame_at) {
+        // in order for interpolation to work, at least 2 frames per key are needed, if a
+        // key only has one frame at timestamp 0, we shall duplicate it to make an ending
+        // frame at timestamp duration, so that there's always a well-defined transition
 
-            CORE_ASERT(timestamp >= prev_time, "Assimp failed to return frames in chronological order!");
-            scales[i].value = glm::vec3(value.x, value.y, value.z);
-            scales[i].timestamp = timestamp;
-            prev_time = timestamp;
+        frames.reserve(n_frames + 1);
 
-            if (i == 0) {  // mirror the first frame into the last frame so it loops
-                auto& last_frame = scales.back();
-                last_frame.value = glm::vec3(value.x, value.y, value.z);
-                last_frame.timestamp = duration;
-            }
+        // Assimp guarantees that keyframes will be returned in chronological order and there
+        // will be no duplicates, so we don't need to manually sort in the order of timestamp
+
+        for (auto [i, prev_time] = std::tuple(0U, 0.0f); i < n_frames; ++i) {
+            TFrame frame = frame_at(i);
+            CORE_ASERT(frame.timestamp >= prev_time, "Assimp failed to return frames in chronological order!");
+            prev_time = frame.timestamp;
+            frames.push_back(frame);
         }
+
+        frames.emplace_back(frames.front().value, duration);  // mirror the first frame into the last frame so it loops
     }
 
     template<typename TFrame>
@@ -139,6 +145,22 @@ namespace component {
         return translation * rotation * scale;
     }
 
+    static Node* FindBoneNode(std::vector<Node>& nodes, const std::string& bone_name) {
+        auto node = ranges::find_if(nodes, [&bone_name](const Node& node) {
+            return node.name == bone_name;
+        });
+
+        if (node == nodes.end()) {
+            return nullptr;  // drop the channel if there's no matching node in the hierarchy
+        }
+
+        if (!node->IsBone()) {
+            return nullptr;  // drop the channel if Assimp doesn't think it's a bone
+        }
+
+        return &nodes[node->nid];
+    }
+
     Animation::Animation(const aiScene* ai_scene, Model* model) : n_channels(0) {
         CORE_ASERT(ai_scene->mNumAnimations > 0, "The input file does not contain animations!");
         aiAnimation* ai_animation = ai_scene->mAnimations[0];
@@ -148,29 +170,21 @@ namespace component {
         speed    = static_cast<float>(ai_animation->mTicksPerSecond);
 
         channels.resize(model->n_bones);  // match channels with bones, resize instead of reserve
-        auto& nodes = model->nodes;
 
         for (unsigned int i = 0; i < ai_animation->mNumChannels; ++i) {
             aiNodeAnim* ai_channel = ai_animation->mChannels[i];
             std::string bone_name = ai_channel->mNodeName.C_Str();
 
-            auto node = ranges::find_if(nodes, [&bone_name](const Node& node) {
-                return node.name == bone_name;
-            });
-
-            if (node == nodes.end()) {
-                continue;  // drop the channel if there's no matching node in the hierarchy
-            }
-
-            if (!node->IsBone()) {
-                continue;  // drop the channel if Assimp doesn't think it's a bone
+            Node* node = FindBoneNode(model->nodes, bone_name);
+            if (node == nullptr) {
+                continue;
             }
 
             Channel& channel = channels[node->bid];
             CORE_ASERT(channel.bone_id < 0, "This channel is already filled, duplicate bone!");
 
             channel = std::move(Channel(ai_channel, bone_name, node->bid, duration));
-            nodes[node->nid].alive = true;
+            node->alive = true;
             n_channels++;
         }
 
@@ -179,6 +193,86 @@ namespace component {
         CORE_ASERT(n_channels <= model->n_bones, "Invalid channels are not dropped, please clean up!");
     }
 
+    Animation::Animation(const spmesh::Reader& cache, Model* model) : n_channels(0) {
+        const spmesh::Header& header = cache.GetHeader();
+        CORE_ASERT(header.n_channels > 0, "The cache file does not contain animations!");
+
+        name     = cache.GetString(header.motion_name);
+        duration = header.duration;
+        speed    = header.speed;
+
+        channels.resize(model->n_bones);
+
+        const spmesh::Channel* records = cache.Channels();
+        const spmesh::Key* keys = cache.Keys();
+
+        for (unsigned int i = 0; i < header.n_channels; ++i) {
+            const spmesh::Channel& record = records[i];
+            std::string bone_name { cache.GetString(record.name) };
+
+            uint64_t n_keys = record.n_positions + record.n_rotations + record.n_scales;
+            CORE_ASERT(record.first_key + n_keys <= header.n_keys, "Corrupted cache: keys out of bound!");
+
+            Node* node = FindBoneNode(model->nodes, bone_name);
+            if (node == nullptr) {
+                continue;
+            }
+
+            Channel& channel = channels[node->bid];
+            CORE_ASERT(channel.bone_id < 0, "This channel is already filled, duplicate bone!");
+
+            channel = std::move(Channel(record, keys, bone_name, node->bid, duration));
+            node->alive = true;
+            n_channels++;
+        }
+
+        CORE_ASERT(n_channels <= model->n_bones, "Invalid channels are not dropped, please clean up!");
+    }
+
+    void Animation::SaveCache(const aiScene* ai_scene, const std::string& filepath, uint64_t source_hash, uint64_t options) {
+        if (ai_scene->mNumAnimations == 0) {
+            return;
+        }
+
+        // the raw keyframes are cached rather than the processed channels, since the latter
+        // depend on the bone ids of the model that the animation is attached to
+        aiAnimation* ai_animation = ai_scene->mAnimations[0];
+        auto writer = spmesh::Writer(source_hash, options, 0);
+
+        writer.SetMotion(ai_animation->mName.C_Str(),
+            static_cast<float>(ai_animation->mDuration), static_cast<float>(ai_animation->mTicksPerSecond));
+
+        std::vector<spmesh::Key> positions, rotations, scales;
+
+        for (unsigned int i = 0; i < ai_animation->mNumChannels; ++i) {
+            aiNodeAnim* ai_channel = ai_animation->mChannels[i];
+            positions.clear();
+            rotations.clear();
+            scales.clear();
+
+            for (unsigned int j = 0; j < ai_channel->mNumPositionKeys; ++j) {
+                auto& value = ai_channel->mPositionKeys[j].mValue;
+                positions.push_back({ static_cast<float>(ai_channel->mPositionKeys[j].mTime), { value.x, value.y, value.z, 0.0f } });
+            }
+
+            for (unsigned int j = 0; j < ai_channel->mNumRotationKeys; ++j) {
+                auto& value = ai_channel->mRotationKeys[j].mValue;
+                rotations.push_back({ static_cast<float>(ai_channel->mRotationKeys[j].mTime), { value.w, value.x, value.y, value.z } });
+            }
+
+            for (unsigned int j = 0; j < ai_channel->mNumScalingKeys; ++j) {
+                auto& value = ai_channel->mScalingKeys[j].mValue;
+                scales.push_back({ static_cast<float>(ai_channel->mScalingKeys[j].mTime), { value.x, value.y, value.z, 0.0f } });
+            }
+
+            writer.AddChannel(ai_channel->mNodeName.C_Str(), positions, rotations, scales);
+        }
+
+        if (writer.Save(filepath)) {
+            CORE_TRACE("Animation cache saved to: {0}", filepath);
+        }
+    }
+
     Animator::Animator(Model* model) { Reset(model); }
 
     void Animator::Reset(Model* model) {
@@ -188,6 +282,7 @@ namespace component {
     }
 
     void Animator::Update(Model& model, float deltatime) {
+        PROFILE_FUNCTION();
         const auto& animation = model.animation;
         current_time += animation->speed * deltatime;
         current_time = fmod(current_time, animation->duration);  // loop the clip
@@ -142,6 +142,7 @@
 #include <glm/glm.hpp>
 #include "component/component.h"
 #include "component/model.h"
+#include "component/spmesh.h"
 
 namespace component {
 
@@ -166,12 +167,16 @@ namespace component {
         template<typename TFrame>
         std::tuple<int, int> GetFrameIndex(const std::vector<TFrame>& frames, float time) const;
 
+        template<typename TFrame, typename Func>
+        static void Sample(std::vector<TFrame>& frames, unsigned int n_frames, float duration, Func&& frame_at);
+
       public:
         std::string name;
         int bone_id = -1;
 
         Channel() : bone_id(-1) {}
         Channel(aiNodeAnim* ai_channel, const std::string& name, int id, float duration);
+        Channel(const spmesh::Channel& record, const spmesh::Key* keys, const std::string& name, int id, float duration);
         Channel(Channel&& other) = default;
         Channel& operator=(Channel&& other) = default;
 
@@ -192,6 +197,9 @@ namespace component {
         float speed;
 
         Animation(const aiScene* ai_scene, Model* model);
+        Animation(const spmesh::Reader& cache, Model* model);
+
+        static void SaveCache(const aiScene* ai_scene, const std::string& filepath, uint64_t source_hash, uint64_t options);
     };
 
     class Animator : public Component {
@@ -4,8 +4,10 @@
 #include "core/base.h"
 #include "core/app.h"
 #include "core/log.h"
+#include "asset/stream.h"
 #include "component/material.h"
 #include "utils/ext.h"
+#include "utils/profile.h"
 
 namespace component {
 
@@ -119,6 +121,9 @@ namespace component {
             SetUniform(929U, 0.0f);                    // clearcoat
             SetUniform(930U, 0.0f);                    // clearcoat roughness
 
+            // diffuse IBL source
+            SetUniform(932U, false);                   // irradiance from SH9 instead of the irradiance map
+
             // shading model switch
             SetUniform(999U, uvec2(1, 0));             // uvec2 model
         }
@@ -127,10 +132,16 @@ namespace component {
     Material::Material(const asset_ref<Material>& material_asset) : Material(*material_asset) {}  // calls copy ctor
 
     void Material::Bind() const {
+        PROFILE_FUNCTION();
         // visitor lambda function
         static auto upload = [](auto& unif) { unif.Upload(); };
 
         CORE_ASERT(shader, "Unable to bind the material, please set a valid shader first...");
+
+        if (shader->ID() != shader_id) {
+            const_cast<Material*>(this)->Refresh();  // materials are never created const, this is safe
+        }
+
         shader->Bind();  // smart bind the attached shader
 
         // upload uniform values to the shader
@@ -146,6 +157,15 @@ namespace component {
         }
     }
 
+    void Material::Request(float pixels) const {
+        // report the on-screen size of a mesh drawn with this material, for the texture streamer
+        for (const auto& [unit, texture] : textures) {
+            if (texture != nullptr) {
+                asset::TextureStreamer::Request(*texture, pixels);
+            }
+        }
+    }
+
     void Material::Unbind() const {
         // thanks to smart shader and texture bindings, there's no need to unbind or cleanup
         // just keep the current rendering state and let the next material's bind does its work
@@ -170,8 +190,14 @@ namespace component {
             return;
         }
 
+        shader->Wait();  // a program that's still compiling in the background has no uniforms yet
+        LoadUniforms();
+    }
+
+    void Material::LoadUniforms() {
         // load active uniforms from the shader and cache them into the `uniforms` std::map
         GLuint id = shader->ID();
+        this->shader_id = id;
         CORE_INFO("Parsing active uniforms in shader (id = {0}): ...", id);
 
         GLint n_uniforms;
@@ -244,6 +270,31 @@ namespace component {
         }
     }
 
+    void Material::Refresh() {
+        // the shader has been reloaded, parse the uniforms of the new program, then carry over the
+        // values (or bound pointers) of the uniforms that still exist with the same name and type
+        auto old_uniforms = std::move(uniforms);
+        uniforms.clear();
+        LoadUniforms();
+
+        for (auto& [location, unif_variant] : uniforms) {
+            std::visit([&old_uniforms](auto& unif) {
+                using U = std::decay_t<decltype(unif)>;
+
+                for (const auto& [_, old_variant] : old_uniforms) {
+                    if (auto old = std::get_if<U>(&old_variant); old != nullptr && old->name == unif.name) {
+                        GLuint owner_id = unif.owner_id;
+                        GLuint location = unif.location;
+                        unif = *old;
+                        unif.owner_id = owner_id;
+                        unif.location = location;
+                        break;
+                    }
+                }
+            }, unif_variant);
+        }
+    }
+
     void Material::SetTexture(GLuint unit, asset_ref<Texture> texture_ref) {
         size_t n_textures = 0;
         for (const auto& [_, texture] : textures) {
@@ -311,6 +362,11 @@ namespace component {
         }
     }
 
+    template<typename T, typename>
+    void Material::SetUniformArray(pbr_u attribute, GLuint size, const std::vector<T>* array_ptr) {
+        SetUniformArray<T>(static_cast<GLuint>(attribute), size, array_ptr);
+    }
+
     // explicit template instantiation using X macro
     #define INSTANTIATE_TEMPLATE(T) \
         template class Uniform<T>; \
@@ -318,7 +374,8 @@ namespace component {
         template void Material::SetUniform<T>(pbr_u attribute, const T& value); \
         template void Material::BindUniform<T>(GLuint location, const T* value_ptr); \
         template void Material::BindUniform<T>(pbr_u attribute, const T* value_ptr); \
-        template void Material::SetUniformArray(GLuint location, GLuint size, const std::vector<T>* array_ptr);
+        template void Material::SetUniformArray(GLuint location, GLuint size, const std::vector<T>* array_ptr); \
+        template void Material::SetUniformArray(pbr_u attribute, GLuint size, const std::vector<T>* array_ptr);
 
     INSTANTIATE_TEMPLATE(int)
     INSTANTIATE_TEMPLATE(GLuint)
@@ -90,6 +90,8 @@ namespace component {
         subsurf_color = 927U,
         clearcoat     = 929U,
         cc_roughness  = 930U,
+        irradiance_sh = 932U,
+        sh9           = 940U,  // vec3[9], locations 940-948
         shading_model = 999U
     };
 
@@ -124,15 +126,20 @@ namespace component {
         using Texture = asset::Texture;
 
         asset_ref<Shader> shader;
+        GLuint shader_id = 0;  // program the uniforms were parsed from, changes if the shader is reloaded
         std::map<GLuint, uniform_variant> uniforms;
         std::map<GLuint, asset_ref<Texture>> textures;
 
+        void LoadUniforms();
+        void Refresh();
+
       public:
         Material(const asset_ref<Shader>& shader_asset);
         Material(const asset_ref<Material>& material_asset);
 
         void Bind() const;
         void Unbind() const;
+        void Request(float pixels) const;
 
         void SetShader(asset_ref<Shader> shader_ref);
         void SetTexture(GLuint unit, asset_ref<Texture> texture_ref);
@@ -152,6 +159,9 @@ namespace component {
 
         template<typename T, typename = is_glsl_t<T>>
         void SetUniformArray(GLuint location, GLuint size, const std::vector<T>* array_ptr);
+
+        template<typename T, typename = is_glsl_t<T>>
+        void SetUniformArray(pbr_u attribute, GLuint size, const std::vector<T>* array_ptr);
     };
 
 }
@@ -1,10 +1,14 @@
 #include "pch.h"
 
+#include <cstring>
 #include "core/base.h"
 #include "core/app.h"
+#include "core/bench.h"
 #include "core/debug.h"
 #include "core/log.h"
 #include "component/mesh.h"
+#include "utils/file.h"
+#include "utils/meshopt.h"
 
 using namespace glm;
 using namespace core;
@@ -12,20 +16,101 @@ using namespace asset;
 
 namespace component {
 
-    static const std::vector<GLint> va_offset = {  // vertex attribute offset
-        offsetof(Mesh::Vertex, position),
-        offsetof(Mesh::Vertex, normal),
-        offsetof(Mesh::Vertex, uv),
-        offsetof(Mesh::Vertex, uv2),
-        offsetof(Mesh::Vertex, tangent),
-        offsetof(Mesh::Vertex, binormal),
-        offsetof(Mesh::Vertex, bone_id),
-        offsetof(Mesh::Vertex, bone_wt)
-    };
+    static asset_tmp<VAO> internal_vao;
 
-    static const std::vector<GLint> va_size = { 3, 3, 2, 2, 3, 3, 4, 4 };  // vertex attribute size
+    // vertex formats of the built-in primitives (position, normal, uv and optionally tangents)
+    static const std::bitset<6> basic_format(0b000111);
+    static const std::bitset<6> tangent_format(0b110111);
+    static const std::bitset<6> quad_format(0b000101);
 
-    static asset_tmp<VAO> internal_vao;
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    Mesh::Layout::Layout(std::bitset<6> format, bool skinned, size_t n_bones) {
+        auto add = [this](GLuint location, GLint size, GLenum type, bool normalized, GLint n_bytes) {
+            attributes[location] = Attribute { stride, size, type, normalized };
+            stride += n_bytes;
+        };
+
+        if (format.test(0)) { add(0, 3, GL_FLOAT, false, 12); }                   // position
+        if (format.test(1)) { add(1, 4, GL_INT_2_10_10_10_REV, true, 4); }        // normal
+        if (format.test(2)) { add(2, 2, GL_HALF_FLOAT, false, 4); }               // uv
+        if (format.test(3)) { add(3, 2, GL_HALF_FLOAT, false, 4); }               // uv2
+        if (format.test(4)) { add(4, 4, GL_INT_2_10_10_10_REV, true, 4); }        // tangent + handedness
+
+        // bit 5 (binormal) is implied by the tangent's handedness, it's never stored
+        if (skinned) {
+            bool wide = n_bones > 256;
+            add(6, 4, wide ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, false, wide ? 8 : 4);  // bone_id
+            add(7, 4, GL_UNSIGNED_BYTE, true, 4);                                         // bone_wt
+        }
+    }
+
+    void Mesh::Layout::Encode(const Vertex* vertices, size_t n_verts, uint8_t* dst) const {
+        auto write = [](uint8_t* ptr, const auto& value) { std::memcpy(ptr, &value, sizeof(value)); };
+
+        for (size_t i = 0; i < n_verts; i++, dst += stride) {
+            const Vertex& v = vertices[i];
+
+            if (auto& a = attributes[0]; a.offset >= 0) {
+                write(dst + a.offset, v.position);
+            }
+
+            if (auto& a = attributes[1]; a.offset >= 0) {
+                write(dst + a.offset, glm::packSnorm3x10_1x2(vec4(v.normal, 0.0f)));
+            }
+
+            if (auto& a = attributes[2]; a.offset >= 0) {
+                write(dst + a.offset, glm::packHalf2x16(v.uv));
+            }
+
+            if (auto& a = attributes[3]; a.offset >= 0) {
+                write(dst + a.offset, glm::packHalf2x16(v.uv2));
+            }
+
+            if (auto& a = attributes[4]; a.offset >= 0) {
+                float handedness = glm::dot(glm::cross(v.normal, v.tangent), v.binormal) < 0.0f ? -1.0f : 1.0f;
+                write(dst + a.offset, glm::packSnorm3x10_1x2(vec4(v.tangent, handedness)));
+            }
+
+            if (auto& a = attributes[6]; a.offset >= 0) {
+                auto id = glm::max(v.bone_id, ivec4(0));  // an empty slot (-1) has a weight of 0 anyway
+
+                if (a.type == GL_UNSIGNED_SHORT) {
+                    write(dst + a.offset, glm::u16vec4(id));
+                }
+                else {
+                    write(dst + a.offset, glm::u8vec4(id));
+                }
+            }
+
+            if (auto& a = attributes[7]; a.offset >= 0) {
+                // round each weight to 8 bits, then give the rounding error to the largest one, so
+                // that the weights still sum up to exactly 1 and the skinned vertex doesn't shrink
+                auto weights = glm::ivec4(glm::round(glm::clamp(v.bone_wt, 0.0f, 1.0f) * 255.0f));
+                int sum = weights.x + weights.y + weights.z + weights.w;
+
+                if (sum > 0) {
+                    int largest = 0;
+                    for (int k = 1; k < 4; k++) {
+                        largest = weights[k] > weights[largest] ? k : largest;
+                    }
+                    weights[largest] = glm::clamp(weights[largest] + 255 - sum, 0, 255);
+                }
+
+                write(dst + a.offset, glm::u8vec4(weights));
+            }
+        }
+    }
+
+    uint64_t Mesh::Layout::Key() const {
+        // hash the fields one by one, the padding bytes of `Attribute` are not initialized
+        std::vector<GLint> fields { stride };
+        for (const auto& a : attributes) {
+            fields.insert(fields.end(), { a.offset, a.size, static_cast<GLint>(a.type), a.normalized ? 1 : 0 });
+        }
+
+        return utils::Hash64(fields.data(), fields.size() * sizeof(GLint));
+    }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -91,7 +176,7 @@ namespace component {
             }
         }
 
-        CreateBuffers(vertices, indices);
+        CreateBuffers(vertices, indices, Layout(tangent_format));
     }
 
     void Mesh::CreateCube(float size) {
@@ -148,7 +233,7 @@ namespace component {
             16, 18, 19,   20, 23, 22,   20, 22, 21
         };
 
-        CreateBuffers(vertices, indices);
+        CreateBuffers(vertices, indices, Layout(basic_format));
     }
 
     void Mesh::CreatePlane(float size) {
@@ -184,7 +269,7 @@ namespace component {
         // counter-clockwise winding order
         std::vector<GLuint> indices { 0, 1, 2, 2, 3, 0, 6, 5, 4, 4, 7, 6 };
 
-        CreateBuffers(vertices, indices);
+        CreateBuffers(vertices, indices, Layout(basic_format));
     }
 
     void Mesh::Create2DQuad(float size) {
@@ -213,7 +298,7 @@ namespace component {
         // counter-clockwise winding order
         std::vector<GLuint> indices { 0, 1, 2, 2, 3, 0 };
 
-        CreateBuffers(vertices, indices);
+        CreateBuffers(vertices, indices, Layout(quad_format));
     }
 
     void Mesh::CreateTorus(float R, float r) {
@@ -280,7 +365,7 @@ namespace component {
             }
         }
 
-        CreateBuffers(vertices, indices);
+        CreateBuffers(vertices, indices, Layout(basic_format));
     }
 
     void Mesh::CreateCapsule(float a, float r) {
@@ -401,7 +486,7 @@ namespace component {
             }
         }
 
-        CreateBuffers(vertices, indices);
+        CreateBuffers(vertices, indices, Layout(tangent_format));
     }
 
     void Mesh::CreatePyramid(float s) {
@@ -450,7 +535,7 @@ namespace component {
             +7, +8, +9, 10, 11, 12, 13, 14, 15
         };
 
-        CreateBuffers(vertices, indices);
+        CreateBuffers(vertices, indices, Layout(basic_format));
     }
 
     Mesh::Mesh(Primitive object) : Component() {
@@ -472,34 +557,137 @@ namespace component {
     Mesh::Mesh(asset_ref<VAO> vao, size_t n_verts)
         : Component(), vao(vao), n_verts(n_verts), n_tris(n_verts / 3) {}
 
-    Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices) : Component() {
-        CreateBuffers(vertices, indices);
-        material_id = vao->ID();  // only this ctor will be called when loading external models
+    Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, const Layout& layout)
+        : Mesh(vertices.data(), vertices.size(), indices.data(), indices.size(), layout) {}
+
+    Mesh::Mesh(const Vertex* vertices, size_t n_verts, const GLuint* indices, size_t n_indices, const Layout& layout) : Component() {
+        CreateBuffers(vertices, n_verts, indices, n_indices, layout);
+        material_id = block ? block->Name() : vao->ID();  // only this ctor will be called when loading external models
     }
 
     Mesh::Mesh(const asset_ref<Mesh>& mesh_asset) : Mesh(*mesh_asset) {}  // calls copy ctor
 
-    void Mesh::CreateBuffers(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices) {
-        vao = MakeAsset<VAO>();
-        vbo = MakeAsset<VBO>(vertices.size() * sizeof(Vertex), &vertices[0]);
-        ibo = MakeAsset<IBO>(indices.size() * sizeof(GLuint), &indices[0]);
+    void Mesh::CreateBuffers(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, const Layout& layout) {
+        CreateBuffers(vertices.data(), vertices.size(), indices.data(), indices.size(), layout);
+    }
+
+    void Mesh::CreateBuffers(const Vertex* vertices, size_t n_verts, const GLuint* indices, size_t n_indices, const Layout& layout) {
+        // the data can come from anywhere, including a memory-mapped file, it's packed into the
+        // layout on the fly, so the full-precision vertices never reach the GPU
+        std::vector<uint8_t> packed(n_verts * layout.stride);
+        layout.Encode(vertices, n_verts, packed.data());
+
+        this->layout = layout;
+        this->n_verts = n_verts;
+        this->n_tris = n_indices / 3;
+
+        auto setup = [layout](const VAO& vao, GLuint vbo_id) {
+            for (GLuint i = 0; i < 8; i++) {
+                if (const auto& attribute = layout.attributes[i]; attribute.offset >= 0) {
+                    vao.SetVBO(vbo_id, i, attribute.offset, attribute.size, layout.stride, attribute.type, attribute.normalized);
+                }
+            }
+        };
 
-        GLuint vbo_id = vbo->ID();
-        GLuint ibo_id = ibo->ID();
+        // the indices of meshes with up to 65536 vertices fit in 16 bits, half the index buffer
+        bool short_indices = n_verts <= std::numeric_limits<uint16_t>::max() + size_t(1);
+        GLenum index_type = short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-        for (GLuint i = 0; i < 8; i++) {
-            GLenum va_type = i == 6 ? GL_INT : GL_FLOAT;
-            vao->SetVBO(vbo_id, i, va_offset[i], va_size[i], sizeof(Vertex), va_type);
+        if (GeometryArena::enabled) {
+            block = GeometryArena::Allocate(layout.Key(), layout.stride, n_verts, n_indices, index_type, setup);
+            block->SetData(packed.data(), indices);
+            base_vertex = block->base_vertex;
+            first_index = block->first_index;
         }
+        else {
+            vao = MakeAsset<VAO>();
+            vbo = MakeAsset<VBO>(packed.size(), packed.data());
 
-        vao->SetIBO(ibo_id);
+            if (short_indices) {
+                std::vector<uint16_t> narrow(indices, indices + n_indices);
+                ibo = MakeAsset<IBO>(n_indices * sizeof(uint16_t), narrow.data());
+            }
+            else {
+                ibo = MakeAsset<IBO>(n_indices * sizeof(GLuint), indices);
+            }
 
-        n_verts = vertices.size();
-        n_tris = indices.size() / 3;
+            setup(*vao, vbo->ID());
+            vao->SetIBO(ibo->ID(), index_type);
+        }
+
+        // a loose bounding sphere centered at the AABB center, good enough for screen size estimates
+        if (n_verts > 0) {
+            glm::vec3 min_pos = vertices[0].position;
+            glm::vec3 max_pos = vertices[0].position;
+
+            for (size_t i = 1; i < n_verts; i++) {
+                min_pos = glm::min(min_pos, vertices[i].position);
+                max_pos = glm::max(max_pos, vertices[i].position);
+            }
+
+            glm::vec3 center = (min_pos + max_pos) * 0.5f;
+            float radius = 0.0f;
+
+            for (size_t i = 0; i < n_verts; i++) {
+                radius = std::max(radius, glm::distance(center, vertices[i].position));
+            }
+
+            this->bounds = glm::vec4(center, radius);
+        }
+    }
+
+    void Mesh::CreateMeshlets(const Vertex* vertices, size_t n_verts, const GLuint* indices, size_t n_indices) {
+        using utils::meshopt::Meshlet;
+        auto data = utils::meshopt::BuildMeshlets(indices, n_indices, &vertices[0].position.x, sizeof(Vertex), n_verts);
+
+        n_meshlets = static_cast<uint32_t>(data.size());
+        meshlets = MakeAsset<SSBO>(8, n_meshlets * sizeof(Meshlet), GL_DYNAMIC_STORAGE_BIT);
+        meshlets->SetData(data.data());
+
+        // 5 uints per command, after the draw count, which is reset to 0 before each culling pass
+        clusters = MakeAsset<SSBO>(9, sizeof(GLuint) + n_meshlets * 5 * sizeof(GLuint), GL_DYNAMIC_STORAGE_BIT);
+        clusters->Clear();
+    }
+
+    VAO& Mesh::GetVAO() const {
+        return block ? block->GetVAO() : *vao;
+    }
+
+    Mesh::LOD Mesh::GetLOD() const {
+        if (lods.empty()) {
+            return LOD { 0, static_cast<uint32_t>(n_tris * 3), 0.0f };
+        }
+
+        return lods[std::min<size_t>(lod, lods.size() - 1)];
     }
 
     void Mesh::Draw() const {
-        vao->Draw(GL_TRIANGLES, n_tris * 3);
+        LOD level = GetLOD();
+        GetVAO().Draw(GL_TRIANGLES, level.count, first_index + level.first, base_vertex);
+    }
+
+    void Mesh::DrawClusters() const {
+        // the commands and the draw count are both read from the clusters buffer on the GPU
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, clusters->ID());
+        glBindBuffer(GL_PARAMETER_BUFFER, clusters->ID());
+        GetVAO().DrawIndirect(GL_TRIANGLES, sizeof(GLuint), sizeof(GLuint), n_meshlets);
+    }
+
+    bool Mesh::SharesBuffers(const Mesh& other) const {
+        return block && other.block && block->SharesPage(*other.block);
+    }
+
+    void Mesh::DrawBatch(const std::vector<const Mesh*>& meshes) {
+        // the caller makes sure that all meshes share the buffers of the first one
+        static std::vector<DrawCommand> commands;  // reused across calls to avoid allocations
+        commands.clear();
+
+        for (const Mesh* mesh : meshes) {
+            LOD level = mesh->GetLOD();
+            commands.push_back(DrawCommand { level.count, 1, mesh->first_index + level.first, mesh->base_vertex, 0 });
+        }
+
+        meshes.front()->GetVAO().MultiDraw(GL_TRIANGLES, commands);
     }
 
     void Mesh::DrawQuad() {
@@ -513,6 +701,7 @@ namespace component {
 
         internal_vao->Bind();
         glDrawArrays(GL_TRIANGLES, 0, 3);  // 3 vertices, 3 vertex shader invocations
+        core::Benchmark::draw_calls++;
     }
 
     void Mesh::DrawGrid() {
@@ -522,6 +711,7 @@ namespace component {
 
         internal_vao->Bind();
         glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, 1, 0);  // 6 vertices, 6 invocations
+        core::Benchmark::draw_calls++;
     }
 
     void Mesh::SetMaterialID(GLuint mid) const {
@@ -18,6 +18,7 @@
    or use multiple VBOs per mesh (one for each vertex attribute), or share VBOs between
    multiple VAOs and meshes to save memory space, coupled with dynamic and stream usage
    hints to gain slightly better performance, but I'd rather not add too much complexity.
+   (that was before scenes with hundreds of meshes, see "# geometry arena" below.)
 
    in this demo, we will never need to update these buffers once they are setup. All the
    vertex attributes and triangle indices are measured in local model space, which means
@@ -31,6 +32,61 @@
    it happens only once to construct the mesh, so that later we would gain the benefit of
    saving bandwidth between frame updates.
 
+   # vertex layout
+
+   `Vertex` is the full-precision format used on the CPU side (importing, procedural meshes
+   and the ".spmesh" cache), but it's 96 bytes, most of which a static mesh never uses (bones,
+   a second UV set). On upload, vertices are packed into a compact per-mesh `Layout` derived
+   from the attributes the mesh actually has (the `vtx_format` bitset of a model), missing
+   attributes take no space at all and are disabled in the VAO:
+
+   > position: 3 x float                  12 bytes
+   > normal:   10-10-10-2 snorm            4 bytes
+   > uv, uv2:  2 x half float              4 bytes each
+   > tangent:  10-10-10-2 snorm            4 bytes, w = handedness, replaces the binormal
+   > bone_id:  4 x uint8 (uint16 if > 256 bones)   4 or 8 bytes
+   > bone_wt:  4 x unorm8, summing to 255   4 bytes
+
+   a textured static mesh with tangents is now 24 bytes per vertex, a skinned one 32 bytes.
+   attribute locations are unchanged and the packed formats are converted to floats by the
+   vertex fetch, so shaders still see `vec3 normal` or `vec2 uv`, except for the binormal,
+   which is rebuilt in the shader as `cross(normal, tangent.xyz) * tangent.w`, and the bone
+   ids, which are pure unsigned integers and must be declared as `uvec4 bone_id`, a signed
+   `ivec4` input reads undefined values from an unsigned format. Unused bone slots are written
+   as bone 0 with a weight of 0, which contributes nothing.
+
+   indices stay 32-bit on the CPU side, but a mesh with up to 65536 vertices uploads them as
+   16-bit indices, the VAO remembers the index type for its draw calls.
+
+   # geometry arena
+
+   while `GeometryArena::enabled` is set (the default), a mesh doesn't own a VAO, VBO and IBO,
+   it's a block of a large page shared by the meshes of the same layout (see "asset/arena.h"),
+   `base_vertex` and `first_index` locate it in the page, and draw calls add them to the range
+   to draw. Meshes in the same page have the same VAO, so switching between them is free, and
+   `DrawBatch()` draws several of them, at their current levels of detail, with one indirect
+   multi-draw call. Pages are also split by index type, so a mesh in the arena still gets 16-bit
+   indices when it can, and a batch, which never spans pages, has a single index type.
+
+   # levels of detail
+
+   an imported mesh can have several levels of detail (see `Model::lod_levels`), they are all
+   simplified from the same vertices, so they share the VBO, and their index buffers are laid
+   out one after another in the IBO, `lods` holds the range and geometric error of each one.
+   `Draw()` draws the level `lod`, which is set by the renderer every frame from the error of
+   each level projected on the screen, a single-level mesh ignores it.
+
+   # meshlets
+
+   large imported meshes are also split into meshlets (see "utils/meshopt.h"), small clusters
+   of the full-detail level with a bounding sphere and a normal cone, stored in the `meshlets`
+   SSBO (binding point 8). A compute pass can then test every meshlet against the frustum,
+   the normal cone and the depth pyramid, and write one `DrawElementsIndirectCommand` for each
+   visible meshlet to the `clusters` SSBO (binding point 9), after a `uint` draw count, so that
+   `DrawClusters()` draws only those ranges with a single `glMultiDrawElementsIndirectCount`,
+   without a round trip to the CPU. The renderer does this when `Renderer::ClusterCulling()`
+   is enabled, see "core/cull_meshlet.glsl".
+
    # use a custom layout
 
    our code is based on the assumption that the buffer data is always static, if that was
@@ -52,13 +108,16 @@
    mesh via algorithms such as "Quadric Error of Edge Collapse" and "Loop Subdivision",
    this can help reduce the number of vertices drastically but is still able to preserve
    most details of the mesh, there will be no apparent visual distinction. In this class,
-   we will restrict the mesh data size to fit into only one VBO.
+   we will restrict the mesh data size to fit into only one VBO. The quadric simplifier in
+   "utils/meshopt.h" is used for levels of detail, which keep the full mesh for close-ups.
 */
 
 #pragma once
 
+#include <bitset>
 #include <vector>
 #include <glm/glm.hpp>
+#include "asset/arena.h"
 #include "asset/vao.h"
 #include "asset/buffer.h"
 #include "component/component.h"
@@ -83,13 +142,49 @@ namespace component {
         };
 
         static_assert(sizeof(Vertex) == 20 * sizeof(float) + 4 * sizeof(int));
-        size_t n_verts, n_tris;
+
+        struct Layout {
+            struct Attribute {
+                GLint offset = -1;  // -1 if the attribute is not stored
+                GLint size = 0;
+                GLenum type = GL_FLOAT;
+                bool normalized = false;
+            };
+
+            Attribute attributes[8];  // indexed by the shader location, same order as `Vertex`
+            GLint stride = 0;
+
+            // format bits: position, normal, uv, uv2, tangent, binormal (see `Model::ProcessMesh()`)
+            Layout(std::bitset<6> format = std::bitset<6>(0x3F), bool skinned = false, size_t n_bones = 0);
+            void Encode(const Vertex* vertices, size_t n_verts, uint8_t* dst) const;
+            uint64_t Key() const;  // equal for layouts that can share a VAO
+        };
+
+        struct LOD {
+            uint32_t first = 0, count = 0;  // range in the index buffer
+            float error = 0.0f;             // geometric error vs. the full mesh, in local units
+        };
+
+        size_t n_verts, n_tris;  // of the full-detail mesh
+        glm::vec4 bounds { 0.0f };  // bounding sphere in local space, xyz = center, w = radius
+        Layout layout;
+        std::vector<LOD> lods;  // empty if the mesh has a single level of detail
+        mutable uint32_t lod = 0;  // the level drawn by `Draw()`, picked by the renderer
+        uint32_t n_meshlets = 0;   // 0 if the mesh has no meshlets
+        asset_ref<asset::SSBO> meshlets;  // `meshopt::Meshlet[]`
+        asset_ref<asset::SSBO> clusters;  // draw count + `DrawElementsIndirectCommand[]`
+        GLint base_vertex = 0;   // offsets in the geometry arena,
+        GLuint first_index = 0;  // 0 if the mesh owns its buffers
 
       private:
         friend class Model;
         asset_ref<asset::VAO> vao;
         asset_ref<asset::VBO> vbo;
         asset_ref<asset::IBO> ibo;
+        asset_ref<asset::GeometryArena::Block> block;  // replaces the buffers above in the arena
+
+        asset::VAO& GetVAO() const;
+        LOD GetLOD() const;  // the range drawn at the current level of detail
 
         void CreateSphere(float radius = 1.0f);
         void CreateCube(float size = 1.0f);
@@ -98,15 +193,21 @@ namespace component {
         void CreateTorus(float R = 1.5f, float r = 0.5f);
         void CreateCapsule(float a = 2.0f, float r = 1.0f);
         void CreatePyramid(float s = 2.0f);
-        void CreateBuffers(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+        void CreateBuffers(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, const Layout& layout);
+        void CreateBuffers(const Vertex* vertices, size_t n_verts, const GLuint* indices, size_t n_indices, const Layout& layout);
+        void CreateMeshlets(const Vertex* vertices, size_t n_verts, const GLuint* indices, size_t n_indices);
 
       public:
         Mesh(Primitive object);
         Mesh(asset_ref<asset::VAO> vao, size_t n_verts);
-        Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+        Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, const Layout& layout = Layout());
+        Mesh(const Vertex* vertices, size_t n_verts, const GLuint* indices, size_t n_indices, const Layout& layout = Layout());
         Mesh(const asset_ref<Mesh>& mesh_asset);
 
         void Draw() const;
+        void DrawClusters() const;
+        bool SharesBuffers(const Mesh& other) const;
+        static void DrawBatch(const std::vector<const Mesh*>& meshes);
         static void DrawQuad();
         static void DrawGrid();
 
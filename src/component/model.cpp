@@ -1,5 +1,6 @@
 #include "pch.h"
 
+#include <cstring>
 #include "core/base.h"
 #include "core/log.h"
 #include "component/model.h"
@@ -7,6 +8,9 @@
 #include "component/material.h"
 #include "component/animator.h"
 #include "utils/ext.h"
+#include "utils/file.h"
+#include "utils/meshopt.h"
+#include "utils/profile.h"
 
 using namespace utils;
 
@@ -35,7 +39,38 @@ namespace component {
     }
 
     Model::Model(const std::string& filepath, Quality quality, bool animate) : Component(), animated(animate) {
+        ProcessScene(filepath, quality);
+        Upload();
+    }
+
+    Model::Model(const asset_ref<Model>& model_asset) : Component() {
+        const Model& model = *model_asset;
+        CORE_ASERT(model.Uploaded(), "Cannot share a model that has not been uploaded to the GPU...");
+
+        this->vtx_format = model.vtx_format;
+        this->materials_cache = model.materials_cache;
+        this->n_nodes  = model.n_nodes;
+        this->n_bones  = model.n_bones;
+        this->n_meshes = model.n_meshes;
+        this->n_verts  = model.n_verts;
+        this->n_tris   = model.n_tris;
+        this->animated = model.animated;
+        this->nodes    = model.nodes;
+        this->meshes   = model.meshes;  // the copied meshes share the same VAOs
+        this->materials = model.materials;
+    }
+
+    asset_ref<Model> Model::Import(const std::string& filepath, Quality quality, bool animate) {
+        auto model = asset_ref<Model>(new Model());  // the default ctor is private, can't use `MakeAsset`
+        model->animated = animate;
+        model->ProcessScene(filepath, quality);
+        return model;
+    }
+
+    void Model::ProcessScene(const std::string& filepath, Quality quality) {
+        PROFILE_FUNCTION();
         this->vtx_format.reset();
+        this->staging.clear();
         this->meshes.clear();
         this->materials.clear();
 
@@ -54,24 +89,64 @@ namespace component {
             import_options |= aiProcess_PreTransformVertices;
         }
 
-        Assimp::Importer importer;
-        importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, 4);  // stick to "4 bones per vertex" rule
-        importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_ANIMATIONS, false);
+        // our own pass reorders the triangles anyway, Assimp's would be wasted work
+        if (optimize) {
+            import_options &= ~aiProcess_ImproveCacheLocality;
+        }
+
+        // the cache is keyed by everything that affects the imported data, bit 33 is the motion bit
+        // of `AttachMotion()`, the rest of the options must fit in the 29 bits above it
+        uint64_t mesh_options = static_cast<uint64_t>(optimize)
+            | (static_cast<uint64_t>(std::round(std::clamp(overdraw_threshold - 1.0f, 0.0f, 1.27f) * 100.0f)) << 1)
+            | (static_cast<uint64_t>(std::min(lod_levels, spmesh::max_lods)) << 8)
+            | (static_cast<uint64_t>(std::round(std::clamp(lod_ratio, 0.0f, 1.0f) * 100.0f)) << 12)
+            | (static_cast<uint64_t>(std::round(std::clamp(lod_max_error, 0.0f, 1.0f) * 1000.0f)) << 19);
+
+        uint64_t cache_options = static_cast<uint64_t>(import_options)
+            | (static_cast<uint64_t>(animated) << 32)
+            | (mesh_options << 34);
+        uint64_t source_hash = utils::HashFile(filepath);
+        std::string cache_path = spmesh::CachePath(filepath, cache_options);
 
         CORE_TRACE("Start loading model: {0}...", filepath);
         auto start_time = std::chrono::high_resolution_clock::now();
-        
-        this->ai_root = importer.ReadFile(filepath, import_options);
 
-        if (!ai_root || ai_root->mRootNode == nullptr || ai_root->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
-            CORE_ERROR("Failed to import model: {0}", filepath);
-            CORE_ERROR("Assimp error: {0}", importer.GetErrorString());
-            SP_DBG_BREAK();
-            return;
-        }
+        bool cached = source_hash != 0 && LoadCache(cache_path, source_hash, cache_options);
 
-        ProcessTree(ai_root->mRootNode, -1);  // recursively process and store the hierarchy info
-        ProcessNode(ai_root->mRootNode);      // recursively process every node before return
+        if (!cached) {
+            Assimp::Importer importer;
+            importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, 4);  // stick to "4 bones per vertex" rule
+            importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_ANIMATIONS, false);
+
+            if (PROFILE_SCOPE("Assimp::ReadFile"); true) {
+                this->ai_root = importer.ReadFile(filepath, import_options);
+            }
+
+            if (!ai_root || ai_root->mRootNode == nullptr || ai_root->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
+                CORE_ERROR("Failed to import model: {0}", filepath);
+                CORE_ERROR("Assimp error: {0}", importer.GetErrorString());
+                SP_DBG_BREAK();
+                return;
+            }
+
+            if (PROFILE_SCOPE("Model::ProcessNode"); true) {
+                ProcessTree(ai_root->mRootNode, -1);  // recursively process and store the hierarchy info
+                ProcessNode(ai_root->mRootNode);      // recursively process every node before return
+            }
+
+            ai_root = nullptr;
+
+            // the assimp importer will automatically free the aiScene upon function return so we cannot
+            // free the root resources manually (in case the second `delete` leads to undefined behavior)
+            if constexpr (false) {
+                delete ai_root;
+                importer.FreeScene();
+            }
+
+            if (source_hash != 0) {
+                SaveCache(cache_path, source_hash, cache_options);
+            }
+        }
 
         if (animated) {
             unsigned int cnt = ranges::count_if(nodes, [](const Node& node) { return node.bid >= 0; });
@@ -81,15 +156,7 @@ namespace component {
 
         auto end_time = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double, std::milli> loading_time = end_time - start_time;
-        CORE_TRACE("Model import complete! Total loading time: {0:.2f} ms", loading_time.count());
-        ai_root = nullptr;
-
-        // the assimp importer will automatically free the aiScene upon function return so we cannot
-        // free the root resources manually (in case the second `delete` leads to undefined behavior)
-        if constexpr (false) {
-            delete ai_root;
-            importer.FreeScene();
-        }
+        CORE_TRACE("Model {0} complete! Total loading time: {1:.2f} ms", cached ? "cache load" : "import", loading_time.count());
 
         CORE_TRACE("Generating model loading report...... (for reference)");
         CORE_TRACE("-----------------------------------------------------");
@@ -104,7 +171,69 @@ namespace component {
         CORE_DEBUG("vertex has uv set 1 ? [{0}]", vtx_format.test(2) ? "Y" : "N");
         CORE_DEBUG("vertex has uv set 2 ? [{0}]", vtx_format.test(3) ? "Y" : "N");
         CORE_DEBUG("vertex has tan/btan ? [{0}]", vtx_format.test(4) ? "Y" : "N");
+        CORE_DEBUG("vertex stride on GPU: {0} bytes (unpacked {1})", Mesh::Layout(vtx_format, animated, n_bones).stride, sizeof(Mesh::Vertex));
+        CORE_TRACE("-----------------------------------------------------");
+
+        // post-transform cache and vertex fetch efficiency of the index buffers, see "utils/meshopt.h",
+        // the analysis replays every index buffer, so it's skipped when the report is compiled out
+#if SP_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+        double acmr = 0.0, atvr = 0.0, overfetch = 0.0;
+        size_t stride = Mesh::Layout(vtx_format, animated, n_bones).stride;
+
+        size_t lod_tris[spmesh::max_lods] = {};
+
+        for (const auto& data : staging) {
+            const GLuint* indices = data.idx_view ? data.idx_view : data.indices.data();
+            size_t n_indices = data.lods.empty() ? data.n_indices : data.lods[0].count;  // the full mesh only
+            auto stats = meshopt::AnalyzeVertexCache(indices, n_indices, data.n_verts);
+            acmr += stats.acmr * (n_indices / 3);
+            atvr += stats.atvr * data.n_verts;
+            overfetch += meshopt::AnalyzeVertexFetch(indices, n_indices, data.n_verts, stride) * data.n_verts;
+
+            // a mesh that ran out of levels keeps drawing its coarsest one
+            for (size_t i = 0; i < spmesh::max_lods; i++) {
+                lod_tris[i] += data.lods.empty() ? n_indices / 3 : data.lods[std::min(i, data.lods.size() - 1)].count / 3;
+            }
+        }
+
+        CORE_DEBUG("vertex cache ACMR:     {0:.3f}", n_tris > 0 ? acmr / n_tris : 0.0);
+        CORE_DEBUG("vertex cache ATVR:     {0:.3f}", n_verts > 0 ? atvr / n_verts : 0.0);
+        CORE_DEBUG("vertex overfetch:      {0:.3f}", n_verts > 0 ? overfetch / n_verts : 0.0);
+
+        for (unsigned int i = 1; i < std::min(lod_levels, spmesh::max_lods); i++) {
+            CORE_DEBUG("triangles in LOD {0}:    {1:.2f}k", i, lod_tris[i] * 0.001f);
+        }
+#endif
+
         CORE_TRACE("-----------------------------------------------------");
+    }
+
+    void Model::Upload() {
+        PROFILE_FUNCTION();
+        meshes.reserve(meshes.size() + staging.size());
+        auto layout = Mesh::Layout(vtx_format, animated, n_bones);  // shared by all meshes of the model
+
+        for (auto& data : staging) {
+            // cached meshes are read straight from the mapped file, without an intermediate copy
+            const Mesh::Vertex* vertices = data.vtx_view ? data.vtx_view : data.vertices.data();
+            const GLuint* indices = data.idx_view ? data.idx_view : data.indices.data();
+
+            auto& mesh = meshes.emplace_back(vertices, data.n_verts, indices, data.n_indices, layout);  // create the VAO
+
+            if (data.lods.size() > 1) {
+                mesh.lods = data.lods;
+                mesh.n_tris = data.lods[0].count / 3;
+            }
+
+            if (!animated && mesh.n_tris >= meshlet_min_tris) {
+                mesh.CreateMeshlets(vertices, data.n_verts, indices, mesh.n_tris * 3);
+            }
+            ProcessMaterial(data.matkey, mesh);
+        }
+
+        staging.clear();
+        staging.shrink_to_fit();  // release the CPU copy of the vertices
+        cache.reset();            // and unmap the cache file
 
         std::string all_mtls = "not available";
 
@@ -143,7 +272,7 @@ namespace component {
 
     void Model::ProcessNode(aiNode* ai_node) {
         // allocate storage for meshes upfront in every recursion
-        meshes.reserve(meshes.size() + ai_node->mNumMeshes);
+        staging.reserve(staging.size() + ai_node->mNumMeshes);
 
         // iteratively process every mesh in the current node
         for (unsigned int i = 0; i < ai_node->mNumMeshes; i++) {
@@ -179,10 +308,8 @@ namespace component {
             vtx_format = local_format;
         }
 
-        static bool warned = false;
-        if (vtx_format != local_format && !warned) {
-            CORE_WARN("Inconsistent vertex format! Some meshes have attributes missing...");
-            warned = true;
+        if (vtx_format != local_format) {
+            CORE_WARN_ONCE("Inconsistent vertex format! Some meshes have attributes missing...");
         }
 
         vtx_format |= local_format;  // bitwise or on every pair of bits
@@ -278,24 +405,94 @@ namespace component {
             }
         }
 
-        auto& mesh = meshes.emplace_back(vertices, indices);  // move construct mesh in-place
-        n_meshes++;
+        // reorder the triangles for the post-transform cache and early-z
+        if (optimize && !indices.empty()) {
+            auto clusters = meshopt::OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+            meshopt::OptimizeOverdraw(indices.data(), indices.size(), &vertices[0].position.x, sizeof(Mesh::Vertex),
+                vertices.size(), clusters, overdraw_threshold);
+        }
 
-        // establish the association between mesh and material
-        aiMaterial* ai_material = ai_root->mMaterials[ai_mesh->mMaterialIndex];
-        ProcessMaterial(ai_material, mesh);
-    }
+        // simplify each level of detail from the previous one, so the error of a level is bounded
+        // by the sum of the errors of the collapses so far, levels are appended to the indices
+        std::vector<Mesh::LOD> lods = { Mesh::LOD { 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+        float radius = 0.0f;
+
+        if (lod_levels > 1 && !indices.empty()) {
+            glm::vec3 min_pos = vertices[0].position;
+            glm::vec3 max_pos = vertices[0].position;
+
+            for (const auto& vertex : vertices) {
+                min_pos = glm::min(min_pos, vertex.position);
+                max_pos = glm::max(max_pos, vertex.position);
+            }
 
-    void Model::ProcessMaterial(aiMaterial* ai_material, const Mesh& mesh) {
+            radius = glm::distance(min_pos, max_pos) * 0.5f;
+        }
+
+        for (unsigned int level = 1; level < std::min(lod_levels, spmesh::max_lods) && radius > 0.0f; level++) {
+            const Mesh::LOD prev = lods.back();
+            size_t target = static_cast<size_t>(prev.count * lod_ratio) / 3 * 3;
+            std::vector<GLuint> lod_indices(prev.count);
+            float error = 0.0f;
+
+            // the error of a level adds up with the previous ones, each level only gets what's left
+            float budget = lod_max_error * radius - prev.error;
+            if (budget <= 0.0f) {
+                break;
+            }
+
+            size_t count = meshopt::Simplify(lod_indices.data(), indices.data() + prev.first, prev.count,
+                &vertices[0].position.x, sizeof(Mesh::Vertex), vertices.size(), target, budget, &error);
+
+            if (count == 0 || count > prev.count * 0.9f) {
+                break;  // out of error budget, or locked by seams, not worth another level
+            }
+
+            lod_indices.resize(count);
+            if (optimize) {
+                meshopt::OptimizeVertexCache(lod_indices.data(), lod_indices.size(), vertices.size());
+            }
+
+            lods.push_back(Mesh::LOD { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(count), prev.error + error });
+            indices.insert(indices.end(), lod_indices.begin(), lod_indices.end());
+        }
+
+        // renumber the vertices for fetch locality, in the order of the full mesh which is where
+        // locality matters most, unused vertices are dropped so `n_verts` is corrected afterwards
+        if (optimize && !indices.empty()) {
+            n_verts -= static_cast<unsigned int>(vertices.size());
+
+            auto remap = meshopt::OptimizeVertexFetch(indices.data(), indices.size(), vertices.size());
+            meshopt::RemapVertices(vertices, remap);
+
+            n_verts += static_cast<unsigned int>(vertices.size());
+        }
+
+        // the mesh's VAO is created later in `Upload()`, here we only find out the material key
+        aiMaterial* ai_material = ai_root->mMaterials[ai_mesh->mMaterialIndex];
         CORE_ASERT(ai_material != nullptr, "Corrupted assimp data: material is nullptr!");
 
         aiString name;
         if (ai_material->Get(AI_MATKEY_NAME, name) != AI_SUCCESS) {
-            CORE_ERROR("Unable to load mesh's material (VAO = {0})...", mesh.vao->ID());
-            return;
+            CORE_ERROR("Unable to load mesh's material (mesh = {0})...", n_meshes);
+            name.Clear();
         }
 
-        std::string matkey { name.C_Str() };
+        auto& data = staging.emplace_back();
+        data.n_verts = vertices.size();
+        data.n_indices = indices.size();
+        data.vertices = std::move(vertices);
+        data.indices = std::move(indices);
+        data.lods = std::move(lods);
+        data.matkey = name.C_Str();
+        n_meshes++;
+    }
+
+    void Model::ProcessMaterial(const std::string& matkey, const Mesh& mesh) {
+        // establish the association between mesh and material
+        if (matkey.empty()) {
+            return;
+        }
 
         // check if the matkey already exists in local cache
         if (materials_cache.find(matkey) != materials_cache.end()) {
@@ -309,6 +506,73 @@ namespace component {
         materials_cache[matkey] = matid;
     }
 
+    bool Model::LoadCache(const std::string& filepath, uint64_t source_hash, uint64_t options) {
+        PROFILE_FUNCTION();
+        auto reader = std::make_unique<spmesh::Reader>(filepath, source_hash, options);
+        if (!reader->Valid()) {
+            return false;
+        }
+
+        const spmesh::Header& header = reader->GetHeader();
+        vtx_format = std::bitset<6>(header.vtx_format);
+
+        nodes.reserve(header.n_nodes);
+        for (const spmesh::Node* record = reader->Nodes(); n_nodes < header.n_nodes; record++) {
+            auto& node = nodes.emplace_back(n_nodes++, record->pid, std::string(reader->GetString(record->name)));
+            node.bid = record->bid;
+            node.n2p = glm::make_mat4(record->n2p);
+            node.m2n = glm::make_mat4(record->m2n);
+        }
+
+        n_bones = header.n_bones;
+        staging.reserve(header.n_meshes);
+
+        for (const spmesh::Mesh* record = reader->Meshes(); n_meshes < header.n_meshes; record++) {
+            auto& data = staging.emplace_back();
+            data.vtx_view  = reader->Vertices() + record->first_vertex;
+            data.idx_view  = reader->Indices() + record->first_index;
+            data.n_verts   = record->n_verts;
+            data.n_indices = record->n_indices;
+            data.matkey    = reader->GetString(record->matkey);
+
+            for (uint32_t i = 0, first = 0; i < std::min(record->n_lods, spmesh::max_lods); i++) {
+                data.lods.push_back(Mesh::LOD { first, record->lod_indices[i], record->lod_error[i] });
+                first += record->lod_indices[i];
+            }
+
+            n_meshes++;
+            n_verts += record->n_verts;
+            n_tris += (data.lods.empty() ? record->n_indices : data.lods[0].count) / 3;
+        }
+
+        cache = std::move(reader);  // the views above point into the mapping
+        return true;
+    }
+
+    void Model::SaveCache(const std::string& filepath, uint64_t source_hash, uint64_t options) const {
+        PROFILE_FUNCTION();
+        auto writer = spmesh::Writer(source_hash, options, static_cast<uint32_t>(vtx_format.to_ulong()));
+
+        for (const auto& node : nodes) {
+            spmesh::Node record {};
+            record.nid  = node.nid;
+            record.pid  = node.pid;
+            record.bid  = node.bid;
+            record.name = writer.AddString(node.name);
+            std::memcpy(record.n2p, glm::value_ptr(node.n2p), sizeof(record.n2p));
+            std::memcpy(record.m2n, glm::value_ptr(node.m2n), sizeof(record.m2n));
+            writer.AddNode(record);
+        }
+
+        for (const auto& data : staging) {
+            writer.AddMesh(data.vertices.data(), data.n_verts, data.indices.data(), data.n_indices, data.matkey, data.lods);
+        }
+
+        if (writer.Save(filepath)) {
+            CORE_TRACE("Model cache saved to: {0}", filepath);
+        }
+    }
+
     Material& Model::SetMaterial(const std::string& matkey, asset_ref<Material>&& material) {
         CORE_ASERT(materials_cache.count(matkey) > 0, "Invalid material key: {0}", matkey);
 
@@ -336,11 +600,25 @@ namespace component {
             // | aiProcess_PreTransformVertices  // this flag must be disabled to load animation
             ;
 
+        // the motion bit keeps the cache apart from the model's own, when both come from one file,
+        // no other key sets it, see `ProcessScene()`
+        uint64_t cache_options = static_cast<uint64_t>(import_options) | (1ULL << 33);
+        uint64_t source_hash = utils::HashFile(filepath);
+        std::string cache_path = spmesh::CachePath(filepath, cache_options);
+
+        CORE_TRACE("Start loading animation from: {0}...", filepath);
+
+        if (source_hash != 0) {
+            if (auto cache = spmesh::Reader(cache_path, source_hash, cache_options); cache.Valid()) {
+                animation = std::make_unique<Animation>(cache, this);
+                return;
+            }
+        }
+
         Assimp::Importer importer;
         importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, 4);
         importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_ANIMATIONS, true);
 
-        CORE_TRACE("Start loading animation from: {0}...", filepath);
         const aiScene* scene = importer.ReadFile(filepath, import_options);
 
         // note that we don't need to check `scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE`
@@ -355,6 +633,10 @@ namespace component {
         }
 
         animation = std::make_unique<Animation>(scene, this);
+
+        if (source_hash != 0) {
+            Animation::SaveCache(scene, cache_path, source_hash, cache_options);
+        }
     }
 
 }
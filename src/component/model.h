@@ -79,6 +79,50 @@
    loaded mesh). In GLSL, there's a corresponding built-in uniform `self.material_id`, which
    can be used for branching the shader code in order to shade every mesh differently.
 
+   # async import
+
+   reading the file and building the vertices is pure CPU work, while creating the VAOs must be
+   done on the main thread that owns the OpenGL context, so model loading is split in 2 stages.
+   `Import()` reads the file into a staging area and can be called from any thread, `Upload()`
+   then turns the staged meshes into VAOs, and assigns the material ids. The regular ctor just
+   runs both stages in a row. An uploaded model can be shared by multiple entities, each model
+   component constructed from it has its own copy of the nodes and materials, but all of them
+   share the same meshes (VAOs), animations are not copied so must be attached separately.
+
+   # binary cache
+
+   importing a large model with Assimp takes a while (triangulation, normals and tangents are
+   generated, the data structure is validated, etc.), so the result is cached in the ".spmesh"
+   format in `paths::cache`, the next time the same file is imported with the same options, we
+   just map the cache file and pack the vertex blobs straight into the VBOs, without another
+   copy. The cache keeps full-precision vertices, the compact GPU layout is chosen at upload
+   from the model's vertex format (see `Mesh::Layout`), so it can change without invalidating
+   the cache. Same goes for animations loaded by `AttachMotion()`, see `spmesh.h` for details.
+
+   # mesh optimization
+
+   with `optimize` set, the triangles and vertices of each mesh are reordered right after the
+   import for the post-transform cache, overdraw and vertex fetch (see "utils/meshopt.h"), so
+   the binary cache stores the optimized meshes and the pass is only paid once. The loading
+   report prints the resulting ACMR, ATVR and overfetch of the model.
+
+   # levels of detail
+
+   each mesh is also simplified into up to `lod_levels` levels of detail, each with about
+   `lod_ratio` times the triangles of the previous one, as long as the geometric error stays
+   under `lod_max_error` times the size of the mesh. The levels share the vertices of the full
+   mesh and are appended to its index buffer (see `Mesh::lods`), they are built and cached at
+   import like the rest. The renderer picks a level for each mesh every frame from the error
+   projected on the screen, see `Renderer::SetLODError()`.
+
+   # meshlets
+
+   a static mesh with at least `meshlet_min_tris` triangles is also split into meshlets on
+   upload, so that the renderer can cull its invisible parts on the GPU when the full mesh is
+   drawn, see `Renderer::ClusterCulling()`. Meshlets are contiguous ranges of the optimized
+   index buffer, building them is a single linear pass, so they are not cached. Skinned meshes
+   are skipped, their bounds move with the bones.
+
    # skeleton animation
 
    users can optionally attach animations (motions) to the imported model. Ideally, animation
@@ -102,11 +146,12 @@
 #include <assimp/postprocess.h>
 #include "core/base.h"
 #include "component/component.h"
+#include "component/mesh.h"
+#include "component/spmesh.h"
 
 namespace component {
 
     class Animation;
-    class Mesh;
     class Material;
 
     class Node {
@@ -135,11 +180,30 @@ namespace component {
 
     class Model : public Component {
       private:
+        struct MeshData {  // mesh data imported on the CPU side, waiting to be uploaded
+            std::vector<Mesh::Vertex> vertices;      // owned data if imported by Assimp
+            std::vector<GLuint> indices;
+            const Mesh::Vertex* vtx_view = nullptr;  // or a view into the mapped cache file
+            const GLuint* idx_view = nullptr;
+            size_t n_verts = 0, n_indices = 0;       // indices of all levels of detail
+            std::vector<Mesh::LOD> lods;
+            std::string matkey;
+        };
+
         const aiScene* ai_root = nullptr;
         std::bitset<6> vtx_format;
         std::unordered_map<std::string, GLuint> materials_cache;  // matkey : matid
+        std::vector<MeshData> staging;
+        std::unique_ptr<spmesh::Reader> cache;  // kept mapped until the meshes are uploaded
 
       public:
+        static inline bool optimize = true;  // reorder triangles and vertices after import, see "utils/meshopt.h"
+        static inline float overdraw_threshold = 1.05f;  // max vertex cache cost of the overdraw pass
+        static inline unsigned int lod_levels = 4;  // including the full mesh, 1 = no levels of detail
+        static inline float lod_ratio = 0.5f;       // triangles of each level vs. the previous one
+        static inline float lod_max_error = 0.05f;  // relative to the mesh radius, coarser levels are dropped
+        static inline unsigned int meshlet_min_tris = 1024;  // smaller meshes are not worth a culling dispatch
+
         unsigned int n_nodes = 0, n_bones = 0;
         unsigned int n_meshes = 0, n_verts = 0, n_tris = 0;
         bool animated = false;
@@ -150,13 +214,23 @@ namespace component {
         std::unique_ptr<Animation> animation;
 
       private:
+        Model() = default;
+        void ProcessScene(const std::string& filepath, Quality quality);
         void ProcessTree(aiNode* ai_node, int parent);
         void ProcessNode(aiNode* ai_node);
         void ProcessMesh(aiMesh* ai_mesh);
-        void ProcessMaterial(aiMaterial* ai_material, const Mesh& mesh);
+        void ProcessMaterial(const std::string& matkey, const Mesh& mesh);
+        bool LoadCache(const std::string& filepath, uint64_t source_hash, uint64_t options);
+        void SaveCache(const std::string& filepath, uint64_t source_hash, uint64_t options) const;
 
       public:
         Model(const std::string& filepath, Quality quality, bool animate = false);
+        Model(const asset_ref<Model>& model_asset);
+
+        static asset_ref<Model> Import(const std::string& filepath, Quality quality, bool animate = false);
+        void Upload();
+        bool Uploaded() const { return staging.empty(); }
+
         Material& SetMaterial(const std::string& matkey, asset_ref<Material>&& material);
         void AttachMotion(const std::string& filepath);
     };
@@ -0,0 +1,202 @@
+#include "pch.h"
+
+#include <cstring>
+#include "core/log.h"
+#include "component/spmesh.h"
+#include "utils/path.h"
+
+namespace component::spmesh {
+
+    static constexpr uint64_t alignment = 16;
+
+    static inline uint64_t Align(uint64_t offset) {
+        return (offset + alignment - 1) & ~(alignment - 1);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    Reader::Reader(const std::string& filepath, uint64_t source_hash, uint64_t options) {
+        file = std::make_unique<utils::MappedFile>(filepath);
+        if (!file->Valid() || file->Size() < sizeof(Header)) {
+            return;
+        }
+
+        auto h = reinterpret_cast<const Header*>(file->Data());
+
+        bool valid = std::memcmp(h->magic, magic, sizeof(magic)) == 0
+            && h->version == version
+            && h->source_hash == source_hash
+            && h->options == options
+            && h->file_size == file->Size();
+
+        // make sure that every section fits in the file, in case it's truncated or corrupted
+        valid = valid
+            && h->nodes    + h->n_nodes    * sizeof(Node)    <= h->file_size
+            && h->meshes   + h->n_meshes   * sizeof(Mesh)    <= h->file_size
+            && h->channels + h->n_channels * sizeof(Channel) <= h->file_size
+            && h->keys     + h->n_keys     * sizeof(Key)     <= h->file_size
+            && h->vertices + h->n_verts    * sizeof(component::Mesh::Vertex) <= h->file_size
+            && h->indices  + h->n_indices  * sizeof(GLuint)  <= h->file_size
+            && h->chars    + h->n_chars                      <= h->file_size;
+
+        if (!valid) {
+            CORE_TRACE("Cache file is outdated, will be rebuilt: {0}", filepath);
+            file.reset();  // unmap now so that the file can be overwritten
+            return;
+        }
+
+        header = h;
+    }
+
+    const Node* Reader::Nodes() const {
+        return reinterpret_cast<const Node*>(file->Data() + header->nodes);
+    }
+
+    const Mesh* Reader::Meshes() const {
+        return reinterpret_cast<const Mesh*>(file->Data() + header->meshes);
+    }
+
+    const Channel* Reader::Channels() const {
+        return reinterpret_cast<const Channel*>(file->Data() + header->channels);
+    }
+
+    const Key* Reader::Keys() const {
+        return reinterpret_cast<const Key*>(file->Data() + header->keys);
+    }
+
+    const component::Mesh::Vertex* Reader::Vertices() const {
+        return reinterpret_cast<const component::Mesh::Vertex*>(file->Data() + header->vertices);
+    }
+
+    const GLuint* Reader::Indices() const {
+        return reinterpret_cast<const GLuint*>(file->Data() + header->indices);
+    }
+
+    std::string_view Reader::GetString(const String& str) const {
+        CORE_ASERT(str.offset + str.length <= header->n_chars, "Corrupted cache: string out of bound!");
+        return std::string_view(reinterpret_cast<const char*>(file->Data() + header->chars + str.offset), str.length);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    Writer::Writer(uint64_t source_hash, uint64_t options, uint32_t vtx_format) {
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.vtx_format = vtx_format;
+        header.source_hash = source_hash;
+        header.options = options;
+    }
+
+    String Writer::AddString(std::string_view str) {
+        String ref { static_cast<uint32_t>(chars.size()), static_cast<uint32_t>(str.size()) };
+        chars.append(str);
+        return ref;
+    }
+
+    void Writer::AddNode(const Node& node) {
+        nodes.push_back(node);
+        header.n_bones += node.bid >= 0 ? 1 : 0;
+    }
+
+    void Writer::AddMesh(const component::Mesh::Vertex* vtx, size_t n_verts, const GLuint* idx, size_t n_indices, std::string_view matkey,
+        const std::vector<component::Mesh::LOD>& lods)
+    {
+        CORE_ASERT(lods.size() <= max_lods, "Too many levels of detail: {0}", lods.size());
+        auto& mesh = meshes.emplace_back();
+        mesh.first_vertex = vertices.size();
+        mesh.first_index  = indices.size();
+        mesh.n_verts      = static_cast<uint32_t>(n_verts);
+        mesh.n_indices    = static_cast<uint32_t>(n_indices);
+        mesh.matkey       = AddString(matkey);
+        mesh.n_lods       = static_cast<uint32_t>(lods.size());
+
+        for (size_t i = 0; i < lods.size(); i++) {
+            mesh.lod_indices[i] = lods[i].count;
+            mesh.lod_error[i] = lods[i].error;
+        }
+
+        vertices.insert(vertices.end(), vtx, vtx + n_verts);
+        indices.insert(indices.end(), idx, idx + n_indices);
+    }
+
+    void Writer::SetMotion(std::string_view name, float duration, float speed) {
+        header.motion_name = AddString(name);
+        header.duration = duration;
+        header.speed = speed;
+    }
+
+    void Writer::AddChannel(std::string_view name, const std::vector<Key>& positions,
+        const std::vector<Key>& rotations, const std::vector<Key>& scales)
+    {
+        auto& channel = channels.emplace_back();
+        channel.name        = AddString(name);
+        channel.n_positions = static_cast<uint32_t>(positions.size());
+        channel.n_rotations = static_cast<uint32_t>(rotations.size());
+        channel.n_scales    = static_cast<uint32_t>(scales.size());
+        channel.first_key   = keys.size();
+
+        keys.insert(keys.end(), positions.begin(), positions.end());
+        keys.insert(keys.end(), rotations.begin(), rotations.end());
+        keys.insert(keys.end(), scales.begin(), scales.end());
+    }
+
+    bool Writer::Save(const std::string& filepath) {
+        header.n_nodes    = static_cast<uint32_t>(nodes.size());
+        header.n_meshes   = static_cast<uint32_t>(meshes.size());
+        header.n_channels = static_cast<uint32_t>(channels.size());
+        header.n_keys     = keys.size();
+        header.n_verts    = vertices.size();
+        header.n_indices  = indices.size();
+        header.n_chars    = chars.size();
+
+        // lay out the sections one after another, each one aligned to 16 bytes
+        uint64_t offset = Align(sizeof(Header));
+        auto place = [&offset](uint64_t& section, uint64_t size) {
+            section = offset;
+            offset = Align(offset + size);
+        };
+
+        place(header.nodes,    nodes.size()    * sizeof(Node));
+        place(header.meshes,   meshes.size()   * sizeof(Mesh));
+        place(header.channels, channels.size() * sizeof(Channel));
+        place(header.keys,     keys.size()     * sizeof(Key));
+        place(header.vertices, vertices.size() * sizeof(component::Mesh::Vertex));
+        place(header.indices,  indices.size()  * sizeof(GLuint));
+        place(header.chars,    chars.size());
+        header.file_size = offset;
+
+        std::vector<uint8_t> buffer(offset, 0);
+        auto copy = [&buffer](uint64_t section, const void* data, size_t size) {
+            if (size > 0) {
+                std::memcpy(buffer.data() + section, data, size);
+            }
+        };
+
+        copy(0,               &header,          sizeof(Header));
+        copy(header.nodes,    nodes.data(),     nodes.size()    * sizeof(Node));
+        copy(header.meshes,   meshes.data(),    meshes.size()   * sizeof(Mesh));
+        copy(header.channels, channels.data(),  channels.size() * sizeof(Channel));
+        copy(header.keys,     keys.data(),      keys.size()     * sizeof(Key));
+        copy(header.vertices, vertices.data(),  vertices.size() * sizeof(component::Mesh::Vertex));
+        copy(header.indices,  indices.data(),   indices.size()  * sizeof(GLuint));
+        copy(header.chars,    chars.data(),     chars.size());
+
+        return utils::WriteFileAtomic(filepath, buffer.data(), buffer.size());
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    std::string CachePath(const std::string& source_path, uint64_t options) {
+        // the file name is keyed by the source path and the import options, so that the same
+        // model imported with different settings (or as a model vs. a motion) doesn't collide
+        uint64_t key = utils::Hash64(source_path.data(), source_path.size());
+        key = utils::Hash64(&options, sizeof(options), key);
+
+        std::ostringstream name;
+        name << std::filesystem::path(source_path).stem().string() << "."
+             << std::hex << std::setw(16) << std::setfill('0') << key << ".spmesh";
+
+        return utils::paths::cache + name.str();
+    }
+
+}
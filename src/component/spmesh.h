@@ -0,0 +1,146 @@
+/*
+   ".spmesh" is our own binary format for caching imported models, once a model has been read
+   by Assimp, the processed data is dumped into `paths::cache` as is, so that next time we can
+   skip Assimp entirely, which can take seconds for a large FBX with the high quality preset.
+   the same format is used to cache animation clips, in which case it only has the motion and
+   channels sections. The file is meant to be memory-mapped and read in place, there's no
+   parsing involved, every section is an array of fixed-size records at a known offset.
+
+   # layout
+
+   > [Header]  magic, version, counts, source hash, import options, section offsets
+   > [Node]    x n_nodes,    the hierarchy in DFS order (the index is the node id)
+   > [Mesh]    x n_meshes,   ranges into the vertex and index blobs, LOD table, material key
+   > [Channel] x n_channels, ranges into the key blob
+   > [Key]     x n_keys,     raw animation keyframes as read from Assimp
+   > [Vertex]  x n_verts,    vertex blob in the exact layout of `Mesh::Vertex`
+   > [GLuint]  x n_indices,  index blob, local to each mesh, all levels of detail in a row
+   > [char]    x n_chars,    string table, strings are referenced by offset and length
+
+   every section starts at a 16-byte aligned offset, so that the blobs can be handed over to
+   OpenGL directly from the mapping. All values are stored in native (little-endian) order.
+
+   # validation
+
+   a cache file is only used if the magic, the version, the hash of the source file's content
+   and the import options all match, otherwise it's silently rebuilt from the source. Bump up
+   `version` whenever the layout of any record, or the way the data is processed, is changed.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "core/base.h"
+#include "component/mesh.h"
+#include "utils/file.h"
+
+namespace component::spmesh {
+
+    inline constexpr char magic[8] = { 'S', 'P', 'M', 'E', 'S', 'H', '\0', '\0' };
+    inline constexpr uint32_t version = 4;
+    inline constexpr uint32_t max_lods = 8;
+
+    struct String {
+        uint32_t offset;  // into the string table
+        uint32_t length;
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t vtx_format;  // bitset of vertex attributes
+        uint64_t source_hash;
+        uint64_t options;     // import options that affect the output
+
+        uint32_t n_nodes, n_bones, n_meshes, n_channels;
+        uint64_t n_keys, n_verts, n_indices, n_chars;
+
+        String motion_name;   // the clip, valid if `n_channels` > 0
+        float duration, speed;
+
+        uint64_t nodes, meshes, channels, keys, vertices, indices, chars;  // section offsets
+        uint64_t file_size;
+    };
+
+    struct Node {
+        int32_t nid, pid, bid;
+        String name;
+        float n2p[16];
+        float m2n[16];
+    };
+
+    struct Mesh {
+        uint64_t first_vertex, first_index;  // into the vertex and index blobs
+        uint32_t n_verts, n_indices;         // indices of all levels of detail
+        String matkey;
+        uint32_t n_lods, padding;
+        uint32_t lod_indices[max_lods];      // number of indices of each level, the full mesh first
+        float lod_error[max_lods];
+    };
+
+    struct Channel {
+        String name;
+        uint32_t n_positions, n_rotations, n_scales;
+        uint64_t first_key;  // positions, then rotations, then scales
+    };
+
+    struct Key {
+        float time;
+        float value[4];  // xyz for positions and scales, wxyz for rotations
+    };
+
+    static_assert(sizeof(Header) % 8 == 0 && sizeof(Node) % 4 == 0 && sizeof(Mesh) % 8 == 0);
+
+    // a validated read-only view over a memory-mapped cache file
+    class Reader {
+      private:
+        std::unique_ptr<utils::MappedFile> file;
+        const Header* header = nullptr;
+
+      public:
+        Reader(const std::string& filepath, uint64_t source_hash, uint64_t options);
+
+        bool Valid() const { return header != nullptr; }
+        const Header& GetHeader() const { return *header; }
+
+        const Node* Nodes() const;
+        const Mesh* Meshes() const;
+        const Channel* Channels() const;
+        const Key* Keys() const;
+        const component::Mesh::Vertex* Vertices() const;
+        const GLuint* Indices() const;
+        std::string_view GetString(const String& str) const;
+    };
+
+    // collects the sections in memory and writes them to disk in one go
+    class Writer {
+      private:
+        Header header {};
+        std::vector<Node> nodes;
+        std::vector<Mesh> meshes;
+        std::vector<Channel> channels;
+        std::vector<Key> keys;
+        std::vector<component::Mesh::Vertex> vertices;
+        std::vector<GLuint> indices;
+        std::string chars;
+
+      public:
+        Writer(uint64_t source_hash, uint64_t options, uint32_t vtx_format);
+
+        String AddString(std::string_view str);
+        void AddNode(const Node& node);
+        void AddMesh(const component::Mesh::Vertex* vtx, size_t n_verts, const GLuint* idx, size_t n_indices, std::string_view matkey,
+            const std::vector<component::Mesh::LOD>& lods);
+        void SetMotion(std::string_view name, float duration, float speed);
+        void AddChannel(std::string_view name, const std::vector<Key>& positions, const std::vector<Key>& rotations, const std::vector<Key>& scales);
+
+        bool Save(const std::string& filepath);
+    };
+
+    std::string CachePath(const std::string& source_path, uint64_t options);
+
+}
@@ -8,12 +8,14 @@
 #include "core/debug.h"
 #include "core/event.h"
 #include "core/input.h"
+#include "core/job.h"
 #include "core/log.h"
 #include "core/window.h"
 #include "scene/renderer.h"
 #include "scene/scene.h"
 #include "scene/ui.h"
 #include "utils/path.h"
+#include "utils/profile.h"
 
 using namespace scene;
 
@@ -31,6 +33,10 @@ namespace core {
         this->gl_context_active = false;
         std::cout << "Initializing console logger ...\n" << std::endl;
         Log::Init();
+        utils::CPUProfiler::SetThreadName("Main Thread");
+
+        CORE_INFO("Starting worker threads ...");
+        JobSystem::Init();
 
         CORE_INFO("Searching sources and assets path tree ...");
         utils::paths::SearchPaths();
@@ -132,6 +138,8 @@ namespace core {
     }
 
     void Application::MainEventUpdate() {
+        PROFILE_FRAME();
+        PROFILE_FUNCTION();
         if constexpr (_freeglut) {
             glutMainLoopEvent();
         }
@@ -141,6 +149,7 @@ namespace core {
     }
 
     void Application::PostEventUpdate() {
+        PROFILE_FUNCTION();
         // check if the user has requested to exit
         if (Input::GetKeyDown(VK_ESCAPE)) {
             app_shutdown = Window::OnExitRequest();
@@ -175,6 +184,8 @@ namespace core {
 
         Input::Clear();
         Clock::Reset();
+        utils::GPUProfiler::Clear();
+        JobSystem::Shutdown();
         Window::Clear();
         Log::Shutdown();
     }
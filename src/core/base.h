@@ -67,6 +67,12 @@
     inline constexpr bool _freeglut = false;
 #endif
 
+#ifdef __BENCHMARK__
+    inline constexpr bool bench_mode = true;
+#else
+    inline constexpr bool bench_mode = false;
+#endif
+
 #include <memory>
 
 constexpr auto __APP__ = "sketchpad";
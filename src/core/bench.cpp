@@ -0,0 +1,203 @@
+#include "pch.h"
+
+#include "core/app.h"
+#include "core/bench.h"
+#include "core/clock.h"
+#include "core/log.h"
+#include "scene/factory.h"
+#include "scene/renderer.h"
+#include "utils/path.h"
+#include "utils/profile.h"
+
+using namespace scene;
+
+namespace core {
+
+    using hr_clock = std::chrono::high_resolution_clock;
+
+    static double ElapsedMS(const hr_clock::time_point& since) {
+        return std::chrono::duration<double, std::milli>(hr_clock::now() - since).count();
+    }
+
+    static std::string Escape(const std::string& str) {
+        std::string out;
+        for (char c : str) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    static void WriteReport(const std::string& filepath, const std::vector<Benchmark::Report>& reports,
+        unsigned int n_frames, float timestep)
+    {
+        std::ofstream stream(filepath, std::ios::out | std::ios::trunc);
+
+        if (!stream.is_open()) {
+            CORE_ERROR("Unable to write benchmark report to {0}", filepath);
+            return;
+        }
+
+        const auto& app = Application::GetInstance();
+
+        stream << std::fixed << std::setprecision(4);
+        stream << "{\n";
+        stream << "  \"vendor\": \"" << Escape(app.gl_vendor) << "\",\n";
+        stream << "  \"renderer\": \"" << Escape(app.gl_renderer) << "\",\n";
+        stream << "  \"version\": \"" << Escape(app.gl_version) << "\",\n";
+        stream << "  \"n_frames\": " << n_frames << ",\n";
+        stream << "  \"timestep\": " << timestep << ",\n";
+        stream << "  \"scenes\": [\n";
+
+        for (size_t i = 0; i < reports.size(); i++) {
+            const auto& report = reports[i];
+            double cpu_sum = 0.0, gpu_sum = 0.0;
+
+            for (const auto& frame : report.frames) {
+                cpu_sum += frame.cpu_ms;
+                gpu_sum += frame.gpu_ms;
+            }
+
+            double n = std::max<double>(1.0, static_cast<double>(report.frames.size()));
+
+            stream << "    {\n";
+            stream << "      \"title\": \"" << Escape(report.title) << "\",\n";
+            stream << "      \"load_ms\": " << report.load_ms << ",\n";
+            stream << "      \"avg_cpu_ms\": " << cpu_sum / n << ",\n";
+            stream << "      \"avg_gpu_ms\": " << gpu_sum / n << ",\n";
+            stream << "      \"gpu_passes\": [\n";
+
+            for (size_t j = 0; j < report.passes.size(); j++) {
+                const auto& pass = report.passes[j];
+                stream << "        { \"name\": \"" << Escape(pass.name) << "\""
+                       << ", \"depth\": " << pass.depth
+                       << ", \"avg_ms\": " << pass.total_ms / std::max(1U, pass.n_samples) << " }"
+                       << (j + 1 < report.passes.size() ? ",\n" : "\n");
+            }
+
+            stream << "      ],\n";
+            stream << "      \"frames\": [\n";
+
+            for (size_t j = 0; j < report.frames.size(); j++) {
+                const auto& frame = report.frames[j];
+                stream << "        { \"cpu_ms\": " << frame.cpu_ms
+                       << ", \"gpu_ms\": " << frame.gpu_ms
+                       << ", \"draw_calls\": " << frame.draw_calls
+                       << ", \"dispatches\": " << frame.dispatches << " }"
+                       << (j + 1 < report.frames.size() ? ",\n" : "\n");
+            }
+
+            stream << "      ]\n";
+            stream << "    }" << (i + 1 < reports.size() ? ",\n" : "\n");
+        }
+
+        stream << "  ]\n";
+        stream << "}\n";
+
+        CORE_INFO("Benchmark report has been saved to {0}", filepath);
+    }
+
+    static void Accumulate(std::vector<Benchmark::Pass>& passes) {
+        for (const auto& section : utils::GPUProfiler::results) {
+            auto it = std::find_if(passes.begin(), passes.end(), [&section](const Benchmark::Pass& pass) {
+                return pass.name == section.name && pass.depth == section.depth;
+            });
+
+            if (it == passes.end()) {
+                it = passes.insert(passes.end(), Benchmark::Pass { section.name, section.depth, 0.0, 0 });
+            }
+
+            it->total_ms += section.ms;
+            it->n_samples++;
+        }
+    }
+
+    int Benchmark::Run(int argc, char** argv) {
+        unsigned int n_frames = argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 300U;
+        float timestep = argc > 2 ? std::stof(argv[2]) : 1.0f / 60.0f;
+        std::string output = argc > 3 ? std::string(argv[3]) : utils::paths::root + "sketchpad_bench.json";
+
+        if (n_frames == 0 || timestep <= 0.0f) {
+            CORE_ERROR("Invalid benchmark settings: {0} frames, timestep {1}", n_frames, timestep);
+            return EXIT_FAILURE;
+        }
+
+        CORE_INFO("Running benchmark: {0} frames per scene, fixed timestep {1:.4f}s", n_frames, timestep);
+
+        // GPU timer queries are read back `n_queries` frames late so that we never wait on them
+        constexpr GLuint n_queries = 4;
+        GLuint queries[n_queries] = { 0 };
+        glCreateQueries(GL_TIME_ELAPSED, n_queries, queries);
+
+        auto resolve = [&queries](GLuint frame_index, Frame& frame) {
+            GLuint64 elapsed = 0;  // in nanoseconds
+            glGetQueryObjectui64v(queries[frame_index % n_queries], GL_QUERY_RESULT, &elapsed);
+            frame.gpu_ms = static_cast<double>(elapsed) * 1e-6;
+        };
+
+        std::vector<Report> reports;
+        reports.reserve(factory::titles.size());
+
+        for (const auto& title : factory::titles) {
+            auto& report = reports.emplace_back();
+            report.title = title;
+            report.frames.resize(n_frames);
+
+            Clock::Reset();
+            utils::GPUProfiler::Reset();
+            uint64_t last_resolved = utils::GPUProfiler::results_frame;
+
+            auto load_start = hr_clock::now();
+            Renderer::Attach(title);  // blocking call
+            report.load_ms = ElapsedMS(load_start);
+
+            for (GLuint i = 0; i < n_frames; i++) {
+                if (i >= n_queries) {
+                    resolve(i - n_queries, report.frames[i - n_queries]);  // query is about to be reused
+                }
+
+                auto& frame = report.frames[i];
+                draw_calls = dispatches = 0;
+                Clock::Update(timestep);
+                PROFILE_FRAME();
+
+                auto frame_start = hr_clock::now();
+                glBeginQuery(GL_TIME_ELAPSED, queries[i % n_queries]);
+                Renderer::DrawScene();
+                glEndQuery(GL_TIME_ELAPSED);
+                frame.cpu_ms = ElapsedMS(frame_start);
+
+                frame.draw_calls = draw_calls;
+                frame.dispatches = dispatches;
+                Renderer::Flush();
+
+                // the GPU profiler resolves its sections a few frames late, pick them up once ready
+                if (auto resolved = utils::GPUProfiler::results_frame; resolved != last_resolved) {
+                    Accumulate(report.passes);
+                    last_resolved = resolved;
+                }
+            }
+
+            for (GLuint i = n_frames > n_queries ? n_frames - n_queries : 0; i < n_frames; i++) {
+                resolve(i, report.frames[i]);
+            }
+
+            Renderer::Detach();  // blocking call
+            CORE_INFO("Scene \"{0}\" loaded in {1:.2f} ms", title, report.load_ms);
+        }
+
+        glDeleteQueries(n_queries, queries);
+
+        WriteReport(output, reports, n_frames, timestep);
+
+        // save the CPU timeline next to the report, open it in chrome://tracing or Perfetto
+        auto trace = std::filesystem::path(output);
+        trace.replace_filename(trace.stem().string() + "_trace.json");
+        utils::CPUProfiler::Export(trace.string());
+
+        return EXIT_SUCCESS;
+    }
+
+}
@@ -0,0 +1,77 @@
+/*
+   the benchmark runner is a headless driver of the application that replaces the regular
+   main event loop in the "sketchpad_bench" build target (which defines `__BENCHMARK__`).
+   it loads every scene registered in the factory one after another, renders each of them
+   for a fixed number of frames at a fixed timestep, and writes the per-frame statistics
+   into a JSON report, so that performance changes can be measured in a reproducible way.
+
+   the frame rate displayed in the status bar is sampled every 0.1 second on a wall clock,
+   it's only good for a rough glance. With a fixed timestep, animations, cloth simulation
+   and everything else driven by `Clock` advance exactly the same on every run, no matter
+   how fast or slow the machine is, so two reports are directly comparable, even if they
+   come from a CI box running on a software rasterizer such as Mesa llvmpipe.
+
+   # offscreen context
+
+   in bench mode the main window is created invisible, there's no surfaceless context on
+   Win32 (that's an EGL/Mesa feature), but an invisible window gives us a fully functional
+   default framebuffer of the same size, and nothing ever shows up on the desktop. The UI
+   layer is not drawn, we only call `Init()` and `OnSceneRender()` on each scene.
+
+   # statistics
+
+   - load time: wall time spent in `Renderer::Attach()`, including precomputation
+   - cpu time:  wall time spent by the CPU to record the frame (until `OnSceneRender()` returns)
+   - gpu time:  time elapsed on the GPU for the frame, measured by `GL_TIME_ELAPSED` queries
+   - draw calls & dispatches: number of draw and compute commands issued during the frame
+   - gpu passes: average GPU time of each section recorded by the `GPUProfiler`
+
+   GPU queries are resolved a few frames late from a small ring buffer, so reading them
+   back does not stall the pipeline and skew the CPU timings of the next frame.
+
+   # usage
+
+   > sketchpad_bench.exe [n_frames] [timestep] [output.json]
+   > sketchpad_bench.exe 600 0.0166667 D:\\report.json
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace core {
+
+    class Benchmark {
+      public:
+        struct Frame {
+            double cpu_ms = 0.0;
+            double gpu_ms = 0.0;
+            unsigned int draw_calls = 0;
+            unsigned int dispatches = 0;
+        };
+
+        struct Pass {
+            std::string name;
+            int depth = 0;
+            double total_ms = 0.0;
+            unsigned int n_samples = 0;
+        };
+
+        struct Report {
+            std::string title;
+            double load_ms = 0.0;
+            std::vector<Frame> frames;
+            std::vector<Pass> passes;  // per-pass GPU breakdown, accumulated over resolved frames
+        };
+
+        // per-frame command counters, increment on every draw call or compute dispatch, they are
+        // reported to the CPU profiler and reset at the end of each frame by `Renderer::Flush()`
+        static inline unsigned int draw_calls = 0;
+        static inline unsigned int dispatches = 0;
+
+      public:
+        static int Run(int argc, char** argv);
+    };
+
+}
@@ -40,25 +40,47 @@ namespace core {
 
     #pragma warning(pop)
 
+    void Clock::SetTickRate(double hz, unsigned int max_catch_up) {
+        fixed_delta = 1.0 / std::max(hz, 1.0);
+        max_ticks = std::max(max_catch_up, 1U);
+    }
+
     void Clock::Reset() {
         start_time = std::chrono::system_clock::now();
-        last_frame = this_frame = delta_time = time = 0.0f;
+        last_frame = this_frame = accumulator = 0.0;
+        delta_time = time = 0.0f;
 
         fps = ms = 0.0f;
         frame_count = 0;
-        duration = 0.0f;
+        duration = 0.0;
+        n_frames = 0;
+
+        ticks = 0;
+        tick_count = 0;
+        alpha = 0.0f;
     }
 
     void Clock::Update() {
         if constexpr (_freeglut) {
-            this_frame = glutGet(GLUT_ELAPSED_TIME) / 1000.0f;
+            Tick(glutGet(GLUT_ELAPSED_TIME) / 1000.0);
         }
         else {
-            this_frame = static_cast<float>(glfwGetTime());
+            Tick(glfwGetTime());
         }
-        
-        delta_time = this_frame - last_frame;
+    }
+
+    void Clock::Update(float fixed_step) {
+        // advance by a fixed amount of time regardless of the wall clock (used by the benchmark),
+        // time is derived from the frame count so that rounding errors do not pile up over time
+        n_frames++;
+        Tick(static_cast<double>(n_frames) * fixed_step);
+    }
+
+    void Clock::Tick(double now) {
+        this_frame = now;
+        double delta = this_frame - last_frame;
         last_frame = this_frame;
+        delta_time = static_cast<float>(delta);
 
         // for devices that tick at a fixed interval (e.g. timers and stopwatches), it's easier
         // to work with delta time, but this approach suffers from floating point imprecision.
@@ -71,21 +93,42 @@ namespace core {
         // limited extent. For robustness, we must compare real time to a fixed start timestamp.
 
         if constexpr (true) {
-            time = this_frame;
+            time = static_cast<float>(this_frame);
         }
         else {
             time += delta_time;  // never do this !!! watch out for rounding errors...
         }
 
+        // consume the accumulated frame time in fixed ticks, a tiny tolerance makes sure that
+        // a frame which lasts exactly one tick (e.g. in the benchmark) is never rounded down
+        constexpr double epsilon = 1e-9;
+        accumulator += delta;
+        ticks = 0;
+
+        while (accumulator + epsilon >= fixed_delta && ticks < max_ticks) {
+            accumulator -= fixed_delta;
+            ticks++;
+        }
+
+        // we are too far behind (e.g. after loading a scene or hitting a breakpoint), instead
+        // of catching up over the next frames, drop the backlog and let the simulation slow down
+        if (accumulator >= fixed_delta) {
+            accumulator = std::fmod(accumulator, fixed_delta);
+        }
+
+        accumulator = std::max(accumulator, 0.0);
+        tick_count += ticks;
+        alpha = static_cast<float>(accumulator / fixed_delta);
+
         // compute frames per second
         frame_count++;
-        duration += delta_time;
+        duration += delta;
 
-        if (duration >= 0.1f) {
-            fps = frame_count / duration;
-            ms = 1000.0f * duration / frame_count;
+        if (duration >= 0.1) {
+            fps = static_cast<float>(frame_count / duration);
+            ms = static_cast<float>(1000.0 * duration / frame_count);
             frame_count = 0;
-            duration = 0.0f;
+            duration = 0.0;
         }
     }
 
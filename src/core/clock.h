@@ -1,3 +1,36 @@
+/*
+   the clock keeps track of the time elapsed since the app started, and drives two kinds of
+   updates: the variable step of each rendered frame, and the fixed step of the simulation.
+
+   # variable step
+
+   `delta_time` is the time between the last two frames, it's fine for things that can be
+   evaluated at any point in time, such as camera movement, easing, or skeletal animations
+   that sample keyframes by timestamp. It varies from frame to frame, and so would anything
+   that integrates over it, which is a problem for physics and numerical solvers.
+
+   # fixed step
+
+   simulations are advanced in ticks of exactly `fixed_delta` seconds, the clock accumulates
+   the frame time and consumes it in whole ticks, `ticks` is the number of ticks due in the
+   current frame, which can be 0 on a fast machine, or several on a slow one. To prevent the
+   "spiral of death" (each frame takes longer because it has to catch up more ticks), ticks
+   are capped at `max_ticks` per frame, excess time is discarded and the simulation slows down.
+
+   > for (unsigned int i = 0; i < Clock::ticks; i++) {
+   >     Simulate(Clock::fixed_delta);
+   > }
+
+   what's left in the accumulator is a fraction of a tick, `alpha` is that fraction in [0, 1),
+   it can be used to interpolate between the previous and current states when rendering, so
+   that motion looks smooth even if the tick rate is lower than the frame rate.
+
+   > position = glm::mix(prev_position, curr_position, Clock::alpha);
+
+   internal time is kept in double precision, the public `time` and `delta_time` are floats
+   as they are mostly fed into shaders and glm, which work with single precision anyways.
+*/
+
 #pragma once
 
 #include <chrono>
@@ -9,11 +42,15 @@ namespace core {
       private:
         static std::chrono::time_point<std::chrono::system_clock> start_time;
 
-        static inline float last_frame = 0.0f;
-        static inline float this_frame = 0.0f;
+        static inline double last_frame = 0.0;
+        static inline double this_frame = 0.0;
+        static inline double accumulator = 0.0;  // frame time not yet consumed by fixed ticks
 
         static inline int frame_count = 0;
-        static inline float duration = 0.0f;
+        static inline double duration = 0.0;
+
+        static inline unsigned int n_frames = 0;  // number of frames advanced by a fixed step
+        static void Tick(double now);
 
       public:
         static inline float delta_time = 0.0f;
@@ -22,10 +59,18 @@ namespace core {
         static inline float fps = 0.0f;  // frames per second (sampled every 0.1 second)
         static inline float ms = 0.0f;   // milliseconds per frame
 
+        static inline double fixed_delta = 1.0 / 60.0;  // duration of a simulation tick in seconds
+        static inline unsigned int max_ticks = 4;       // max number of catch-up ticks per frame
+        static inline unsigned int ticks = 0;           // number of ticks due in the current frame
+        static inline uint64_t tick_count = 0;          // total number of ticks since reset
+        static inline float alpha = 0.0f;               // interpolation factor between the last two ticks
+
         static std::string GetDateTimeUTC();
+        static void SetTickRate(double hz, unsigned int max_catch_up = 4);
 
         static void Reset();
         static void Update();
+        static void Update(float fixed_step);
     };
 
 }
@@ -0,0 +1,392 @@
+#include "pch.h"
+
+#include <condition_variable>
+#include <deque>
+#include "core/job.h"
+#include "core/log.h"
+#include "utils/profile.h"
+
+namespace core {
+
+    using JobRef = std::shared_ptr<Job>;
+
+    struct Worker {
+        std::deque<JobRef> jobs;
+        std::mutex mutex;
+    };
+
+    static std::vector<std::unique_ptr<Worker>> workers;
+    static std::vector<std::thread> threads;
+
+    static std::deque<JobRef> main_queue;
+    static std::mutex main_mutex;
+
+    static std::mutex sleep_mutex;
+    static std::condition_variable wake_up;
+    static std::atomic<int> n_queued { 0 };  // number of jobs sitting in the workers' queues
+    static std::atomic<bool> running { false };
+    static std::atomic<unsigned int> next_worker { 0 };
+
+    static std::thread::id main_thread_id = std::this_thread::get_id();
+    static thread_local int worker_index = -1;  // -1 on threads that are not workers
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    static void Execute(const JobRef& job);
+
+    static void Schedule(const JobRef& job) {
+        if (job->main_thread) {
+            std::lock_guard lock(main_mutex);
+            main_queue.push_back(job);
+            return;
+        }
+
+        if (workers.empty()) {
+            Execute(job);  // the job system is not running, execute it right away on this thread
+            return;
+        }
+
+        size_t i = worker_index >= 0 ? worker_index : next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+        if (auto& worker = workers[i]; true) {
+            std::lock_guard lock(worker->mutex);
+            worker->jobs.push_back(job);
+        }
+
+        // touching the sleep mutex makes sure a worker can't miss the notification in between
+        // checking the predicate and going to sleep (the lost wake-up problem)
+        n_queued.fetch_add(1, std::memory_order_release);
+        { std::lock_guard lock(sleep_mutex); }
+        wake_up.notify_one();
+    }
+
+    static JobRef Pop(int self) {
+        // pop from the back of our own queue first
+        if (self >= 0) {
+            auto& worker = workers[self];
+            std::lock_guard lock(worker->mutex);
+
+            if (!worker->jobs.empty()) {
+                JobRef job = std::move(worker->jobs.back());
+                worker->jobs.pop_back();
+                n_queued.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+
+        // then try to steal from the front of other queues
+        size_t n = workers.size();
+        size_t start = static_cast<size_t>(self + 1);
+
+        for (size_t k = 0; k < n; k++) {
+            size_t i = (start + k) % n;
+            if (static_cast<int>(i) == self) {
+                continue;
+            }
+
+            auto& victim = workers[i];
+            std::lock_guard lock(victim->mutex);
+
+            if (!victim->jobs.empty()) {
+                JobRef job = std::move(victim->jobs.front());
+                victim->jobs.pop_front();
+                n_queued.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+
+        return nullptr;
+    }
+
+    static JobRef PopMain() {
+        std::lock_guard lock(main_mutex);
+        if (main_queue.empty()) {
+            return nullptr;
+        }
+
+        JobRef job = std::move(main_queue.front());
+        main_queue.pop_front();
+        return job;
+    }
+
+    static void Finish(const JobRef& job) {
+        std::vector<JobRef> successors;
+        std::exception_ptr error;
+
+        if (std::lock_guard lock(job->mutex); true) {
+            successors.swap(job->successors);
+            error = job->error;
+            job->done.store(true, std::memory_order_release);
+        }
+
+        for (auto& successor : successors) {
+            if (error) {
+                std::lock_guard lock(successor->mutex);
+                if (!successor->error) {
+                    successor->error = error;  // a failed dependency fails all of its successors
+                }
+            }
+
+            if (successor->n_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                Schedule(successor);
+            }
+        }
+    }
+
+    static void Execute(const JobRef& job) {
+        PROFILE_SCOPE("Job");
+
+        // all dependencies have finished, so reading the error without the lock is safe here
+        if (!job->error) {
+            try {
+                job->task();
+            }
+            catch (...) {
+                std::lock_guard lock(job->mutex);
+                job->error = std::current_exception();
+            }
+        }
+
+        job->task = nullptr;  // release the captured resources as early as possible
+        Finish(job);
+    }
+
+    static void WorkerLoop(int index) {
+        worker_index = index;
+        utils::CPUProfiler::SetThreadName("Worker " + std::to_string(index));
+
+        while (true) {
+            if (JobRef job = Pop(index); job != nullptr) {
+                Execute(job);
+                continue;
+            }
+
+            std::unique_lock lock(sleep_mutex);
+            wake_up.wait(lock, [] {
+                return n_queued.load(std::memory_order_acquire) > 0 || !running.load(std::memory_order_acquire);
+            });
+
+            if (!running.load(std::memory_order_acquire) && n_queued.load(std::memory_order_acquire) == 0) {
+                break;
+            }
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    void JobHandle::Wait() const {
+        if (job == nullptr) {
+            return;
+        }
+
+        // instead of blocking, the waiting thread helps to execute other jobs
+        while (!job->done.load(std::memory_order_acquire)) {
+            if (!JobSystem::ExecuteOne()) {
+                std::this_thread::yield();
+            }
+        }
+
+        if (job->error) {
+            std::rethrow_exception(job->error);
+        }
+    }
+
+    JobHandle JobHandle::Then(std::function<void()> task) const {
+        return JobSystem::Enqueue(std::move(task), { *this }, false);
+    }
+
+    JobHandle JobHandle::ThenOnMainThread(std::function<void()> task) const {
+        return JobSystem::Enqueue(std::move(task), { *this }, true);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    void JobSystem::Init(unsigned int n_workers) {
+        CORE_ASERT(workers.empty(), "The job system has already been initialized...");
+
+        // leave one core to the main thread, which also executes jobs while waiting on them
+        if (n_workers == 0) {
+            n_workers = std::max(std::thread::hardware_concurrency(), 2U) - 1;
+        }
+
+        main_thread_id = std::this_thread::get_id();
+        running.store(true, std::memory_order_release);
+
+        for (unsigned int i = 0; i < n_workers; i++) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+
+        for (unsigned int i = 0; i < n_workers; i++) {
+            threads.emplace_back(WorkerLoop, static_cast<int>(i));
+        }
+
+        CORE_INFO("Job system started with {0} worker threads", n_workers);
+    }
+
+    void JobSystem::Shutdown() {
+        if (workers.empty()) {
+            return;
+        }
+
+        // workers finish the jobs that are already queued before they exit
+        if (std::lock_guard lock(sleep_mutex); true) {
+            running.store(false, std::memory_order_release);
+        }
+
+        wake_up.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        threads.clear();
+        workers.clear();
+
+        std::lock_guard lock(main_mutex);
+        main_queue.clear();  // GL work cannot run without a scene, discard it
+    }
+
+    JobHandle JobSystem::Submit(Task task, const std::vector<JobHandle>& deps) {
+        return Enqueue(std::move(task), deps, false);
+    }
+
+    JobHandle JobSystem::SubmitMain(Task task, const std::vector<JobHandle>& deps) {
+        return Enqueue(std::move(task), deps, true);
+    }
+
+    JobHandle JobSystem::Enqueue(Task&& task, const std::vector<JobHandle>& deps, bool main_thread) {
+        auto job = std::make_shared<Job>();
+        job->task = std::move(task);
+        job->main_thread = main_thread;
+
+        // the extra count keeps the job from being scheduled while we are still adding dependencies
+        job->n_pending.store(static_cast<int>(deps.size()) + 1, std::memory_order_relaxed);
+
+        for (const auto& dep : deps) {
+            if (dep.job == nullptr) {
+                job->n_pending.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            std::lock_guard lock(dep.job->mutex);
+
+            if (dep.job->done.load(std::memory_order_acquire)) {
+                if (dep.job->error) {
+                    std::lock_guard job_lock(job->mutex);
+                    job->error = dep.job->error;
+                }
+                job->n_pending.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            else {
+                dep.job->successors.push_back(job);
+            }
+        }
+
+        if (job->n_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            Schedule(job);
+        }
+
+        return JobHandle(job);
+    }
+
+    bool JobSystem::ExecuteOne() {
+        // the main thread gives priority to GL work, since no one else can execute it
+        if (IsMainThread()) {
+            if (JobRef job = PopMain(); job != nullptr) {
+                Execute(job);
+                return true;
+            }
+        }
+
+        if (workers.empty()) {
+            return false;
+        }
+
+        if (JobRef job = Pop(worker_index); job != nullptr) {
+            Execute(job);
+            return true;
+        }
+
+        return false;
+    }
+
+    void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, const Range& body) {
+        if (begin >= end) {
+            return;
+        }
+
+        // by default, split the range into about 4 chunks per thread to balance the load
+        size_t n_threads = workers.size() + 1;
+        if (grain == 0) {
+            grain = std::max<size_t>(1, (end - begin + n_threads * 4 - 1) / (n_threads * 4));
+        }
+
+        size_t n_chunks = (end - begin + grain - 1) / grain;
+
+        if (n_chunks == 1 || workers.empty()) {
+            body(begin, end);
+            return;
+        }
+
+        std::vector<JobHandle> chunks;
+        chunks.reserve(n_chunks - 1);
+
+        for (size_t i = 1; i < n_chunks; i++) {
+            size_t lo = begin + i * grain;
+            size_t hi = std::min(end, lo + grain);
+            chunks.push_back(Submit([&body, lo, hi] { body(lo, hi); }));
+        }
+
+        // the calling thread takes the first chunk, then helps with the rest while waiting,
+        // all chunks must have finished before we return since they reference `body`
+        std::exception_ptr error;
+
+        try {
+            body(begin, std::min(end, begin + grain));
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        for (auto& chunk : chunks) {
+            try {
+                chunk.Wait();
+            }
+            catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void JobSystem::ExecuteMainThreadJobs(double budget_ms) {
+        PROFILE_FUNCTION();
+        CORE_ASERT(IsMainThread(), "Main thread jobs must be executed on the main thread!");
+
+        // at least one job is executed per call, so that progress is made even under a tiny budget
+        auto start = std::chrono::steady_clock::now();
+
+        while (JobRef job = PopMain()) {
+            Execute(job);
+
+            auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+            if (elapsed.count() >= budget_ms) {
+                break;
+            }
+        }
+    }
+
+    bool JobSystem::IsMainThread() {
+        return std::this_thread::get_id() == main_thread_id;
+    }
+
+    unsigned int JobSystem::WorkerCount() {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+}
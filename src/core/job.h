@@ -0,0 +1,97 @@
+/*
+   the job system is a pool of worker threads (one per core, minus the main thread) that runs
+   small tasks in parallel, it's meant for CPU-heavy work such as image decoding, model import
+   or any loop that can be split into independent chunks. OpenGL calls are not allowed on the
+   workers since the context is only current on the main thread, GL work must be sent to the
+   main thread queue instead, which is drained by the renderer at the start of every frame.
+
+   # work stealing
+
+   each worker owns a double-ended queue of jobs, it pushes and pops jobs at the back of its
+   own queue (LIFO, the most recent job is likely still hot in cache), when it runs out of
+   work, it steals from the front of another worker's queue (FIFO, the oldest job is likely
+   the largest one). Jobs submitted from a worker go to that worker's queue, jobs submitted
+   from other threads are distributed round-robin. Idle workers sleep on a condition variable.
+
+   # task graph
+
+   a job can depend on any number of other jobs, it's only scheduled once all of them have
+   finished, so a set of jobs forms a directed acyclic graph, `Then()` is a shortcut for a
+   job with a single dependency (a continuation). Every job is referred to by a `JobHandle`,
+   which can be waited on, a thread that waits is not idle, it keeps executing other jobs
+   (the main thread also executes main thread jobs), so waiting inside a job never deadlocks.
+
+   > auto decode = JobSystem::Submit([&] { image = utils::Image(path); });
+   > auto upload = decode.ThenOnMainThread([&] { texture = MakeAsset<Texture>(image); });
+   > upload.Wait();
+
+   > JobSystem::ParallelFor(0, n_pixels, 4096, [&](size_t begin, size_t end) { ... });
+
+   if a job throws, the exception is stored in the job and passed on to its successors, which
+   are skipped, `Wait()` rethrows it on the waiting thread.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace core {
+
+    struct Job {
+        std::function<void()> task;
+        bool main_thread = false;
+        std::atomic<int> n_pending { 0 };  // number of dependencies that have not finished yet
+        std::atomic<bool> done { false };
+
+        std::mutex mutex;  // guards the fields below
+        std::vector<std::shared_ptr<Job>> successors;
+        std::exception_ptr error;
+    };
+
+    class JobHandle {
+      private:
+        std::shared_ptr<Job> job;
+        friend class JobSystem;
+
+      public:
+        JobHandle() = default;
+        explicit JobHandle(const std::shared_ptr<Job>& job) : job(job) {}
+
+        bool Valid() const { return job != nullptr; }
+        bool Done() const { return job == nullptr || job->done.load(std::memory_order_acquire); }
+
+        void Wait() const;
+        JobHandle Then(std::function<void()> task) const;
+        JobHandle ThenOnMainThread(std::function<void()> task) const;
+    };
+
+    class JobSystem {
+      public:
+        using Task = std::function<void()>;
+        using Range = std::function<void(size_t begin, size_t end)>;
+
+        static inline double main_thread_budget = 2.0;  // max milliseconds per frame spent on main thread jobs
+
+        static void Init(unsigned int n_workers = 0);
+        static void Shutdown();
+
+        static JobHandle Submit(Task task, const std::vector<JobHandle>& deps = {});
+        static JobHandle SubmitMain(Task task, const std::vector<JobHandle>& deps = {});
+        static void ParallelFor(size_t begin, size_t end, size_t grain, const Range& body);
+        static void ExecuteMainThreadJobs(double budget_ms);
+
+        static bool IsMainThread();
+        static unsigned int WorkerCount();
+
+      private:
+        static JobHandle Enqueue(Task&& task, const std::vector<JobHandle>& deps, bool main_thread);
+        static bool ExecuteOne();
+        friend class JobHandle;
+    };
+
+}
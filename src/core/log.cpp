@@ -1,7 +1,10 @@
 #include "pch.h"
 
+#include <spdlog/async.h>
+#include <spdlog/sinks/dup_filter_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include "core/log.h"
+#include "utils/profile.h"
 
 namespace core {
 
@@ -14,7 +17,7 @@ namespace core {
     std::shared_ptr<spdlog::logger> Log::logger;
 
     /* the logger expects a vector of shared pointers to sinks, so the steps are:
-      
+
        [1] make a std::vector to store the pointers
        [2] emplace back sink pointers to the vector
        [3] for each individual sink in the vector, set format and level (or use default)
@@ -26,6 +29,14 @@ namespace core {
            pointer type of the derived sink class that supports these functions, otherwise
            `sinks[i]` will fallback to the base sink type, which does not have the methods you
            want unless you manually cast them to the right pointer types.
+
+       [*] the console sink is wrapped in a duplicate filter, which swallows a message if it's
+           identical to the previous one and less than `max_skip_duration` have passed, the
+           filter is a distributing sink, the pattern set on it is forwarded to the sub-sinks.
+
+       [*] in async mode, the logger pushes messages into the queue of a global thread pool,
+           which must be created before the logger, the pool's only worker thread does the
+           actual formatting and writing, `overrun_oldest` drops messages instead of blocking.
     */
 
     void Log::Init() {
@@ -33,18 +44,54 @@ namespace core {
 
         std::vector<wincolor_sink_ptr> sinks;  // pointers to sinks that support setting custom color
         sinks.emplace_back(std::make_shared<spdlog::sinks::stdout_color_sink_mt>());  // console sink
-        sinks[0]->set_pattern("%^%T > [%L] %v%$");  // e.g. 23:55:59 > [I] sample message
         sinks[0]->set_color(spdlog::level::trace, sinks[0]->CYAN);
         sinks[0]->set_color(spdlog::level::debug, sinks[0]->BOLD);
 
-        logger = std::make_shared<spdlog::logger>("sketchpad", begin(sinks), end(sinks));
+        auto dup_filter = std::make_shared<spdlog::sinks::dup_filter_sink_mt>(std::chrono::seconds(5));
+        dup_filter->add_sink(sinks[0]);
+        dup_filter->set_pattern("%^%T > [%L] %v%$");  // e.g. 23:55:59 > [I] sample message
+
+        if constexpr (async) {
+            spdlog::init_thread_pool(queue_size, 1, [] { utils::CPUProfiler::SetThreadName("Log Thread"); });
+            logger = std::make_shared<spdlog::async_logger>("sketchpad", dup_filter, spdlog::thread_pool(),
+                spdlog::async_overflow_policy::overrun_oldest);
+        }
+        else {
+            logger = std::make_shared<spdlog::logger>("sketchpad", dup_filter);
+        }
+
         spdlog::register_logger(logger);
-        logger->set_level(spdlog::level::trace);  // log level less than this will be silently ignored
-        logger->flush_on(spdlog::level::trace);   // the minimum log level that will trigger automatic flush
+        logger->set_level(static_cast<spdlog::level::level_enum>(SP_LOG_LEVEL));  // lower levels are ignored
+
+        if constexpr (async) {
+            logger->flush_on(spdlog::level::err);    // errors are flushed right away, the rest in batches
+            spdlog::flush_every(std::chrono::seconds(1));
+        }
+        else {
+            logger->flush_on(spdlog::level::trace);  // the minimum log level that will trigger automatic flush
+        }
+    }
+
+    bool Log::Throttle(std::atomic<int64_t>& next_ns, double seconds) {
+        using namespace std::chrono;
+        int64_t now = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        int64_t next = next_ns.load(std::memory_order_relaxed);
+
+        if (now < next) {
+            return false;
+        }
+
+        // if multiple threads pass the check at the same time, only the one who wins the race logs
+        int64_t interval = static_cast<int64_t>(seconds * 1e9);
+        return next_ns.compare_exchange_strong(next, now + interval, std::memory_order_relaxed);
+    }
+
+    void Log::Flush() {
+        logger->flush();
     }
 
     void Log::Shutdown() {
-        spdlog::shutdown();
+        spdlog::shutdown();  // flush the pending messages and join the background thread
     }
 
-}
\ No newline at end of file
+}
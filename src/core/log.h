@@ -1,14 +1,97 @@
+/*
+   the console logger is a thin wrapper around "spdlog", it comes in two flavors that are
+   selected at compile time based on the build configuration:
+
+   # synchronous mode (debug build)
+
+   every log call formats the message and writes it to the console on the calling thread,
+   the logger is flushed on every message, so nothing is lost when we hit a breakpoint or an
+   assertion, or when the app crashes. This is what we want while debugging, but a console
+   write is a blocking system call which costs tens of microseconds, sometimes much more.
+
+   # asynchronous mode (release and benchmark build)
+
+   log calls only push the message into a bounded queue, the formatting and writing happens
+   on a dedicated background thread. When the queue is full, the oldest message is dropped,
+   so a burst of logs (e.g. shader compilation, uniform parsing or the model import report)
+   never blocks the render thread. The backend is flushed periodically and on every error.
+
+   # compile-time level
+
+   `SP_LOG_LEVEL` is the minimum level that is compiled in, log calls below this level are
+   stripped out by the preprocessor entirely, so their arguments are not even evaluated. It
+   can be overridden at the build system's level, e.g. the benchmark build only keeps `info`.
+
+   # rate limiting
+
+   a log call inside the render loop is executed on every frame and would flood the console,
+   such call sites should use the rate-limited variants, the state is kept per call site.
+
+   > CORE_WARN_ONCE("...");            // only logs the first time this line is hit
+   > CORE_WARN_EVERY(1.0, "...");      // logs at most once per second at this call site
+
+   besides, identical consecutive messages are also deduplicated by the sink, which prints
+   a single "skipped n duplicate messages" line in place of the repeated ones.
+*/
+
 #pragma once
 
+#include <atomic>
 #include <spdlog/spdlog.h>
 #include "core/base.h"
 
-#define CORE_INFO(...)  ::core::Log::GetLogger()->info(__VA_ARGS__)
-#define CORE_WARN(...)  ::core::Log::GetLogger()->warn(__VA_ARGS__)
-#define CORE_DEBUG(...) ::core::Log::GetLogger()->debug(__VA_ARGS__)
-#define CORE_TRACE(...) ::core::Log::GetLogger()->trace(__VA_ARGS__)
+// log levels follow spdlog: 0 = trace, 1 = debug, 2 = info, 3 = warn, 4 = error, 5 = critical
+#ifndef SP_LOG_LEVEL
+    #define SP_LOG_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+
+#if SP_LOG_LEVEL <= SPDLOG_LEVEL_TRACE
+    #define CORE_TRACE(...) ::core::Log::GetLogger()->trace(__VA_ARGS__)
+#else
+    #define CORE_TRACE(...) (void)0
+#endif
+
+#if SP_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+    #define CORE_DEBUG(...) ::core::Log::GetLogger()->debug(__VA_ARGS__)
+#else
+    #define CORE_DEBUG(...) (void)0
+#endif
+
+#if SP_LOG_LEVEL <= SPDLOG_LEVEL_INFO
+    #define CORE_INFO(...) ::core::Log::GetLogger()->info(__VA_ARGS__)
+#else
+    #define CORE_INFO(...) (void)0
+#endif
+
+#if SP_LOG_LEVEL <= SPDLOG_LEVEL_WARN
+    #define CORE_WARN(...) ::core::Log::GetLogger()->warn(__VA_ARGS__)
+#else
+    #define CORE_WARN(...) (void)0
+#endif
+
 #define CORE_ERROR(...) ::core::Log::GetLogger()->error(__VA_ARGS__)
 
+// per call site rate limiters, `_SP_LOG_ONCE` logs only once, `_SP_LOG_EVERY` at most once per `seconds`
+#define _SP_LOG_ONCE(log, ...) do { \
+    static std::atomic_flag _sp_logged = ATOMIC_FLAG_INIT; \
+    if (!_sp_logged.test_and_set(std::memory_order_relaxed)) { log(__VA_ARGS__); } } while (0)
+
+#define _SP_LOG_EVERY(seconds, log, ...) do { \
+    static std::atomic<int64_t> _sp_next_ns { 0 }; \
+    if (::core::Log::Throttle(_sp_next_ns, seconds)) { log(__VA_ARGS__); } } while (0)
+
+#define CORE_INFO_ONCE(...)  _SP_LOG_ONCE(CORE_INFO, __VA_ARGS__)
+#define CORE_WARN_ONCE(...)  _SP_LOG_ONCE(CORE_WARN, __VA_ARGS__)
+#define CORE_DEBUG_ONCE(...) _SP_LOG_ONCE(CORE_DEBUG, __VA_ARGS__)
+#define CORE_TRACE_ONCE(...) _SP_LOG_ONCE(CORE_TRACE, __VA_ARGS__)
+#define CORE_ERROR_ONCE(...) _SP_LOG_ONCE(CORE_ERROR, __VA_ARGS__)
+
+#define CORE_INFO_EVERY(seconds, ...)  _SP_LOG_EVERY(seconds, CORE_INFO, __VA_ARGS__)
+#define CORE_WARN_EVERY(seconds, ...)  _SP_LOG_EVERY(seconds, CORE_WARN, __VA_ARGS__)
+#define CORE_DEBUG_EVERY(seconds, ...) _SP_LOG_EVERY(seconds, CORE_DEBUG, __VA_ARGS__)
+#define CORE_TRACE_EVERY(seconds, ...) _SP_LOG_EVERY(seconds, CORE_TRACE, __VA_ARGS__)
+#define CORE_ERROR_EVERY(seconds, ...) _SP_LOG_EVERY(seconds, CORE_ERROR, __VA_ARGS__)
+
 // exceptions, error handling and varying levels of logging is part of the app's normal workflow
 // assertions however, must hold in any correct release build, they only apply to the debug mode
 
@@ -25,10 +108,17 @@ namespace core {
         static std::shared_ptr<spdlog::logger> logger;
 
       public:
-        static std::shared_ptr<spdlog::logger> GetLogger() { return logger; }
+        // async logging in release builds, in debug mode every message is written and flushed immediately
+        static constexpr bool async = !debug_mode;
+        static constexpr size_t queue_size = 8192;  // max number of pending messages in async mode
+
+        // return by reference, copying a shared pointer on every log call costs an atomic increment
+        static const std::shared_ptr<spdlog::logger>& GetLogger() { return logger; }
+        static bool Throttle(std::atomic<int64_t>& next_ns, double seconds);
 
       public:
         static void Init();
+        static void Flush();
         static void Shutdown();
     };
 
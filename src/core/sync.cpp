@@ -2,6 +2,7 @@
 
 #include "core/log.h"
 #include "core/sync.h"
+#include "utils/profile.h"
 
 namespace core {
 
@@ -99,4 +100,73 @@ namespace core {
         glFinish();  // wait until all commands issued so far are fully executed by the GPU
     }
 
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    void FrameSync::Wait(GLsync& fence) {
+        if (fence == nullptr) {
+            return;
+        }
+
+        // block with a long timeout rather than polling, the first call flushes the fence
+        constexpr GLuint64 timeout = static_cast<GLuint64>(1e8);  // 100 ms
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+
+        bool warned = false;
+        GLuint64 wait_time = timeout;
+
+        while (status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(fence, 0, timeout);
+            wait_time += timeout;
+
+            if (!warned && wait_time > warn_threshold) {
+                CORE_WARN("Frame fence has been hanging for over 10 secs on the client!");
+                warned = true;
+            }
+        }
+
+        if (status == GL_WAIT_FAILED) {
+            CORE_ERROR("An error occurred while waiting on the frame fence");
+        }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    void FrameSync::BeginFrame() {
+        // if the CPU is `n_frames` ahead, this is where it waits for the GPU to catch up
+        PROFILE_SCOPE("FrameSync::Wait");
+        Wait(fences[Index()]);
+    }
+
+    void FrameSync::EndFrame() {
+        GLsync& fence = fences[Index()];
+        if (fence != nullptr) {
+            glDeleteSync(fence);  // `BeginFrame()` was skipped this frame, the old fence is stale
+        }
+
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        CORE_ASERT(fence != nullptr, "Unable to create a frame fence sync object");
+        frame++;
+    }
+
+    void FrameSync::WaitFrame(uint64_t frame_count) {
+        // wait until the GPU has finished the commands of the given frame (as numbered by `FrameCount()`)
+        if (frame_count >= frame) {
+            WaitIdle();  // the frame is still being recorded, so we have to wait on everything
+        }
+        else if (frame_count + n_frames > frame) {
+            Wait(fences[frame_count % n_frames]);  // o/w the frame is older and has already completed
+        }
+    }
+
+    void FrameSync::WaitIdle() {
+        // wait on every frame in flight, oldest first, then on the commands issued since then
+        for (GLuint i = 0; i < n_frames; i++) {
+            Wait(fences[(Index() + i) % n_frames]);
+        }
+
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        Wait(fence);
+    }
+
 }
@@ -1,5 +1,30 @@
+/*
+   a sync object is a fence inserted into the GPU's command stream, it becomes signaled once
+   all the commands issued before it have been fully executed, so the CPU can block on it or
+   poll its status, which is a more fine-grained alternative to `glFinish()`.
+
+   # frames in flight
+
+   the CPU and the GPU run asynchronously, while the GPU is executing frame N, the CPU should
+   already be recording frame N + 1, so that the two overlap and the frame time is the max of
+   the two rather than the sum. The catch is that the CPU must not get too far ahead, or the
+   latency grows without bound, and any buffer it writes on a per-frame basis could still be
+   in use by the GPU, in which case the write either corrupts the data or stalls the driver.
+
+   `FrameSync` is a ring of `n_frames` fences, one is inserted at the end of each frame, at
+   the beginning of frame N, the CPU only waits on the fence of frame N - `n_frames`, which
+   has most likely been signaled long ago, so the wait is free unless the GPU is the bottleneck.
+   Per-frame dynamic buffers are partitioned into `n_frames` regions, frame N only writes to
+   region N % `n_frames`, which the fence guarantees is no longer read by the GPU.
+
+   > FrameSync::BeginFrame();  // may block until region `FrameSync::Index()` is free
+   > ...
+   > FrameSync::EndFrame();    // before the buffer swap
+*/
+
 #pragma once
 
+#include <array>
 #include <glad/glad.h>
 
 namespace core {
@@ -19,7 +44,7 @@ namespace core {
         Sync& operator=(Sync&& other) = delete;
 
         bool Signaled();
-        void ClientWaitSync(GLuint64 timeout = 1e5);  // 0.1 ms
+        void ClientWaitSync(GLuint64 timeout = 1e8);  // 100 ms
         void ServerWaitSync();
 
         static GLint64 GetServerTimeout();
@@ -27,4 +52,23 @@ namespace core {
         static void WaitFinish();
     };
 
-}
\ No newline at end of file
+    class FrameSync {
+      public:
+        static constexpr GLuint n_frames = 3;  // max number of frames the CPU can record ahead of the GPU
+
+      private:
+        static inline std::array<GLsync, n_frames> fences {};
+        static inline uint64_t frame = 0;  // number of frames ended so far
+        static void Wait(GLsync& fence);
+
+      public:
+        static GLuint Index() { return static_cast<GLuint>(frame % n_frames); }
+        static uint64_t FrameCount() { return frame; }
+
+        static void BeginFrame();
+        static void EndFrame();
+        static void WaitFrame(uint64_t frame_count);
+        static void WaitIdle();
+    };
+
+}
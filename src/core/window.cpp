@@ -54,6 +54,11 @@ namespace core {
                 glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);  // hint the debug context
             }
 
+            if constexpr (bench_mode) {
+                glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);  // offscreen, the default framebuffer still exists
+                glfwWindowHint(GLFW_FOCUSED, GLFW_FALSE);
+            }
+
             window_ptr = glfwCreateWindow(width, height, title.c_str(), NULL, NULL);
             CORE_ASERT(window_ptr != nullptr, "Failed to create the main window...");
             CORE_INFO("Window resolution is set to {0}x{1} ...", width, height);
@@ -10,9 +10,11 @@
 #include "component/all.h"
 #include "scene/renderer.h"
 #include "scene/ui.h"
+#include "utils/bcn.h"
 #include "utils/ext.h"
 #include "utils/math.h"
 #include "utils/path.h"
+#include "utils/profile.h"
 #include "example/scene_01.h"
 
 using namespace core;
@@ -59,7 +61,33 @@ namespace scene {
     // this is called before the first frame, use this function to initialize your scene
     void Scene01::Init() {
         this->title = "Tiled Forward Renderer";
-        PrecomputeIBL(paths::texture + "HDRI\\cosmic\\");
+
+        // kick off the heavy file I/O first, so that the workers decode in the background while
+        // the main thread is busy precomputing IBL and compiling shaders, material textures are
+        // block-compressed, the encoding only happens once and is cached on disk afterwards, only
+        // their tail mips are uploaded here, the finer levels are streamed in as the camera moves
+        if (std::string tex_path = paths::model + "runestone\\"; true) {
+            resource_manager.LoadModel(20, tex_path + "runestone.fbx", Quality::Auto);
+            resource_manager.LoadTexture(21, tex_path + "pillars_albedo.png", bcn::Format::BC7, true);
+            resource_manager.LoadTexture(22, tex_path + "pillars_normal.png", bcn::Format::BC5, true);
+            resource_manager.LoadTexture(23, tex_path + "pillars_metallic.png", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(24, tex_path + "pillars_roughness.png", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(25, tex_path + "platform_albedo.png", bcn::Format::BC7, true);
+            resource_manager.LoadTexture(26, tex_path + "platform_normal.png", bcn::Format::BC5, true);
+            resource_manager.LoadTexture(27, tex_path + "platform_metallic.png", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(28, tex_path + "platform_roughness.png", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(29, tex_path + "platform_emissive.png", bcn::Format::BC7, true);
+            resource_manager.LoadTexture(30, paths::texture + "common\\checkboard.png");
+        }
+
+        Renderer::SeamlessCubemap(true);
+        Renderer::DepthTest(false);
+        Renderer::FaceCulling(true);
+
+        auto ibl = IBLBaker::Bake(paths::texture + "HDRI\\cosmic\\");
+        irradiance_map  = ibl.irradiance_map;
+        prefiltered_map = ibl.prefiltered_map;
+        BRDF_LUT        = ibl.BRDF_LUT;
 
         resource_manager.Add(-1, MakeAsset<Mesh>(Primitive::Sphere));
         resource_manager.Add(01, MakeAsset<Shader>(paths::shader + "core\\infinite_grid.glsl"));
@@ -75,6 +103,8 @@ namespace scene {
         resource_manager.Add(98, MakeAsset<Sampler>(FilterMode::Point));
         resource_manager.Add(99, MakeAsset<Sampler>(FilterMode::Bilinear));
 
+        resource_manager.Wait();  // block until the model and textures are uploaded
+
         // check errors periodically in case the built-in debug message callback fails
         Debug::CheckGLError(0);  // checkpoint 0
 
@@ -132,8 +162,7 @@ namespace scene {
         runestone.GetComponent<Transform>().Scale(0.02f);
         runestone.GetComponent<Transform>().Translate(world::down * 4.0f);
 
-        if (std::string model_path = paths::model + "runestone\\runestone.fbx"; true) {
-            auto& model = runestone.AddComponent<Model>(model_path, Quality::Auto);
+        if (auto& model = runestone.AddComponent<Model>(resource_manager.Get<Model>(20)); true) {
             SetupMaterial(model.SetMaterial("pillars",  resource_manager.Get<Material>(14)), 31);
             SetupMaterial(model.SetMaterial("platform", resource_manager.Get<Material>(14)), 32);
         }
@@ -204,6 +233,7 @@ namespace scene {
         Renderer::FaceCulling(true);
         Renderer::AlphaBlend(false);
         Renderer::SeamlessCubemap(true);
+        Renderer::ClusterCulling(true, true);  // occlusion culling against the depth prepass
     }
 
     // this is called every frame, update your scene here and submit entities to the renderer
@@ -263,6 +293,7 @@ namespace scene {
 
         // ------------------------------ depth prepass ------------------------------
 
+        GPUProfiler::Push("Depth Prepass");
         framebuffer_0.Bind();
         framebuffer_0.Clear(-1);
 
@@ -275,6 +306,7 @@ namespace scene {
         Renderer::Submit(skybox.id);
         Renderer::Render();
         Renderer::DepthPrepass(false);
+        Renderer::BuildDepthPyramid(framebuffer_0.GetDepthTexture());
 
         if (draw_depth_buffer) {  // visualize the depth buffer and return early
             Renderer::DepthTest(false);
@@ -283,9 +315,11 @@ namespace scene {
             framebuffer_0.Draw(-1);
             return;
         }
+        GPUProfiler::Pop();
 
         // ------------------------------ dispatch light culling ------------------------------
 
+        GPUProfiler::Push("Light Culling");
         framebuffer_0.GetDepthTexture().Bind(0);
         pl_index->Clear();
 
@@ -301,9 +335,11 @@ namespace scene {
         cull_shader->Dispatch(nx, ny, 1);
         cull_shader->SyncWait();
         cull_shader->Unbind();
+        GPUProfiler::Pop();
 
         // ------------------------------ MRT render pass ------------------------------
 
+        GPUProfiler::Push("MRT Pass");
         // this is the actual shading pass after light culling, now that we know the indices of all
         // visible lights that will contribute to each tile we no longer need to loop through every
         // light in the fragment shader. In this pass, we still have the geometry data of entities
@@ -328,15 +364,19 @@ namespace scene {
         Renderer::Render();
 
         framebuffer_1.Unbind();
+        GPUProfiler::Pop();
 
         // ------------------------------ MSAA resolve pass ------------------------------
 
+        GPUProfiler::Push("MSAA Resolve");
         framebuffer_2.Clear();
         FBO::CopyColor(framebuffer_1, 0, framebuffer_2, 0);
         FBO::CopyColor(framebuffer_1, 1, framebuffer_2, 1);
+        GPUProfiler::Pop();
 
         // ------------------------------ apply Gaussian blur ------------------------------
 
+        GPUProfiler::Push("Bloom");
         FBO::CopyColor(framebuffer_2, 1, framebuffer_3, 0);  // downsample the bloom target (nearest filtering)
         auto& ping = framebuffer_3.GetColorTexture(0);
         auto& pong = framebuffer_3.GetColorTexture(1);
@@ -351,9 +391,11 @@ namespace scene {
             bloom_shader->Dispatch(ping.width / 32, ping.width / 18);
             bloom_shader->SyncWait(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
         }
+        GPUProfiler::Pop();
 
         // ------------------------------ postprocessing pass ------------------------------
 
+        GPUProfiler::Push("Postprocess");
         framebuffer_2.GetColorTexture(0).Bind(0);  // color texture
         framebuffer_3.GetColorTexture(0).Bind(1);  // bloom texture
 
@@ -369,6 +411,7 @@ namespace scene {
 
         postprocess_shader->Unbind();
         bilinear_sampler->Unbind(1);
+        GPUProfiler::Pop();
     }
 
     // this is called every frame, update your ImGui widgets here to control entities in the scene
@@ -495,66 +538,6 @@ namespace scene {
         }
     }
 
-    void Scene01::PrecomputeIBL(const std::string& hdri) {
-        Renderer::SeamlessCubemap(true);
-        Renderer::DepthTest(false);
-        Renderer::FaceCulling(true);
-
-        auto irradiance_shader = CShader(paths::shader + "core\\irradiance_map.glsl");
-        auto prefilter_shader  = CShader(paths::shader + "core\\prefilter_envmap.glsl");
-        auto envBRDF_shader    = CShader(paths::shader + "core\\environment_BRDF.glsl");
-
-        auto env_map = MakeAsset<Texture>(hdri, ".hdr", 2048, 0);
-        env_map->Bind(0);
-
-        irradiance_map  = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, 128, 128, 6, GL_RGBA16F, 1);
-        prefiltered_map = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, 2048, 2048, 6, GL_RGBA16F, 8);
-        BRDF_LUT        = MakeAsset<Texture>(GL_TEXTURE_2D, 1024, 1024, 1, GL_RGBA16F, 1);
-
-        CORE_INFO("Precomputing diffuse irradiance map from {0}", hdri);
-        irradiance_map->BindILS(0, 0, GL_WRITE_ONLY);
-
-        if (irradiance_shader.Bind(); true) {
-            irradiance_shader.Dispatch(128 / 32, 128 / 32, 6);
-            irradiance_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
-
-            auto irradiance_fence = Sync(0);
-            irradiance_fence.ClientWaitSync();
-            irradiance_map->UnbindILS(0);
-        }
-
-        CORE_INFO("Precomputing specular prefiltered envmap from {0}", hdri);
-        Texture::Copy(*env_map, 0, *prefiltered_map, 0);  // copy the base level
-
-        const GLuint max_level = prefiltered_map->n_levels - 1;
-        GLuint resolution = prefiltered_map->width / 2;
-        prefilter_shader.Bind();
-
-        for (unsigned int level = 1; level <= max_level; level++, resolution /= 2) {
-            float roughness = level / static_cast<float>(max_level);
-            GLuint n_groups = glm::max<GLuint>(resolution / 32, 1);
-
-            prefiltered_map->BindILS(level, 1, GL_WRITE_ONLY);
-            prefilter_shader.SetUniform(0, roughness);
-            prefilter_shader.Dispatch(n_groups, n_groups, 6);
-            prefilter_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
-
-            auto prefilter_fence = Sync(level);
-            prefilter_fence.ClientWaitSync();
-            prefiltered_map->UnbindILS(1);
-        }
-
-        CORE_INFO("Precomputing specular environment BRDF from {0}", hdri);
-        BRDF_LUT->BindILS(0, 2, GL_WRITE_ONLY);
-
-        if (envBRDF_shader.Bind(); true) {
-            envBRDF_shader.Dispatch(1024 / 32, 1024 / 32, 1);
-            envBRDF_shader.SyncWait(GL_ALL_BARRIER_BITS);
-            Sync::WaitFinish();
-            BRDF_LUT->UnbindILS(2);
-        }
-    }
-
     void Scene01::SetupMaterial(Material& pbr_mat, int mat_id) {
         pbr_mat.SetTexture(pbr_t::irradiance_map, irradiance_map);
         pbr_mat.SetTexture(pbr_t::prefiltered_map, prefiltered_map);
@@ -567,25 +550,23 @@ namespace scene {
             pbr_mat.BindUniform(pbr_u::ao, &sphere_ao);
         }
         else if (mat_id == 2) {  // plane
-            pbr_mat.SetTexture(pbr_t::albedo, MakeAsset<Texture>(paths::texture + "common\\checkboard.png"));
+            pbr_mat.SetTexture(pbr_t::albedo, resource_manager.Get<Texture>(30));
             pbr_mat.SetUniform(pbr_u::metalness, 0.1f);
             pbr_mat.BindUniform(pbr_u::roughness, &plane_roughness);
             pbr_mat.SetUniform(pbr_u::uv_scale, vec2(8.0f));
         }
         else if (mat_id == 31) {  // runestone pillars
-            std::string tex_path = paths::model + "runestone\\";
-            pbr_mat.SetTexture(pbr_t::albedo,    MakeAsset<Texture>(tex_path + "pillars_albedo.png"));
-            pbr_mat.SetTexture(pbr_t::normal,    MakeAsset<Texture>(tex_path + "pillars_normal.png"));
-            pbr_mat.SetTexture(pbr_t::metallic,  MakeAsset<Texture>(tex_path + "pillars_metallic.png"));
-            pbr_mat.SetTexture(pbr_t::roughness, MakeAsset<Texture>(tex_path + "pillars_roughness.png"));
+            pbr_mat.SetTexture(pbr_t::albedo,    resource_manager.Get<Texture>(21));
+            pbr_mat.SetTexture(pbr_t::normal,    resource_manager.Get<Texture>(22));
+            pbr_mat.SetTexture(pbr_t::metallic,  resource_manager.Get<Texture>(23));
+            pbr_mat.SetTexture(pbr_t::roughness, resource_manager.Get<Texture>(24));
         }
         else if (mat_id == 32) {  // runestone platform
-            std::string tex_path = paths::model + "runestone\\";
-            pbr_mat.SetTexture(pbr_t::albedo,    MakeAsset<Texture>(tex_path + "platform_albedo.png"));
-            pbr_mat.SetTexture(pbr_t::normal,    MakeAsset<Texture>(tex_path + "platform_normal.png"));
-            pbr_mat.SetTexture(pbr_t::metallic,  MakeAsset<Texture>(tex_path + "platform_metallic.png"));
-            pbr_mat.SetTexture(pbr_t::roughness, MakeAsset<Texture>(tex_path + "platform_roughness.png"));
-            pbr_mat.SetTexture(pbr_t::emission,  MakeAsset<Texture>(tex_path + "platform_emissive.png"));
+            pbr_mat.SetTexture(pbr_t::albedo,    resource_manager.Get<Texture>(25));
+            pbr_mat.SetTexture(pbr_t::normal,    resource_manager.Get<Texture>(26));
+            pbr_mat.SetTexture(pbr_t::metallic,  resource_manager.Get<Texture>(27));
+            pbr_mat.SetTexture(pbr_t::roughness, resource_manager.Get<Texture>(28));
+            pbr_mat.SetTexture(pbr_t::emission,  resource_manager.Get<Texture>(29));
         }
     }
 
@@ -13,6 +13,7 @@
 #include "utils/ext.h"
 #include "utils/math.h"
 #include "utils/path.h"
+#include "utils/profile.h"
 #include "example/scene_02.h"
 
 using namespace core;
@@ -50,7 +51,15 @@ namespace scene {
 
     void Scene02::Init() {
         this->title = "Environment Lighting (IBL)";
-        PrecomputeIBL(paths::texture + "HDRI\\Field-Path-Steinbacher-Street-4K2.hdr");
+        Renderer::SeamlessCubemap(true);
+        Renderer::DepthTest(false);
+        Renderer::FaceCulling(true);
+
+        auto ibl = IBLBaker::Bake(paths::texture + "HDRI\\Field-Path-Steinbacher-Street-4K2.hdr", true);
+        irradiance_map  = ibl.irradiance_map;
+        prefiltered_map = ibl.prefiltered_map;
+        BRDF_LUT        = ibl.BRDF_LUT;
+        irradiance_sh   = ibl.irradiance_sh;
 
         resource_manager.Add(-1, MakeAsset<Mesh>(Primitive::Sphere));
         resource_manager.Add(-2, MakeAsset<Mesh>(Primitive::Cube));
@@ -161,6 +170,7 @@ namespace scene {
         Renderer::DepthTest(true);
         Renderer::AlphaBlend(true);
         Renderer::FaceCulling(true);
+        Renderer::ClusterCulling(true);  // cull the meshlets of the motorbike on the GPU
     }
 
     void Scene02::OnSceneRender() {
@@ -191,6 +201,7 @@ namespace scene {
 
         // ------------------------------ MRT render pass ------------------------------
 
+        GPUProfiler::Push("MRT Pass");
         framebuffer_0.Clear();
         framebuffer_0.Bind();
 
@@ -204,15 +215,19 @@ namespace scene {
         Renderer::Render();
 
         framebuffer_0.Unbind();
+        GPUProfiler::Pop();
 
         // ------------------------------ MSAA resolve pass ------------------------------
 
+        GPUProfiler::Push("MSAA Resolve");
         framebuffer_1.Clear();
         FBO::CopyColor(framebuffer_0, 0, framebuffer_1, 0);
         FBO::CopyColor(framebuffer_0, 1, framebuffer_1, 1);
+        GPUProfiler::Pop();
 
         // ------------------------------ apply Gaussian blur ------------------------------
 
+        GPUProfiler::Push("Bloom");
         FBO::CopyColor(framebuffer_1, 1, framebuffer_2, 0);  // downsample the bloom target (nearest filtering)
         auto& ping = framebuffer_2.GetColorTexture(0);
         auto& pong = framebuffer_2.GetColorTexture(1);
@@ -227,9 +242,11 @@ namespace scene {
             bloom_shader->Dispatch(ping.width / 32, ping.width / 18);
             bloom_shader->SyncWait(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
         }
+        GPUProfiler::Pop();
 
         // ------------------------------ postprocessing pass ------------------------------
 
+        GPUProfiler::Push("Postprocess");
         framebuffer_1.GetColorTexture(0).Bind(0);  // color texture
         framebuffer_2.GetColorTexture(0).Bind(1);  // bloom texture
 
@@ -245,6 +262,7 @@ namespace scene {
 
         postprocess_shader->Unbind();
         bilinear_sampler->Unbind(1);
+        GPUProfiler::Pop();
     }
 
     void Scene02::OnImGuiRender() {
@@ -411,68 +429,15 @@ namespace scene {
         }
     }
 
-    void Scene02::PrecomputeIBL(const std::string& hdri) {
-        Renderer::SeamlessCubemap(true);
-        Renderer::DepthTest(false);
-        Renderer::FaceCulling(true);
-
-        auto irradiance_shader = CShader(paths::shader + "core\\irradiance_map.glsl");
-        auto prefilter_shader  = CShader(paths::shader + "core\\prefilter_envmap.glsl");
-        auto envBRDF_shader    = CShader(paths::shader + "core\\environment_BRDF.glsl");
-
-        auto env_map = MakeAsset<Texture>(hdri, 2048, 0);
-        env_map->Bind(0);
-
-        irradiance_map  = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, 128, 128, 6, GL_RGBA16F, 1);
-        prefiltered_map = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, 2048, 2048, 6, GL_RGBA16F, 8);
-        BRDF_LUT        = MakeAsset<Texture>(GL_TEXTURE_2D, 1024, 1024, 1, GL_RGBA16F, 1);
-
-        CORE_INFO("Precomputing diffuse irradiance map from {0}", hdri);
-        irradiance_map->BindILS(0, 0, GL_WRITE_ONLY);
-
-        if (irradiance_shader.Bind(); true) {
-            irradiance_shader.Dispatch(128 / 32, 128 / 32, 6);
-            irradiance_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
-
-            auto irradiance_fence = Sync(0);
-            irradiance_fence.ClientWaitSync();
-            irradiance_map->UnbindILS(0);
-        }
-
-        CORE_INFO("Precomputing specular prefiltered envmap from {0}", hdri);
-        Texture::Copy(*env_map, 0, *prefiltered_map, 0);  // copy the base level
-
-        const GLuint max_level = prefiltered_map->n_levels - 1;
-        GLuint resolution = prefiltered_map->width / 2;
-        prefilter_shader.Bind();
-
-        for (unsigned int level = 1; level <= max_level; level++, resolution /= 2) {
-            float roughness = level / static_cast<float>(max_level);
-            GLuint n_groups = glm::max<GLuint>(resolution / 32, 1);
-
-            prefiltered_map->BindILS(level, 1, GL_WRITE_ONLY);
-            prefilter_shader.SetUniform(0, roughness);
-            prefilter_shader.Dispatch(n_groups, n_groups, 6);
-            prefilter_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
-
-            auto prefilter_fence = Sync(level);
-            prefilter_fence.ClientWaitSync();
-            prefiltered_map->UnbindILS(1);
+    void Scene02::SetupMaterial(Material& pbr_mat, int mat_id) {
+        if (irradiance_sh.empty()) {
+            pbr_mat.SetTexture(pbr_t::irradiance_map, irradiance_map);
         }
-
-        CORE_INFO("Precomputing specular environment BRDF from {0}", hdri);
-        BRDF_LUT->BindILS(0, 2, GL_WRITE_ONLY);
-
-        if (envBRDF_shader.Bind(); true) {
-            envBRDF_shader.Dispatch(1024 / 32, 1024 / 32, 1);
-            envBRDF_shader.SyncWait(GL_ALL_BARRIER_BITS);
-            Sync::WaitFinish();
-            BRDF_LUT->UnbindILS(2);
+        else {
+            pbr_mat.SetUniform(pbr_u::irradiance_sh, true);
+            pbr_mat.SetUniformArray(pbr_u::sh9, 9, &irradiance_sh);
         }
-    }
 
-    void Scene02::SetupMaterial(Material& pbr_mat, int mat_id) {
-        pbr_mat.SetTexture(pbr_t::irradiance_map, irradiance_map);
         pbr_mat.SetTexture(pbr_t::prefiltered_map, prefiltered_map);
         pbr_mat.SetTexture(pbr_t::BRDF_LUT, BRDF_LUT);
 
@@ -23,8 +23,8 @@ namespace scene {
         asset_ref<Texture> irradiance_map;
         asset_ref<Texture> prefiltered_map;
         asset_ref<Texture> BRDF_LUT;
+        std::vector<vec3> irradiance_sh;
 
-        void PrecomputeIBL(const std::string& hdri);
         void SetupMaterial(Material& pbr_mat, int mat_id);
 
         void RenderSphere();
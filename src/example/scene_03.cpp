@@ -13,6 +13,7 @@
 #include "utils/ext.h"
 #include "utils/math.h"
 #include "utils/path.h"
+#include "utils/profile.h"
 #include "example/scene_03.h"
 
 using namespace core;
@@ -60,7 +61,14 @@ namespace scene {
 
     void Scene03::Init() {
         this->title = "Disney Principled BSDF";
-        PrecomputeIBL(utils::paths::texture + "HDRI\\hotel_room_4k2.hdr");
+        Renderer::SeamlessCubemap(true);
+        Renderer::DepthTest(false);
+        Renderer::FaceCulling(true);
+
+        auto ibl = IBLBaker::Bake(utils::paths::texture + "HDRI\\hotel_room_4k2.hdr");
+        irradiance_map  = ibl.irradiance_map;
+        prefiltered_map = ibl.prefiltered_map;
+        BRDF_LUT        = ibl.BRDF_LUT;
 
         resource_manager.Add(01, MakeAsset<Shader>(paths::shader + "core\\infinite_grid.glsl"));
         resource_manager.Add(02, MakeAsset<Shader>(paths::shader + "core\\skybox.glsl"));
@@ -206,6 +214,7 @@ namespace scene {
 
         // ------------------------------ MRT render pass ------------------------------
 
+        GPUProfiler::Push("MRT Pass");
         framebuffer_0.Clear();
         framebuffer_0.Bind();
 
@@ -239,14 +248,18 @@ namespace scene {
         }
 
         framebuffer_0.Unbind();
+        GPUProfiler::Pop();
 
         // ------------------------------ MSAA resolve pass ------------------------------
         
+        GPUProfiler::Push("MSAA Resolve");
         framebuffer_1.Clear();
         FBO::CopyColor(framebuffer_0, 0, framebuffer_1, 0);
+        GPUProfiler::Pop();
 
         // ------------------------------ postprocessing pass ------------------------------
 
+        GPUProfiler::Push("Postprocess");
         framebuffer_1.GetColorTexture(0).Bind(0);
         auto postprocess_shader = resource_manager.Get<Shader>(05);
         postprocess_shader->Bind();
@@ -255,6 +268,7 @@ namespace scene {
         Renderer::Clear();
         Mesh::DrawQuad();
         postprocess_shader->Unbind();
+        GPUProfiler::Pop();
     }
 
     void Scene03::OnImGuiRender() {
@@ -361,66 +375,6 @@ namespace scene {
         }
     }
 
-    void Scene03::PrecomputeIBL(const std::string& hdri) {
-        Renderer::SeamlessCubemap(true);
-        Renderer::DepthTest(false);
-        Renderer::FaceCulling(true);
-
-        auto irradiance_shader = CShader(paths::shader + "core\\irradiance_map.glsl");
-        auto prefilter_shader  = CShader(paths::shader + "core\\prefilter_envmap.glsl");
-        auto envBRDF_shader    = CShader(paths::shader + "core\\environment_BRDF.glsl");
-
-        auto env_map = MakeAsset<Texture>(hdri, 2048, 0);
-        env_map->Bind(0);
-
-        irradiance_map  = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, 128, 128, 6, GL_RGBA16F, 1);
-        prefiltered_map = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, 2048, 2048, 6, GL_RGBA16F, 8);
-        BRDF_LUT        = MakeAsset<Texture>(GL_TEXTURE_2D, 1024, 1024, 1, GL_RGBA16F, 1);
-
-        CORE_INFO("Precomputing diffuse irradiance map from {0}", hdri);
-        irradiance_map->BindILS(0, 0, GL_WRITE_ONLY);
-
-        if (irradiance_shader.Bind(); true) {
-            irradiance_shader.Dispatch(128 / 32, 128 / 32, 6);
-            irradiance_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
-
-            auto irradiance_fence = Sync(0);
-            irradiance_fence.ClientWaitSync();
-            irradiance_map->UnbindILS(0);
-        }
-
-        CORE_INFO("Precomputing specular prefiltered envmap from {0}", hdri);
-        Texture::Copy(*env_map, 0, *prefiltered_map, 0);  // copy the base level
-
-        const GLuint max_level = prefiltered_map->n_levels - 1;
-        GLuint resolution = prefiltered_map->width / 2;
-        prefilter_shader.Bind();
-
-        for (unsigned int level = 1; level <= max_level; level++, resolution /= 2) {
-            float roughness = level / static_cast<float>(max_level);
-            GLuint n_groups = glm::max<GLuint>(resolution / 32, 1);
-
-            prefiltered_map->BindILS(level, 1, GL_WRITE_ONLY);
-            prefilter_shader.SetUniform(0, roughness);
-            prefilter_shader.Dispatch(n_groups, n_groups, 6);
-            prefilter_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
-
-            auto prefilter_fence = Sync(level);
-            prefilter_fence.ClientWaitSync();
-            prefiltered_map->UnbindILS(1);
-        }
-
-        CORE_INFO("Precomputing specular environment BRDF from {0}", hdri);
-        BRDF_LUT->BindILS(0, 2, GL_WRITE_ONLY);
-
-        if (envBRDF_shader.Bind(); true) {
-            envBRDF_shader.Dispatch(1024 / 32, 1024 / 32, 1);
-            envBRDF_shader.SyncWait(GL_ALL_BARRIER_BITS);
-            Sync::WaitFinish();
-            BRDF_LUT->UnbindILS(2);
-        }
-    }
-
     void Scene03::SetupMaterial(Material& mat) {
         mat.SetTexture(pbr_t::irradiance_map, irradiance_map);
         mat.SetTexture(pbr_t::prefiltered_map, prefiltered_map);
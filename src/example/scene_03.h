@@ -25,7 +25,6 @@ namespace scene {
         asset_ref<Texture> prefiltered_map;
         asset_ref<Texture> BRDF_LUT;
 
-        void PrecomputeIBL(const std::string& hdri);
         void SetupMaterial(Material& mat);
         Entity& GetEntity(int entity_id);
     };
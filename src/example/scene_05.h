@@ -29,7 +29,6 @@ namespace scene {
         asset_ref<Texture> prefiltered_map;
         asset_ref<Texture> BRDF_LUT;
 
-        void PrecomputeIBL(const std::string& hdri);
         void SetupMaterial(Material& pbr_mat, int mat_id);
     };
 
@@ -10,9 +10,11 @@
 #include "component/all.h"
 #include "scene/renderer.h"
 #include "scene/ui.h"
+#include "utils/bcn.h"
 #include "utils/ext.h"
 #include "utils/math.h"
 #include "utils/path.h"
+#include "utils/profile.h"
 #include "example/scene_06.h"
 
 using namespace core;
@@ -37,7 +39,34 @@ namespace scene {
 
     void Scene06::Init() {
         this->title = "Bezier Area Lights with LTC";
-        PrecomputeIBL(paths::texture + "HDRI\\Evening_07_4K.hdr");
+
+        // the cathedral textures are block-compressed and streamed, the workers map (or encode on
+        // the first run) the mip chains while we precompute IBL, and only the tail mips are uploaded
+        // before the first frame, the finer levels are streamed in as the camera moves around
+        if (std::string tex_path = paths::model + "sibenik\\"; true) {
+            resource_manager.LoadTexture(20, tex_path + "kamen_zid_albedo.jpg", bcn::Format::BC7, true);
+            resource_manager.LoadTexture(21, tex_path + "kamen_zid_normal.jpg", bcn::Format::BC5, true);
+            resource_manager.LoadTexture(22, tex_path + "kamen_zid_rough.jpg", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(23, tex_path + "kamen_zid_ao.jpg", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(24, tex_path + "pod_rub_albedo.jpg", bcn::Format::BC7, true);
+            resource_manager.LoadTexture(25, tex_path + "pod_rub_normal.jpg", bcn::Format::BC5, true);
+            resource_manager.LoadTexture(26, tex_path + "pod_rub_rough.jpg", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(27, tex_path + "pod_rub_ao.jpg", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(28, tex_path + "stupovi_albedo.jpg", bcn::Format::BC7, true);
+            resource_manager.LoadTexture(29, tex_path + "stupovi_rough.jpg", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(30, tex_path + "tile_albedo.png", bcn::Format::BC7, true);
+            resource_manager.LoadTexture(31, tex_path + "tile_metalness.png", bcn::Format::BC4, true);
+            resource_manager.LoadTexture(32, tex_path + "tile_roughness.png", bcn::Format::BC4, true);
+        }
+
+        Renderer::SeamlessCubemap(true);
+        Renderer::DepthTest(false);
+        Renderer::FaceCulling(true);
+
+        auto ibl = IBLBaker::Bake(paths::texture + "HDRI\\Evening_07_4K.hdr");
+        irradiance_map  = ibl.irradiance_map;
+        prefiltered_map = ibl.prefiltered_map;
+        BRDF_LUT        = ibl.BRDF_LUT;
 
         resource_manager.Add(00, MakeAsset<CShader>(paths::shader + "core\\bloom.glsl"));
         resource_manager.Add(01, MakeAsset<Shader>(paths::shader + "core\\infinite_grid.glsl"));
@@ -50,13 +79,10 @@ namespace scene {
         resource_manager.Add(13, MakeAsset<Material>(resource_manager.Get<Shader>(03)));
         resource_manager.Add(14, MakeAsset<Material>(resource_manager.Get<Shader>(04)));
 
-        resource_manager.Add(20, MakeAsset<Texture>(paths::model + "sibenik\\kamen_zid_albedo.jpg"));
-        resource_manager.Add(21, MakeAsset<Texture>(paths::model + "sibenik\\kamen_zid_normal.jpg"));
-        resource_manager.Add(22, MakeAsset<Texture>(paths::model + "sibenik\\kamen_zid_rough.jpg"));
-        resource_manager.Add(23, MakeAsset<Texture>(paths::model + "sibenik\\kamen_zid_ao.jpg"));
-
         resource_manager.Add(98, MakeAsset<Sampler>(FilterMode::Point));
         resource_manager.Add(99, MakeAsset<Sampler>(FilterMode::Bilinear));
+
+        resource_manager.Wait();  // block until the tail mips are uploaded
         
         AddUBO(resource_manager.Get<Shader>(02)->ID());
         AddUBO(resource_manager.Get<Shader>(03)->ID());
@@ -163,6 +189,7 @@ namespace scene {
         Renderer::DepthTest(true);
         Renderer::AlphaBlend(true);
         Renderer::FaceCulling(false);
+        Renderer::ClusterCulling(true);  // frustum culling only, the cathedral is drawn double-sided
     }
 
     void Scene06::OnSceneRender() {
@@ -182,6 +209,7 @@ namespace scene {
 
         // ------------------------------ MRT render pass ------------------------------
 
+        GPUProfiler::Push("MRT Pass");
         framebuffer_0.Clear();
         framebuffer_0.Bind();
 
@@ -209,15 +237,19 @@ namespace scene {
         }
 
         framebuffer_0.Unbind();
+        GPUProfiler::Pop();
 
         // ------------------------------ MSAA resolve pass ------------------------------
         
+        GPUProfiler::Push("MSAA Resolve");
         framebuffer_1.Clear();
         FBO::CopyColor(framebuffer_0, 0, framebuffer_1, 0);
         FBO::CopyColor(framebuffer_0, 1, framebuffer_1, 1);
+        GPUProfiler::Pop();
 
         // ------------------------------ apply Gaussian blur ------------------------------
 
+        GPUProfiler::Push("Bloom");
         FBO::CopyColor(framebuffer_1, 1, framebuffer_2, 0);  // downsample the bloom target (nearest filtering)
         auto& ping = framebuffer_2.GetColorTexture(0);
         auto& pong = framebuffer_2.GetColorTexture(1);
@@ -232,9 +264,11 @@ namespace scene {
             bloom_shader->Dispatch(ping.width / 32, ping.width / 18);
             bloom_shader->SyncWait(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
         }
+        GPUProfiler::Pop();
 
         // ------------------------------ postprocessing pass ------------------------------
 
+        GPUProfiler::Push("Postprocess");
         framebuffer_1.GetColorTexture(0).Bind(0);  // color texture
         framebuffer_2.GetColorTexture(0).Bind(1);  // bloom texture
 
@@ -250,6 +284,7 @@ namespace scene {
 
         postprocess_shader->Unbind();
         bilinear_sampler->Unbind(1);
+        GPUProfiler::Pop();
     }
 
     void Scene06::OnImGuiRender() {
@@ -307,66 +342,6 @@ namespace scene {
         }
     }
 
-    void Scene06::PrecomputeIBL(const std::string& hdri) {
-        Renderer::SeamlessCubemap(true);
-        Renderer::DepthTest(false);
-        Renderer::FaceCulling(true);
-
-        auto irradiance_shader = CShader(paths::shader + "core\\irradiance_map.glsl");
-        auto prefilter_shader  = CShader(paths::shader + "core\\prefilter_envmap.glsl");
-        auto envBRDF_shader    = CShader(paths::shader + "core\\environment_BRDF.glsl");
-
-        auto env_map = MakeAsset<Texture>(hdri, 2048, 0);
-        env_map->Bind(0);
-
-        irradiance_map  = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, 128, 128, 6, GL_RGBA16F, 1);
-        prefiltered_map = MakeAsset<Texture>(GL_TEXTURE_CUBE_MAP, 2048, 2048, 6, GL_RGBA16F, 8);
-        BRDF_LUT        = MakeAsset<Texture>(GL_TEXTURE_2D, 1024, 1024, 1, GL_RGBA16F, 1);
-
-        CORE_INFO("Precomputing diffuse irradiance map from {0}", hdri);
-        irradiance_map->BindILS(0, 0, GL_WRITE_ONLY);
-
-        if (irradiance_shader.Bind(); true) {
-            irradiance_shader.Dispatch(128 / 32, 128 / 32, 6);
-            irradiance_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
-
-            auto irradiance_fence = Sync(0);
-            irradiance_fence.ClientWaitSync();
-            irradiance_map->UnbindILS(0);
-        }
-
-        CORE_INFO("Precomputing specular prefiltered envmap from {0}", hdri);
-        Texture::Copy(*env_map, 0, *prefiltered_map, 0);  // copy the base level
-
-        const GLuint max_level = prefiltered_map->n_levels - 1;
-        GLuint resolution = prefiltered_map->width / 2;
-        prefilter_shader.Bind();
-
-        for (unsigned int level = 1; level <= max_level; level++, resolution /= 2) {
-            float roughness = level / static_cast<float>(max_level);
-            GLuint n_groups = glm::max<GLuint>(resolution / 32, 1);
-
-            prefiltered_map->BindILS(level, 1, GL_WRITE_ONLY);
-            prefilter_shader.SetUniform(0, roughness);
-            prefilter_shader.Dispatch(n_groups, n_groups, 6);
-            prefilter_shader.SyncWait(GL_TEXTURE_FETCH_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
-
-            auto prefilter_fence = Sync(level);
-            prefilter_fence.ClientWaitSync();
-            prefiltered_map->UnbindILS(1);
-        }
-
-        CORE_INFO("Precomputing specular environment BRDF from {0}", hdri);
-        BRDF_LUT->BindILS(0, 2, GL_WRITE_ONLY);
-
-        if (envBRDF_shader.Bind(); true) {
-            envBRDF_shader.Dispatch(1024 / 32, 1024 / 32, 1);
-            envBRDF_shader.SyncWait(GL_ALL_BARRIER_BITS);
-            Sync::WaitFinish();
-            BRDF_LUT->UnbindILS(2);
-        }
-    }
-
     void Scene06::SetupMaterial(Material& pbr_mat, int mat_id) {
         pbr_mat.SetTexture(pbr_t::irradiance_map, irradiance_map);
         pbr_mat.SetTexture(pbr_t::prefiltered_map, prefiltered_map);
@@ -375,14 +350,12 @@ namespace scene {
         pbr_mat.BindUniform(0, &skybox_exposure);
         pbr_mat.BindUniform(1, &enable_pl);
 
-        std::string tex_path = utils::paths::model + "sibenik\\";
-
         if (mat_id == 10) {  // hallway curb
             pbr_mat.SetUniform(pbr_u::uv_scale, vec2(8.0f));
-            pbr_mat.SetTexture(pbr_t::albedo,    MakeAsset<Texture>(tex_path + "pod_rub_albedo.jpg"));
-            pbr_mat.SetTexture(pbr_t::normal,    MakeAsset<Texture>(tex_path + "pod_rub_normal.jpg"));
-            pbr_mat.SetTexture(pbr_t::roughness, MakeAsset<Texture>(tex_path + "pod_rub_rough.jpg"));
-            pbr_mat.SetTexture(pbr_t::ao,        MakeAsset<Texture>(tex_path + "pod_rub_ao.jpg"));
+            pbr_mat.SetTexture(pbr_t::albedo,    resource_manager.Get<Texture>(24));
+            pbr_mat.SetTexture(pbr_t::normal,    resource_manager.Get<Texture>(25));
+            pbr_mat.SetTexture(pbr_t::roughness, resource_manager.Get<Texture>(26));
+            pbr_mat.SetTexture(pbr_t::ao,        resource_manager.Get<Texture>(27));
         }
         else if (mat_id == 11) {  // square window frames
             pbr_mat.SetUniform(pbr_u::albedo, vec4(0.0f, 0.0f, 0.0f, 1.0f));
@@ -413,17 +386,17 @@ namespace scene {
         }
         else if (mat_id == 16) {  // pillars
             pbr_mat.SetUniform(pbr_u::uv_scale, vec2(8.0f));
-            pbr_mat.SetTexture(pbr_t::albedo,    MakeAsset<Texture>(tex_path + "stupovi_albedo.jpg"));
-            pbr_mat.SetTexture(pbr_t::roughness, MakeAsset<Texture>(tex_path + "stupovi_rough.jpg"));
+            pbr_mat.SetTexture(pbr_t::albedo,    resource_manager.Get<Texture>(28));
+            pbr_mat.SetTexture(pbr_t::roughness, resource_manager.Get<Texture>(29));
         }
         else if (mat_id == 17) {  // circle window inner dots
             pbr_mat.SetUniform(pbr_u::albedo, vec4(0.0f, 0.0f, 1.0f, 1.0f));
             pbr_mat.SetUniform(pbr_u::roughness, 0.25f);
         }
         else if (mat_id == 18) {  // floor
-            pbr_mat.SetTexture(pbr_t::albedo,    MakeAsset<Texture>(tex_path + "tile_albedo.png"));
-            pbr_mat.SetTexture(pbr_t::metallic,  MakeAsset<Texture>(tex_path + "tile_metalness.png"));
-            pbr_mat.SetTexture(pbr_t::roughness, MakeAsset<Texture>(tex_path + "tile_roughness.png"));
+            pbr_mat.SetTexture(pbr_t::albedo,    resource_manager.Get<Texture>(30));
+            pbr_mat.SetTexture(pbr_t::metallic,  resource_manager.Get<Texture>(31));
+            pbr_mat.SetTexture(pbr_t::roughness, resource_manager.Get<Texture>(32));
         }
         else if (mat_id == 19) {  // window dent
             pbr_mat.SetUniform(pbr_u::uv_scale, vec2(4.0f));
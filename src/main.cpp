@@ -7,7 +7,9 @@
 #include <cstdlib>
 #include <crtdbg.h>
 #include <windows.h>
+#include "core/base.h"
 #include "core/app.h"
+#include "core/bench.h"
 
 #if defined(_MSC_VER) && _MSC_VER >= 1922
 #pragma execution_character_set("utf-8")
@@ -86,6 +88,13 @@ int main(int argc, char** argv) {
     // from now on, font/color/style of the console text printed by `printf, fprintf, cout, cerr`
     // will be solid white, but those printed by the application core are controlled by "spdlog".
 
+    // the benchmark build runs every scene offscreen for a fixed number of frames and then exits
+    if constexpr (bench_mode) {
+        int ret = core::Benchmark::Run(argc, argv);
+        app.Clear();
+        return ret;
+    }
+
     app.Start();  // start the welcome screen
 
     // main event loop
@@ -4,14 +4,18 @@
 #include <GLFW/glfw3.h>
 
 #include "core/base.h"
+#include "core/bench.h"
 #include "core/clock.h"
 #include "core/input.h"
+#include "core/job.h"
 #include "core/log.h"
 #include "core/sync.h"
 #include "core/window.h"
 #include "asset/buffer.h"
 #include "asset/fbo.h"
 #include "asset/shader.h"
+#include "asset/stream.h"
+#include "asset/texture.h"
 #include "component/all.h"
 #include "scene/entity.h"
 #include "scene/factory.h"
@@ -20,6 +24,7 @@
 #include "scene/ui.h"
 #include "utils/ext.h"
 #include "utils/path.h"
+#include "utils/profile.h"
 
 using namespace core;
 using namespace asset;
@@ -33,7 +38,184 @@ namespace scene {
 
     static bool depth_prepass = false;
     static uint shadow_index = 0U;
+    static float lod_error = 1.0f;       // max screen-space error of a level of detail, in pixels
+    static float lod_hysteresis = 0.25f;  // fraction of `lod_error` to cross before switching back
+    static bool face_culling = false;
+    static bool cluster_culling = false;
+    static bool occlusion_culling = false;
+    static mat4 view_projection {};      // of the main camera, updated on every normal pass
+    static std::vector<vec4> frustum(6);  // planes of the main camera in world space
     static asset_tmp<UBO> renderer_input = nullptr;
+    static asset_tmp<CShader> cull_shader = nullptr;
+    static asset_tmp<CShader> pyramid_shader = nullptr;
+    static asset_tmp<Texture> depth_pyramid = nullptr;
+
+    // estimate the on-screen diameter (in pixels) of a mesh from its bounding sphere, this is the
+    // feedback used by the texture streamer, so it doesn't have to be accurate, just consistent
+    static float ScreenSize(const Mesh& mesh, const Transform& transform, const Camera* camera) {
+        if (camera == nullptr || mesh.bounds.w <= 0.0f) {
+            return 0.0f;
+        }
+
+        const mat4& M = transform.transform;
+        float scale = std::max({ glm::length(vec3(M[0])), glm::length(vec3(M[1])), glm::length(vec3(M[2])) });
+        float radius = mesh.bounds.w * scale;
+        vec3 center = vec3(M * vec4(vec3(mesh.bounds), 1.0f));
+
+        float distance = glm::distance(center, camera->T->position);
+        if (distance <= radius) {
+            return static_cast<float>(std::max(Window::width, Window::height));  // camera is inside
+        }
+
+        float tan_half_fov = std::tan(glm::radians(camera->fov) * 0.5f);
+        return radius / (distance * tan_half_fov) * Window::height;
+    }
+
+    // pick the coarsest level of detail of a mesh whose geometric error projects to less than
+    // `lod_error` pixels, to avoid popping back and forth when the error hovers around the limit,
+    // a coarser level must be under the limit minus the hysteresis, and the current level must
+    // exceed the limit plus the hysteresis before a finer one is picked
+    static uint32_t SelectLOD(const Mesh& mesh, const Transform& transform, const Camera* camera) {
+        if (camera == nullptr || mesh.lods.size() < 2) {
+            return mesh.lod;
+        }
+
+        const mat4& M = transform.transform;
+        float scale = std::max({ glm::length(vec3(M[0])), glm::length(vec3(M[1])), glm::length(vec3(M[2])) });
+        vec3 center = vec3(M * vec4(vec3(mesh.bounds), 1.0f));
+
+        // distance to the nearest point of the bounding sphere, so the error is never underestimated
+        float distance = glm::distance(center, camera->T->position) - mesh.bounds.w * scale;
+        if (distance <= camera->near_clip) {
+            return 0;
+        }
+
+        // a length of 1 at unit distance covers P[1][1] half-viewports vertically
+        float pixels_per_unit = camera->GetProjectionMatrix()[1][1] * 0.5f * Window::height * scale / distance;
+        auto projected = [&](uint32_t level) { return mesh.lods[level].error * pixels_per_unit; };
+
+        uint32_t current = std::min<uint32_t>(mesh.lod, static_cast<uint32_t>(mesh.lods.size() - 1));
+        uint32_t coarsest = 0;
+
+        for (uint32_t level = 1; level < mesh.lods.size() && projected(level) <= lod_error; level++) {
+            coarsest = level;
+        }
+
+        if (coarsest > current) {
+            while (coarsest > current && projected(coarsest) > lod_error * (1.0f - lod_hysteresis)) {
+                coarsest--;
+            }
+            return coarsest;
+        }
+
+        if (coarsest < current && projected(current) <= lod_error * (1.0f + lod_hysteresis)) {
+            return current;
+        }
+
+        return coarsest;
+    }
+
+    // extract the 6 frustum planes from the view-projection matrix (Gribb and Hartmann 2001), a
+    // point is inside a plane if `dot(plane.xyz, p) + plane.w >= 0`
+    static void UpdateFrustum(const Camera& camera) {
+        view_projection = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+        mat4 rows = glm::transpose(view_projection);
+
+        for (int i = 0; i < 3; i++) {
+            frustum[i * 2 + 0] = rows[3] + rows[i];
+            frustum[i * 2 + 1] = rows[3] - rows[i];
+        }
+
+        for (auto& plane : frustum) {
+            plane /= glm::length(vec3(plane));
+        }
+    }
+
+    // whether a mesh is culled by clusters in this pass, the meshlets only cover the full mesh
+    static bool UsesClusters(const Mesh& mesh, const Camera* camera) {
+        return cluster_culling && camera != nullptr && mesh.n_meshlets > 0 && mesh.lod == 0;
+    }
+
+    // dispatch the culling pass over the meshlets of a mesh, this must happen before the material
+    // is bound since it binds its own program and texture
+    static void CullClusters(const Mesh& mesh, const Transform& transform, const Camera* camera) {
+        if (cull_shader == nullptr) {
+            cull_shader = WrapAsset<CShader>(utils::paths::shader + "core\\cull_meshlet.glsl");
+        }
+
+        const mat4& M = transform.transform;
+        float scale = std::max({ glm::length(vec3(M[0])), glm::length(vec3(M[1])), glm::length(vec3(M[2])) });
+        vec3 camera_position = vec3(glm::inverse(M) * vec4(camera->T->position, 1.0f));
+
+        // a mirrored transform flips the winding order, so the cones would point the wrong way
+        bool cone_culling = face_culling && glm::determinant(mat3(M)) > 0.0f;
+        bool occlusion = occlusion_culling && depth_pyramid != nullptr && !depth_prepass;
+
+        mesh.meshlets->Reset(8);
+        mesh.clusters->Reset(9);
+        mesh.clusters->Clear(0, sizeof(GLuint));  // reset the draw count
+
+        cull_shader->SetUniform(0, mesh.n_meshlets);
+        cull_shader->SetUniform(1, M);
+        cull_shader->SetUniform(2, view_projection);
+        cull_shader->SetUniform(3, camera_position);
+        cull_shader->SetUniform(4, scale);
+        cull_shader->SetUniform(5, cone_culling);
+        cull_shader->SetUniform(6, occlusion);
+        cull_shader->SetUniformArray(7, 6, frustum);
+        cull_shader->SetUniform(13, mesh.first_index);  // offsets in the geometry arena
+        cull_shader->SetUniform(14, mesh.base_vertex);
+
+        if (occlusion) {
+            depth_pyramid->Bind(0);
+        }
+
+        cull_shader->Bind();
+        cull_shader->Dispatch((mesh.n_meshlets + 63) / 64, 1, 1);
+        cull_shader->SyncWait(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // group the meshes of a model that can be drawn by a single multi-draw call: same material
+    // and same arena page, the groups are drawn in the order of their first mesh, meshes culled
+    // by clusters are drawn on their own. Uniforms are per entity and the transform is shared,
+    // so the draws of a batch don't need any per-draw data
+    struct Batch {
+        GLuint material_id;
+        bool clustered;
+        std::vector<const Mesh*> meshes;
+    };
+
+    static std::vector<Batch> batches;  // reused across models and frames to avoid allocations
+    static size_t n_batches = 0;
+
+    static void BatchMeshes(const Model& model, const Camera* camera) {
+        n_batches = 0;
+
+        for (const auto& mesh : model.meshes) {
+            bool clustered = UsesClusters(mesh, camera);
+            Batch* batch = nullptr;
+
+            for (size_t i = 0; i < n_batches && !clustered && batch == nullptr; i++) {
+                Batch& other = batches[i];
+                if (!other.clustered && other.material_id == mesh.material_id && other.meshes.front()->SharesBuffers(mesh)) {
+                    batch = &other;
+                }
+            }
+
+            if (batch == nullptr) {
+                if (n_batches == batches.size()) {
+                    batches.emplace_back();
+                }
+
+                batch = &batches[n_batches++];
+                batch->material_id = mesh.material_id;
+                batch->clustered = clustered;
+                batch->meshes.clear();
+            }
+
+            batch->meshes.push_back(&mesh);
+        }
+    }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -128,6 +310,8 @@ namespace scene {
             glDisable(GL_CULL_FACE);
             is_enabled = false;
         }
+
+        face_culling = is_enabled;  // normal cones can only cull meshlets whose back faces are culled
     }
 
     void Renderer::SeamlessCubemap(bool enable) {
@@ -170,9 +354,53 @@ namespace scene {
         shadow_index = index;  // use this to identify a specific shadow pass and light source
     }
 
+    void Renderer::SetLODError(float pixels, float hysteresis) {
+        lod_error = std::max(pixels, 0.0f);  // 0 always draws the full meshes
+        lod_hysteresis = std::clamp(hysteresis, 0.0f, 1.0f);
+    }
+
+    void Renderer::ClusterCulling(bool enable, bool occlusion) {
+        cluster_culling = enable;
+        occlusion_culling = enable && occlusion;
+    }
+
+    void Renderer::BuildDepthPyramid(const Texture& depth) {
+        PROFILE_FUNCTION();
+        GPU_SCOPE("Depth Pyramid");
+
+        if (pyramid_shader == nullptr) {
+            pyramid_shader = WrapAsset<CShader>(utils::paths::shader + "core\\depth_pyramid.glsl");
+        }
+
+        if (depth_pyramid == nullptr || depth_pyramid->width != depth.width || depth_pyramid->height != depth.height) {
+            depth_pyramid = WrapAsset<Texture>(GL_TEXTURE_2D, depth.width, depth.height, 1, GL_R32F, 0);  // full mip chain
+        }
+
+        depth.Bind(0);
+        pyramid_shader->Bind();
+
+        // each level reads the one below as an image, so every level must wait for the previous
+        for (GLuint level = 0; level < depth_pyramid->n_levels; level++) {
+            GLuint width = std::max(depth.width >> level, 1U);
+            GLuint height = std::max(depth.height >> level, 1U);
+
+            if (level > 0) {
+                depth_pyramid->BindILS(level - 1, 0, GL_READ_ONLY);
+            }
+
+            depth_pyramid->BindILS(level, 1, GL_WRITE_ONLY);
+            pyramid_shader->SetUniform(0, static_cast<int>(level));
+            pyramid_shader->Dispatch((width + 15) / 16, (height + 15) / 16, 1);
+            pyramid_shader->SyncWait(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+
+        pyramid_shader->Unbind();
+    }
+
     ///////////////////////////////////////////////////////////////////////////////////////////////
 
     void Renderer::Attach(const std::string& title) {
+        PROFILE_FUNCTION();
         CORE_TRACE("Attaching scene \"{0}\" ......", title);
 
         // create the renderer input UBO on the first run (internal UBO)
@@ -182,6 +410,7 @@ namespace scene {
             const std::vector<GLuint> stride { 8U, 8U, 4U, 4U, 4U, 4U, 4U, 4U };
 
             renderer_input = WrapAsset<UBO>(10, offset, length, stride);
+            renderer_input->MultiBuffer(8);  // updated on every `Render()` call, up to 8 times per frame
         }
 
         Input::Clear();
@@ -199,10 +428,15 @@ namespace scene {
         new_scene->Init();  // asynchronous call
         curr_scene = new_scene;
 
-        Sync::WaitFinish();  // block until the CPU and GPU are in sync
+        FrameSync::WaitIdle();  // block until the CPU and GPU are in sync
     }
 
     void Renderer::Detach() {
+        PROFILE_FUNCTION();
+        if (curr_scene == nullptr) {
+            return;  // nothing to detach (e.g. the benchmark has already unloaded every scene)
+        }
+
         CORE_TRACE("Detaching scene \"{0}\" ......", curr_scene->title);
 
         last_scene = curr_scene;
@@ -211,8 +445,9 @@ namespace scene {
         delete last_scene;  // every object in the scene will be destructed
         last_scene = nullptr;
 
-        Sync::WaitFinish();  // block until the scene is fully unloaded
+        FrameSync::WaitIdle();  // block until the scene is fully unloaded
         Renderer::Reset();   // reset renderer to a clean default state
+        utils::GPUProfiler::Reset();  // pending queries belong to the old scene
     }
 
     void Renderer::Reset() {
@@ -228,6 +463,7 @@ namespace scene {
         SetFrontFace(1);
         SetViewport(Window::width, Window::height);
         SetShadowPass(0);
+        ClusterCulling(0);
     }
 
     void Renderer::Clear() {
@@ -246,6 +482,13 @@ namespace scene {
     }
 
     void Renderer::Flush() {
+        utils::GPUProfiler::EndFrame();  // close the frame before the buffer swap
+        FrameSync::EndFrame();
+
+        PROFILE_COUNTER("Draw Calls", Benchmark::draw_calls);
+        PROFILE_COUNTER("Dispatches", Benchmark::dispatches);
+        Benchmark::draw_calls = Benchmark::dispatches = 0;
+
         if constexpr (_freeglut) {
             glutSwapBuffers();
             glutPostRedisplay();
@@ -257,10 +500,28 @@ namespace scene {
     }
 
     void Renderer::Render(const asset_ref<asset::Shader> custom_shader) {
+        PROFILE_FUNCTION();
+        GPU_SCOPE("Render");
+
         auto& reg = curr_scene->registry;
         auto mesh_group = reg.group<Mesh>(entt::get<Transform, Tag, Material>);
         auto model_group = reg.group<Model>(entt::get<Transform, Tag>);  // materials are managed by the model
 
+        // the main camera is only needed for texture streaming feedback in the normal passes
+        const Camera* main_camera = nullptr;
+        if (!custom_shader) {
+            for (auto&& [e, camera, tag] : reg.view<Camera, Tag>().each()) {
+                if (tag.Contains(ETag::MainCamera)) {
+                    main_camera = &camera;
+                    break;
+                }
+            }
+
+            if (main_camera != nullptr && cluster_culling) {
+                UpdateFrustum(*main_camera);
+            }
+        }
+
         if (!render_queue.empty()) {
             constexpr float near_clip = 0.1f;
             constexpr float far_clip = 100.0f;
@@ -279,6 +540,7 @@ namespace scene {
             renderer_input->SetUniform(5U, utils::val_ptr(delta_time));
             renderer_input->SetUniform(6U, utils::val_ptr(static_cast<int>(depth_prepass)));
             renderer_input->SetUniform(7U, utils::val_ptr(shadow_index));
+            renderer_input->Commit();  // the next `Render()` call must not overwrite these values
         }
 
         while (!render_queue.empty()) {
@@ -312,6 +574,7 @@ namespace scene {
                     material.SetUniform(1006U, 0U);  // ext_1006
                     material.SetUniform(1007U, 0U);  // ext_1007
                     material.Bind();  // smart binding, no need to unbind
+                    material.Request(ScreenSize(mesh, transform, main_camera));
                 }
 
                 if (tag.Contains(ETag::Skybox)) {
@@ -329,10 +592,24 @@ namespace scene {
                 auto& transform = model_group.get<Transform>(e);
                 auto& model = model_group.get<Model>(e);
 
-                for (auto& mesh : model.meshes) {
-                    GLuint material_id = mesh.material_id;
+                if (!custom_shader) {
+                    for (auto& mesh : model.meshes) {
+                        mesh.lod = SelectLOD(mesh, transform, main_camera);  // custom passes reuse it
+                    }
+                }
+
+                BatchMeshes(model, main_camera);
+
+                for (size_t i = 0; i < n_batches; i++) {
+                    const Batch& batch = batches[i];
+                    const Mesh& mesh = *batch.meshes.front();
+                    GLuint material_id = batch.material_id;
                     auto& material = model.materials.at(material_id);
 
+                    if (batch.clustered) {
+                        CullClusters(mesh, transform, main_camera);
+                    }
+
                     if (custom_shader) {
                         custom_shader->SetUniform(1000U, transform.transform);
                         custom_shader->SetUniform(1001U, material_id);
@@ -348,15 +625,27 @@ namespace scene {
                         material.SetUniform(1006U, 0U);  // ext_1006
                         material.SetUniform(1007U, 0U);  // ext_1007
                         material.Bind();  // smart binding, no need to unbind
+
+                        for (const Mesh* member : batch.meshes) {
+                            material.Request(ScreenSize(*member, transform, main_camera));
+                        }
                     }
 
-                    mesh.Draw();
+                    if (batch.clustered) {
+                        mesh.DrawClusters();
+                    }
+                    else if (batch.meshes.size() == 1) {
+                        mesh.Draw();
+                    }
+                    else {
+                        Mesh::DrawBatch(batch.meshes);
+                    }
                 }
             }
 
             // a non-null entity must have either a mesh or a model component to be considered renderable
             else {
-                CORE_ERROR("Entity {0} in the render list is non-renderable!", e);
+                CORE_ERROR_EVERY(1.0, "Entity {0} in the render list is non-renderable!", e);
                 Clear();  // in this case just show a deep blue screen (UI stuff is separate)
             }
 
@@ -365,14 +654,31 @@ namespace scene {
     }
 
     void Renderer::DrawScene() {
+        PROFILE_FUNCTION();
+        FrameSync::BeginFrame();  // wait if the GPU is more than `n_frames` behind
+        JobSystem::ExecuteMainThreadJobs(JobSystem::main_thread_budget);  // GL work sent by the workers
+        TextureStreamer::Update();  // stream in the texture levels requested in the last frame
+        Shader::Poll();  // finish the programs compiled in the background since the last frame
+        Shader::HotReload();  // rebuild the programs whose sources have been edited
+        utils::GPUProfiler::BeginFrame();
         curr_scene->OnSceneRender();
     }
 
+    void Renderer::DrawLoadingScreen(float progress) {
+        // a standalone frame drawn while the scene is loading, `curr_scene` is not available yet
+        ui::NewFrame();
+        ui::DrawLoadingScreen(progress);
+        ui::EndFrame();
+        Flush();
+    }
+
     void Renderer::DrawImGui() {
+        PROFILE_FUNCTION();
         bool switch_scene = false;
         std::string next_scene_title;
 
         if (ui::NewFrame(); true) {
+            GPU_SCOPE("ImGui");
             ui::DrawMenuBar(next_scene_title);
             ui::DrawStatusBar();
 
@@ -42,6 +42,39 @@
    from a light source's perspective. Note that most intermediate passes actually do not
    require the vertices data, so can be applied directly on the framebuffer.
 
+   # levels of detail
+
+   in the normal passes, every mesh that has levels of detail (imported models, see "model.h")
+   draws the coarsest level whose geometric error, projected with the main camera, stays under
+   `SetLODError()` pixels (1 by default), a hysteresis band around the limit keeps meshes from
+   switching back and forth at some distance. Custom passes such as shadows don't pick a level
+   but reuse the one from the last normal pass, so that a mesh always casts its own shadow.
+
+   # cluster culling
+
+   with `ClusterCulling()` enabled, a mesh that has meshlets (see "mesh.h") and is drawn at full
+   detail in a normal pass is culled on the GPU before it's drawn: a compute pass tests every
+   meshlet against the main camera's frustum, and against its normal cone if back faces are
+   culled, then writes the draw commands of the visible ones, which are drawn by a single
+   indirect call. With `occlusion` set, meshlets are also tested against a depth pyramid that
+   must be built from the depth buffer of an earlier pass in the same frame, usually the depth
+   prepass, by `BuildDepthPyramid()`, the prepass itself skips this test.
+
+   > Renderer::ClusterCulling(true, true);
+   > ... depth prepass ...
+   > Renderer::BuildDepthPyramid(framebuffer.GetDepthTexture());
+   > ... normal passes ...
+
+   # batching
+
+   the meshes of an imported model that share a material and a page of the geometry arena
+   (see "asset/arena.h") are drawn together, the material is bound once and a single call to
+   `glMultiDrawElementsIndirect` draws all of them at their current levels of detail, rather
+   than a bind and a draw call per mesh. Meshes of a model share the transform and the entity
+   uniforms, so the draws need no per-draw data. Native meshes are separate entities with
+   their own uniforms, so they are still drawn one by one, but since they share the VAO of
+   their page, there's no VAO switch between them.
+
    # order of submission
 
    when you submit a list of entities to the renderer, they are internally stored in a
@@ -76,9 +109,10 @@
    between threads, there can be only one context, so overall it's not worth the effort.
 
    in this regard, Vulkan and D3D12 are a better option, we will leave this support for a
-   future project. That said, the resource manager can be used to optimize the loading of
-   resources in a concurrent way (TODO: integrate the "taskflow" library), this should be
-   more than enough for us to achieve reasonably good performance.
+   future project. That said, the CPU side of loading (file I/O, image decoding, parsing)
+   can still run concurrently on the workers of `core::JobSystem`, which then send the GL
+   part back to the main thread queue, the queue is drained at the start of `DrawScene()`
+   within a time budget, this should be more than enough to achieve good performance.
 */
 
 #pragma once
@@ -88,6 +122,10 @@
 #include <ECS/entt.hpp>
 #include "asset/shader.h"
 
+namespace asset {
+    class Texture;  // forward declaration
+}
+
 namespace scene {
 
     class Scene;  // forward declaration
@@ -113,6 +151,9 @@ namespace scene {
         static void SetFrontFace(bool ccw);
         static void SetViewport(GLuint width, GLuint height);
         static void SetShadowPass(unsigned int index);
+        static void SetLODError(float pixels, float hysteresis = 0.25f);
+        static void ClusterCulling(bool enable, bool occlusion = false);
+        static void BuildDepthPyramid(const asset::Texture& depth);
 
         // core event functions
         static void Attach(const std::string& title);
@@ -125,6 +166,7 @@ namespace scene {
 
         static void DrawScene();
         static void DrawImGui();
+        static void DrawLoadingScreen(float progress);
 
         // submit a variable number of entity ids to the render queue
         template<typename... Args>
@@ -0,0 +1,129 @@
+#include "pch.h"
+
+#include "core/job.h"
+#include "core/log.h"
+#include "asset/shader.h"
+#include "asset/stream.h"
+#include "asset/texture.h"
+#include "component/model.h"
+#include "scene/renderer.h"
+#include "scene/resource.h"
+#include "utils/image.h"
+#include "utils/profile.h"
+
+using namespace core;
+using namespace asset;
+using namespace component;
+
+namespace scene {
+
+    ResourceManager::~ResourceManager() {
+        // the upload jobs hold a pointer to this manager, they must finish before we go away
+        for (auto& load : loading) {
+            try {
+                load.upload.Wait();
+            }
+            catch (...) {}
+        }
+    }
+
+    Future<Texture> ResourceManager::LoadTexture(int key, const std::string& img_path, GLuint levels) {
+        auto image = std::make_shared<std::unique_ptr<utils::Image>>();
+        auto result = std::make_shared<asset_ref<Texture>>();
+
+        auto decode = JobSystem::Submit([image, img_path] {
+            *image = std::make_unique<utils::Image>(img_path);
+        });
+
+        auto upload = decode.ThenOnMainThread([this, key, levels, image, result] {
+            *result = MakeAsset<Texture>(**image, levels);
+            image->reset();  // release the pixels as soon as they are on the GPU
+            Add(key, *result);
+        });
+
+        loading.push_back({ decode, upload });
+        return Future<Texture>(upload, result);
+    }
+
+    Future<Texture> ResourceManager::LoadTexture(int key, const std::string& img_path, utils::bcn::Format format, bool stream) {
+        auto image = std::make_shared<std::unique_ptr<utils::BlockImage>>();
+        auto result = std::make_shared<asset_ref<Texture>>();
+
+        // on a cache miss, encoding is split into block rows that are spread across the workers
+        auto decode = JobSystem::Submit([image, img_path, format] {
+            *image = std::make_unique<utils::BlockImage>(img_path, format);
+        });
+
+        auto upload = decode.ThenOnMainThread([this, key, stream, image, result] {
+            if (stream) {
+                *result = TextureStreamer::Create(std::move(*image));  // the streamer keeps the file mapped
+            }
+            else {
+                *result = MakeAsset<Texture>(**image);
+                image->reset();  // unmap the cache file
+            }
+            Add(key, *result);
+        });
+
+        loading.push_back({ decode, upload });
+        return Future<Texture>(upload, result);
+    }
+
+    Future<Model> ResourceManager::LoadModel(int key, const std::string& filepath, Quality quality, bool animate) {
+        auto result = std::make_shared<asset_ref<Model>>();
+
+        auto decode = JobSystem::Submit([result, filepath, quality, animate] {
+            *result = Model::Import(filepath, quality, animate);
+        });
+
+        auto upload = decode.ThenOnMainThread([this, key, result] {
+            (*result)->Upload();
+            Add(key, *result);
+        });
+
+        loading.push_back({ decode, upload });
+        return Future<Model>(upload, result);
+    }
+
+    float ResourceManager::Progress() const {
+        if (loading.empty()) {
+            return 1.0f;
+        }
+
+        // each load counts as 2 steps, so that progress is made even before the first upload
+        size_t n_steps = 0;
+        for (const auto& load : loading) {
+            n_steps += static_cast<size_t>(load.decode.Done()) + static_cast<size_t>(load.upload.Done());
+        }
+
+        return n_steps / (2.0f * loading.size());
+    }
+
+    void ResourceManager::Wait() {
+        PROFILE_FUNCTION();
+        auto pending = [this] {
+            bool compiling = !Shader::Poll();  // finish the programs that the driver is done with
+            return compiling || std::any_of(loading.begin(), loading.end(), [](const Loading& load) { return !load.upload.Done(); });
+        };
+
+        // keep drawing frames while the workers are decoding and the driver is compiling shaders, so
+        // that the window stays responsive, uploads are executed in between frames, each frame takes
+        // only as many as the budget allows
+        while (pending()) {
+            JobSystem::ExecuteMainThreadJobs(JobSystem::main_thread_budget);
+            Renderer::DrawLoadingScreen(Progress());
+        }
+
+        for (auto& load : loading) {
+            try {
+                load.upload.Wait();
+            }
+            catch (const std::exception& e) {
+                CORE_ERROR("Failed to load asset: {0}", e.what());
+            }
+        }
+
+        loading.clear();
+    }
+
+}
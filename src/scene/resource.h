@@ -23,14 +23,38 @@
    despite the merits of a powerful manager, of course implementation does have a price.
    for apps with a small scope, it's also less beneficial so perhaps not worth the cost.
    for our demo, the main focus is on static rendering where we only care about in-scene
-   framerates and the number of draw calls, thus to make it easy, our scene and renderer
-   are not harnessing the power of parallelism by running on multiple threads, and most
-   resources will simply be loaded upfront, so there's really nothing to play with here.
+   framerates and the number of draw calls, thus to make it easy, most resources will be
+   loaded upfront when the scene is initialized, the only thing we care about is that the
+   loading time is as short as possible, see the async loading section below.
 
    for now, this class solely serves as a container to manage the lifetime of resources
    per scene level, each scene will have a `resource_manager` member whose scope is tied
    to the scene. Later on, we will upgrade it to a singleton that controls all scenes.
 
+   # async loading
+
+   decoding images and importing models is slow, but it doesn't need the OpenGL context, so
+   `LoadTexture()` and `LoadModel()` split the work in 2 stages: the file is decoded on one of
+   the worker threads, then a continuation uploads the data to the GPU on the main thread. The
+   uploads are executed by the main thread in small batches, under the time budget set in the
+   job system, so that we can keep drawing the loading screen in between. Once uploaded, the
+   asset is added to the manager under the given key, just as if `Add()` had been called.
+
+   > resource_manager.LoadModel(20, paths::model + "runestone.fbx", Quality::Auto);
+   > resource_manager.LoadTexture(21, paths::texture + "albedo.png");
+   > ...  // do other work on the main thread, the files are decoded in parallel
+   > resource_manager.Wait();  // draw the loading screen until all assets are uploaded
+   > auto texture = resource_manager.Get<Texture>(21);
+
+   each load also returns a `Future`, which can be polled or waited on individually, `Get()`
+   on a future blocks the main thread until the asset is ready, without drawing any frames.
+   the manager always waits for the pending loads before it's destructed, since the uploads
+   are going to add the assets into it. Passing a `bcn::Format` to `LoadTexture()` instead of
+   the number of levels loads a block-compressed texture, the first load encodes the image on
+   the workers and writes the cache, later loads simply map the cached mip chain. If `stream`
+   is set, the texture is handed to the `TextureStreamer` instead, only the tail mips are
+   uploaded and the finer levels are streamed in later on demand (see "asset/stream.h").
+
    # terminology
 
    unless otherwise stated, "asset" is defined as any object that holds OpenGL states or
@@ -75,20 +99,58 @@
 #pragma once
 
 #include <map>
+#include <string>
 #include <typeinfo>
 #include <typeindex>
+#include <vector>
+#include <glad/glad.h>
 #include "core/base.h"
+#include "core/job.h"
+
+namespace asset {
+    class Texture;
+}
+
+namespace utils::bcn {
+    enum class Format : uint8_t;
+}
+
+namespace component {
+    class Model;
+    enum class Quality : uint32_t;
+}
 
 namespace scene {
 
+    template<typename T>
+    class Future {
+      private:
+        core::JobHandle job;
+        asset_ref<asset_ref<T>> result;  // filled in by the upload job
+
+      public:
+        Future() = default;
+        Future(const core::JobHandle& job, const asset_ref<asset_ref<T>>& result) : job(job), result(result) {}
+
+        bool Ready() const { return job.Done(); }
+        asset_ref<T> Get() const;
+    };
+
     class ResourceManager {
       private:
         std::map<int, std::type_index> registry;
         std::map<int, asset_ref<void>> resources;
+
+        struct Loading {
+            core::JobHandle decode;  // runs on a worker thread
+            core::JobHandle upload;  // runs on the main thread
+        };
+
+        std::vector<Loading> loading;  // async loads that have not been waited on
         
       public:
         ResourceManager() {}
-        ~ResourceManager() {}
+        ~ResourceManager();
 
         template<typename T>
         void Add(int key, const asset_ref<T>& resource);
@@ -98,6 +160,13 @@ namespace scene {
 
         void Del(int key);
         void Clear();
+
+        Future<asset::Texture> LoadTexture(int key, const std::string& img_path, GLuint levels = 0);
+        Future<asset::Texture> LoadTexture(int key, const std::string& img_path, utils::bcn::Format format, bool stream = false);
+        Future<component::Model> LoadModel(int key, const std::string& filepath, component::Quality quality, bool animate = false);
+
+        float Progress() const;
+        void Wait();
     };
 
 }
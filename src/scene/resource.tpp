@@ -2,6 +2,17 @@
 
 namespace scene {
 
+    template<typename T>
+    inline asset_ref<T> Future<T>::Get() const {
+        if (result == nullptr) {
+            CORE_ERROR("Invalid future, the asset was never requested!");
+            return nullptr;
+        }
+
+        job.Wait();  // rethrows the exception if the load has failed
+        return *result;
+    }
+
     template<typename T>
     inline void ResourceManager::Add(int key, const asset_ref<T>& resource) {
         // ignore keys that are already in the registry
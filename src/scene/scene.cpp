@@ -53,7 +53,10 @@ namespace scene {
 
             // uniform blocks >= 10 are reserved for internal use only
             if (binding_point < 10) {
-                UBOs.try_emplace(binding_point, shader_id, idx);  // construct UBO in-place
+                auto [it, inserted] = UBOs.try_emplace(binding_point, shader_id, idx);  // construct UBO in-place
+                if (inserted) {
+                    it->second.MultiBuffer();  // scene UBOs are updated at most once per frame
+                }
             }
         }
     }
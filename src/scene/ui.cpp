@@ -25,6 +25,7 @@
 #include "scene/renderer.h"
 #include "scene/ui.h"
 #include "utils/path.h"
+#include "utils/profile.h"
 
 using namespace core;
 using namespace component;
@@ -233,8 +234,8 @@ namespace scene::ui {
             return true;
         }
 
-        CORE_ERROR("Failed to load inspector due to clipping issues...");
-        CORE_ERROR("Did you draw a full screen opaque window?");
+        CORE_ERROR_EVERY(1.0, "Failed to load inspector due to clipping issues...");
+        CORE_ERROR_EVERY(1.0, "Did you draw a full screen opaque window?");
         return false;
     }
 
@@ -542,9 +543,67 @@ namespace scene::ui {
         End();
     }
 
+    static void DrawProfilerWindow(bool* show) {
+        if (Window::layer == Layer::Scene) {
+            return;
+        }
+
+        SetNextWindowSize(ImVec2(420.0f, 360.0f), ImGuiCond_FirstUseEver);
+
+        if (!Begin("Profiler", show)) {
+            End();
+            return;
+        }
+
+        using utils::GPUProfiler;
+        const auto& sections = GPUProfiler::results;
+        const float frame_ms = static_cast<float>(GPUProfiler::FrameTime());
+
+        Checkbox("Enable", &GPUProfiler::enabled);
+        SameLine(0.0f, 20.0f);
+
+        if (Button("Export CPU Trace")) {
+            utils::CPUProfiler::Export(utils::paths::root + "trace-" + Clock::GetDateTimeUTC() + ".json");
+        }
+
+        DrawTooltip("Save the CPU timeline of all threads, open it in chrome://tracing or Perfetto.");
+        SameLine(0.0f, 20.0f);
+        TextColored(cyan, "Frame #%llu", static_cast<unsigned long long>(GPUProfiler::results_frame));
+        SameLine(0.0f, 20.0f);
+        TextColored(cyan, "Dropped: %llu", static_cast<unsigned long long>(GPUProfiler::dropped_frames));
+        DrawTooltip("Frames whose queries were not ready in time, they are dropped instead of stalling.");
+        Separator();
+
+        if (sections.empty()) {
+            TextDisabled("No GPU timings available yet...");
+        }
+
+        for (const auto& section : sections) {
+            float ratio = frame_ms > 0.0f ? static_cast<float>(section.ms) / frame_ms : 0.0f;
+            auto text_color = ratio > 0.3f ? red : (ratio > 0.1f ? yellow : green);
+
+            Indent(1.0f + 16.0f * section.depth);
+            if (section.count > 1) {
+                Text("%s (x%d)", section.name.c_str(), section.count);
+            }
+            else {
+                TextUnformatted(section.name.c_str());
+            }
+            Unindent(1.0f + 16.0f * section.depth);
+
+            SameLine(220.0f);
+            TextColored(text_color, "%7.3f ms", section.ms);
+            SameLine(0.0f, 10.0f);
+            ProgressBar(std::clamp(ratio, 0.0f, 1.0f), ImVec2(-1.0f, 0.0f), "");
+        }
+
+        End();
+    }
+
     void DrawMenuBar(std::string& new_title) {
         static bool show_about_window = false;
         static bool show_instructions = false;
+        static bool show_profiler = false;
         static bool show_home_popup = false;
         static bool music_on = true;
 
@@ -675,7 +734,7 @@ namespace scene::ui {
             }
 
             if (MenuItem(ICON_FK_COG)) {
-                // TODO: open profiler window
+                show_profiler = !show_profiler;
             }
             else if (IsItemHovered()) {
                 PushStyleColor(ImGuiCol_PopupBg, tooltip_bg_color);
@@ -713,6 +772,10 @@ namespace scene::ui {
             DrawAboutWindow("v1.0", &show_about_window);
         }
 
+        if (show_profiler) {
+            DrawProfilerWindow(&show_profiler);
+        }
+
         if (show_home_popup) {
             static const char* message = "\nDo you want to return to the main menu?\n\n";
             static const ImVec2 popup_size = ImVec2(360.0f, 172.0f);
@@ -755,7 +818,7 @@ namespace scene::ui {
             DrawTooltip("Time elapsed since application startup.");
 
             SameLine(0.0f, 15.0f); DrawVerticalLine(); SameLine(0.0f, 15.0f);
-            SameLine(GetWindowWidth() - 355);
+            SameLine(GetWindowWidth() - 495);
 
             TextColored(cyan, "FPS");
             SameLine(0.0f, 5.0f);
@@ -766,6 +829,13 @@ namespace scene::ui {
 
             SameLine(0.0f, 15.0f); DrawVerticalLine(); SameLine(0.0f, 15.0f);
 
+            TextColored(cyan, "GPU");
+            SameLine(0.0f, 5.0f);
+            Text("(%.2f ms)", utils::GPUProfiler::FrameTime());
+            DrawTooltip("GPU time of the frame, measured by timestamp queries a few frames ago.");
+
+            SameLine(0.0f, 15.0f); DrawVerticalLine(); SameLine(0.0f, 15.0f);
+
             TextColored(cyan, "Window");
             SameLine(0.0f, 5.0f);
             Text("(%d, %d)", Window::width, Window::height);
@@ -782,7 +852,7 @@ namespace scene::ui {
         draw_list->AddImage(id, ImVec2(0.0f, 0.0f), ImVec2(win_w, win_h));
     }
 
-    void DrawLoadingScreen() {
+    void DrawLoadingScreen(float progress) {
         const static float win_w = (float) Window::width;
         const static float win_h = (float) Window::height;
         const static float bar_w = 268.0f;
@@ -806,13 +876,15 @@ namespace scene::ui {
         const static float size = 20.0f;
         float r, g, b;
 
+        // the arrows are lit up as loading progresses, the remaining ones are dimmed
         for (float i = 0.0f; i < 1.0f; i += 0.05f, x += size * 1.5f) {
             r = (i <= 0.33f) ? 1.0f : ((i <= 0.66f) ? 1 - (i - 0.33f) * 3 : 0.0f);
             g = (i <= 0.33f) ? i * 3 : 1.0f;
             b = (i > 0.66f) ? (i - 0.66f) * 3 : 0.0f;
+            float a = (i < progress) ? 255.0f : 40.0f;
 
             draw_list->AddTriangleFilled(ImVec2(x, y - 0.5f * size), ImVec2(x, y + 0.5f * size),
-                ImVec2(x + size, y), IM_COL32(r * 255, g * 255, b * 255, 255.0f));
+                ImVec2(x + size, y), IM_COL32(r * 255, g * 255, b * 255, a));
         }
 
         End();
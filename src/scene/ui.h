@@ -41,7 +41,7 @@ namespace scene::ui {
     void DrawMenuBar(std::string& new_title);
     void DrawStatusBar(void);
     void DrawWelcomeScreen(ImTextureID id);
-    void DrawLoadingScreen(void);
+    void DrawLoadingScreen(float progress = 0.0f);
     void DrawCrosshair(void);
 
 }
@@ -0,0 +1,429 @@
+#include "pch.h"
+
+#include <cstring>
+#include "core/job.h"
+#include "core/log.h"
+#include "utils/bcn.h"
+#include "utils/profile.h"
+
+namespace utils::bcn {
+
+    // interpolation weights of BC7 4-bit indices, in 1/64 units
+    static constexpr int weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // BC7 blocks are little-endian 128-bit strings, fields are packed from the lowest bit up
+    class BitStream {
+      private:
+        uint64_t bits[2] = { 0, 0 };
+        unsigned int pos = 0;
+
+      public:
+        BitStream() = default;
+        explicit BitStream(const uint8_t src[16]) { std::memcpy(bits, src, 16); }
+
+        void Write(uint32_t value, unsigned int n_bits) {
+            for (unsigned int i = 0; i < n_bits; i++, pos++) {
+                bits[pos >> 6] |= static_cast<uint64_t>((value >> i) & 1) << (pos & 63);
+            }
+        }
+
+        uint32_t Read(unsigned int n_bits) {
+            uint32_t value = 0;
+            for (unsigned int i = 0; i < n_bits; i++, pos++) {
+                value |= static_cast<uint32_t>((bits[pos >> 6] >> (pos & 63)) & 1) << i;
+            }
+            return value;
+        }
+
+        void CopyTo(uint8_t dst[16]) const { std::memcpy(dst, bits, 16); }
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    size_t BlockSize(Format format) {
+        return format == Format::BC4 ? 8 : 16;
+    }
+
+    size_t CompressedSize(Format format, uint32_t width, uint32_t height) {
+        size_t n_blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+        return n_blocks * BlockSize(format);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    static void BC4Palette(uint8_t r0, uint8_t r1, uint8_t palette[8]) {
+        palette[0] = r0;
+        palette[1] = r1;
+
+        if (r0 > r1) {  // 6 interpolated values
+            for (int i = 2; i < 8; i++) {
+                palette[i] = static_cast<uint8_t>(((8 - i) * r0 + (i - 1) * r1) / 7);
+            }
+        }
+        else {  // 4 interpolated values, plus 0 and 255
+            for (int i = 2; i < 6; i++) {
+                palette[i] = static_cast<uint8_t>(((6 - i) * r0 + (i - 1) * r1) / 5);
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    void EncodeBC4(const uint8_t src[16], uint8_t dst[8]) {
+        uint8_t lo = 255, hi = 0;
+        for (int i = 0; i < 16; i++) {
+            lo = std::min(lo, src[i]);
+            hi = std::max(hi, src[i]);
+        }
+
+        // r0 > r1 selects the 8 levels mode, if the block is constant, r0 == r1 and all indices are 0
+        uint8_t palette[8];
+        BC4Palette(hi, lo, palette);
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_error = 256;
+            for (int j = 0; j < 8; j++) {
+                int error = std::abs(static_cast<int>(src[i]) - palette[j]);
+                if (error < best_error) {
+                    best = j;
+                    best_error = error;
+                }
+            }
+            indices |= static_cast<uint64_t>(best) << (3 * i);
+        }
+
+        dst[0] = hi;
+        dst[1] = lo;
+        for (int i = 0; i < 6; i++) {
+            dst[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+    }
+
+    void DecodeBC4(const uint8_t src[8], uint8_t dst[16]) {
+        uint8_t palette[8];
+        BC4Palette(src[0], src[1], palette);
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++) {
+            indices |= static_cast<uint64_t>(src[2 + i]) << (8 * i);
+        }
+
+        for (int i = 0; i < 16; i++) {
+            dst[i] = palette[(indices >> (3 * i)) & 0x7];
+        }
+    }
+
+    void EncodeBC5(const uint8_t r[16], const uint8_t g[16], uint8_t dst[16]) {
+        EncodeBC4(r, dst);
+        EncodeBC4(g, dst + 8);
+    }
+
+    void DecodeBC5(const uint8_t src[16], uint8_t r[16], uint8_t g[16]) {
+        DecodeBC4(src, r);
+        DecodeBC4(src + 8, g);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    struct Endpoints {
+        int q[2][4];  // 7-bit quantized endpoints
+        int p[2];     // p-bits
+    };
+
+    static inline int Unquantize(int q, int p) {
+        return (q << 1) | p;  // 7 bits + p-bit = 8 bits
+    }
+
+    static inline int Interpolate(int e0, int e1, int index) {
+        return ((64 - weights4[index]) * e0 + weights4[index] * e1 + 32) >> 6;
+    }
+
+    // quantize an endpoint to 7 bits per channel, trying both p-bits
+    static void QuantizeEndpoint(const float e[4], int q[4], int& p) {
+        float best_error = std::numeric_limits<float>::max();
+
+        for (int pbit = 0; pbit < 2; pbit++) {
+            int candidate[4];
+            float error = 0.0f;
+
+            for (int c = 0; c < 4; c++) {
+                float v = std::clamp(e[c], 0.0f, 255.0f);
+                candidate[c] = std::clamp(static_cast<int>(std::round((v - pbit) * 0.5f)), 0, 127);
+                float d = static_cast<float>(Unquantize(candidate[c], pbit)) - v;
+                error += d * d;
+            }
+
+            if (error < best_error) {
+                best_error = error;
+                std::memcpy(q, candidate, sizeof(candidate));
+                p = pbit;
+            }
+        }
+    }
+
+    // select the best index for every pixel, returns the total squared error
+    static int AssignIndices(const int px[16][4], const Endpoints& ep, uint8_t indices[16]) {
+        int palette[16][4];
+        for (int c = 0; c < 4; c++) {
+            int e0 = Unquantize(ep.q[0][c], ep.p[0]);
+            int e1 = Unquantize(ep.q[1][c], ep.p[1]);
+            for (int i = 0; i < 16; i++) {
+                palette[i][c] = Interpolate(e0, e1, i);
+            }
+        }
+
+        int total_error = 0;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_error = std::numeric_limits<int>::max();
+            for (int j = 0; j < 16; j++) {
+                int error = 0;
+                for (int c = 0; c < 4; c++) {
+                    int d = px[i][c] - palette[j][c];
+                    error += d * d;
+                }
+                if (error < best_error) {
+                    best = j;
+                    best_error = error;
+                }
+            }
+            indices[i] = static_cast<uint8_t>(best);
+            total_error += best_error;
+        }
+
+        return total_error;
+    }
+
+    // solve for the endpoints that minimize the error given the indices (least squares)
+    static bool FitEndpoints(const int px[16][4], const uint8_t indices[16], float e0[4], float e1[4]) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+
+        for (int i = 0; i < 16; i++) {
+            float w = weights4[indices[i]] / 64.0f;
+            aa += (1.0f - w) * (1.0f - w);
+            ab += (1.0f - w) * w;
+            bb += w * w;
+
+            for (int c = 0; c < 4; c++) {
+                ax[c] += (1.0f - w) * px[i][c];
+                bx[c] += w * px[i][c];
+            }
+        }
+
+        float det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f) {
+            return false;  // all pixels use the same index
+        }
+
+        for (int c = 0; c < 4; c++) {
+            e0[c] = (bb * ax[c] - ab * bx[c]) / det;
+            e1[c] = (aa * bx[c] - ab * ax[c]) / det;
+        }
+
+        return true;
+    }
+
+    void EncodeBC7(const uint8_t rgba[64], uint8_t dst[16]) {
+        int px[16][4];
+        float mean[4] = {};
+
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 4; c++) {
+                px[i][c] = rgba[i * 4 + c];
+                mean[c] += px[i][c] / 16.0f;
+            }
+        }
+
+        // covariance matrix of the block's colors
+        float cov[4][4] = {};
+        for (int i = 0; i < 16; i++) {
+            float d[4];
+            for (int c = 0; c < 4; c++) {
+                d[c] = px[i][c] - mean[c];
+            }
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++) {
+                    cov[r][c] += d[r] * d[c];
+                }
+            }
+        }
+
+        // principal axis by power iteration, starting from the channel with the highest variance,
+        // the diagonal of the covariance would be a bad seed: for two anti-correlated channels of
+        // equal variance (e.g. a red/green checker) it's orthogonal to the axis, and `cov * seed` is 0
+        int k = 0;
+        for (int c = 1; c < 4; c++) {
+            k = cov[c][c] > cov[k][k] ? c : k;
+        }
+
+        float axis[4] = {};
+        axis[k] = 1.0f;
+
+        for (int iter = 0; iter < 8 && cov[k][k] > 1e-6f; iter++) {
+            float next[4] = {};
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++) {
+                    next[r] += cov[r][c] * axis[c];
+                }
+            }
+
+            float norm = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+            if (norm < 1e-6f) {
+                break;  // the block is (nearly) constant
+            }
+
+            for (int c = 0; c < 4; c++) {
+                axis[c] = next[c] / norm;
+            }
+        }
+
+        // project the pixels onto the axis to find the extent of the colors
+        float t_min = std::numeric_limits<float>::max();
+        float t_max = std::numeric_limits<float>::lowest();
+
+        for (int i = 0; i < 16; i++) {
+            float t = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                t += (px[i][c] - mean[c]) * axis[c];
+            }
+            t_min = std::min(t_min, t);
+            t_max = std::max(t_max, t);
+        }
+
+        float e0[4], e1[4];
+        for (int c = 0; c < 4; c++) {
+            e0[c] = mean[c] + axis[c] * t_min;
+            e1[c] = mean[c] + axis[c] * t_max;
+        }
+
+        Endpoints best_ep;
+        uint8_t best_indices[16];
+        QuantizeEndpoint(e0, best_ep.q[0], best_ep.p[0]);
+        QuantizeEndpoint(e1, best_ep.q[1], best_ep.p[1]);
+        int best_error = AssignIndices(px, best_ep, best_indices);
+
+        // refine the endpoints with least squares, keep whichever is better
+        for (int iter = 0; iter < 2 && best_error > 0; iter++) {
+            if (!FitEndpoints(px, best_indices, e0, e1)) {
+                break;
+            }
+
+            Endpoints ep;
+            uint8_t indices[16];
+            QuantizeEndpoint(e0, ep.q[0], ep.p[0]);
+            QuantizeEndpoint(e1, ep.q[1], ep.p[1]);
+            int error = AssignIndices(px, ep, indices);
+
+            if (error >= best_error) {
+                break;
+            }
+
+            best_ep = ep;
+            best_error = error;
+            std::memcpy(best_indices, indices, 16);
+        }
+
+        // the MSB of the first index (the anchor) is implicitly 0, swap the endpoints if needed
+        if (best_indices[0] & 0x8) {
+            std::swap(best_ep.q[0], best_ep.q[1]);
+            std::swap(best_ep.p[0], best_ep.p[1]);
+            for (int i = 0; i < 16; i++) {
+                best_indices[i] = 15 - best_indices[i];
+            }
+        }
+
+        BitStream stream;
+        stream.Write(1 << 6, 7);  // mode 6
+
+        for (int c = 0; c < 4; c++) {
+            stream.Write(best_ep.q[0][c], 7);
+            stream.Write(best_ep.q[1][c], 7);
+        }
+
+        stream.Write(best_ep.p[0], 1);
+        stream.Write(best_ep.p[1], 1);
+        stream.Write(best_indices[0], 3);
+
+        for (int i = 1; i < 16; i++) {
+            stream.Write(best_indices[i], 4);
+        }
+
+        stream.CopyTo(dst);
+    }
+
+    void DecodeBC7(const uint8_t src[16], uint8_t rgba[64]) {
+        BitStream stream(src);
+        uint32_t mode = stream.Read(7);
+        CORE_ASERT(mode == (1 << 6), "Only BC7 mode 6 blocks can be decoded...");
+
+        int q[2][4], p[2];
+        for (int c = 0; c < 4; c++) {
+            q[0][c] = stream.Read(7);
+            q[1][c] = stream.Read(7);
+        }
+
+        p[0] = stream.Read(1);
+        p[1] = stream.Read(1);
+
+        for (int i = 0; i < 16; i++) {
+            int index = stream.Read(i == 0 ? 3 : 4);
+            for (int c = 0; c < 4; c++) {
+                int e0 = Unquantize(q[0][c], p[0]);
+                int e1 = Unquantize(q[1][c], p[1]);
+                rgba[i * 4 + c] = static_cast<uint8_t>(Interpolate(e0, e1, index));
+            }
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    std::vector<uint8_t> Compress(Format format, const uint8_t* rgba, uint32_t width, uint32_t height) {
+        PROFILE_FUNCTION();
+        uint32_t n_cols = (width + 3) / 4;
+        uint32_t n_rows = (height + 3) / 4;
+        size_t block_size = BlockSize(format);
+
+        std::vector<uint8_t> output(static_cast<size_t>(n_cols) * n_rows * block_size);
+
+        core::JobSystem::ParallelFor(0, n_rows, 0, [&](size_t begin, size_t end) {
+            uint8_t block[64];
+            uint8_t r[16], g[16];
+
+            for (size_t row = begin; row < end; row++) {
+                for (uint32_t col = 0; col < n_cols; col++) {
+                    // gather the 4x4 block, clamping to the edge of the image
+                    for (uint32_t y = 0; y < 4; y++) {
+                        uint32_t sy = std::min(static_cast<uint32_t>(row) * 4 + y, height - 1);
+                        for (uint32_t x = 0; x < 4; x++) {
+                            uint32_t sx = std::min(col * 4 + x, width - 1);
+                            std::memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+                        }
+                    }
+
+                    uint8_t* dst = output.data() + (row * n_cols + col) * block_size;
+
+                    if (format == Format::BC7) {
+                        EncodeBC7(block, dst);
+                        continue;
+                    }
+
+                    for (int i = 0; i < 16; i++) {
+                        r[i] = block[i * 4 + 0];
+                        g[i] = block[i * 4 + 1];
+                    }
+
+                    if (format == Format::BC5) {
+                        EncodeBC5(r, g, dst);
+                    }
+                    else {
+                        EncodeBC4(r, dst);
+                    }
+                }
+            }
+        });
+
+        return output;
+    }
+
+}
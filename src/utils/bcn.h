@@ -0,0 +1,57 @@
+/*
+   a CPU encoder for the block compression formats supported by every desktop GPU that runs
+   OpenGL 4.6, the image is divided into 4x4 blocks, each block is encoded independently into
+   a fixed number of bytes, so the GPU can decode any texel without touching other blocks. As
+   opposed to PNG or JPG, the texture stays compressed in video memory, which cuts down VRAM
+   usage and the bandwidth of texture fetches by 4x (BC7, BC5) to 8x (BC4) vs. RGBA8.
+
+   > BC4: 1 channel,  8 bytes per block, 2 endpoints + 8 levels, for masks (roughness, ao...)
+   > BC5: 2 channels, 16 bytes per block, 2 x BC4, for tangent-space normal maps (z is derived)
+   > BC7: 4 channels, 16 bytes per block, for color textures (albedo, emission...)
+
+   # BC7
+
+   BC7 has 8 modes that trade off the number of subsets, endpoint precision and index bits,
+   a full encoder searches through all of them, which is very slow. We only use mode 6, which
+   has a single subset, RGBA 7.7.7.7 endpoints plus a shared p-bit each, and 4-bit indices.
+   mode 6 alone is a good fit for smooth and noisy textures alike, and has reasonable quality
+   for most albedo maps, blocks with sharp edges between several colors are its weak point.
+
+   endpoints are picked along the principal axis of the block's colors (PCA), then refined by
+   least squares on the selected indices, which converges within a couple of iterations.
+
+   # usage
+
+   the encoder is pure CPU code with no dependency on OpenGL, so it can be used anywhere (e.g.
+   in a tool or a unit test). `Compress()` encodes an RGBA8 image of any size, blocks on the
+   right and bottom edges are padded by clamping, rows of blocks are encoded in parallel by
+   the job system. The decoders are the reference of the bit layouts and used for validation.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace utils::bcn {
+
+    enum class Format : uint8_t {
+        BC4 = 4,  // R
+        BC5 = 5,  // RG
+        BC7 = 7   // RGBA
+    };
+
+    size_t BlockSize(Format format);  // number of bytes per 4x4 block
+    size_t CompressedSize(Format format, uint32_t width, uint32_t height);
+
+    void EncodeBC4(const uint8_t src[16], uint8_t dst[8]);
+    void EncodeBC5(const uint8_t r[16], const uint8_t g[16], uint8_t dst[16]);
+    void EncodeBC7(const uint8_t rgba[64], uint8_t dst[16]);
+
+    void DecodeBC4(const uint8_t src[8], uint8_t dst[16]);
+    void DecodeBC5(const uint8_t src[16], uint8_t r[16], uint8_t g[16]);
+    void DecodeBC7(const uint8_t src[16], uint8_t rgba[64]);  // mode 6 only
+
+    std::vector<uint8_t> Compress(Format format, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+}
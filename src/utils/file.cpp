@@ -0,0 +1,112 @@
+#include "pch.h"
+
+#include <cstring>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "core/log.h"
+#include "utils/file.h"
+
+namespace utils {
+
+    MappedFile::MappedFile(const std::string& filepath) {
+        file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE) {
+            file = nullptr;
+            return;  // the file doesn't exist, which is normal for a cache miss
+        }
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            return;  // empty files cannot be mapped
+        }
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            CORE_ERROR("Unable to create file mapping: {0} (error = {1})", filepath, GetLastError());
+            return;
+        }
+
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (data == nullptr) {
+            CORE_ERROR("Unable to map view of file: {0} (error = {1})", filepath, GetLastError());
+            return;
+        }
+
+        size = static_cast<size_t>(file_size.QuadPart);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+
+        if (file != nullptr) {
+            CloseHandle(file);
+        }
+    }
+
+    uint64_t Hash64(const void* data, size_t size, uint64_t seed) {
+        constexpr uint64_t prime = 0x100000001B3ULL;
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t hash = seed;
+
+        size_t n_words = size / 8;
+        for (size_t i = 0; i < n_words; i++) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i * 8, 8);  // unaligned load
+            hash = (hash ^ word) * prime;
+        }
+
+        for (size_t i = n_words * 8; i < size; i++) {
+            hash = (hash ^ bytes[i]) * prime;
+        }
+
+        return hash;
+    }
+
+    uint64_t HashFile(const std::string& filepath) {
+        auto file = MappedFile(filepath);
+        if (!file.Valid()) {
+            return 0;
+        }
+
+        return Hash64(file.Data(), file.Size());
+    }
+
+    bool WriteFileAtomic(const std::string& filepath, const void* data, size_t size) {
+        // write to a temporary file first then rename it, so that readers never see a partial
+        // file, and concurrent writers (e.g. two workers loading the same model) don't collide
+        std::ostringstream tmp_path;
+        tmp_path << filepath << "." << std::this_thread::get_id() << ".tmp";
+
+        if (auto stream = std::ofstream(tmp_path.str(), std::ios::binary | std::ios::trunc); true) {
+            stream.write(static_cast<const char*>(data), size);
+
+            if (!stream.good()) {
+                CORE_ERROR("Failed to write file: {0}", tmp_path.str());
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tmp_path.str(), filepath, error);
+
+        if (error) {
+            CORE_ERROR("Failed to replace file: {0} ({1})", filepath, error.message());
+            std::filesystem::remove(tmp_path.str(), error);
+            return false;
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,53 @@
+/*
+   helpers for the binary caches stored under `paths::cache`, which let us skip expensive work
+   such as model importing on the next run. A cache file is always validated against a hash
+   of its source file, so that it's silently rebuilt whenever the source has been modified.
+
+   # memory mapping
+
+   `MappedFile` maps a whole file into the address space as read-only, the OS pages it in on
+   demand, so opening a large file is almost free, and the data can be handed over to OpenGL
+   straight from the mapping without an intermediate copy. The mapping stays valid until the
+   object is destructed, pointers into it must not outlive the object.
+
+   # hashing
+
+   `Hash64()` is a 64-bit FNV-1a that consumes 8 bytes at a time, it's not cryptographic, but
+   it's fast enough to hash a source file of several hundred MBs on every load, which is more
+   reliable than checking timestamps (e.g. files checked out from git have fresh timestamps).
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace utils {
+
+    class MappedFile {
+      private:
+        void* file = nullptr;     // Win32 file handle
+        void* mapping = nullptr;  // Win32 file mapping handle
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+      public:
+        explicit MappedFile(const std::string& filepath);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) = delete;
+        MappedFile& operator=(MappedFile&& other) = delete;
+
+        bool Valid() const { return data != nullptr; }
+        const uint8_t* Data() const { return data; }
+        size_t Size() const { return size; }
+    };
+
+    uint64_t Hash64(const void* data, size_t size, uint64_t seed = 0xCBF29CE484222325ULL);
+    uint64_t HashFile(const std::string& filepath);  // returns 0 if the file cannot be read
+
+    bool WriteFileAtomic(const std::string& filepath, const void* data, size_t size);
+
+}
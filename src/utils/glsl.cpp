@@ -0,0 +1,215 @@
+#include "pch.h"
+
+#include <mutex>
+#include "core/log.h"
+#include "utils/glsl.h"
+#include "utils/profile.h"
+
+namespace fs = std::filesystem;
+
+namespace utils::glsl {
+
+    struct File {
+        fs::file_time_type mtime;
+        std::vector<std::string> chunks;    // text between the includes, one more than includes
+        std::vector<std::string> includes;  // normalized paths of the included files
+        size_t marker = std::string::npos;  // offset of the first directive in `chunks[0]`
+        bool once = false;                  // has "#pragma once"
+    };
+
+    static std::mutex mutex;  // guards the cache and the graph
+    static std::unordered_map<std::string, std::shared_ptr<const File>> cache;
+    static std::unordered_map<std::string, std::set<std::string>> included_by;  // reversed include edges
+
+    static std::shared_ptr<File> Parse(const std::string& filepath) {
+        std::ifstream file_stream = std::ifstream(filepath, std::ios::in);
+        if (!file_stream.is_open()) {
+            return nullptr;
+        }
+
+        auto file = std::make_shared<File>();
+        file->chunks.emplace_back();
+        file->chunks.back().reserve(8192);
+
+        auto directory = fs::path(filepath).parent_path();
+        std::string line;
+
+        while (std::getline(file_stream, line)) {
+            bool is_include = line.find("#include") != std::string::npos;
+            bool is_ifdef = line.find("#ifdef") != std::string::npos;
+
+            // the stage macro goes right before the first "#ifdef" or "#include" of the source file
+            if ((is_include || is_ifdef) && file->marker == std::string::npos && file->includes.empty()) {
+                file->marker = file->chunks[0].size();
+            }
+
+            if (line.find("#pragma once") == 0) {
+                file->once = true;
+                continue;
+            }
+
+            if (is_include) {
+                size_t open = line.find('"');
+                size_t close = line.rfind('"');
+
+                if (open != std::string::npos && close > open) {
+                    std::string relative_path = line.substr(open + 1, close - open - 1);
+                    file->includes.push_back(Normalize((directory / relative_path).string()));
+                    file->chunks.emplace_back();
+                    continue;
+                }
+
+                CORE_WARN("Invalid #include directive in {0}: {1}", filepath, line);
+            }
+
+            file->chunks.back().append(line).push_back('\n');
+        }
+
+        file->chunks.back().push_back('\n');
+        return file;
+    }
+
+    static std::shared_ptr<const File> Load(const std::string& filepath) {
+        std::error_code error;
+        auto mtime = fs::last_write_time(filepath, error);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (auto it = cache.find(filepath); it != cache.end() && !error && it->second->mtime == mtime) {
+            return it->second;
+        }
+
+        auto file = Parse(filepath);
+        if (file == nullptr) {
+            return nullptr;
+        }
+
+        file->mtime = mtime;
+
+        // replace the outgoing edges of this file in the include graph
+        for (auto& [header, parents] : included_by) {
+            parents.erase(filepath);
+        }
+
+        for (const auto& header : file->includes) {
+            included_by[header].insert(filepath);
+        }
+
+        cache.insert_or_assign(filepath, file);
+        return file;
+    }
+
+    static void Expand(const std::string& filepath, std::string& output, Program& program, std::set<std::string>& once) {
+        auto file = Load(filepath);
+        if (file == nullptr) {
+            CORE_ERROR("Unable to read shader file {0} ... ", filepath);
+            return;
+        }
+
+        if (file->once && !once.insert(filepath).second) {
+            return;  // already expanded in this program
+        }
+
+        if (std::find(program.files.begin(), program.files.end(), filepath) == program.files.end()) {
+            program.files.push_back(filepath);
+        }
+
+        for (size_t i = 0; i < file->chunks.size(); i++) {
+            output += file->chunks[i];
+            if (i < file->includes.size()) {
+                Expand(file->includes[i], output, program, once);
+            }
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    std::string Normalize(const std::string& filepath) {
+        return fs::path(filepath).lexically_normal().make_preferred().string();
+    }
+
+    bool Program::HasStage(const std::string& macro) const {
+        return suffix.find("#ifdef " + macro) != std::string::npos;
+    }
+
+    std::string Program::Stage(const std::string& macro) const {
+        std::string define = "#ifndef " + macro + "\n#define " + macro + "\n#endif\n\n";
+
+        std::string output;
+        output.reserve(prefix.size() + define.size() + suffix.size());
+        output.append(prefix).append(define).append(suffix);
+        return output;
+    }
+
+    Program Preprocess(const std::string& filepath) {
+        PROFILE_FUNCTION();
+        std::string path = Normalize(filepath);
+        std::set<std::string> once;
+        Program program;
+
+        auto file = Load(path);
+        if (file == nullptr) {
+            CORE_ERROR("Unable to read shader file {0} ... ", path);
+            return program;
+        }
+
+        once.insert(path);
+        program.files.push_back(path);
+
+        // the source file is split at the marker, everything before it goes to the prefix
+        size_t marker = std::min(file->marker, file->chunks[0].size());
+        program.prefix = file->chunks[0].substr(0, marker);
+
+        if (file->marker == std::string::npos) {
+            return program;  // no directives at all, there's no stage to compile
+        }
+
+        std::string& output = program.suffix;
+        output.reserve(65536);
+        output.append(file->chunks[0], marker);
+
+        for (size_t i = 0; i < file->includes.size(); i++) {
+            Expand(file->includes[i], output, program, once);
+            output += file->chunks[i + 1];
+        }
+
+        return program;
+    }
+
+    std::vector<std::string> Dependents(const std::string& filepath) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> dependents;
+        std::set<std::string> visited;
+        std::queue<std::string> queue;
+        queue.push(Normalize(filepath));
+
+        // walk the reversed include edges, breadth first
+        while (!queue.empty()) {
+            std::string file = queue.front();
+            queue.pop();
+
+            if (auto it = included_by.find(file); it != included_by.end()) {
+                for (const auto& parent : it->second) {
+                    if (visited.insert(parent).second) {
+                        dependents.push_back(parent);
+                        queue.push(parent);
+                    }
+                }
+            }
+        }
+
+        return dependents;
+    }
+
+    void Invalidate(const std::string& filepath) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cache.erase(Normalize(filepath));
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cache.clear();
+        included_by.clear();
+    }
+
+}
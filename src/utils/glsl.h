@@ -0,0 +1,61 @@
+/*
+   a small GLSL preprocessor that resolves "#include" for the shader class, every stage of a
+   program is built from the same ".glsl" file (see "asset/shader.h"), the only difference is
+   the stage macro (e.g. "vertex_shader") that's defined before the first directive, so the
+   file and its includes are expanded only once per program, and the stage sources are cut
+   from the same flattened text by inserting a different macro each time.
+
+   # file cache
+
+   the contents of every file that has been read are cached, split into text chunks and the
+   list of files it includes, so a header like "pbr_shading.glsl" that's included by a dozen
+   programs is read and parsed only once. Each file's last write time is checked whenever it
+   is expanded, a file that has changed on disk is simply parsed again, `Invalidate()` can
+   also drop a file from the cache explicitly.
+
+   # include once
+
+   a header that contains the line "#pragma once" is expanded at most once per program, any
+   later "#include" of it is skipped, the line itself is removed since the pragma means nothing
+   to the GLSL compiler. Without it, headers are expanded every time they're included, so they
+   must be protected by "#ifndef/#define" guards as usual. Note that guards are evaluated per
+   stage while the pragma is not, so a header that is included inside a stage block should use
+   guards (or be included once at the top of the file, outside of any stage block).
+
+   # dependency graph
+
+   the cache keeps track of which files include which, `Dependents()` returns every file that
+   includes the given one directly or indirectly, so that when a header changes we know which
+   programs need to be rebuilt, `Program::files` lists the source file and all of its includes.
+
+   > auto program = glsl::Preprocess(paths::shader + "scene_01\\pbr.glsl");
+   > if (program.HasStage("vertex_shader")) { auto code = program.Stage("vertex_shader"); }
+
+   all functions are thread-safe, file paths are normalized so that "a/../b.glsl" and "b.glsl"
+   refer to the same entry, `Normalize()` gives the form used as the key in the cache.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace utils::glsl {
+
+    struct Program {
+        std::string prefix;  // flattened text before the first directive of the source file
+        std::string suffix;  // flattened text from the first directive to the end
+        std::vector<std::string> files;  // the source file followed by all of its includes
+
+        bool HasStage(const std::string& macro) const;
+        std::string Stage(const std::string& macro) const;
+    };
+
+    std::string Normalize(const std::string& filepath);
+    Program Preprocess(const std::string& filepath);
+
+    std::vector<std::string> Dependents(const std::string& filepath);
+    void Invalidate(const std::string& filepath);
+    void Clear();
+
+}
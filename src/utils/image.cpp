@@ -6,20 +6,277 @@
 #endif
 #include <stb_image.h>
 
+#include <cstring>
+#include "core/job.h"
 #include "core/log.h"
 #include "utils/ext.h"
 #include "utils/image.h"
+#include "utils/imgproc.h"
+#include "utils/path.h"
+#include "utils/profile.h"
 
 namespace utils {
 
+    // decoded HDRIs are large (a 4K panorama takes 64 MB in half floats) and tend to be loaded
+    // back to back (e.g. every scene precomputes its IBL maps), so their pixel buffers are kept
+    // in a small pool for reuse, which saves us from page faulting in fresh memory every time
+    static std::mutex pool_mutex;
+    static std::vector<std::pair<size_t, uint8_t*>> pool;  // capacity and buffer
+    static constexpr size_t max_pooled = 2;
+
+    static uint8_t* AcquireBuffer(size_t size, size_t& capacity) {
+        std::lock_guard lock(pool_mutex);
+        auto best = pool.end();
+
+        for (auto it = pool.begin(); it != pool.end(); ++it) {
+            if (it->first >= size && (best == pool.end() || it->first < best->first)) {
+                best = it;
+            }
+        }
+
+        if (best != pool.end()) {
+            uint8_t* buffer = best->second;
+            capacity = best->first;
+            pool.erase(best);
+            return buffer;
+        }
+
+        capacity = size;
+        return new uint8_t[size];
+    }
+
+    static void ReleaseBuffer(uint8_t* buffer, size_t capacity) {
+        std::lock_guard lock(pool_mutex);
+        if (pool.size() < max_pooled) {
+            pool.emplace_back(capacity, buffer);
+        }
+        else {
+            delete[] buffer;
+        }
+    }
+
     void Image::deleter::operator()(uint8_t* buffer) {
-        if (buffer != nullptr) {
+        if (buffer == nullptr) {
+            return;
+        }
+
+        if (pooled > 0) {
+            ReleaseBuffer(buffer, pooled);
+        }
+        else {
             stbi_image_free(buffer);
         }
     }
 
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Radiance RGBE (.hdr) file, we only handle the common layout written by most tools, which
+    // is "-Y height +X width" with new-style RLE scanlines, anything else is left to `stb`
+    struct Radiance {
+        int width = 0, height = 0;
+        std::vector<size_t> scanlines;  // byte offset of each scanline
+    };
+
+    static bool ParseRadiance(const uint8_t* data, size_t size, Radiance& hdr) {
+        size_t pos = 0;
+
+        auto next_line = [&]() -> std::string_view {
+            size_t start = pos;
+            while (pos < size && data[pos] != '\n') {
+                pos++;
+            }
+            auto line = std::string_view(reinterpret_cast<const char*>(data + start), pos - start);
+            pos = std::min(pos + 1, size);
+            return line;
+        };
+
+        if (next_line().substr(0, 2) != "#?") {
+            return false;
+        }
+
+        for (auto line = next_line(); !line.empty(); line = next_line()) {
+            if (line.substr(0, 7) == "FORMAT=" && line != "FORMAT=32-bit_rle_rgbe") {
+                return false;
+            }
+            if (pos >= size) {
+                return false;
+            }
+        }
+
+        std::string resolution(next_line());
+        if (std::sscanf(resolution.c_str(), "-Y %d +X %d", &hdr.height, &hdr.width) != 2) {
+            return false;
+        }
+
+        int w = hdr.width;
+        if (w < 8 || w > 0x7FFF || hdr.height <= 0) {
+            return false;  // such scanlines are never run-length encoded
+        }
+
+        // find where each scanline starts, this pass only reads the run lengths so it's fast,
+        // but it has to be sequential since scanlines are compressed to different sizes
+        hdr.scanlines.reserve(hdr.height);
+
+        for (int y = 0; y < hdr.height; y++) {
+            if (pos + 4 > size || data[pos] != 2 || data[pos + 1] != 2 || ((data[pos + 2] << 8) | data[pos + 3]) != w) {
+                return false;
+            }
+
+            hdr.scanlines.push_back(pos);
+            pos += 4;
+
+            for (int c = 0; c < 4; c++) {
+                for (int x = 0; x < w;) {
+                    if (pos >= size) {
+                        return false;
+                    }
+
+                    int count = data[pos++];
+                    if (count > 128) {
+                        count -= 128;
+                        pos += 1;
+                    }
+                    else {
+                        pos += count;
+                    }
+
+                    x += count;
+                    if (count == 0 || x > w) {
+                        return false;
+                    }
+                }
+            }
+
+            if (pos > size) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // the 4 channels of a scanline are stored one after another, each as a series of runs
+    static void DecodeScanline(const uint8_t* src, int width, uint8_t* rgbe) {
+        src += 4;  // skip the scanline header
+
+        for (int c = 0; c < 4; c++) {
+            for (int x = 0; x < width;) {
+                int count = *src++;
+
+                if (count > 128) {
+                    uint8_t value = *src++;
+                    for (count -= 128; count > 0; count--, x++) {
+                        rgbe[x * 4 + c] = value;
+                    }
+                }
+                else {
+                    for (; count > 0; count--, x++) {
+                        rgbe[x * 4 + c] = *src++;
+                    }
+                }
+            }
+        }
+    }
+
+    static void ReportHDR(const imgproc::HDRStats& stats) {
+        float log_average_luminance = stats.LogAverage();
+
+        CORE_TRACE("HDR image luminance report:");
+        CORE_TRACE("------------------------------------------------------------------------");
+        CORE_DEBUG("min: {0}, max: {1}, log average: {2}", stats.min_luminance, stats.max_luminance, log_average_luminance);
+        CORE_TRACE("------------------------------------------------------------------------");
+
+        float luminance_diff = stats.max_luminance - stats.min_luminance;
+        if (luminance_diff > 10000.0f) {
+            CORE_WARN("Input HDR image is too bright, some pixels have values close to infinity!");
+            CORE_WARN("This can lead to serious artifact in IBL or even completely white images!");
+            CORE_WARN("Please use a different image or manually adjust the exposure values (EV)!");
+        }
+    }
+
+    bool Image::DecodeRadiance(const std::string& filepath, bool flip) {
+        auto file = MappedFile(filepath);
+        Radiance hdr;
+
+        if (!file.Valid() || !ParseRadiance(file.Data(), file.Size(), hdr)) {
+            return false;
+        }
+
+        width = hdr.width;
+        height = hdr.height;
+        n_channels = 3;  // RGBE carries no alpha, it's filled with 1.0
+
+        size_t capacity = 0;
+        size_t row_size = static_cast<size_t>(width) * 4;
+        uint8_t* buffer = AcquireBuffer(row_size * height * sizeof(uint16_t), capacity);
+        pixels = std::unique_ptr<uint8_t, deleter>(buffer, deleter { capacity });
+
+        uint16_t* output = reinterpret_cast<uint16_t*>(buffer);
+
+        // RGBE decodes to mantissa * 2^(exponent - 136), or 0 if the exponent is 0
+        float scale[256] = { 0.0f };
+        for (int e = 1; e < 256; e++) {
+            scale[e] = std::ldexp(1.0f, e - 136);
+        }
+
+        constexpr size_t rows_per_job = 16;
+        std::vector<imgproc::HDRStats> partial((height + rows_per_job - 1) / rows_per_job);
+
+        // each scanline is decoded, converted to float and then to half on the fly, so the whole
+        // image never exists in 32-bit floats, only a single row per worker does
+        core::JobSystem::ParallelFor(0, height, rows_per_job, [&](size_t begin, size_t end) {
+            std::vector<uint8_t> rgbe(row_size);
+            std::vector<float> row(row_size);
+            auto& stats = partial[begin / rows_per_job];
+
+            for (size_t y = begin; y < end; y++) {
+                DecodeScanline(file.Data() + hdr.scanlines[y], width, rgbe.data());
+
+                for (size_t i = 0; i < row_size; i += 4) {
+                    float s = scale[rgbe[i + 3]];
+                    row[i + 0] = rgbe[i + 0] * s;
+                    row[i + 1] = rgbe[i + 1] * s;
+                    row[i + 2] = rgbe[i + 2] * s;
+                    row[i + 3] = 1.0f;
+                }
+
+                size_t dst_row = flip ? height - 1 - y : y;
+                stats.Merge(imgproc::HDRToHalf(row.data(), output + dst_row * row_size, width));
+            }
+        });
+
+        imgproc::HDRStats stats;
+        for (const auto& chunk : partial) {
+            stats.Merge(chunk);
+        }
+
+        ReportHDR(stats);
+        return true;
+    }
+
+    bool Image::DecodeFloat(const std::string& filepath) {
+        // fallback for HDR files that we can't decode ourselves, `stb` loads them in full floats
+        float* buffer = stbi_loadf(filepath.c_str(), &width, &height, &n_channels, 4);
+
+        if (buffer == nullptr) {
+            CORE_ERROR("Failed to load image: {0}", filepath);
+            CORE_ERROR("STBI failure reason: {0}", stbi_failure_reason());
+            return false;
+        }
+
+        size_t capacity = 0;
+        size_t n_pixels = static_cast<size_t>(width) * height;
+        uint8_t* halfs = AcquireBuffer(n_pixels * 4 * sizeof(uint16_t), capacity);
+        pixels = std::unique_ptr<uint8_t, deleter>(halfs, deleter { capacity });
+
+        ReportHDR(imgproc::HDRToHalf(buffer, reinterpret_cast<uint16_t*>(halfs), n_pixels));
+        stbi_image_free(buffer);
+        return true;
+    }
+
     Image::Image(const std::string& filepath, GLuint channels, bool flip) : width(0), height(0), n_channels(0) {
-        stbi_set_flip_vertically_on_load(flip);
+        PROFILE_FUNCTION();
+        stbi_set_flip_vertically_on_load_thread(flip);  // per thread, images can be decoded on workers
 
         // supported file extensions (will support ".psd", ".tga" and ".gif" in the future)
         const std::vector<std::string> extensions { ".jpg", ".png", ".jpeg", ".bmp", ".hdr", ".exr" };
@@ -35,46 +292,9 @@ namespace utils {
         this->is_hdr = stbi_is_hdr(filepath.c_str());
 
         if (is_hdr) {
-            float* buffer = stbi_loadf(filepath.c_str(), &width, &height, &n_channels, 4);
-
-            if (buffer == nullptr) {
-                CORE_ERROR("Failed to load image: {0}", filepath);
-                CORE_ERROR("STBI failure reason: {0}", stbi_failure_reason());
+            if (!DecodeRadiance(filepath, flip) && !DecodeFloat(filepath)) {
                 return;
             }
-
-            // report HDR image statistics before the buffer pointer is reset
-            size_t n_pixels = width * height;
-            float min_luminance = std::numeric_limits<float>::max();
-            float max_luminance = std::numeric_limits<float>::min();
-            float sum_log_luminance = 0.0f;
-
-            for (size_t i = 0; i < n_pixels; i++) {
-                const float* pixel_ptr = buffer + (i * 3);  // move forward 3 channels
-
-                auto color = glm::vec3(pixel_ptr[0], pixel_ptr[1], pixel_ptr[2]);
-                auto luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
-
-                min_luminance = std::min(min_luminance, luminance);
-                max_luminance = std::max(max_luminance, luminance);
-                sum_log_luminance += std::max(log(luminance + 0.00001f), 0.0f);  // avoid division by zero
-            }
-
-            float log_average_luminance = exp(sum_log_luminance / n_pixels);
-
-            CORE_TRACE("HDR image luminance report:");
-            CORE_TRACE("------------------------------------------------------------------------");
-            CORE_DEBUG("min: {0}, max: {1}, log average: {2}", min_luminance, max_luminance, log_average_luminance);
-            CORE_TRACE("------------------------------------------------------------------------");
-
-            float luminance_diff = max_luminance - min_luminance;
-            if (luminance_diff > 10000.0f) {
-                CORE_WARN("Input HDR image is too bright, some pixels have values close to infinity!");
-                CORE_WARN("This can lead to serious artifact in IBL or even completely white images!");
-                CORE_WARN("Please use a different image or manually adjust the exposure values (EV)!");
-            }
-            
-            pixels.reset(reinterpret_cast<uint8_t*>(buffer));
         }
 
         else {
@@ -87,6 +307,11 @@ namespace utils {
                 return;
             }
 
+            // `n_channels` is the number of channels in the file, the buffer has as many as we asked for
+            if (channels > 0) {
+                n_channels = channels;
+            }
+
             pixels.reset(buffer);
         }
 
@@ -137,6 +362,10 @@ namespace utils {
         }
     }
 
+    GLenum Image::Type() const {
+        return is_hdr ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE;
+    }
+
     template<typename T>
     const T* Image::GetPixels() const {
         return reinterpret_cast<const T*>(pixels.get());
@@ -144,6 +373,203 @@ namespace utils {
 
     // explicit template function instantiation
     template const uint8_t* Image::GetPixels<uint8_t>() const;
-    template const float* Image::GetPixels<float>() const;
+    template const uint16_t* Image::GetPixels<uint16_t>() const;  // half floats
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    // DDS file layout, see https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+    struct DDSPixelFormat {
+        uint32_t size, flags, fourcc, rgb_bit_count;
+        uint32_t r_mask, g_mask, b_mask, a_mask;
+    };
+
+    struct DDSHeader {
+        uint32_t magic;  // "DDS "
+        uint32_t size, flags, height, width, pitch_or_linear_size, depth, mip_map_count;
+        uint32_t reserved1[11];  // [0] = our tag, [1] = version, [2..3] = source hash
+        DDSPixelFormat pixel_format;
+        uint32_t caps, caps2, caps3, caps4, reserved2;
+    };
+
+    struct DDSHeaderDX10 {
+        uint32_t dxgi_format, resource_dimension, misc_flag, array_size, misc_flags2;
+    };
+
+    struct DDSFile {
+        DDSHeader header;
+        DDSHeaderDX10 dx10;
+    };
+
+    static_assert(sizeof(DDSHeader) == 128 && sizeof(DDSHeaderDX10) == 20);
+
+    static constexpr uint32_t FourCC(char a, char b, char c, char d) {
+        return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+    }
+
+    static constexpr uint32_t dds_magic = FourCC('D', 'D', 'S', ' ');
+    static constexpr uint32_t dds_tag = FourCC('S', 'K', 'P', 'D');
+    static constexpr uint32_t dds_version = 2;  // 2: Kaiser filtered mipmaps
+
+    static uint32_t DXGIFormat(bcn::Format format) {
+        switch (format) {
+            case bcn::Format::BC4: return 80;  // DXGI_FORMAT_BC4_UNORM
+            case bcn::Format::BC5: return 83;  // DXGI_FORMAT_BC5_UNORM
+            case bcn::Format::BC7: return 98;  // DXGI_FORMAT_BC7_UNORM
+            default: return 0;
+        }
+    }
+
+    BlockImage::BlockImage(const std::string& filepath, bcn::Format format) : format(format) {
+        PROFILE_FUNCTION();
+        uint64_t source_hash = HashFile(filepath);
+        std::string cache_path = CachePath(filepath, format);
+
+        if (source_hash == 0) {
+            throw std::runtime_error("Unable to read image file: " + filepath);
+        }
+
+        if (LoadCache(cache_path, source_hash)) {
+            CORE_INFO("Loading compressed image from cache: {0}", cache_path);
+            return;
+        }
+
+        auto image = Image(filepath, 4);  // always read RGBA, the encoder picks the channels it needs
+        if (image.GetPixels<uint8_t>() == nullptr) {
+            throw std::runtime_error("Unable to claim image data from: " + filepath);
+        }
+
+        if (image.IsHDR()) {
+            throw std::runtime_error("Block compression of HDR images is not supported: " + filepath);
+        }
+
+        this->width = image.Width();
+        this->height = image.Height();
+
+        // BC7 is meant for color maps (sRGB), BC5 for normal maps and BC4 for data maps
+        auto space = format == bcn::Format::BC7 ? imgproc::Space::sRGB
+                   : format == bcn::Format::BC5 ? imgproc::Space::Normal : imgproc::Space::Linear;
+
+        auto pixels = image.GetPixels<uint8_t>();
+        auto mipmaps = imgproc::GenerateMips(pixels, width, height, imgproc::Filter::Kaiser, space);
+
+        for (GLuint i = 0, w = width, h = height; i <= mipmaps.size(); i++, w = std::max(w / 2, 1U), h = std::max(h / 2, 1U)) {
+            auto blocks = bcn::Compress(format, i == 0 ? pixels : mipmaps[i - 1].data(), w, h);
+            offsets.push_back(storage.size());
+            storage.insert(storage.end(), blocks.begin(), blocks.end());
+        }
+
+        data = storage.data();
+        SaveCache(cache_path, source_hash);
+    }
+
+    bool BlockImage::LoadCache(const std::string& filepath, uint64_t source_hash) {
+        auto mapping = std::make_unique<MappedFile>(filepath);
+        if (!mapping->Valid() || mapping->Size() < sizeof(DDSFile)) {
+            return false;
+        }
+
+        DDSFile dds;
+        std::memcpy(&dds, mapping->Data(), sizeof(DDSFile));
+        const auto& h = dds.header;
+
+        bool valid = h.magic == dds_magic
+            && h.reserved1[0] == dds_tag
+            && h.reserved1[1] == dds_version
+            && h.reserved1[2] == static_cast<uint32_t>(source_hash)
+            && h.reserved1[3] == static_cast<uint32_t>(source_hash >> 32)
+            && h.pixel_format.fourcc == FourCC('D', 'X', '1', '0')
+            && dds.dx10.dxgi_format == DXGIFormat(format)
+            && h.width > 0 && h.height > 0 && h.mip_map_count > 0;
+
+        if (!valid) {
+            CORE_TRACE("Cache file is outdated, will be rebuilt: {0}", filepath);
+            return false;
+        }
+
+        width = h.width;
+        height = h.height;
+
+        size_t offset = 0;
+        for (GLuint i = 0; i < h.mip_map_count; i++) {
+            offsets.push_back(offset);
+            offset += bcn::CompressedSize(format, std::max(width >> i, 1U), std::max(height >> i, 1U));
+        }
+
+        if (sizeof(DDSFile) + offset != mapping->Size()) {
+            CORE_TRACE("Cache file is truncated, will be rebuilt: {0}", filepath);
+            offsets.clear();
+            return false;
+        }
+
+        file = std::move(mapping);
+        data = file->Data() + sizeof(DDSFile);
+        return true;
+    }
+
+    void BlockImage::SaveCache(const std::string& filepath, uint64_t source_hash) const {
+        DDSFile dds {};
+        auto& h = dds.header;
+
+        h.magic = dds_magic;
+        h.size = 124;  // excluding the magic
+        h.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;  // caps, height, width, pixel format, mip count, linear size
+        h.height = height;
+        h.width = width;
+        h.pitch_or_linear_size = static_cast<uint32_t>(LevelSize(0));
+        h.depth = 1;
+        h.mip_map_count = Levels();
+        h.reserved1[0] = dds_tag;
+        h.reserved1[1] = dds_version;
+        h.reserved1[2] = static_cast<uint32_t>(source_hash);
+        h.reserved1[3] = static_cast<uint32_t>(source_hash >> 32);
+        h.pixel_format.size = sizeof(DDSPixelFormat);
+        h.pixel_format.flags = 0x4;  // the format is given by the fourcc
+        h.pixel_format.fourcc = FourCC('D', 'X', '1', '0');
+        h.caps = 0x1000 | 0x400000 | 0x8;  // texture, mipmap, complex
+
+        dds.dx10.dxgi_format = DXGIFormat(format);
+        dds.dx10.resource_dimension = 3;  // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+        dds.dx10.array_size = 1;
+
+        std::vector<uint8_t> buffer(sizeof(DDSFile) + storage.size());
+        std::memcpy(buffer.data(), &dds, sizeof(DDSFile));
+        std::memcpy(buffer.data() + sizeof(DDSFile), storage.data(), storage.size());
+
+        if (!WriteFileAtomic(filepath, buffer.data(), buffer.size())) {
+            CORE_WARN("Unable to write compressed image cache: {0}", filepath);
+        }
+    }
+
+    GLenum BlockImage::IFormat() const {
+        switch (format) {
+            case bcn::Format::BC4: return GL_COMPRESSED_RED_RGTC1;
+            case bcn::Format::BC5: return GL_COMPRESSED_RG_RGTC2;
+            case bcn::Format::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+            default: return 0;
+        }
+    }
+
+    const uint8_t* BlockImage::LevelData(GLuint level) const {
+        CORE_ASERT(level < Levels(), "Mipmap level {0} is not valid in the image...", level);
+        return data + offsets[level];
+    }
+
+    GLsizei BlockImage::LevelSize(GLuint level) const {
+        GLuint w = std::max(width >> level, 1U);
+        GLuint h = std::max(height >> level, 1U);
+        return static_cast<GLsizei>(bcn::CompressedSize(format, w, h));
+    }
+
+    std::string BlockImage::CachePath(const std::string& filepath, bcn::Format format) {
+        // keyed by the source path and the format, the same image may be used in several formats
+        uint64_t key = Hash64(filepath.data(), filepath.size());
+        key = Hash64(&format, sizeof(format), key);
+
+        std::ostringstream name;
+        name << std::filesystem::path(filepath).stem().string() << "."
+             << std::hex << std::setw(16) << std::setfill('0') << key << ".dds";
+
+        return paths::cache + name.str();
+    }
 
 }
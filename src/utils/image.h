@@ -20,8 +20,8 @@
 
    `GetPixels()` returns a `const T*` pointer to the underlying pixels data, this access
    is made read-only to protect data integrity. The generic type `T` can be either 8-bit
-   `uint8_t` or 32-bit `float`, depending on whether or not the image is in high dynamic
-   range. While this pointer can tell us where data is stored in memory, the size of the
+   `uint8_t` or 16-bit `uint16_t` (half floats), depending on whether or not the image is
+   in high dynamic range, `Type()` returns the matching OpenGL pixel type. While this pointer can tell us where data is stored in memory, the size of the
    data is determined by the image's width, height as well as internal format.
 
    # file formats
@@ -44,7 +44,7 @@
     > ends with the extension ".hdr" or ".exr", typically used as environment cubemaps
     > used to represent colors over a much wider dynamic range (very bright or dark)
     > pixels are stored in 4-channel RGBE, 8 bits per channel (E: shared exponent)
-    > pixels are read in as floating-point values, 32 bits per channel RGB, no alpha
+    > pixels are read in as half floats, 16 bits per channel RGBA, alpha is always 1
     > pixels are read in as linear values in linear color space (i.e. gamma compressed)
 
    # color space
@@ -79,6 +79,15 @@
    color space convertion. Even if some PNG files offer 16 ~ 48 bits per channel, we'll
    only read them in as 8 bits to align with the standard.
 
+   # HDR decoding
+
+   Radiance files are decoded by our own parser rather than `stb`, which would first expand
+   the whole image into 32-bit floats (128 MB for a 4K panorama). We find the offset of every
+   run-length encoded scanline in a quick sequential pass, then the scanlines are decoded in
+   parallel by the job system and converted to half floats row by row, directly into a pooled
+   buffer, the luminance statistics are reduced in the same pass. Files in a layout that the
+   parser doesn't handle (flat or old-style RLE, flipped axes) fall back to `stb`.
+
    # about over exposure
 
    note that overbright pixels in the HDR image can cause problems to the IBL computation
@@ -97,13 +106,29 @@
    for free to use HDRIs, check out https://www.ihdri.com/ & https://polyhaven.com/hdris
    for free 360 panorama images, check out https://www.flickr.com/groups/equirectangular/
    you can also stitch HDR panoramas in Photoshop or create one from scratch in Blender.
+
+   # block compression
+
+   `BlockImage` is the compressed counterpart of `Image`, it encodes an LDR image into BC4,
+   BC5 or BC7 (see "bcn.h") along with its full mip chain, which are then uploaded as is, so
+   the driver has nothing to compress or generate. Mipmaps are generated on the CPU with the
+   Kaiser filter in "imgproc.h", BC7 is assumed to hold colors (filtered in linear space), BC5
+   normals (renormalized at every level), and BC4 plain data.
+
+   encoding is slow (seconds for a 4K albedo map), so the result is cached under `paths::cache`
+   in a DDS file with a DX10 header (readable by most texture viewers), tagged with the hash of
+   the source image's content. The next time the same image is requested in the same format,
+   the DDS file is memory-mapped and the levels are read in place, the source is not decoded.
 */
 
 #pragma once
 
 #include <memory>
 #include <string>
+#include <vector>
 #include <glad/glad.h>
+#include "utils/bcn.h"
+#include "utils/file.h"
 
 namespace utils {
 
@@ -113,11 +138,15 @@ namespace utils {
         bool is_hdr;
 
         struct deleter {
+            size_t pooled;  // capacity of a pooled buffer, 0 (value-initialized) if owned by `stb`
             void operator()(uint8_t* buffer);
         };
 
         std::unique_ptr<uint8_t, deleter> pixels;  // with `stb` custom deleter
 
+        bool DecodeRadiance(const std::string& filepath, bool flip);
+        bool DecodeFloat(const std::string& filepath);
+
       public:
         Image(const std::string& filepath, GLuint channels = 0, bool flip = false);
 
@@ -131,9 +160,42 @@ namespace utils {
         GLuint Height() const;
         GLenum Format() const;
         GLenum IFormat() const;
+        GLenum Type() const;
 
         template<typename T>
         const T* GetPixels() const;
     };
 
+    class BlockImage {
+      private:
+        GLuint width = 0, height = 0;
+        bcn::Format format;
+
+        std::vector<size_t> offsets;           // byte offset of each mip level
+        std::vector<uint8_t> storage;          // owns the levels if freshly encoded
+        std::unique_ptr<MappedFile> file;      // maps the levels if read from the cache
+        const uint8_t* data = nullptr;
+
+        bool LoadCache(const std::string& filepath, uint64_t source_hash);
+        void SaveCache(const std::string& filepath, uint64_t source_hash) const;
+
+      public:
+        BlockImage(const std::string& filepath, bcn::Format format);
+
+        BlockImage(const BlockImage&) = delete;
+        BlockImage& operator=(const BlockImage&) = delete;
+        BlockImage(BlockImage&& other) noexcept = default;
+        BlockImage& operator=(BlockImage&& other) noexcept = default;
+
+        GLuint Width() const { return width; }
+        GLuint Height() const { return height; }
+        GLuint Levels() const { return static_cast<GLuint>(offsets.size()); }
+        GLenum IFormat() const;
+
+        const uint8_t* LevelData(GLuint level) const;
+        GLsizei LevelSize(GLuint level) const;
+
+        static std::string CachePath(const std::string& filepath, bcn::Format format);
+    };
+
 }
@@ -0,0 +1,1126 @@
+#include "pch.h"
+
+#include <cstring>
+#include "core/job.h"
+#include "core/log.h"
+#include "utils/imgproc.h"
+#include "utils/profile.h"
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    #define SP_TARGET_SSE41
+    #define SP_TARGET_AVX2
+#else
+    #include <cpuid.h>
+    #define SP_TARGET_SSE41 __attribute__((target("sse4.1")))
+    #define SP_TARGET_AVX2  __attribute__((target("avx2,f16c")))
+#endif
+
+#include <immintrin.h>
+
+namespace utils::imgproc {
+
+    static void CPUID(int info[4], int leaf, int subleaf) {
+    #if defined(_MSC_VER)
+        __cpuidex(info, leaf, subleaf);
+    #else
+        unsigned int a = 0, b = 0, c = 0, d = 0;
+        __cpuid_count(leaf, subleaf, a, b, c, d);
+        info[0] = a; info[1] = b; info[2] = c; info[3] = d;
+    #endif
+    }
+
+    static uint64_t XGETBV() {
+    #if defined(_MSC_VER)
+        return _xgetbv(0);
+    #else
+        uint32_t eax = 0, edx = 0;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+    #endif
+    }
+
+    static ISA DetectISA() {
+        int info[4] = {};
+        CPUID(info, 0, 0);
+        int max_leaf = info[0];
+
+        CPUID(info, 1, 0);
+        bool sse41   = info[2] & (1 << 19);
+        bool osxsave = info[2] & (1 << 27);
+        bool avx     = info[2] & (1 << 28);
+        bool f16c    = info[2] & (1 << 29);
+
+        bool avx2 = false;
+        if (max_leaf >= 7) {
+            CPUID(info, 7, 0);
+            avx2 = info[1] & (1 << 5);
+        }
+
+        // the OS must also save the upper halves of the YMM registers on context switches
+        bool ymm = osxsave && avx && (XGETBV() & 0x6) == 0x6;
+
+        if (avx2 && f16c && ymm) {
+            return ISA::AVX2;
+        }
+
+        return sse41 ? ISA::SSE41 : ISA::Scalar;
+    }
+
+    static const ISA supported_isa = DetectISA();
+    static ISA active_isa = supported_isa;
+
+    ISA GetISA() {
+        return active_isa;
+    }
+
+    ISA SetISA(ISA isa) {
+        active_isa = std::min(isa, supported_isa);
+        return active_isa;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    // IEEE 754 binary16 conversions, rounded to nearest even just like the F16C instructions
+    static uint16_t ToHalf(float f) {
+        uint32_t x;
+        std::memcpy(&x, &f, sizeof(x));
+
+        uint32_t sign = (x >> 16) & 0x8000;
+        uint32_t bits = x & 0x7FFFFFFF;
+
+        if (bits >= 0x7F800000) {  // inf or nan (keep nan quiet)
+            return static_cast<uint16_t>(sign | 0x7C00 | (bits > 0x7F800000 ? 0x200 : 0));
+        }
+
+        if (bits >= 0x477FF000) {  // too large, rounds up to inf
+            return static_cast<uint16_t>(sign | 0x7C00);
+        }
+
+        if (bits < 0x38800000) {  // subnormal half
+            if (bits < 0x33000000) {
+                return static_cast<uint16_t>(sign);
+            }
+
+            uint32_t exponent = bits >> 23;
+            uint32_t mantissa = (bits & 0x7FFFFF) | 0x800000;
+            uint32_t shift = 126 - exponent;
+
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1U << shift) - 1);
+            uint32_t midpoint = 1U << (shift - 1);
+
+            half += (rest > midpoint || (rest == midpoint && (half & 1))) ? 1 : 0;
+            return static_cast<uint16_t>(sign | half);
+        }
+
+        uint32_t half = (bits - 0x38000000) >> 13;  // rebias the exponent from 127 to 15
+        uint32_t rest = bits & 0x1FFF;
+        half += (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ? 1 : 0;  // may carry into the exponent
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    static float ToFloat(uint16_t h) {
+        uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+        uint32_t exponent = (h >> 10) & 0x1F;
+        uint32_t mantissa = h & 0x3FF;
+        uint32_t x = 0;
+
+        if (exponent == 0) {
+            float f = mantissa * (1.0f / 16777216.0f);  // subnormal, mantissa * 2^-24
+            return sign ? -f : f;
+        }
+        else if (exponent == 31) {
+            x = sign | 0x7F800000 | (mantissa << 13);
+        }
+        else {
+            x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+
+        float f;
+        std::memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+
+    // lookup tables are built once on first use, which is thread-safe since C++11
+    struct Tables {
+        float unorm[256];       // 8-bit unorm to float
+        float srgb[256];        // 8-bit sRGB to linear float
+        float snorm[256];       // 8-bit unorm to [-1, 1]
+        uint16_t half[256];     // 8-bit unorm to half
+        uint8_t encode[4096];   // 12-bit linear to 8-bit sRGB
+
+        Tables() {
+            for (int i = 0; i < 256; i++) {
+                float v = i * (1.0f / 255.0f);
+                unorm[i] = v;
+                srgb[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+                snorm[i] = v * 2.0f - 1.0f;
+                half[i] = ToHalf(v);
+            }
+
+            for (int i = 0; i < 4096; i++) {
+                float v = i / 4095.0f;
+                float s = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+                encode[i] = static_cast<uint8_t>(std::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    };
+
+    static const Tables& LUT() {
+        static const Tables tables;
+        return tables;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    static void FloatToHalfScalar(const float* src, uint16_t* dst, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = ToHalf(src[i]);
+        }
+    }
+
+    SP_TARGET_AVX2
+    static void FloatToHalfAVX2(const float* src, uint16_t* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+        }
+        FloatToHalfScalar(src + i, dst + i, n - i);
+    }
+
+    static void HalfToFloatScalar(const uint16_t* src, float* dst, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = ToFloat(src[i]);
+        }
+    }
+
+    SP_TARGET_AVX2
+    static void HalfToFloatAVX2(const uint16_t* src, float* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+        }
+        HalfToFloatScalar(src + i, dst + i, n - i);
+    }
+
+    static void UnormToHalfScalar(const uint8_t* src, uint16_t* dst, size_t n) {
+        const auto& lut = LUT();
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = lut.half[src[i]];
+        }
+    }
+
+    SP_TARGET_AVX2
+    static void UnormToHalfAVX2(const uint8_t* src, uint16_t* dst, size_t n) {
+        const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+            __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), scale);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+        }
+        UnormToHalfScalar(src + i, dst + i, n - i);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    // natural log with ~1e-5 absolute error, good enough for statistics, ln(m) is expanded in
+    // the series of atanh((m - 1) / (m + 1)), which converges fast for the mantissa in [1, 2)
+    static inline float FastLog(float x) {
+        uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+
+        float exponent = static_cast<float>(static_cast<int>(bits >> 23) - 127);
+        bits = (bits & 0x7FFFFF) | 0x3F800000;
+
+        float m;
+        std::memcpy(&m, &bits, sizeof(m));
+
+        float t = (m - 1.0f) / (m + 1.0f);
+        float t2 = t * t;
+        return exponent * 0.69314718f + 2.0f * t * (1.0f + t2 * (1.0f / 3 + t2 * (1.0f / 5 + t2 * (1.0f / 7))));
+    }
+
+    SP_TARGET_SSE41
+    static inline __m128 FastLog(__m128 x) {
+        __m128i bits = _mm_castps_si128(x);
+        __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+        __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x7FFFFF)), _mm_set1_epi32(0x3F800000)));
+
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+        __m128 t2 = _mm_mul_ps(t, t);
+
+        __m128 p = _mm_add_ps(_mm_set1_ps(1.0f / 5), _mm_mul_ps(t2, _mm_set1_ps(1.0f / 7)));
+        p = _mm_add_ps(_mm_set1_ps(1.0f / 3), _mm_mul_ps(t2, p));
+        p = _mm_add_ps(one, _mm_mul_ps(t2, p));
+        return _mm_add_ps(_mm_mul_ps(exponent, _mm_set1_ps(0.69314718f)), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.0f), t), p));
+    }
+
+    SP_TARGET_AVX2
+    static inline __m256 FastLog(__m256 x) {
+        __m256i bits = _mm256_castps_si256(x);
+        __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+        __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFF)), _mm256_set1_epi32(0x3F800000)));
+
+        __m256 one = _mm256_set1_ps(1.0f);
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+        __m256 t2 = _mm256_mul_ps(t, t);
+
+        __m256 p = _mm256_add_ps(_mm256_set1_ps(1.0f / 5), _mm256_mul_ps(t2, _mm256_set1_ps(1.0f / 7)));
+        p = _mm256_add_ps(_mm256_set1_ps(1.0f / 3), _mm256_mul_ps(t2, p));
+        p = _mm256_add_ps(one, _mm256_mul_ps(t2, p));
+        return _mm256_add_ps(_mm256_mul_ps(exponent, _mm256_set1_ps(0.69314718f)), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), t), p));
+    }
+
+    static constexpr float luma[4] = { 0.2126f, 0.7152f, 0.0722f, 0.0f };  // Rec. 709
+    static constexpr float luma_bias = 1e-5f;  // avoids ln(0)
+
+    static void HDRToHalfScalar(const float* rgba, uint16_t* dst, size_t n, HDRStats& stats) {
+        float lo = stats.min_luminance, hi = stats.max_luminance, sum = 0.0f;
+
+        for (size_t i = 0; i < n; i++, rgba += 4, dst += 4) {
+            float luminance = (rgba[0] * luma[0] + rgba[1] * luma[1]) + (rgba[2] * luma[2] + rgba[3] * luma[3]);
+            lo = std::min(lo, luminance);
+            hi = std::max(hi, luminance);
+            sum += FastLog(std::max(luminance, 0.0f) + luma_bias);
+
+            for (int c = 0; c < 4; c++) {
+                dst[c] = ToHalf(rgba[c]);
+            }
+        }
+
+        stats.min_luminance = lo;
+        stats.max_luminance = hi;
+        stats.sum_log += sum;
+        stats.n_pixels += n;
+    }
+
+    SP_TARGET_SSE41
+    static void HDRToHalfSSE41(const float* rgba, uint16_t* dst, size_t n, HDRStats& stats) {
+        const __m128 weights = _mm_loadu_ps(luma);
+        const __m128 bias = _mm_set1_ps(luma_bias);
+        const __m128 zero = _mm_setzero_ps();
+
+        __m128 lo = _mm_set1_ps(stats.min_luminance);
+        __m128 hi = _mm_set1_ps(stats.max_luminance);
+        __m128 sum = _mm_setzero_ps();
+
+        // one pixel per register, the luminance ends up broadcast to all 4 lanes
+        for (size_t i = 0; i < n; i++) {
+            __m128 px = _mm_loadu_ps(rgba + i * 4);
+            __m128 luminance = _mm_mul_ps(px, weights);
+            luminance = _mm_hadd_ps(luminance, luminance);
+            luminance = _mm_hadd_ps(luminance, luminance);
+
+            lo = _mm_min_ps(lo, luminance);
+            hi = _mm_max_ps(hi, luminance);
+            sum = _mm_add_ps(sum, FastLog(_mm_add_ps(_mm_max_ps(luminance, zero), bias)));
+
+            for (int c = 0; c < 4; c++) {
+                dst[i * 4 + c] = ToHalf(rgba[i * 4 + c]);  // no F16C below AVX2
+            }
+        }
+
+        stats.min_luminance = _mm_cvtss_f32(lo);
+        stats.max_luminance = _mm_cvtss_f32(hi);
+        stats.sum_log += _mm_cvtss_f32(sum);
+        stats.n_pixels += n;
+    }
+
+    SP_TARGET_AVX2
+    static void HDRToHalfAVX2(const float* rgba, uint16_t* dst, size_t n, HDRStats& stats) {
+        const __m256 weights = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(luma));
+        const __m256 bias = _mm256_set1_ps(luma_bias);
+        const __m256 zero = _mm256_setzero_ps();
+
+        __m256 lo = _mm256_set1_ps(stats.min_luminance);
+        __m256 hi = _mm256_set1_ps(stats.max_luminance);
+        __m256 sum = _mm256_setzero_ps();
+        size_t i = 0;
+
+        // two pixels per register, one in each 128-bit lane, `hadd` also works per lane
+        for (; i + 2 <= n; i += 2) {
+            __m256 px = _mm256_loadu_ps(rgba + i * 4);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm256_cvtps_ph(px, _MM_FROUND_TO_NEAREST_INT));
+
+            __m256 luminance = _mm256_mul_ps(px, weights);
+            luminance = _mm256_hadd_ps(luminance, luminance);
+            luminance = _mm256_hadd_ps(luminance, luminance);
+
+            lo = _mm256_min_ps(lo, luminance);
+            hi = _mm256_max_ps(hi, luminance);
+            sum = _mm256_add_ps(sum, FastLog(_mm256_add_ps(_mm256_max_ps(luminance, zero), bias)));
+        }
+
+        __m128 lo4 = _mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1));
+        __m128 hi4 = _mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1));
+        __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+
+        stats.min_luminance = _mm_cvtss_f32(lo4);
+        stats.max_luminance = _mm_cvtss_f32(hi4);
+        stats.sum_log += _mm_cvtss_f32(sum4);
+        stats.n_pixels += i;
+
+        HDRToHalfScalar(rgba + i * 4, dst + i * 4, n - i, stats);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    struct Pattern {
+        int8_t select[4];  // source channel of each output channel, or -1 for a constant
+        uint8_t value[4];  // constant value of each output channel
+    };
+
+    static void SwizzleScalar(const uint8_t* src, uint32_t sc, uint8_t* dst, uint32_t dc, const Pattern& p, size_t n) {
+        for (size_t i = 0; i < n; i++, src += sc, dst += dc) {
+            for (uint32_t c = 0; c < dc; c++) {
+                dst[c] = p.select[c] >= 0 ? src[p.select[c]] : p.value[c];
+            }
+        }
+    }
+
+    // builds the byte shuffle and the constant mask of a 4 to 4 channels swizzle (4 pixels)
+    static void SwizzleMask(const Pattern& p, int8_t shuffle[16], int8_t constant[16]) {
+        for (int i = 0; i < 4; i++) {
+            for (int c = 0; c < 4; c++) {
+                bool is_const = p.select[c] < 0;
+                shuffle[i * 4 + c] = is_const ? static_cast<int8_t>(0x80) : static_cast<int8_t>(i * 4 + p.select[c]);
+                constant[i * 4 + c] = is_const ? static_cast<int8_t>(p.value[c]) : 0;
+            }
+        }
+    }
+
+    SP_TARGET_SSE41
+    static void Swizzle4SSE41(const uint8_t* src, uint8_t* dst, const Pattern& p, size_t n) {
+        int8_t shuffle[16], constant[16];
+        SwizzleMask(p, shuffle, constant);
+
+        const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle));
+        const __m128i fill = _mm_loadu_si128(reinterpret_cast<const __m128i*>(constant));
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4) {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+            px = _mm_or_si128(_mm_shuffle_epi8(px, mask), fill);  // indices with the MSB set yield 0
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), px);
+        }
+        SwizzleScalar(src + i * 4, 4, dst + i * 4, 4, p, n - i);
+    }
+
+    SP_TARGET_AVX2
+    static void Swizzle4AVX2(const uint8_t* src, uint8_t* dst, const Pattern& p, size_t n) {
+        int8_t shuffle[16], constant[16];
+        SwizzleMask(p, shuffle, constant);
+
+        // the byte shuffle works within each 128-bit lane, so the same mask is used in both lanes
+        const __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle)));
+        const __m256i fill = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(constant)));
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+            __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+            px = _mm256_or_si256(_mm256_shuffle_epi8(px, mask), fill);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), px);
+        }
+        SwizzleScalar(src + i * 4, 4, dst + i * 4, 4, p, n - i);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    // x * a / 255 rounded to nearest, exact for all 8-bit inputs
+    static inline uint8_t MulDiv255(uint32_t x, uint32_t a) {
+        uint32_t t = x * a + 128;
+        return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+    }
+
+    static void PremultiplyScalar(uint8_t* rgba, size_t n) {
+        for (size_t i = 0; i < n; i++, rgba += 4) {
+            rgba[0] = MulDiv255(rgba[0], rgba[3]);
+            rgba[1] = MulDiv255(rgba[1], rgba[3]);
+            rgba[2] = MulDiv255(rgba[2], rgba[3]);
+        }
+    }
+
+    SP_TARGET_SSE41
+    static inline __m128i PremultiplyWords(__m128i px) {
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(px, alpha), _mm_set1_epi16(128));
+        t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        return _mm_blend_epi16(t, px, 0x88);  // keep the original alpha
+    }
+
+    SP_TARGET_SSE41
+    static void PremultiplySSE41(uint8_t* rgba, size_t n) {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4) {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
+            __m128i lo = PremultiplyWords(_mm_unpacklo_epi8(px, zero));
+            __m128i hi = PremultiplyWords(_mm_unpackhi_epi8(px, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), _mm_packus_epi16(lo, hi));
+        }
+        PremultiplyScalar(rgba + i * 4, n - i);
+    }
+
+    SP_TARGET_AVX2
+    static inline __m256i PremultiplyWords(__m256i px) {
+        __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(px, alpha), _mm256_set1_epi16(128));
+        t = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+        return _mm256_blend_epi16(t, px, 0x88);
+    }
+
+    SP_TARGET_AVX2
+    static void PremultiplyAVX2(uint8_t* rgba, size_t n) {
+        const __m256i zero = _mm256_setzero_si256();
+        size_t i = 0;
+
+        // unpack and pack both work per 128-bit lane, so the pixel order is preserved
+        for (; i + 8 <= n; i += 8) {
+            __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + i * 4));
+            __m256i lo = PremultiplyWords(_mm256_unpacklo_epi8(px, zero));
+            __m256i hi = PremultiplyWords(_mm256_unpackhi_epi8(px, zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i * 4), _mm256_packus_epi16(lo, hi));
+        }
+        PremultiplyScalar(rgba + i * 4, n - i);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    // 2x2 box filter on RGBA8 integers, for one row of the output
+    static void BoxRowScalar(const uint8_t* r0, const uint8_t* r1, uint32_t w, uint8_t* dst, uint32_t dw, uint32_t x) {
+        for (; x < dw; x++) {
+            uint32_t x0 = std::min(x * 2, w - 1) * 4;
+            uint32_t x1 = std::min(x * 2 + 1, w - 1) * 4;
+
+            for (int c = 0; c < 4; c++) {
+                uint32_t sum = r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c];
+                dst[x * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+
+    SP_TARGET_SSE41
+    static void BoxRowSSE41(const uint8_t* r0, const uint8_t* r1, uint32_t w, uint8_t* dst, uint32_t dw) {
+        const __m128i round = _mm_set1_epi16(2);
+        uint32_t x = 0;
+
+        // 4 source pixels per row make 2 output pixels
+        for (; x + 1 < dw && x * 2 + 3 < w; x += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + x * 8));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + x * 8));
+
+            __m128i lo = _mm_add_epi16(_mm_cvtepu8_epi16(a), _mm_cvtepu8_epi16(b));                                // p0, p1
+            __m128i hi = _mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(a, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(b, 8)));  // p2, p3
+
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));  // p0 + p1, p2 + p3
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(sum, sum));
+        }
+
+        BoxRowScalar(r0, r1, w, dst, dw, x);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    // filter taps along one axis, output pixel x reads the source pixels 2x + offset
+    struct Kernel {
+        int offset;
+        int n_taps;
+        float weights[6];
+    };
+
+    static double BesselI0(double x) {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; k++) {
+            term *= (x * 0.5 / k) * (x * 0.5 / k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    static Kernel MakeKernel(Filter filter) {
+        if (filter == Filter::Box) {
+            return Kernel { 0, 2, { 0.5f, 0.5f } };
+        }
+
+        // Kaiser-windowed sinc of width 3 in output pixels (alpha = 4), sampled at the source
+        // pixel centers, which are 0.25, 0.75 and 1.25 output pixels away from the center
+        constexpr double alpha = 4.0;
+        constexpr double half_width = 1.5;
+        constexpr double pi = 3.14159265358979323846;
+
+        Kernel kernel { -2, 6, {} };
+        double weights[6], sum = 0.0;
+
+        for (int i = 0; i < 6; i++) {
+            double d = (i - 2.5) * 0.5;
+            double t = d / half_width;
+            double sinc = std::sin(pi * d) / (pi * d);
+            double window = BesselI0(alpha * std::sqrt(std::max(0.0, 1.0 - t * t))) / BesselI0(alpha);
+            weights[i] = sinc * window;
+            sum += weights[i];
+        }
+
+        for (int i = 0; i < 6; i++) {
+            kernel.weights[i] = static_cast<float>(weights[i] / sum);
+        }
+
+        return kernel;
+    }
+
+    static void DecodeRow(const uint8_t* src, uint32_t w, Space space, float* dst) {
+        const auto& lut = LUT();
+        const float* table = space == Space::sRGB ? lut.srgb : space == Space::Normal ? lut.snorm : lut.unorm;
+
+        for (uint32_t x = 0; x < w; x++, src += 4, dst += 4) {
+            dst[0] = table[src[0]];
+            dst[1] = table[src[1]];
+            dst[2] = table[src[2]];
+            dst[3] = lut.unorm[src[3]];  // alpha is always linear
+        }
+    }
+
+    static void EncodeRow(const float* src, uint32_t w, Space space, uint8_t* dst) {
+        const auto& lut = LUT();
+        auto unorm = [](float v) { return static_cast<uint8_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+
+        for (uint32_t x = 0; x < w; x++, src += 4, dst += 4) {
+            if (space == Space::sRGB) {
+                for (int c = 0; c < 3; c++) {
+                    dst[c] = lut.encode[static_cast<int>(std::clamp(src[c], 0.0f, 1.0f) * 4095.0f + 0.5f)];
+                }
+            }
+            else if (space == Space::Normal) {
+                float len = std::sqrt(src[0] * src[0] + src[1] * src[1] + src[2] * src[2]);
+                float n[3] = { 0.0f, 0.0f, 1.0f };
+
+                if (len > 1e-4f) {
+                    n[0] = src[0] / len;
+                    n[1] = src[1] / len;
+                    n[2] = src[2] / len;
+                }
+
+                for (int c = 0; c < 3; c++) {
+                    dst[c] = unorm(n[c] * 0.5f + 0.5f);
+                }
+            }
+            else {
+                for (int c = 0; c < 3; c++) {
+                    dst[c] = unorm(src[c]);
+                }
+            }
+
+            dst[3] = unorm(src[3]);
+        }
+    }
+
+    // vertical pass, weighted sum of n rows of floats, element-wise
+    static void VerticalScalar(const float* const* rows, const float* weights, int n, size_t count, float* dst, size_t i = 0) {
+        for (; i < count; i++) {
+            float acc = 0.0f;
+            for (int k = 0; k < n; k++) {
+                acc = acc + weights[k] * rows[k][i];
+            }
+            dst[i] = acc;
+        }
+    }
+
+    SP_TARGET_SSE41
+    static void VerticalSSE41(const float* const* rows, const float* weights, int n, size_t count, float* dst) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 acc = _mm_setzero_ps();
+            for (int k = 0; k < n; k++) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+            }
+            _mm_storeu_ps(dst + i, acc);
+        }
+        VerticalScalar(rows, weights, n, count, dst, i);
+    }
+
+    SP_TARGET_AVX2
+    static void VerticalAVX2(const float* const* rows, const float* weights, int n, size_t count, float* dst) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 acc = _mm256_setzero_ps();
+            for (int k = 0; k < n; k++) {
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i)));
+            }
+            _mm256_storeu_ps(dst + i, acc);
+        }
+        VerticalScalar(rows, weights, n, count, dst, i);
+    }
+
+    // horizontal pass, each output pixel is a weighted sum of n source pixels (RGBA floats)
+    static void HorizontalScalar(const float* src, uint32_t w, const Kernel& k, float* dst, uint32_t dw) {
+        for (uint32_t x = 0; x < dw; x++) {
+            float acc[4] = {};
+            for (int t = 0; t < k.n_taps; t++) {
+                int sx = std::clamp(static_cast<int>(x * 2) + k.offset + t, 0, static_cast<int>(w) - 1);
+                for (int c = 0; c < 4; c++) {
+                    acc[c] = acc[c] + k.weights[t] * src[sx * 4 + c];
+                }
+            }
+            std::memcpy(dst + x * 4, acc, sizeof(acc));
+        }
+    }
+
+    SP_TARGET_SSE41
+    static void HorizontalSSE41(const float* src, uint32_t w, const Kernel& k, float* dst, uint32_t dw) {
+        for (uint32_t x = 0; x < dw; x++) {
+            __m128 acc = _mm_setzero_ps();
+            for (int t = 0; t < k.n_taps; t++) {
+                int sx = std::clamp(static_cast<int>(x * 2) + k.offset + t, 0, static_cast<int>(w) - 1);
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(k.weights[t]), _mm_loadu_ps(src + sx * 4)));
+            }
+            _mm_storeu_ps(dst + x * 4, acc);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    // moments of one row of an equirectangular image, the 5 column weights are 1, cos(phi),
+    // sin(phi), sin^2(phi) and sin(phi)cos(phi), accumulated separately for the even and odd
+    // columns, so that the 3 paths add up the exact same values in the exact same order
+    struct Moments {
+        float sum[2][5][4];  // [parity][weight][rgba]
+    };
+
+    static void MomentsScalar(const float* row, uint32_t w, const float* table, Moments& m) {
+        size_t stride = static_cast<size_t>(w) * 4;
+        std::memset(&m, 0, sizeof(Moments));
+
+        for (uint32_t x = 0; x < w; x++) {
+            auto& acc = m.sum[x & 1];
+            const float* px = row + x * 4;
+
+            for (int c = 0; c < 4; c++) {
+                acc[0][c] = acc[0][c] + px[c];
+            }
+
+            for (int k = 1; k < 5; k++) {
+                float weight = table[(k - 1) * stride + x * 4];
+                for (int c = 0; c < 4; c++) {
+                    acc[k][c] = acc[k][c] + px[c] * weight;
+                }
+            }
+        }
+    }
+
+    SP_TARGET_SSE41
+    static void MomentsSSE41(const float* row, uint32_t w, const float* table, Moments& m) {
+        size_t stride = static_cast<size_t>(w) * 4;
+        __m128 acc[2][5];
+
+        for (auto& parity : acc) {
+            for (auto& v : parity) {
+                v = _mm_setzero_ps();
+            }
+        }
+
+        for (uint32_t x = 0; x < w; x++) {
+            auto& sum = acc[x & 1];
+            __m128 px = _mm_loadu_ps(row + x * 4);
+            sum[0] = _mm_add_ps(sum[0], px);
+
+            for (int k = 1; k < 5; k++) {
+                sum[k] = _mm_add_ps(sum[k], _mm_mul_ps(px, _mm_loadu_ps(table + (k - 1) * stride + x * 4)));
+            }
+        }
+
+        for (int p = 0; p < 2; p++) {
+            for (int k = 0; k < 5; k++) {
+                _mm_storeu_ps(m.sum[p][k], acc[p][k]);
+            }
+        }
+    }
+
+    SP_TARGET_AVX2
+    static void MomentsAVX2(const float* row, uint32_t w, const float* table, Moments& m) {
+        size_t stride = static_cast<size_t>(w) * 4;
+        __m256 acc[5];
+
+        for (auto& v : acc) {
+            v = _mm256_setzero_ps();
+        }
+
+        // two pixels per register, the low half holds the even column, the high half the odd one
+        uint32_t x = 0;
+        for (; x + 2 <= w; x += 2) {
+            __m256 px = _mm256_loadu_ps(row + x * 4);
+            acc[0] = _mm256_add_ps(acc[0], px);
+
+            for (int k = 1; k < 5; k++) {
+                acc[k] = _mm256_add_ps(acc[k], _mm256_mul_ps(px, _mm256_loadu_ps(table + (k - 1) * stride + x * 4)));
+            }
+        }
+
+        for (int k = 0; k < 5; k++) {
+            __m128 even = _mm256_castps256_ps128(acc[k]);
+
+            if (x < w) {  // the last column of an odd width is even
+                __m128 px = _mm_loadu_ps(row + x * 4);
+                __m128 weight = k == 0 ? _mm_set1_ps(1.0f) : _mm_loadu_ps(table + (k - 1) * stride + x * 4);
+                even = _mm_add_ps(even, k == 0 ? px : _mm_mul_ps(px, weight));
+            }
+
+            _mm_storeu_ps(m.sum[0][k], even);
+            _mm_storeu_ps(m.sum[1][k], _mm256_extractf128_ps(acc[k], 1));
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    void Downsample(const uint8_t* src, uint32_t w, uint32_t h, uint8_t* dst, Filter filter, Space space) {
+        PROFILE_FUNCTION();
+        uint32_t dw = std::max(w / 2, 1U);
+        uint32_t dh = std::max(h / 2, 1U);
+        ISA isa = active_isa;
+
+        auto row = [&](uint32_t y) { return src + static_cast<size_t>(std::min(y, h - 1)) * w * 4; };
+
+        // linear box filter is a simple integer average, which is exact
+        if (filter == Filter::Box && space == Space::Linear) {
+            core::JobSystem::ParallelFor(0, dh, 0, [&](size_t begin, size_t end) {
+                for (size_t y = begin; y < end; y++) {
+                    const uint8_t* r0 = row(static_cast<uint32_t>(y * 2));
+                    const uint8_t* r1 = row(static_cast<uint32_t>(y * 2 + 1));
+                    uint8_t* out = dst + y * dw * 4;
+
+                    if (isa >= ISA::SSE41) {
+                        BoxRowSSE41(r0, r1, w, out, dw);
+                    }
+                    else {
+                        BoxRowScalar(r0, r1, w, out, dw, 0);
+                    }
+                }
+            });
+            return;
+        }
+
+        const Kernel kernel = MakeKernel(filter);
+
+        core::JobSystem::ParallelFor(0, dh, 0, [&](size_t begin, size_t end) {
+            // the decoded source rows are kept in a ring, since adjacent output rows share
+            // n_taps - 2 of them, a ring of n_taps slots always holds the current window
+            std::vector<float> ring(static_cast<size_t>(kernel.n_taps) * w * 4);
+            std::vector<int> tags(kernel.n_taps, -1);
+            std::vector<float> column(static_cast<size_t>(w) * 4);
+            std::vector<float> filtered(static_cast<size_t>(dw) * 4);
+            const float* rows[6];
+
+            for (size_t y = begin; y < end; y++) {
+                for (int t = 0; t < kernel.n_taps; t++) {
+                    int sy = std::clamp(static_cast<int>(y * 2) + kernel.offset + t, 0, static_cast<int>(h) - 1);
+                    int slot = (static_cast<int>(y * 2) + kernel.offset + t + kernel.n_taps * 2) % kernel.n_taps;
+                    float* decoded = ring.data() + static_cast<size_t>(slot) * w * 4;
+
+                    if (tags[slot] != sy) {
+                        DecodeRow(row(sy), w, space, decoded);
+                        tags[slot] = sy;
+                    }
+
+                    rows[t] = decoded;
+                }
+
+                switch (isa) {
+                    case ISA::AVX2:
+                        VerticalAVX2(rows, kernel.weights, kernel.n_taps, column.size(), column.data());
+                        HorizontalSSE41(column.data(), w, kernel, filtered.data(), dw);
+                        break;
+                    case ISA::SSE41:
+                        VerticalSSE41(rows, kernel.weights, kernel.n_taps, column.size(), column.data());
+                        HorizontalSSE41(column.data(), w, kernel, filtered.data(), dw);
+                        break;
+                    default:
+                        VerticalScalar(rows, kernel.weights, kernel.n_taps, column.size(), column.data());
+                        HorizontalScalar(column.data(), w, kernel, filtered.data(), dw);
+                        break;
+                }
+
+                EncodeRow(filtered.data(), dw, space, dst + y * dw * 4);
+            }
+        });
+    }
+
+    std::vector<std::vector<uint8_t>> GenerateMips(const uint8_t* rgba, uint32_t w, uint32_t h, Filter filter, Space space) {
+        PROFILE_FUNCTION();
+        std::vector<std::vector<uint8_t>> levels;
+        const uint8_t* src = rgba;
+
+        while (w > 1 || h > 1) {
+            uint32_t dw = std::max(w / 2, 1U);
+            uint32_t dh = std::max(h / 2, 1U);
+
+            auto& level = levels.emplace_back(static_cast<size_t>(dw) * dh * 4);
+            Downsample(src, w, h, level.data(), filter, space);
+
+            src = level.data();
+            w = dw;
+            h = dh;
+        }
+
+        return levels;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    static constexpr size_t grain = 1 << 16;  // elements per job for the flat conversions
+
+    void FloatToHalf(const float* src, uint16_t* dst, size_t n) {
+        PROFILE_FUNCTION();
+        bool avx2 = active_isa == ISA::AVX2;
+
+        core::JobSystem::ParallelFor(0, n, grain, [&](size_t begin, size_t end) {
+            avx2 ? FloatToHalfAVX2(src + begin, dst + begin, end - begin) : FloatToHalfScalar(src + begin, dst + begin, end - begin);
+        });
+    }
+
+    void HalfToFloat(const uint16_t* src, float* dst, size_t n) {
+        PROFILE_FUNCTION();
+        bool avx2 = active_isa == ISA::AVX2;
+
+        core::JobSystem::ParallelFor(0, n, grain, [&](size_t begin, size_t end) {
+            avx2 ? HalfToFloatAVX2(src + begin, dst + begin, end - begin) : HalfToFloatScalar(src + begin, dst + begin, end - begin);
+        });
+    }
+
+    void UnormToHalf(const uint8_t* src, uint16_t* dst, size_t n) {
+        PROFILE_FUNCTION();
+        bool avx2 = active_isa == ISA::AVX2;
+
+        core::JobSystem::ParallelFor(0, n, grain, [&](size_t begin, size_t end) {
+            avx2 ? UnormToHalfAVX2(src + begin, dst + begin, end - begin) : UnormToHalfScalar(src + begin, dst + begin, end - begin);
+        });
+    }
+
+    void HDRStats::Merge(const HDRStats& other) {
+        min_luminance = std::min(min_luminance, other.min_luminance);
+        max_luminance = std::max(max_luminance, other.max_luminance);
+        sum_log += other.sum_log;
+        n_pixels += other.n_pixels;
+    }
+
+    float HDRStats::LogAverage() const {
+        return n_pixels > 0 ? static_cast<float>(std::exp(sum_log / n_pixels)) : 0.0f;
+    }
+
+    HDRStats HDRToHalf(const float* rgba, uint16_t* dst, size_t n_pixels) {
+        ISA isa = active_isa;
+        size_t chunk = grain / 4;
+        std::vector<HDRStats> partial((n_pixels + chunk - 1) / chunk);
+
+        // each chunk reduces into its own slot, which are merged at the end in a fixed order
+        core::JobSystem::ParallelFor(0, n_pixels, chunk, [&](size_t begin, size_t end) {
+            auto& stats = partial[begin / chunk];
+            switch (isa) {
+                case ISA::AVX2:  HDRToHalfAVX2(rgba + begin * 4, dst + begin * 4, end - begin, stats);   break;
+                case ISA::SSE41: HDRToHalfSSE41(rgba + begin * 4, dst + begin * 4, end - begin, stats);  break;
+                default:         HDRToHalfScalar(rgba + begin * 4, dst + begin * 4, end - begin, stats); break;
+            }
+        });
+
+        HDRStats result;
+        for (const auto& stats : partial) {
+            result.Merge(stats);
+        }
+
+        return result;
+    }
+
+    void Swizzle(const uint8_t* src, uint32_t sc, uint8_t* dst, uint32_t dc, const char* pattern, size_t n_pixels) {
+        PROFILE_FUNCTION();
+        CORE_ASERT(sc >= 1 && sc <= 4 && dc >= 1 && dc <= 4, "Invalid number of channels: {0} -> {1}", sc, dc);
+        CORE_ASERT(std::strlen(pattern) == dc, "Swizzle pattern {0} does not match {1} channels", pattern, dc);
+
+        Pattern p {};
+        for (uint32_t c = 0; c < dc; c++) {
+            switch (pattern[c]) {
+                case 'r': p.select[c] = 0; break;
+                case 'g': p.select[c] = 1; break;
+                case 'b': p.select[c] = 2; break;
+                case 'a': p.select[c] = 3; break;
+                case '0': p.select[c] = -1; p.value[c] = 0; break;
+                case '1': p.select[c] = -1; p.value[c] = 255; break;
+                default: throw std::invalid_argument("Invalid swizzle pattern: " + std::string(pattern));
+            }
+
+            if (p.select[c] >= static_cast<int8_t>(sc)) {
+                throw std::invalid_argument("Swizzle pattern reads a missing channel: " + std::string(pattern));
+            }
+        }
+
+        ISA isa = active_isa;
+
+        core::JobSystem::ParallelFor(0, n_pixels, grain, [&](size_t begin, size_t end) {
+            const uint8_t* s = src + begin * sc;
+            uint8_t* d = dst + begin * dc;
+
+            if (sc == 4 && dc == 4 && isa == ISA::AVX2) {
+                Swizzle4AVX2(s, d, p, end - begin);
+            }
+            else if (sc == 4 && dc == 4 && isa == ISA::SSE41) {
+                Swizzle4SSE41(s, d, p, end - begin);
+            }
+            else {
+                SwizzleScalar(s, sc, d, dc, p, end - begin);
+            }
+        });
+    }
+
+    void Premultiply(uint8_t* rgba, size_t n_pixels) {
+        PROFILE_FUNCTION();
+        ISA isa = active_isa;
+
+        core::JobSystem::ParallelFor(0, n_pixels, grain, [&](size_t begin, size_t end) {
+            switch (isa) {
+                case ISA::AVX2:  PremultiplyAVX2(rgba + begin * 4, end - begin);   break;
+                case ISA::SSE41: PremultiplySSE41(rgba + begin * 4, end - begin);  break;
+                default:         PremultiplyScalar(rgba + begin * 4, end - begin); break;
+            }
+        });
+    }
+
+    void Unpremultiply(uint8_t* rgba, size_t n_pixels) {
+        PROFILE_FUNCTION();
+
+        // a division per pixel, which is rarely needed (e.g. before re-encoding an image) so it's not vectorized
+        core::JobSystem::ParallelFor(0, n_pixels, grain, [&](size_t begin, size_t end) {
+            for (uint8_t* px = rgba + begin * 4; px < rgba + end * 4; px += 4) {
+                if (uint32_t a = px[3]; a > 0 && a < 255) {
+                    for (int c = 0; c < 3; c++) {
+                        px[c] = static_cast<uint8_t>(std::min(255U, (px[c] * 255U + a / 2) / a));
+                    }
+                }
+            }
+        });
+    }
+
+    std::array<float, 27> ProjectSH(const uint16_t* rgba, uint32_t w, uint32_t h, float window) {
+        PROFILE_FUNCTION();
+        ISA isa = active_isa;
+
+        constexpr double pi = 3.141592653589793;
+        const double d_theta = pi / h;
+        const double d_phi = 2.0 * pi / w;
+        const size_t stride = static_cast<size_t>(w) * 4;
+
+        // column weights, each one is splatted 4 times so that a whole pixel is weighted at once,
+        // phi = 0 points to +x and grows towards +z, same as `Cartesian2Spherical()` in GLSL
+        std::vector<float> table(stride * 4);
+
+        for (uint32_t x = 0; x < w; x++) {
+            double phi = (x + 0.5) * d_phi - pi;
+            double c = std::cos(phi);
+            double s = std::sin(phi);
+            const double weights[4] = { c, s, s * s, s * c };
+
+            for (int k = 0; k < 4; k++) {
+                std::fill_n(table.data() + k * stride + x * 4, 4, static_cast<float>(weights[k]));
+            }
+        }
+
+        // every row is reduced to its own 27 sums, which are then added up in row order, so the
+        // result doesn't depend on how the rows were spread across the workers either
+        std::vector<std::array<double, 27>> rows(h);
+
+        core::JobSystem::ParallelFor(0, h, 16, [&](size_t begin, size_t end) {
+            std::vector<float> pixels(stride);
+            Moments m;
+
+            for (size_t y = begin; y < end; y++) {
+                const uint16_t* src = rgba + y * stride;
+
+                switch (isa) {
+                    case ISA::AVX2:
+                        HalfToFloatAVX2(src, pixels.data(), stride);
+                        MomentsAVX2(pixels.data(), w, table.data(), m);
+                        break;
+                    case ISA::SSE41:
+                        HalfToFloatScalar(src, pixels.data(), stride);
+                        MomentsSSE41(pixels.data(), w, table.data(), m);
+                        break;
+                    default:
+                        HalfToFloatScalar(src, pixels.data(), stride);
+                        MomentsScalar(pixels.data(), w, table.data(), m);
+                        break;
+                }
+
+                // within a row, y = cos(theta) is constant while x and z scale with sin(theta),
+                // so the 9 basis polynomials expand into the 5 column moments
+                double theta = (y + 0.5) * d_theta;
+                double st = std::sin(theta);
+                double ct = std::cos(theta);
+                double d_omega = st * d_theta * d_phi;  // solid angle of the texels in this row
+
+                for (int c = 0; c < 3; c++) {
+                    double s0 = static_cast<double>(m.sum[0][0][c] + m.sum[1][0][c]);  // 1
+                    double sc = static_cast<double>(m.sum[0][1][c] + m.sum[1][1][c]);  // cos(phi)
+                    double ss = static_cast<double>(m.sum[0][2][c] + m.sum[1][2][c]);  // sin(phi)
+                    double s2 = static_cast<double>(m.sum[0][3][c] + m.sum[1][3][c]);  // sin^2(phi)
+                    double sx = static_cast<double>(m.sum[0][4][c] + m.sum[1][4][c]);  // sin(phi)cos(phi)
+
+                    const double poly[9] = {
+                        s0,                                  // 1
+                        ct * s0,                             // y
+                        st * ss,                             // z
+                        st * sc,                             // x
+                        ct * st * sc,                        // y * x
+                        ct * st * ss,                        // y * z
+                        3.0 * st * st * s2 - s0,             // 3z^2 - 1
+                        st * st * sx,                        // z * x
+                        st * st * (s0 - s2) - ct * ct * s0   // x^2 - y^2
+                    };
+
+                    for (int i = 0; i < 9; i++) {
+                        rows[y][i * 3 + c] = poly[i] * d_omega;
+                    }
+                }
+            }
+        });
+
+        std::array<double, 27> total {};
+        for (const auto& row : rows) {
+            for (int i = 0; i < 27; i++) {
+                total[i] += row[i];
+            }
+        }
+
+        // the basis constant K appears twice (projection and reconstruction), the cosine lobe
+        // convolution A_l and the Lambertian 1 / PI are baked in as well, see "utils/sh9.glsl"
+        const double K[9] = {
+            std::sqrt(1.0 / (4.0 * pi)),
+            std::sqrt(3.0 / (4.0 * pi)), std::sqrt(3.0 / (4.0 * pi)), std::sqrt(3.0 / (4.0 * pi)),
+            std::sqrt(15.0 / (4.0 * pi)), std::sqrt(15.0 / (4.0 * pi)), std::sqrt(5.0 / (16.0 * pi)),
+            std::sqrt(15.0 / (4.0 * pi)), std::sqrt(15.0 / (16.0 * pi))
+        };
+
+        const int band[9] = { 0, 1, 1, 1, 2, 2, 2, 2, 2 };
+        const double A[3] = { 1.0, 2.0 / 3.0, 0.25 };  // A_l / PI
+
+        std::array<float, 27> sh {};
+
+        for (int i = 0; i < 9; i++) {
+            int l = band[i];
+            double hanning = 1.0;
+
+            if (window > 0.0f) {
+                hanning = l < window ? 0.5 * (1.0 + std::cos(pi * l / window)) : 0.0;
+            }
+
+            for (int c = 0; c < 3; c++) {
+                sh[i * 3 + c] = static_cast<float>(A[l] * K[i] * K[i] * hanning * total[i * 3 + c]);
+            }
+        }
+
+        return sh;
+    }
+
+}
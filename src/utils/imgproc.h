@@ -0,0 +1,113 @@
+/*
+   CPU image processing kernels, which work on the raw pixels of an `Image` (or any buffer),
+   the main use is to bake mipmaps on the CPU, so that we don't have to rely on the driver's
+   `glGenerateTextureMipmap()`, whose filter quality and cost vary across vendors, and which
+   can't be used at all on block-compressed textures. Every kernel is parallelized over rows
+   or chunks of pixels by the job system, so they are meant to be called from the main thread
+   or from a job (e.g. a texture being decoded on a worker).
+
+   # instruction sets
+
+   each kernel has a scalar version and SIMD versions for SSE4.1 and AVX2 (+ F16C), the best
+   one supported by the CPU is detected once at startup with `cpuid`, the kernels are compiled
+   for all of them regardless of the compiler flags, so the binary still runs on older CPUs.
+   `SetISA()` can force a lower instruction set, which is handy to benchmark or validate the
+   SIMD paths against the scalar ones, every path must produce the same result bit by bit,
+   except for the filtered mipmaps, where the float summation order may differ in the last ulp.
+
+   # mipmaps
+
+   `GenerateMips()` takes an RGBA8 image and returns levels 1 to n (the base level is not
+   copied), each level is downsampled from the previous one by a factor of 2. The filter is
+   either a 2x2 box, or a Kaiser-windowed sinc of width 3 (6 taps per axis), which is sharper
+   and has less aliasing, at about 3x the cost. The content of the image decides the space in
+   which it's filtered:
+
+   > Linear: data maps such as roughness or ao, filtered as is
+   > sRGB: color maps such as albedo, converted to linear space, filtered, then back to sRGB,
+           averaging sRGB values directly would darken the mipmaps (alpha is always linear)
+   > Normal: tangent-space normal maps, the filtered normals are renormalized, otherwise the
+             shorter normals would make the surface look flatter in the distance
+
+   only the linear box filter works on integers, all the other combinations are separable
+   float convolutions, the vertical pass is vectorized along the row, the horizontal pass
+   processes one RGBA pixel per 128-bit register.
+
+   # conversions
+
+   > FloatToHalf: 32-bit float to 16-bit half float, for uploading HDR images to GL_RGBA16F,
+                  which halves the upload bandwidth and lets the driver skip the conversion
+   > UnormToHalf: 8-bit unorm to half float, for LDR images going into float targets
+   > Swizzle: reorders, drops or adds channels, the pattern is a string of one letter per
+              output channel, "rgba" select a source channel, "0" and "1" are constants
+   > Premultiply: multiplies the color channels by alpha (RGBA8), rounded exactly
+   > HDRToHalf: same as FloatToHalf on RGBA pixels, but also reduces the luminance statistics
+                of the image (min, max and log average) in the same pass over the data
+
+   # spherical harmonics
+
+   `ProjectSH()` projects an equirectangular HDR image (RGBA half floats, as decoded by `Image`)
+   onto the first 3 bands of real spherical harmonics, and returns the 9 RGB coefficients of
+   the diffuse irradiance, with the cosine lobe and the Lambertian 1 / PI already rolled in,
+   laid out as the `vec3 sh9[9]` array expected by "utils/sh9.glsl". Each texel is weighted by
+   its solid angle, the directions follow the same mapping as "core/equirect2cube.glsl". The
+   optional Hanning `window` (in bands, e.g. 4) damps the higher bands to reduce ringing on
+   HDRIs with a small, very bright sun, 0 leaves the coefficients untouched.
+
+   the SIMD paths only vectorize the per-row moments, without FMA, even and odd columns are
+   summed apart so that AVX2 can take two pixels at once, rows are reduced in double and added
+   up in a fixed order, so the coefficients are bit-identical across instruction sets and any
+   number of workers, which makes them easy to check without a GPU.
+
+   > auto mips = imgproc::GenerateMips(pixels, w, h, imgproc::Filter::Kaiser, imgproc::Space::sRGB);
+   > imgproc::Swizzle(rgba, 4, bgr, 3, "bgr", w * h);
+   > imgproc::FloatToHalf(floats.data(), halfs.data(), w * h * 4);
+   > auto sh9 = imgproc::ProjectSH(image.GetPixels<uint16_t>(), image.Width(), image.Height());
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace utils::imgproc {
+
+    enum class ISA : uint8_t {
+        Scalar = 0,
+        SSE41  = 1,
+        AVX2   = 2  // including F16C
+    };
+
+    enum class Filter : uint8_t { Box, Kaiser };
+    enum class Space  : uint8_t { Linear, sRGB, Normal };
+
+    struct HDRStats {
+        float min_luminance = std::numeric_limits<float>::max();
+        float max_luminance = std::numeric_limits<float>::lowest();
+        double sum_log = 0.0;  // sum of ln(luminance + 1e-5)
+        size_t n_pixels = 0;
+
+        void Merge(const HDRStats& other);
+        float LogAverage() const;
+    };
+
+    ISA GetISA();
+    ISA SetISA(ISA isa);  // clamped to what the CPU supports, returns the ISA in use
+
+    void Downsample(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, Filter filter, Space space);
+    std::vector<std::vector<uint8_t>> GenerateMips(const uint8_t* rgba, uint32_t width, uint32_t height, Filter filter, Space space);
+
+    void FloatToHalf(const float* src, uint16_t* dst, size_t n);
+    void HalfToFloat(const uint16_t* src, float* dst, size_t n);
+    void UnormToHalf(const uint8_t* src, uint16_t* dst, size_t n);
+    HDRStats HDRToHalf(const float* rgba, uint16_t* dst, size_t n_pixels);
+
+    void Swizzle(const uint8_t* src, uint32_t src_channels, uint8_t* dst, uint32_t dst_channels, const char* pattern, size_t n_pixels);
+    void Premultiply(uint8_t* rgba, size_t n_pixels);
+    void Unpremultiply(uint8_t* rgba, size_t n_pixels);
+
+    std::array<float, 27> ProjectSH(const uint16_t* rgba, uint32_t width, uint32_t height, float window = 0.0f);
+
+}
@@ -0,0 +1,163 @@
+#include "pch.h"
+
+#include <cstring>
+#include "core/log.h"
+#include "utils/file.h"
+#include "utils/ktx.h"
+
+namespace utils {
+
+    static constexpr uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    static constexpr uint32_t vk_format_rgba16f = 97;  // VK_FORMAT_R16G16B16A16_SFLOAT
+    static constexpr uint32_t texel_size = 8;          // 4 channels x 16-bit half floats
+
+    struct KTXHeader {
+        uint8_t identifier[12];
+        uint32_t vk_format;
+        uint32_t type_size;
+        uint32_t pixel_width, pixel_height, pixel_depth;
+        uint32_t layer_count, face_count, level_count;
+        uint32_t supercompression;
+        uint32_t dfd_offset, dfd_length;
+        uint32_t kvd_offset, kvd_length;
+        uint64_t sgd_offset, sgd_length;
+    };
+
+    struct KTXLevel {
+        uint64_t offset;
+        uint64_t length;
+        uint64_t uncompressed_length;
+    };
+
+    static_assert(sizeof(KTXHeader) == 80);
+    static_assert(sizeof(KTXLevel) == 24);
+
+    // basic data format descriptor of RGBA16F: 4 signed float samples of 16 bits, linear BT.709
+    static constexpr uint32_t dfd[] = {
+        92,                       // total size in bytes, including this word
+        0,                        // vendor id = khronos, descriptor type = basic
+        (88U << 16) | 2U,         // block size, version 1.3
+        (1U << 0) | (1U << 8) | (1U << 16),  // color model = RGBSDA, primaries = BT.709, transfer = linear
+        0,                        // texel block dimensions = 1x1x1x1
+        texel_size, 0,            // bytes per plane
+        // samples: channel id | float | signed, bit length - 1, bit offset, position, lower, upper
+        ((0xC0U | 0U)  << 24) | (15U << 16) | 0U,  0, 0xBF800000U, 0x3F800000U,  // R
+        ((0xC0U | 1U)  << 24) | (15U << 16) | 16U, 0, 0xBF800000U, 0x3F800000U,  // G
+        ((0xC0U | 2U)  << 24) | (15U << 16) | 32U, 0, 0xBF800000U, 0x3F800000U,  // B
+        ((0xC0U | 15U) << 24) | (15U << 16) | 48U, 0, 0xBF800000U, 0x3F800000U   // A
+    };
+
+    static size_t Align8(size_t offset) {
+        return (offset + 7) & ~size_t(7);
+    }
+
+    static uint64_t ExpectedSize(uint32_t width, uint32_t height, uint32_t faces, uint32_t level) {
+        uint64_t w = std::max(width >> level, 1U);
+        uint64_t h = std::max(height >> level, 1U);
+        return w * h * faces * texel_size;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    KTXFile::KTXFile(const std::string& filepath) : file(std::make_unique<MappedFile>(filepath)) {
+        if (!file->Valid() || file->Size() < sizeof(KTXHeader)) {
+            return;  // the file doesn't exist, which is normal for a cache miss
+        }
+
+        KTXHeader header;
+        std::memcpy(&header, file->Data(), sizeof(KTXHeader));
+
+        bool valid = std::memcmp(header.identifier, identifier, sizeof(identifier)) == 0
+            && header.vk_format == vk_format_rgba16f
+            && header.pixel_depth == 0 && header.layer_count == 0
+            && (header.face_count == 1 || header.face_count == 6)
+            && header.level_count > 0 && header.supercompression == 0
+            && sizeof(KTXHeader) + header.level_count * sizeof(KTXLevel) <= file->Size();
+
+        if (!valid) {
+            CORE_WARN("Unsupported or corrupted KTX2 file: {0}", filepath);
+            return;
+        }
+
+        std::vector<KTXLevel> levels(header.level_count);
+        std::memcpy(levels.data(), file->Data() + sizeof(KTXHeader), levels.size() * sizeof(KTXLevel));
+
+        for (uint32_t level = 0; level < header.level_count; level++) {
+            const auto& entry = levels[level];
+            uint64_t expected = ExpectedSize(header.pixel_width, header.pixel_height, header.face_count, level);
+
+            if (entry.length != expected || entry.offset + entry.length > file->Size()) {
+                CORE_WARN("Truncated KTX2 file: {0}", filepath);
+                offsets.clear();
+                sizes.clear();
+                return;
+            }
+
+            offsets.push_back(entry.offset);
+            sizes.push_back(entry.length);
+        }
+
+        this->width  = header.pixel_width;
+        this->height = header.pixel_height;
+        this->faces  = header.face_count;
+    }
+
+    KTXFile::~KTXFile() {}  // `MappedFile` is complete here
+
+    const uint8_t* KTXFile::LevelData(uint32_t level) const {
+        return file->Data() + offsets[level];
+    }
+
+    size_t KTXFile::LevelSize(uint32_t level) const {
+        return static_cast<size_t>(sizes[level]);
+    }
+
+    bool KTXFile::Write(const std::string& filepath, uint32_t width, uint32_t height, uint32_t faces,
+        const std::vector<std::vector<uint8_t>>& levels)
+    {
+        uint32_t n_levels = static_cast<uint32_t>(levels.size());
+
+        for (uint32_t level = 0; level < n_levels; level++) {
+            if (levels[level].size() != ExpectedSize(width, height, faces, level)) {
+                CORE_ERROR("Invalid size of level {0} for KTX2 file: {1}", level, filepath);
+                return false;
+            }
+        }
+
+        size_t dfd_offset = sizeof(KTXHeader) + n_levels * sizeof(KTXLevel);
+        size_t data_offset = Align8(dfd_offset + sizeof(dfd));
+
+        // the smallest level goes first, but the level index is still ordered from the base level
+        std::vector<KTXLevel> index(n_levels);
+        size_t offset = data_offset;
+
+        for (uint32_t level = n_levels; level-- > 0;) {
+            index[level] = { offset, levels[level].size(), levels[level].size() };
+            offset = Align8(offset + levels[level].size());
+        }
+
+        KTXHeader header {};
+        std::memcpy(header.identifier, identifier, sizeof(identifier));
+        header.vk_format   = vk_format_rgba16f;
+        header.type_size   = 2;
+        header.pixel_width = width;
+        header.pixel_height = height;
+        header.face_count  = faces;
+        header.level_count = n_levels;
+        header.dfd_offset  = static_cast<uint32_t>(dfd_offset);
+        header.dfd_length  = sizeof(dfd);
+
+        std::vector<uint8_t> buffer(offset, 0);
+        std::memcpy(buffer.data(), &header, sizeof(KTXHeader));
+        std::memcpy(buffer.data() + sizeof(KTXHeader), index.data(), n_levels * sizeof(KTXLevel));
+
+        std::memcpy(buffer.data() + dfd_offset, dfd, sizeof(dfd));
+
+        for (uint32_t level = 0; level < n_levels; level++) {
+            std::memcpy(buffer.data() + index[level].offset, levels[level].data(), levels[level].size());
+        }
+
+        return WriteFileAtomic(filepath, buffer.data(), buffer.size());
+    }
+
+}
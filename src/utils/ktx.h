@@ -0,0 +1,63 @@
+/*
+   a minimal reader and writer for KTX2 files, the Khronos container for GPU textures, used to
+   persist the baked IBL maps under `paths::cache` (see "asset/ibl.h"). We only ever store the
+   textures we render to ourselves, so only what we need is supported: uncompressed RGBA16F
+   (`VK_FORMAT_R16G16B16A16_SFLOAT`) 2D textures or cubemaps with a full or partial mip chain,
+   no array layers, no supercompression. Files written here follow the spec (header, level
+   index and a basic data format descriptor), so they can be opened by other KTX2 tools, but
+   files produced elsewhere are only accepted if they use the same layout.
+
+   the levels are stored from the smallest to the largest as the spec requires, each one padded
+   to 8 bytes, within a level the six faces of a cubemap are contiguous in GL order (+x, -x, +y,
+   -y, +z, -z), which is also what `glGetTextureImage()` returns and `glTextureSubImage3D()`
+   expects, so a level can be read back or uploaded in one call.
+
+   like `BlockImage`, the file is memory-mapped on read, `LevelData()` points right into the
+   mapping, so the pointers are only valid as long as the `KTXFile` object is alive.
+
+   > KTXFile::Write(path, width, height, 6, levels);  // levels[0] is the base level
+   > auto file = KTXFile(path);
+   > if (file.Valid()) { upload(file.LevelData(0), file.LevelSize(0)); }
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+    class MappedFile;  // forward declaration
+
+    class KTXFile {
+      private:
+        uint32_t width = 0, height = 0, faces = 0;
+        std::vector<uint64_t> offsets;  // byte offset of each mip level, base level first
+        std::vector<uint64_t> sizes;    // byte size of each mip level
+        std::unique_ptr<MappedFile> file;
+
+      public:
+        explicit KTXFile(const std::string& filepath);
+        ~KTXFile();
+
+        KTXFile(const KTXFile&) = delete;
+        KTXFile& operator=(const KTXFile&) = delete;
+        KTXFile(KTXFile&& other) noexcept = default;
+        KTXFile& operator=(KTXFile&& other) noexcept = default;
+
+        bool Valid() const { return !offsets.empty(); }
+        uint32_t Width() const { return width; }
+        uint32_t Height() const { return height; }
+        uint32_t Faces() const { return faces; }
+        uint32_t Levels() const { return static_cast<uint32_t>(offsets.size()); }
+
+        const uint8_t* LevelData(uint32_t level) const;
+        size_t LevelSize(uint32_t level) const;
+
+        static bool Write(const std::string& filepath, uint32_t width, uint32_t height, uint32_t faces,
+            const std::vector<std::vector<uint8_t>>& levels);
+    };
+
+}
@@ -0,0 +1,635 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+#include "utils/meshopt.h"
+#include "utils/profile.h"
+
+namespace utils::meshopt {
+
+    // simulates a FIFO post-transform cache, a vertex is in the cache if fewer than `size`
+    // misses happened since it was last loaded, so a flush is just a jump of the timestamp
+    class FIFOCache {
+      private:
+        std::vector<uint32_t> load_time;
+        uint32_t timestamp;
+        uint32_t size;
+
+      public:
+        FIFOCache(size_t n_verts, uint32_t size) : load_time(n_verts, 0), timestamp(size + 1), size(size) {}
+
+        uint32_t Age(uint32_t v) const { return timestamp - load_time[v]; }
+        void Flush() { timestamp += size + 1; }
+
+        bool Miss(uint32_t v) {
+            if (timestamp - load_time[v] > size) {
+                load_time[v] = timestamp++;
+                return true;
+            }
+            return false;
+        }
+    };
+
+    // the quadric error metric of Garland and Heckbert, the weighted sum of the squared distances
+    // from a point to a set of planes, stored as the symmetric 4x4 matrix (A, b, c) of p'Ap + 2b'p + c.
+    // The sum of the weights is kept as well, so that the error is a weighted mean, i.e. a squared
+    // distance that doesn't depend on the scale of the weights (the areas) or on how many there are
+    struct Quadric {
+        double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+        double w = 0.0;
+
+        Quadric() = default;
+        Quadric(const glm::dvec3& n, double d, double w)
+            : a00(w * n.x * n.x), a11(w * n.y * n.y), a22(w * n.z * n.z)
+            , a01(w * n.x * n.y), a02(w * n.x * n.z), a12(w * n.y * n.z)
+            , b0(w * n.x * d), b1(w * n.y * d), b2(w * n.z * d), c(w * d * d), w(w) {}
+
+        Quadric& operator+=(const Quadric& q) {
+            a00 += q.a00; a11 += q.a11; a22 += q.a22; a01 += q.a01; a02 += q.a02; a12 += q.a12;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c; w += q.w;
+            return *this;
+        }
+
+        double Error(const glm::dvec3& p) const {
+            double e = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return w > 0.0 ? std::max(e / w, 0.0) : 0.0;  // can be slightly negative due to rounding
+        }
+    };
+
+    static glm::dvec3 Position(const float* positions, size_t stride, uint32_t v) {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + v * stride);
+        return glm::dvec3(p[0], p[1], p[2]);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    std::vector<uint32_t> OptimizeVertexCache(uint32_t* indices, size_t n_indices, size_t n_verts, uint32_t cache_size) {
+        PROFILE_FUNCTION();
+        size_t n_tris = n_indices / 3;
+        std::vector<uint32_t> clusters;
+
+        if (n_tris == 0) {
+            return clusters;
+        }
+
+        // vertex -> triangles adjacency, the triangles of vertex v are in [offsets[v], offsets[v + 1])
+        std::vector<uint32_t> live(n_verts, 0);  // number of triangles not emitted yet, per vertex
+        std::vector<uint32_t> offsets(n_verts + 1, 0);
+        std::vector<uint32_t> adjacency(n_tris * 3);
+
+        for (size_t i = 0; i < n_tris * 3; i++) {
+            live[indices[i]]++;
+        }
+
+        std::partial_sum(live.begin(), live.end(), offsets.begin() + 1);
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+        for (size_t i = 0; i < n_tris * 3; i++) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<uint32_t> result;
+        std::vector<uint32_t> dead_end;    // recently emitted vertices, to resume from when fanning stalls
+        std::vector<uint32_t> candidates;  // vertices of the triangles emitted in this fan
+        std::vector<uint8_t> emitted(n_tris, 0);
+
+        result.reserve(n_tris * 3);
+        dead_end.reserve(n_tris * 3);
+        clusters.push_back(0);
+
+        auto cache = FIFOCache(n_verts, cache_size);
+        uint32_t cursor = 0;   // for the linear scan, every vertex before it has no live triangle left
+        uint32_t fanning = 0;  // the vertex whose remaining triangles are emitted next
+
+        while (fanning != unused) {
+            candidates.clear();
+
+            for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; k++) {
+                uint32_t t = adjacency[k];
+                if (emitted[t]) {
+                    continue;
+                }
+
+                for (uint32_t c = 0; c < 3; c++) {
+                    uint32_t v = indices[t * 3 + c];
+                    result.push_back(v);
+                    dead_end.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    cache.Miss(v);
+                }
+
+                emitted[t] = 1;
+            }
+
+            // prefer the oldest candidate that will still be in the cache after its own fan, which
+            // may cost up to 2 new vertices per remaining triangle, the others would be reloaded,
+            // but any live candidate is still better than none, which would leave the neighborhood
+            uint32_t next = unused;
+            int64_t best = -1;
+
+            for (uint32_t v : candidates) {
+                if (live[v] > 0) {
+                    uint32_t age = cache.Age(v);
+                    int64_t priority = age + 2 * live[v] <= cache_size ? age : 0;
+                    if (priority > best) {
+                        best = priority;
+                        next = v;
+                    }
+                }
+            }
+
+            while (next == unused && !dead_end.empty()) {
+                uint32_t v = dead_end.back();
+                dead_end.pop_back();
+                next = live[v] > 0 ? v : unused;
+            }
+
+            if (next == unused) {
+                for (; next == unused && cursor < n_verts; cursor++) {
+                    next = live[cursor] > 0 ? cursor : unused;
+                }
+
+                // the fan jumps to an unrelated part of the mesh and locality is lost, which makes
+                // it a hard boundary for the overdraw pass
+                uint32_t n_emitted = static_cast<uint32_t>(result.size() / 3);
+                if (next != unused && n_emitted > clusters.back()) {
+                    clusters.push_back(n_emitted);
+                }
+            }
+
+            fanning = next;
+        }
+
+        std::memcpy(indices, result.data(), result.size() * sizeof(uint32_t));
+        return clusters;
+    }
+
+    void OptimizeOverdraw(uint32_t* indices, size_t n_indices, const float* positions, size_t stride, size_t n_verts,
+        const std::vector<uint32_t>& clusters, float threshold, uint32_t cache_size)
+    {
+        PROFILE_FUNCTION();
+        uint32_t n_tris = static_cast<uint32_t>(n_indices / 3);
+
+        if (n_tris == 0 || clusters.empty()) {
+            return;
+        }
+
+        // split the hard clusters into soft clusters wherever the miss ratio so far is good enough
+        auto cache = FIFOCache(n_verts, cache_size);
+        std::vector<uint32_t> soft;
+
+        for (size_t c = 0; c < clusters.size(); c++) {
+            uint32_t start = clusters[c];
+            uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : n_tris;
+            uint32_t misses = 0;
+
+            cache.Flush();
+            for (uint32_t i = start * 3; i < end * 3; i++) {
+                misses += cache.Miss(indices[i]);
+            }
+
+            float limit = threshold * misses / (end - start);
+            uint32_t begin = start;
+            misses = 0;
+
+            cache.Flush();
+            soft.push_back(start);
+
+            for (uint32_t t = start; t < end; t++) {
+                misses += cache.Miss(indices[t * 3 + 0]);
+                misses += cache.Miss(indices[t * 3 + 1]);
+                misses += cache.Miss(indices[t * 3 + 2]);
+
+                if (t + 1 < end && misses <= limit * (t + 1 - begin)) {
+                    soft.push_back(t + 1);
+                    begin = t + 1;
+                    misses = 0;
+                    cache.Flush();  // the clusters are about to be shuffled, the next one starts cold
+                }
+            }
+        }
+
+        auto position = [&](uint32_t v) { return Position(positions, stride, v); };
+
+        // the area-weighted centroid and normal of each cluster, and the centroid of the mesh
+        size_t n_clusters = soft.size();
+        std::vector<glm::dvec3> centroids(n_clusters);
+        std::vector<glm::dvec3> normals(n_clusters);
+        glm::dvec3 mesh_centroid = glm::dvec3(0.0);
+        double mesh_area = 0.0;
+
+        for (size_t c = 0; c < n_clusters; c++) {
+            uint32_t start = soft[c];
+            uint32_t end = c + 1 < n_clusters ? soft[c + 1] : n_tris;
+            glm::dvec3 weighted = glm::dvec3(0.0);
+            glm::dvec3 normal = glm::dvec3(0.0);
+            double area = 0.0;
+
+            for (uint32_t t = start; t < end; t++) {
+                glm::dvec3 p0 = position(indices[t * 3 + 0]);
+                glm::dvec3 p1 = position(indices[t * 3 + 1]);
+                glm::dvec3 p2 = position(indices[t * 3 + 2]);
+                glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);  // length = 2 x area
+                double w = glm::length(n);
+
+                weighted += (p0 + p1 + p2) * (w / 3.0);
+                normal += n;
+                area += w;
+            }
+
+            centroids[c] = area > 0.0 ? weighted / area : weighted;
+            normals[c] = glm::length(normal) > 0.0 ? glm::normalize(normal) : normal;
+            mesh_centroid += weighted;
+            mesh_area += area;
+        }
+
+        mesh_centroid = mesh_area > 0.0 ? mesh_centroid / mesh_area : mesh_centroid;
+
+        // clusters facing away from the center are on the outside, so they are likely to occlude
+        std::vector<double> keys(n_clusters);
+        std::vector<uint32_t> order(n_clusters);
+
+        for (size_t c = 0; c < n_clusters; c++) {
+            keys[c] = glm::dot(centroids[c] - mesh_centroid, normals[c]);
+            order[c] = static_cast<uint32_t>(c);
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+        std::vector<uint32_t> result;
+        result.reserve(n_tris * 3);
+
+        for (uint32_t c : order) {
+            uint32_t start = soft[c];
+            uint32_t end = c + 1 < n_clusters ? soft[c + 1] : n_tris;
+            result.insert(result.end(), indices + start * 3, indices + end * 3);
+        }
+
+        std::memcpy(indices, result.data(), result.size() * sizeof(uint32_t));
+    }
+
+    std::vector<uint32_t> OptimizeVertexFetch(uint32_t* indices, size_t n_indices, size_t n_verts) {
+        PROFILE_FUNCTION();
+        std::vector<uint32_t> remap(n_verts, unused);
+        uint32_t next = 0;
+
+        for (size_t i = 0; i < n_indices; i++) {
+            uint32_t& v = indices[i];
+            if (remap[v] == unused) {
+                remap[v] = next++;
+            }
+            v = remap[v];
+        }
+
+        return remap;
+    }
+
+    size_t Simplify(uint32_t* dst, const uint32_t* indices, size_t n_indices, const float* positions, size_t stride,
+        size_t n_verts, size_t target_indices, float max_error, float* result_error)
+    {
+        PROFILE_FUNCTION();
+        auto position = [&](uint32_t v) { return Position(positions, stride, v); };
+
+        std::vector<uint32_t> result(indices, indices + n_indices);
+        double error = 0.0;  // of the worst collapse so far, squared distance
+        double limit = static_cast<double>(max_error) * max_error;
+
+        // vertices at the same position (on a UV or normal seam) are wedges of the same point,
+        // each one points to the first wedge of its point, which stands for all of them
+        std::vector<uint32_t> wedge(n_verts);
+        std::vector<uint32_t> order(n_verts);
+        std::iota(order.begin(), order.end(), 0U);
+
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            glm::dvec3 pa = position(a), pb = position(b);
+            return std::tie(pa.x, pa.y, pa.z) < std::tie(pb.x, pb.y, pb.z);
+        });
+
+        for (size_t i = 0; i < n_verts; i++) {
+            uint32_t v = order[i];
+            wedge[v] = i > 0 && position(order[i - 1]) == position(v) ? wedge[order[i - 1]] : v;
+        }
+
+        // only vertices in the interior of a manifold surface can be moved, the ones on a seam or
+        // an open border are locked, otherwise the mesh would crack open or the UVs would tear.
+        // An edge (in wedge space) is manifold if it's used once in each direction
+        std::vector<uint8_t> locked(n_verts, 0);
+        std::unordered_map<uint64_t, uint32_t> edges;
+        edges.reserve(n_indices);
+
+        auto edge_key = [&wedge](uint32_t a, uint32_t b) { return (uint64_t(wedge[a]) << 32) | wedge[b]; };
+
+        for (size_t i = 0; i < n_indices; i++) {
+            edges[edge_key(indices[i], indices[i - i % 3 + (i + 1) % 3])]++;
+        }
+
+        for (size_t i = 0; i < n_indices; i++) {
+            uint32_t a = indices[i];
+            uint32_t b = indices[i - i % 3 + (i + 1) % 3];
+            auto twin = edges.find(edge_key(b, a));
+
+            if (edges[edge_key(a, b)] != 1 || twin == edges.end() || twin->second != 1) {
+                locked[wedge[a]] = locked[wedge[b]] = 1;
+            }
+        }
+
+        for (uint32_t v = 0; v < n_verts; v++) {
+            locked[wedge[v]] |= wedge[v] != v;  // a point with more than one wedge
+        }
+
+        for (uint32_t v = 0; v < n_verts; v++) {
+            locked[v] = locked[wedge[v]];
+        }
+
+        // each vertex starts with the planes of its triangles, weighted by their areas
+        std::vector<Quadric> quadrics(n_verts);
+
+        for (size_t i = 0; i < n_indices; i += 3) {
+            glm::dvec3 p0 = position(indices[i + 0]);
+            glm::dvec3 n = glm::cross(position(indices[i + 1]) - p0, position(indices[i + 2]) - p0);
+            double area = glm::length(n);
+
+            if (area > 0.0) {
+                n /= area;
+                auto plane = Quadric(n, -glm::dot(n, p0), area * 0.5);
+                quadrics[indices[i + 0]] += plane;
+                quadrics[indices[i + 1]] += plane;
+                quadrics[indices[i + 2]] += plane;
+            }
+        }
+
+        struct Collapse {
+            uint32_t src, dst;
+            double cost;
+        };
+
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> offsets(n_verts + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> remap(n_verts);
+        std::vector<uint8_t> touched(n_verts);
+
+        // moving `src` onto `dst` must not flip any of the triangles that survive the collapse
+        auto flips = [&](uint32_t src, uint32_t dst) {
+            for (uint32_t k = offsets[src]; k < offsets[src + 1]; k++) {
+                const uint32_t* tri = &result[adjacency[k] * 3];
+                uint32_t v[3] = { remap[tri[0]], remap[tri[1]], remap[tri[2]] };
+
+                if (v[0] == dst || v[1] == dst || v[2] == dst) {
+                    continue;  // this one is collapsed
+                }
+
+                glm::dvec3 p[3] = { position(v[0]), position(v[1]), position(v[2]) };
+                glm::dvec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+                for (int c = 0; c < 3; c++) {
+                    p[c] = v[c] == src ? position(dst) : p[c];
+                }
+
+                glm::dvec3 n1 = glm::cross(p[1] - p[0], p[2] - p[0]);
+                if (glm::dot(n0, n1) <= 1e-2 * glm::length(n0) * glm::length(n1)) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        // collapse the cheapest edges in passes, a vertex can only take part in one collapse per
+        // pass, so the costs sorted at the start of a pass stay valid until the end of it
+        while (result.size() > target_indices) {
+            std::fill(offsets.begin(), offsets.end(), 0U);
+            for (uint32_t v : result) {
+                offsets[v + 1]++;
+            }
+
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            adjacency.resize(result.size());
+
+            for (size_t i = 0; i < result.size(); i++) {
+                adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+
+            collapses.clear();
+
+            for (size_t i = 0; i < result.size(); i++) {
+                uint32_t a = result[i];
+                uint32_t b = result[i - i % 3 + (i + 1) % 3];
+
+                if (a > b || (locked[a] && locked[b])) {
+                    continue;  // interior edges are seen twice, once in each direction
+                }
+
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+
+                double ab = locked[a] ? std::numeric_limits<double>::max() : q.Error(position(b));
+                double ba = locked[b] ? std::numeric_limits<double>::max() : q.Error(position(a));
+                collapses.push_back(ab <= ba ? Collapse { a, b, ab } : Collapse { b, a, ba });
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+            std::iota(remap.begin(), remap.end(), 0U);
+            std::fill(touched.begin(), touched.end(), uint8_t(0));
+
+            size_t goal = (result.size() - target_indices + 2) / 3;  // number of triangles to remove
+            size_t n_removed = 0, n_applied = 0;
+
+            for (const auto& collapse : collapses) {
+                if (collapse.cost > limit || n_removed >= goal) {
+                    break;
+                }
+
+                if (touched[collapse.src] || touched[collapse.dst] || flips(collapse.src, collapse.dst)) {
+                    continue;
+                }
+
+                for (uint32_t k = offsets[collapse.src]; k < offsets[collapse.src + 1]; k++) {
+                    const uint32_t* tri = &result[adjacency[k] * 3];
+                    n_removed += remap[tri[0]] == collapse.dst || remap[tri[1]] == collapse.dst || remap[tri[2]] == collapse.dst;
+                }
+
+                remap[collapse.src] = collapse.dst;
+                quadrics[collapse.dst] += quadrics[collapse.src];
+                touched[collapse.src] = touched[collapse.dst] = 1;
+                error = std::max(error, collapse.cost);
+                n_applied++;
+            }
+
+            if (n_applied == 0) {
+                break;  // locked down or out of error budget
+            }
+
+            size_t n_kept = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+                if (a != b && b != c && c != a) {
+                    result[n_kept++] = a;
+                    result[n_kept++] = b;
+                    result[n_kept++] = c;
+                }
+            }
+
+            result.resize(n_kept);
+        }
+
+        if (result_error) {
+            *result_error = static_cast<float>(std::sqrt(error));
+        }
+
+        std::memcpy(dst, result.data(), result.size() * sizeof(uint32_t));
+        return result.size();
+    }
+
+    std::vector<Meshlet> BuildMeshlets(const uint32_t* indices, size_t n_indices, const float* positions, size_t stride,
+        size_t n_verts, uint32_t max_vertices, uint32_t max_triangles)
+    {
+        PROFILE_FUNCTION();
+        auto position = [&](uint32_t v) { return Position(positions, stride, v); };
+
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> owner(n_verts, unused);  // the last meshlet that referenced a vertex
+
+        auto finish = [&](uint32_t first, uint32_t count, uint32_t n_unique) {
+            Meshlet& meshlet = meshlets.emplace_back();
+            meshlet.first_index = first;
+            meshlet.n_indices = count;
+            meshlet.n_verts = n_unique;
+            meshlet.padding = 0;
+
+            glm::dvec3 min_pos = position(indices[first]);
+            glm::dvec3 max_pos = min_pos;
+
+            for (uint32_t i = first; i < first + count; i++) {
+                min_pos = glm::min(min_pos, position(indices[i]));
+                max_pos = glm::max(max_pos, position(indices[i]));
+            }
+
+            glm::dvec3 center = (min_pos + max_pos) * 0.5;
+            glm::dvec3 axis = glm::dvec3(0.0);
+            double radius = 0.0;
+
+            for (uint32_t i = first; i < first + count; i += 3) {
+                glm::dvec3 p0 = position(indices[i + 0]);
+                glm::dvec3 p1 = position(indices[i + 1]);
+                glm::dvec3 p2 = position(indices[i + 2]);
+                glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+                double area = glm::length(n);
+
+                radius = std::max({ radius, glm::distance(center, p0), glm::distance(center, p1), glm::distance(center, p2) });
+                axis += area > 0.0 ? n / area : n;
+            }
+
+            // the cone must contain the normals of all triangles, with a margin for float precision
+            double length = glm::length(axis);
+            double min_dot = length > 0.0 ? 1.0 : -1.0;
+            axis = length > 0.0 ? axis / length : axis;
+
+            for (uint32_t i = first; i < first + count && length > 0.0; i += 3) {
+                glm::dvec3 p0 = position(indices[i + 0]);
+                glm::dvec3 n = glm::cross(position(indices[i + 1]) - p0, position(indices[i + 2]) - p0);
+                double area = glm::length(n);
+                min_dot = area > 0.0 ? std::min(min_dot, glm::dot(n / area, axis)) : min_dot;
+            }
+
+            min_dot -= 1e-3;
+
+            for (int k = 0; k < 3; k++) {
+                meshlet.center[k] = static_cast<float>(center[k]);
+                meshlet.cone_axis[k] = static_cast<float>(axis[k]);
+            }
+
+            meshlet.radius = static_cast<float>(radius);
+            meshlet.cone_cutoff = min_dot <= 0.0 ? 1.0f : static_cast<float>(std::sqrt(1.0 - min_dot * min_dot));
+        };
+
+        uint32_t first = 0, n_unique = 0;
+
+        for (uint32_t i = 0; i + 2 < n_indices; i += 3) {
+            uint32_t id = static_cast<uint32_t>(meshlets.size());
+            uint32_t n_new = 0;
+
+            for (uint32_t k = 0; k < 3; k++) {
+                bool seen = owner[indices[i + k]] == id || (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+                n_new += seen ? 0 : 1;
+            }
+
+            if (n_unique + n_new > max_vertices || (i - first) / 3 + 1 > max_triangles) {
+                finish(first, i - first, n_unique);
+                first = i;
+                n_unique = 0;
+                id++;
+            }
+
+            for (uint32_t k = 0; k < 3; k++) {
+                if (owner[indices[i + k]] != id) {
+                    owner[indices[i + k]] = id;
+                    n_unique++;
+                }
+            }
+        }
+
+        if (n_indices >= 3) {
+            finish(first, static_cast<uint32_t>(n_indices / 3 * 3) - first, n_unique);
+        }
+
+        return meshlets;
+    }
+
+    CacheStats AnalyzeVertexCache(const uint32_t* indices, size_t n_indices, size_t n_verts, uint32_t cache_size) {
+        auto cache = FIFOCache(n_verts, cache_size);
+        std::vector<uint8_t> used(n_verts, 0);
+        size_t misses = 0, n_unique = 0;
+
+        for (size_t i = 0; i < n_indices; i++) {
+            misses += cache.Miss(indices[i]);
+            n_unique += used[indices[i]] == 0;
+            used[indices[i]] = 1;
+        }
+
+        CacheStats stats;
+        stats.acmr = n_indices < 3 ? 0.0f : static_cast<float>(misses) / (n_indices / 3);
+        stats.atvr = n_unique == 0 ? 0.0f : static_cast<float>(misses) / n_unique;
+        return stats;
+    }
+
+    float AnalyzeVertexFetch(const uint32_t* indices, size_t n_indices, size_t n_verts, size_t vertex_size) {
+        constexpr size_t line_size = 64;
+        constexpr size_t n_lines = 64;  // direct-mapped, 4 KB
+
+        auto cache = FIFOCache(n_verts, 16);
+        std::vector<size_t> lines(n_lines, ~size_t(0));
+        std::vector<uint8_t> used(n_verts, 0);
+        size_t bytes = 0, n_unique = 0;
+
+        for (size_t i = 0; i < n_indices; i++) {
+            uint32_t v = indices[i];
+            n_unique += used[v] == 0;
+            used[v] = 1;
+
+            if (!cache.Miss(v)) {
+                continue;  // the shaded vertex is reused, no fetch
+            }
+
+            size_t first = v * vertex_size / line_size;
+            size_t last = (v * vertex_size + vertex_size - 1) / line_size;
+
+            for (size_t line = first; line <= last; line++) {
+                if (lines[line % n_lines] != line) {
+                    lines[line % n_lines] = line;
+                    bytes += line_size;
+                }
+            }
+        }
+
+        return n_unique == 0 ? 0.0f : static_cast<float>(bytes) / (n_unique * vertex_size);
+    }
+
+}
@@ -0,0 +1,139 @@
+/*
+   CPU passes that reorder the triangles and vertices of an indexed triangle list for faster
+   rendering, without changing what is drawn, and that simplify it into coarser levels of
+   detail. They run once after a model is imported (see
+   `Model::ProcessMesh()`), the result is saved in the binary cache, so it's not a runtime cost.
+   Like "utils/bcn.h", this is pure CPU code with no dependency on OpenGL, the statistics can
+   be used to benchmark the passes in a tool or a test without a GPU.
+
+   # vertex cache
+
+   after a vertex is shaded, the GPU keeps the result in a small post-transform cache, so that
+   triangles sharing the vertex don't shade it again. Meshes coming out of Assimp are in the
+   order of the source file, which often jumps all over the mesh. `OptimizeVertexCache()` uses
+   Tipsify (Sander et al. 2007): it "fans" around one vertex at a time, emitting all of its
+   remaining triangles, then picks the next fanning vertex among the ones just emitted that
+   are still in the cache, and only falls back to a dead-end stack or a linear scan when none
+   is left, so it runs in linear time. Every fall back flushes the locality, the triangle index
+   where it happens is a "hard" cluster boundary, needed by the overdraw pass.
+
+   # overdraw
+
+   `OptimizeOverdraw()` splits the hard clusters further into "soft" clusters, as long as the
+   cache miss ratio of the part being split stays within `threshold` times that of the whole
+   cluster (e.g. 1.05 = at most 5% worse), then sorts the clusters so that the ones facing
+   outward from the mesh center are drawn first, they are the most likely to occlude the rest,
+   and early-z can then discard more fragments. A larger threshold gives more clusters, less
+   overdraw and worse vertex cache efficiency.
+
+   # vertex fetch
+
+   `OptimizeVertexFetch()` renumbers the vertices in the order they are first referenced by
+   the (reordered) index buffer, so that consecutive vertex fetches hit the same cache lines,
+   vertices not referenced at all are dropped. It only builds the remap table and rewrites the
+   indices, `RemapVertices()` moves the vertices, so any vertex type works.
+
+   # simplification
+
+   `Simplify()` builds a coarser index buffer over the same vertices, by collapsing edges in
+   the order of their quadric error (Garland and Heckbert 1997), a vertex is always collapsed
+   onto one of its neighbors, so no vertex is created and all levels of detail can share one
+   vertex buffer. Collapses are done in passes over a sorted list of edges, each vertex moves
+   at most once per pass, and those that would flip a triangle are skipped. Vertices on open
+   borders and attribute seams (several vertices at the same position) are locked in place,
+   so the mesh never cracks and the UVs never tear, at the cost of a lower reduction on meshes
+   with many seams. It stops at `target_indices` or `max_error`, whichever comes first, and
+   reports the error it reached, as a distance in the same unit as the positions.
+
+   # meshlets
+
+   `BuildMeshlets()` splits an index buffer into clusters of at most `max_vertices` unique
+   vertices and `max_triangles` triangles (64 and 124 fit the limits of most mesh shader
+   hardware), by scanning the triangles in order and starting a new meshlet when one is full,
+   so the index buffer should be optimized for the vertex cache first, which keeps neighbors
+   together. Each meshlet is a contiguous range of the index buffer, with a bounding sphere
+   and a normal cone for culling: if the camera lies within the cone extended by the sphere,
+   every triangle of the meshlet is back-facing. The record is laid out for a std430 buffer
+   (see "core/cull_meshlet.glsl").
+
+   # statistics
+
+   > ACMR: average cache miss ratio, transformed vertices per triangle, 0.5 is the ideal value
+           for a large regular grid, and 3 is the worst case (no reuse at all)
+   > ATVR: average transformed vertex ratio, transformed vertices per unique vertex, 1 is the
+           ideal value, better than ACMR to compare meshes of different topology
+   > overfetch: bytes read from the vertex buffer per byte of vertex data, simulating a cache
+                of 64-byte lines, 1 is the ideal value
+
+   the caches are simulated as FIFO of `cache_size` vertices, which is how older GPUs worked,
+   newer ones process vertices in batches, but an order that is good for the FIFO is good for
+   them too. 16 is a conservative size that works well across vendors.
+
+   > auto clusters = meshopt::OptimizeVertexCache(indices.data(), indices.size(), n_verts);
+   > meshopt::OptimizeOverdraw(indices.data(), indices.size(), &vertices[0].position.x, sizeof(Vertex), n_verts, clusters);
+   > auto remap = meshopt::OptimizeVertexFetch(indices.data(), indices.size(), n_verts);
+   > meshopt::RemapVertices(vertices, remap);
+   > size_t n = meshopt::Simplify(lod.data(), indices.data(), indices.size(), positions, stride, n_verts, target, 1e-2f, &error);
+   > auto meshlets = meshopt::BuildMeshlets(indices.data(), indices.size(), positions, stride, n_verts);
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace utils::meshopt {
+
+    inline constexpr uint32_t unused = 0xFFFFFFFF;  // remap value of the vertices no triangle refers to
+
+    struct Meshlet {
+        float center[3];       // bounding sphere
+        float radius;
+        float cone_axis[3];    // average normal of the triangles
+        float cone_cutoff;     // sine of the cone's half angle, 1 if the cone is too wide to cull
+        uint32_t first_index;  // range in the index buffer
+        uint32_t n_indices;
+        uint32_t n_verts;
+        uint32_t padding;
+    };
+
+    static_assert(sizeof(Meshlet) == 48);
+
+    struct CacheStats {
+        float acmr = 0.0f;
+        float atvr = 0.0f;
+    };
+
+    std::vector<uint32_t> OptimizeVertexCache(uint32_t* indices, size_t n_indices, size_t n_verts, uint32_t cache_size = 16);
+
+    void OptimizeOverdraw(uint32_t* indices, size_t n_indices, const float* positions, size_t stride, size_t n_verts,
+        const std::vector<uint32_t>& clusters, float threshold = 1.05f, uint32_t cache_size = 16);
+
+    std::vector<uint32_t> OptimizeVertexFetch(uint32_t* indices, size_t n_indices, size_t n_verts);
+
+    size_t Simplify(uint32_t* dst, const uint32_t* indices, size_t n_indices, const float* positions, size_t stride,
+        size_t n_verts, size_t target_indices, float max_error, float* result_error = nullptr);
+
+    std::vector<Meshlet> BuildMeshlets(const uint32_t* indices, size_t n_indices, const float* positions, size_t stride,
+        size_t n_verts, uint32_t max_vertices = 64, uint32_t max_triangles = 124);
+
+    CacheStats AnalyzeVertexCache(const uint32_t* indices, size_t n_indices, size_t n_verts, uint32_t cache_size = 16);
+    float AnalyzeVertexFetch(const uint32_t* indices, size_t n_indices, size_t n_verts, size_t vertex_size);
+
+    template<typename T>
+    void RemapVertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap) {
+        size_t n_used = 0;
+        std::vector<T> result(vertices.size());
+
+        for (size_t i = 0; i < vertices.size(); i++) {
+            if (remap[i] != unused) {
+                result[remap[i]] = vertices[i];
+                n_used++;
+            }
+        }
+
+        result.resize(n_used);
+        vertices = std::move(result);
+    }
+
+}
@@ -6,7 +6,7 @@ namespace utils::paths {
     std::filesystem::path solution;
 
     std::string root, source, resource;
-    std::string font, model, screenshot, shader, texture;
+    std::string cache, font, model, screenshot, shader, texture;
 
     /* current working directory could either be the vs2019 project folder or the target
        folders that contain the executables, thus it can vary depending on how and where
@@ -44,11 +44,15 @@ namespace utils::paths {
         source   = src_path.string() + "\\";
         resource = res_path.string() + "\\";
 
+        cache      = (res_path / "cache"     ).string() + "\\";
         font       = (res_path / "font"      ).string() + "\\";
         model      = (res_path / "model"     ).string() + "\\";
         screenshot = (res_path / "screenshot").string() + "\\";
         shader     = (res_path / "shader"    ).string() + "\\";
         texture    = (res_path / "texture"   ).string() + "\\";
+
+        // binary caches are generated at runtime, they are not checked into the repository
+        std::filesystem::create_directories(res_path / "cache");
     }
 
 }
\ No newline at end of file
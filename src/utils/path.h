@@ -11,6 +11,7 @@ namespace utils::paths {
     extern std::string source;
     extern std::string resource;
 
+    extern std::string cache;
     extern std::string font;
     extern std::string model;
     extern std::string screenshot;
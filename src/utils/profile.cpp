@@ -1,9 +1,343 @@
 #include "pch.h"
 
+#include <mutex>
+#include "core/log.h"
 #include "utils/profile.h"
 
 namespace utils {
 
+    struct Event {
+        const char* name = nullptr;
+        uint64_t ts = 0;     // start time in nanoseconds
+        uint64_t dur = 0;    // duration in nanoseconds (complete events only)
+        double value = 0.0;  // counter value (counter events only)
+        char phase = 'X';    // chrome trace event type: 'X' complete, 'C' counter, 'i' instant
+    };
 
+    struct ThreadBuffer {
+        static constexpr uint64_t capacity = 1 << 15;  // must be a power of 2
+        std::vector<Event> events = std::vector<Event>(capacity);
+        std::atomic<uint64_t> head { 0 };  // total number of events written, only the owner writes
+        std::string name;
+        size_t tid = 0;
+    };
+
+    static const auto epoch = std::chrono::steady_clock::now();
+    static std::mutex registry_mutex;  // only guards the list of buffers, never held while recording
+    static std::vector<std::unique_ptr<ThreadBuffer>> registry;
+    static thread_local ThreadBuffer* local_buffer = nullptr;
+
+    static ThreadBuffer& GetThreadBuffer() {
+        if (local_buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            auto& buffer = registry.emplace_back(std::make_unique<ThreadBuffer>());
+            buffer->tid = registry.size();
+            buffer->name = "Thread " + std::to_string(buffer->tid);
+            local_buffer = buffer.get();  // buffers outlive their threads so events can still be exported
+        }
+
+        return *local_buffer;
+    }
+
+    static void Record(const Event& event) {
+        auto& buffer = GetThreadBuffer();
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        buffer.events[head & (ThreadBuffer::capacity - 1)] = event;
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    static std::string Escape(const char* str) {
+        std::string out;
+        for (; str != nullptr && *str != '\0'; ++str) {
+            if (*str == '"' || *str == '\\') {
+                out += '\\';
+            }
+            out += *str;
+        }
+        return out;
+    }
+
+    uint64_t CPUProfiler::Now() {
+        auto elapsed = std::chrono::steady_clock::now() - epoch;
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    void CPUProfiler::Complete(const char* name, uint64_t start, uint64_t end) {
+        Record(Event { name, start, end - start, 0.0, 'X' });
+    }
+
+    void CPUProfiler::Counter(const char* name, double value) {
+        if (enabled.load(std::memory_order_relaxed)) {
+            Record(Event { name, Now(), 0, value, 'C' });
+        }
+    }
+
+    void CPUProfiler::FrameMark() {
+        if (enabled.load(std::memory_order_relaxed)) {
+            Record(Event { "Frame", Now(), 0, 0.0, 'i' });
+        }
+    }
+
+    void CPUProfiler::SetThreadName(const std::string& name) {
+        auto& buffer = GetThreadBuffer();
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        buffer.name = name;
+    }
+
+    bool CPUProfiler::Export(const std::string& filepath) {
+        std::ofstream stream(filepath, std::ios::out | std::ios::trunc);
+
+        if (!stream.is_open()) {
+            CORE_ERROR("Unable to export CPU trace to {0}", filepath);
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        std::vector<Event> snapshot;
+        bool first = true;
+
+        auto separator = [&first, &stream]() {
+            stream << (first ? "\n" : ",\n");
+            first = false;
+        };
+
+        stream << std::fixed << std::setprecision(3);
+        stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+        for (const auto& buffer : registry) {
+            separator();
+            stream << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+                   << ", \"args\": {\"name\": \"" << Escape(buffer->name.c_str()) << "\"}}";
+
+            // the owner thread may keep writing while we copy, so after the copy we re-read the
+            // write index and throw away the oldest events that might have been overwritten
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t tail = head > ThreadBuffer::capacity ? head - ThreadBuffer::capacity : 0;
+
+            snapshot.clear();
+            for (uint64_t i = tail; i < head; ++i) {
+                snapshot.push_back(buffer->events[i & (ThreadBuffer::capacity - 1)]);
+            }
+
+            uint64_t new_head = buffer->head.load(std::memory_order_acquire);
+            uint64_t n_stale = new_head >= ThreadBuffer::capacity + tail ? new_head - ThreadBuffer::capacity - tail + 1 : 0;
+
+            for (size_t i = std::min<size_t>(n_stale, snapshot.size()); i < snapshot.size(); ++i) {
+                const auto& e = snapshot[i];
+                separator();
+                stream << "{\"name\": \"" << Escape(e.name) << "\", \"ph\": \"" << e.phase
+                       << "\", \"ts\": " << e.ts * 1e-3 << ", \"pid\": 1, \"tid\": " << buffer->tid;
+
+                if (e.phase == 'X') {
+                    stream << ", \"dur\": " << e.dur * 1e-3;
+                }
+                else if (e.phase == 'C') {
+                    stream << ", \"args\": {\"value\": " << e.value << "}";
+                }
+                else if (e.phase == 'i') {
+                    stream << ", \"s\": \"g\"";  // global instant event, drawn across all threads
+                }
+
+                stream << "}";
+            }
+        }
+
+        stream << "\n]}\n";
+        CORE_INFO("CPU trace has been saved to {0}", filepath);
+        return true;
+    }
+
+    void CPUProfiler::Reset() {
+        // only safe when no other thread is recording, e.g. between two benchmark runs
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (auto& buffer : registry) {
+            buffer->head.store(0, std::memory_order_release);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    struct Query {
+        std::string name;
+        int depth = 0;
+        int count = 1;
+        GLuint start = 0;
+        GLuint end = 0;
+    };
+
+    struct Slot {
+        std::vector<GLuint> pool;    // query objects owned by this slot, grow on demand
+        std::vector<Query> queries;  // sections recorded in this slot
+        size_t n_used = 0;           // number of query objects used in this frame
+        uint64_t frame = 0;          // index of the frame recorded in this slot
+        bool pending = false;
+    };
+
+    static constexpr size_t n_slots = 4;  // frames of latency
+    static std::array<Slot, n_slots> slots {};
+    static std::vector<size_t> stack {};  // indices of the open sections
+    static uint64_t frame_index = 0;
+    static bool recording = false;
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    static GLuint NextQuery(Slot& slot) {
+        if (slot.n_used == slot.pool.size()) {
+            GLuint query = 0;
+            glCreateQueries(GL_TIMESTAMP, 1, &query);
+            slot.pool.push_back(query);
+        }
+
+        return slot.pool[slot.n_used++];
+    }
+
+    static void Resolve(Slot& slot) {
+        using Section = GPUProfiler::Section;
+        auto& results = GPUProfiler::results;
+        slot.pending = false;
+
+        if (slot.queries.empty()) {
+            return;
+        }
+
+        // the root section is closed last, once its end timestamp is available, all the other
+        // queries in this slot must have been executed as well, so reading them will not block
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(slot.queries.front().end, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (available == GL_FALSE) {
+            GPUProfiler::dropped_frames++;  // the GPU is lagging too far behind, drop the frame rather than wait
+            return;
+        }
+
+        results.clear();
+
+        for (const auto& query : slot.queries) {
+            GLuint64 t0 = 0, t1 = 0;  // in nanoseconds
+            glGetQueryObjectui64v(query.start, GL_QUERY_RESULT, &t0);
+            glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &t1);
+            double ms = t1 > t0 ? static_cast<double>(t1 - t0) * 1e-6 : 0.0;
+            results.push_back(Section { query.name, query.depth, query.count, ms });
+        }
+
+        GPUProfiler::results_frame = slot.frame;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    void GPUProfiler::BeginFrame() {
+        if (recording) {
+            EndFrame();  // the last frame was never closed
+        }
+
+        if (!enabled) {
+            return;
+        }
+
+        frame_index++;
+        auto& slot = slots[frame_index % n_slots];
+
+        // this slot was recorded `n_slots` frames ago, read it back before we overwrite it
+        if (slot.pending) {
+            Resolve(slot);
+        }
+
+        slot.queries.clear();
+        slot.n_used = 0;
+        slot.frame = frame_index;
+
+        stack.clear();
+        recording = true;
+        Push("Frame");
+    }
+
+    void GPUProfiler::EndFrame() {
+        if (!recording) {
+            return;
+        }
+
+        while (!stack.empty()) {
+            Pop();  // close all unbalanced sections along with the root section
+        }
+
+        slots[frame_index % n_slots].pending = true;
+        recording = false;
+    }
+
+    void GPUProfiler::Push(const std::string& name) {
+        if (!recording) {
+            return;
+        }
+
+        auto& slot = slots[frame_index % n_slots];
+        int depth = static_cast<int>(stack.size());
+
+        // consecutive sections of the same name are merged into one (e.g. the 512 cloth simulation
+        // dispatches), we just reopen the last section and move its end timestamp forward on pop,
+        // this way a tight loop of dispatches only costs us a single pair of query objects
+        if (!slot.queries.empty()) {
+            auto& last = slot.queries.back();
+            if (last.end > 0 && last.depth == depth && last.name == name) {
+                last.count++;
+                stack.push_back(slot.queries.size() - 1);
+                return;
+            }
+        }
+
+        auto& query = slot.queries.emplace_back();
+
+        query.name = name;
+        query.depth = depth;
+        query.start = NextQuery(slot);
+        glQueryCounter(query.start, GL_TIMESTAMP);
+
+        stack.push_back(slot.queries.size() - 1);
+    }
+
+    void GPUProfiler::Pop() {
+        if (!recording || stack.empty()) {
+            return;
+        }
+
+        auto& slot = slots[frame_index % n_slots];
+        auto& query = slot.queries[stack.back()];
+        stack.pop_back();
+
+        if (query.end == 0) {
+            query.end = NextQuery(slot);
+        }
+
+        glQueryCounter(query.end, GL_TIMESTAMP);
+    }
+
+    double GPUProfiler::FrameTime() {
+        return results.empty() ? 0.0 : results.front().ms;
+    }
+
+    void GPUProfiler::Reset() {
+        // discard all pending frames, their sections may belong to a scene that's already gone
+        for (auto& slot : slots) {
+            slot.queries.clear();
+            slot.n_used = 0;
+            slot.pending = false;
+        }
+
+        stack.clear();
+        results.clear();
+        recording = false;
+    }
+
+    void GPUProfiler::Clear() {
+        Reset();
+
+        for (auto& slot : slots) {
+            if (!slot.pool.empty()) {
+                glDeleteQueries(static_cast<GLsizei>(slot.pool.size()), slot.pool.data());
+                slot.pool.clear();
+            }
+        }
+
+        CORE_TRACE("GPU profiler dropped {0} frames in total", dropped_frames);
+    }
 
 }
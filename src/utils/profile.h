@@ -1,16 +1,148 @@
-/* a wrapper class for the "optick" profiler library
-   https://github.com/bombomby/optick
+/*
+   a lightweight pair of profilers: the CPU profiler records a hierarchical timeline of every
+   thread that can be inspected in `chrome://tracing` or Perfetto, the GPU profiler measures
+   how long each render pass takes on the GPU.
 
-   TODO: integrate optick into our app
-         read the "optick" documentation
-         may need to define a list of macros for each function
-         determine the calling convention of profiling sessions in our codebase
+   # CPU profiler
+
+   instrumentation is done by a set of macros, a scope marker measures the time between its
+   construction and the end of the enclosing scope, nested scopes naturally form a call tree.
+   counters record a value over time (e.g. draw calls), frame markers separate the frames.
+
+   > PROFILE_FUNCTION();                       // the rest of the function, named after it
+   > PROFILE_SCOPE("Assimp::ReadFile");        // the rest of the enclosing scope
+   > PROFILE_COUNTER("Draw Calls", n_draws);   // a counter track
+   > PROFILE_FRAME();                          // beginning of a new frame
+
+   names must be string literals (or have static storage duration), only the pointer is kept.
+   each thread writes into its own ring buffer, so recording an event never takes a lock, we
+   only bump an atomic write index owned by that thread. When a buffer is full, the oldest
+   events are overwritten, so the trace always holds the latest few seconds of each thread.
+   `Export()` snapshots all ring buffers into a JSON file in the chrome trace event format.
+
+   # GPU profiler
+
+   the CPU and the GPU run asynchronously, a draw call returns as soon as the command is put
+   into the driver's queue, so timing a pass on the CPU side only tells us how long it takes
+   to record the commands, not how long the GPU spends on them. To time the GPU itself, we
+   need to insert timestamp queries into the command stream, `glQueryCounter()` records the
+   GPU time at the point when all previous commands have been fully executed.
+
+   reading back a query result right after it's issued is the worst thing we can do, as it
+   forces the CPU to wait until the GPU has caught up, which serializes the pipeline and the
+   act of measuring would itself hurt the frame rate. Instead, queries are allocated in a ring
+   buffer of `n_slots` frames, results of a frame are only read back `n_slots` frames later,
+   at which point they're almost certainly available. If they are still not ready (e.g. when
+   the GPU is heavily lagging behind), that frame is simply dropped, we never stall.
+
+   we are using `GL_TIMESTAMP` rather than `GL_TIME_ELAPSED` queries because the latter can't
+   be nested, only one elapsed query of each target can be active at any given time, whereas
+   a pair of timestamps can be placed anywhere, so sections are free to nest each other.
+
+   # usage
+
+   sections are pushed and popped in a stack-like fashion, nested sections are indented in
+   the profiler window. Compute dispatches, framebuffer blits and `Renderer::Render()` calls
+   are timed automatically, scenes only need to mark the beginning and end of each pass.
+
+   > GPUProfiler::Push("Shadow Pass");
+   > ...
+   > GPUProfiler::Pop();
+
+   > if (GPU_SCOPE("Bloom"); true) { ... }  // RAII alternative, popped at the end of scope
+
+   the profiler has no effect on rendering, but it does add some overhead, it can be turned
+   off at runtime by setting `GPUProfiler::enabled` to false.
 */
 
 #pragma once
 
+#include <atomic>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+#define _SP_CONCAT_IMPL(x, y) x##y
+#define _SP_CONCAT(x, y) _SP_CONCAT_IMPL(x, y)
+
+#define PROFILE_SCOPE(name) ::utils::CPUScope _SP_CONCAT(_cpu_scope_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_COUNTER(name, value) ::utils::CPUProfiler::Counter(name, static_cast<double>(value))
+#define PROFILE_FRAME() ::utils::CPUProfiler::FrameMark()
+
+#define GPU_SCOPE(name) ::utils::GPUScope _SP_CONCAT(_gpu_scope_, __LINE__)(name)
+
 namespace utils {
 
-    class Profiler;
+    class CPUProfiler {
+      public:
+        static inline std::atomic<bool> enabled { true };
+
+        static uint64_t Now();  // nanoseconds since the profiler started
+        static void Complete(const char* name, uint64_t start, uint64_t end);
+        static void Counter(const char* name, double value);
+        static void FrameMark();
+
+        static void SetThreadName(const std::string& name);
+        static bool Export(const std::string& filepath);
+        static void Reset();
+    };
+
+    class CPUScope {
+      private:
+        const char* name;
+        uint64_t start;
+        bool active;
+
+      public:
+        CPUScope(const char* name) : name(name), start(0), active(CPUProfiler::enabled.load(std::memory_order_relaxed)) {
+            if (active) {
+                start = CPUProfiler::Now();
+            }
+        }
+
+        ~CPUScope() {
+            if (active) {
+                CPUProfiler::Complete(name, start, CPUProfiler::Now());
+            }
+        }
+
+        CPUScope(const CPUScope&) = delete;
+        CPUScope& operator=(const CPUScope&) = delete;
+    };
+
+    class GPUProfiler {
+      public:
+        struct Section {
+            std::string name;
+            int depth = 0;     // nesting level, 0 is the root (whole frame)
+            int count = 1;     // number of consecutive sections of the same name merged into this one
+            double ms = 0.0;   // time elapsed on the GPU in milliseconds
+        };
+
+      public:
+        static inline bool enabled = true;
+        static inline uint64_t dropped_frames = 0;
+        static inline uint64_t results_frame = 0;      // index of the frame `results` belongs to
+        static inline std::vector<Section> results {};  // latest resolved frame, in issue order
+
+        static void BeginFrame();
+        static void EndFrame();
+        static void Push(const std::string& name);
+        static void Pop();
+
+        static double FrameTime();
+        static void Reset();
+        static void Clear();
+    };
+
+    class GPUScope {
+      public:
+        GPUScope(const std::string& name) { GPUProfiler::Push(name); }
+        ~GPUScope() { GPUProfiler::Pop(); }
+
+        GPUScope(const GPUScope&) = delete;
+        GPUScope& operator=(const GPUScope&) = delete;
+    };
 
 }
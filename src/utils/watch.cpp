@@ -0,0 +1,118 @@
+#include "pch.h"
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "core/log.h"
+#include "utils/profile.h"
+#include "utils/watch.h"
+
+namespace fs = std::filesystem;
+
+namespace utils {
+
+    DirectoryWatcher::DirectoryWatcher(const std::string& directory) : directory(directory) {
+        // overlapped mode so that the thread can wait on the stop event at the same time
+        handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+
+        if (handle == INVALID_HANDLE_VALUE) {
+            CORE_ERROR("Unable to watch directory: {0} (error = {1})", directory, GetLastError());
+            handle = nullptr;
+            return;
+        }
+
+        stop_event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        thread = std::thread(&DirectoryWatcher::Run, this);
+    }
+
+    DirectoryWatcher::~DirectoryWatcher() {
+        if (thread.joinable()) {
+            SetEvent(stop_event);
+            thread.join();
+        }
+
+        if (stop_event != nullptr) {
+            CloseHandle(stop_event);
+        }
+
+        if (handle != nullptr) {
+            CloseHandle(handle);
+        }
+    }
+
+    void DirectoryWatcher::Run() {
+        utils::CPUProfiler::SetThreadName("Directory Watcher");
+
+        alignas(DWORD) uint8_t buffer[32768];  // must be DWORD-aligned
+        constexpr DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME;
+
+        OVERLAPPED overlapped {};
+        overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        HANDLE events[2] = { overlapped.hEvent, stop_event };
+
+        while (true) {
+            ResetEvent(overlapped.hEvent);
+
+            if (!ReadDirectoryChangesW(handle, buffer, sizeof(buffer), TRUE, filter, nullptr, &overlapped, nullptr)) {
+                CORE_ERROR("Failed to read directory changes: {0} (error = {1})", directory, GetLastError());
+                break;
+            }
+
+            DWORD bytes = 0;
+
+            if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                CancelIoEx(handle, &overlapped);
+                GetOverlappedResult(handle, &overlapped, &bytes, TRUE);  // the buffer must outlive the request
+                break;
+            }
+
+            if (!GetOverlappedResult(handle, &overlapped, &bytes, FALSE)) {
+                CORE_ERROR("Failed to read directory changes: {0} (error = {1})", directory, GetLastError());
+                break;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            last_change = std::chrono::steady_clock::now();
+
+            if (bytes == 0) {
+                CORE_WARN("Too many changes at once in {0}, some of them are lost", directory);
+                continue;
+            }
+
+            for (auto offset = 0UL;;) {
+                auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer + offset);
+
+                // renamed files are reported under their new name, deleted files are ignored
+                if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME) {
+                    auto name = std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR));
+                    auto path = (fs::path(directory) / name).lexically_normal().make_preferred();
+                    changes.insert(path.string());
+                }
+
+                if (info->NextEntryOffset == 0) {
+                    break;
+                }
+
+                offset += info->NextEntryOffset;
+            }
+        }
+
+        CloseHandle(overlapped.hEvent);
+    }
+
+    std::vector<std::string> DirectoryWatcher::Poll(std::chrono::milliseconds quiet) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // wait until the editor is done writing, then report everything at once
+        if (changes.empty() || std::chrono::steady_clock::now() - last_change < quiet) {
+            return {};
+        }
+
+        auto files = std::vector<std::string>(changes.begin(), changes.end());
+        changes.clear();
+        return files;
+    }
+
+}
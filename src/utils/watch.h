@@ -0,0 +1,57 @@
+/*
+   watches a directory tree for file changes, used by the shader hot-reload during development
+   (see "asset/shader.h"). The watcher runs a background thread that blocks on the OS change
+   notifications (`ReadDirectoryChangesW` on Windows, the counterpart of inotify on Linux), so
+   it costs nothing while the files are left alone, there's no polling of timestamps at all.
+
+   the thread only records the paths of the files that have been modified, created or renamed,
+   the main thread picks them up with `Poll()` once per frame. Most editors save a file in more
+   than one write (or write a temp file and rename it), so `Poll()` returns nothing until the
+   directory has been quiet for a short while, and then all the changes at once, each path is
+   reported only once.
+
+   > auto watcher = DirectoryWatcher(paths::shader);
+   > for (const auto& file : watcher.Poll()) { ... }  // absolute, normalized paths
+
+   if the notification buffer overflows (thousands of files changed at once, e.g. a git branch
+   switch), the individual paths are lost, in which case a warning is logged.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+    class DirectoryWatcher {
+      private:
+        std::string directory;
+        void* handle = nullptr;      // Win32 directory handle
+        void* stop_event = nullptr;  // Win32 event that tells the thread to quit
+        std::thread thread;
+
+        std::mutex mutex;  // guards the fields below, which are written by the thread
+        std::set<std::string> changes;
+        std::chrono::steady_clock::time_point last_change;
+
+        void Run();
+
+      public:
+        explicit DirectoryWatcher(const std::string& directory);
+        ~DirectoryWatcher();
+
+        DirectoryWatcher(const DirectoryWatcher&) = delete;
+        DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+        DirectoryWatcher(DirectoryWatcher&& other) = delete;
+        DirectoryWatcher& operator=(DirectoryWatcher&& other) = delete;
+
+        bool Valid() const { return handle != nullptr; }
+        std::vector<std::string> Poll(std::chrono::milliseconds quiet = std::chrono::milliseconds(100));
+    };
+
+}